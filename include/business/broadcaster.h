@@ -0,0 +1,63 @@
+//
+// Created by Cando on 2026/10/19.
+//
+
+#ifndef EASYCHATSERVER_BROADCASTER_H
+#define EASYCHATSERVER_BROADCASTER_H
+
+#include "common/protocol.h"
+#include "common/connection_handle.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace easychat{
+    // 全服广播（维护公告等）-单例模式
+    // 公告只序列化一次，按在线注册表的分片拆成多个任务在工作线程池中并行推送；
+    // 每个任务每轮最多推送batch_size个连接，然后把剩余部分重新排到任务队列末尾，
+    // 期间到达的聊天消息可以插队处理，广播再大也不会长时间占满工作线程
+    class Broadcaster{
+    public:
+        static Broadcaster& getInstance();
+        // 配置每轮推送的连接数与管理员用户ID（逗号分隔，用户名可以被注册或改名，不作为权限依据）
+        void init(size_t batch_size,const std::string& admin_user_ids);
+        // 是否为管理员
+        bool isAdmin(int user_id) const;
+        // 发起广播，返回广播开始时的在线用户数
+        size_t broadcast(const std::string& content);
+        // 正在进行的广播任务数
+        size_t activeTasks() const {return active_tasks_.load(std::memory_order_relaxed);}
+    private:
+        Broadcaster();
+        ~Broadcaster() = default;
+        // 禁止拷贝和赋值
+        Broadcaster(const Broadcaster&) = delete;
+        Broadcaster& operator=(const Broadcaster&) = delete;
+        // 一次广播的共享状态
+        struct Broadcast{
+            int64_t id;
+            SharedFrame frame;
+            std::atomic<size_t> remaining_shards;
+            std::atomic<size_t> delivered;
+        };
+        // 一个分片的推送进度
+        struct ShardTask{
+            std::shared_ptr<Broadcast> broadcast;
+            size_t shard;
+            std::vector<ConnectionHandle> handles;
+            size_t position = 0;
+            bool started = false;
+        };
+        // 推送一轮，未完成时重新提交
+        void runTick(std::shared_ptr<ShardTask> task);
+        size_t batch_size_;
+        std::unordered_set<int> admin_user_ids_;
+        mutable std::mutex admin_mutex_;
+        std::atomic<size_t> active_tasks_;
+    };
+}
+
+#endif //EASYCHATSERVER_BROADCASTER_H
@@ -0,0 +1,95 @@
+//
+// Created by Cando on 2026/10/19.
+//
+
+#ifndef EASYCHATSERVER_CONVERSATION_INDEX_H
+#define EASYCHATSERVER_CONVERSATION_INDEX_H
+
+#include "common/protocol.h"
+#include "database/message_store.h"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace easychat{
+    // 会话内的一条近期消息
+    struct RecentMessage{
+        int64_t seq;
+        int64_t message_id;
+        int sender_id;
+        std::string content;
+    };
+    // 会话状态：序号计数器与近期消息环
+    // 分配序号、写入存储、追加近期消息都在mutex内完成，保证存储顺序与序号顺序一致
+    struct Conversation{
+        uint64_t key = 0;      // 会话键（创建时设置）
+        std::mutex mutex;
+        bool loaded = false;   // last_seq是否已从存储加载
+        int64_t last_seq = 0;  // 已分配的最大序号
+        std::deque<RecentMessage> recent; // 按序号递增
+        int64_t read_seq[2] = {0,0}; // 单聊双方已回执的已读序号（下标0为ID较小的用户），用于丢弃过期回执
+        std::atomic<size_t> bytes{0}; // 近期消息占用的内存（淘汰时从分片总量中扣除）
+    };
+
+    // 会话索引类-单例模式
+    // 键按哈希分布到多个分片，每个分片按LRU淘汰不再被引用的会话（会话数或近期消息总字节数超出分片配额时）；
+    // 被淘汰的会话下次访问时从存储重新加载序号，近期消息从空开始
+    class ConversationIndex{
+    public:
+        static ConversationIndex& getInstance();
+        // 初始化（每个会话保留的近期消息条数，内存中最多保留的会话数与近期消息总字节数）
+        void init(size_t recent_messages,size_t max_conversations,size_t max_bytes);
+        // 单聊会话键（与方向无关）与群聊会话键
+        static uint64_t directKey(int user_id1,int user_id2);
+        static uint64_t roomKey(int room_id);
+        // 获取会话（不存在时创建），返回的指针在使用期间不会被淘汰
+        std::shared_ptr<Conversation> acquire(uint64_t key);
+        // 查找会话（不存在时返回nullptr，不创建）
+        std::shared_ptr<Conversation> find(uint64_t key);
+        // 追加一条近期消息（调用者持有会话锁）
+        void remember(Conversation& conversation,const MessageInfo& message) const;
+        // 丢弃消息ID不超过max_message_id的近期消息（过期删除后调用，调用者持有会话锁）
+        void forget(Conversation& conversation,int64_t max_message_id) const;
+        // 从近期消息中写出序号大于after_seq且消息ID大于after_id的消息（至多limit条，每条一个MSG_TYPE_SYNC_RESP帧，
+        // 消息体为prefix+seq:content）；after_seq早于近期消息的起点时返回false，需要回源存储（调用者持有会话锁）
+        bool writeRecent(const Conversation& conversation,int64_t after_seq,int64_t after_id,int limit,
+                         std::string_view prefix,FrameWriter& writer,int64_t& last_seq) const;
+        // 从近期消息中写出最新的limit条聊天记录（由新到旧，格式：sender_id:content|sender_id:content|...）；
+        // 近期消息不足limit条时返回false，需要回源存储（调用者持有会话锁）
+        bool writeHistory(const Conversation& conversation,int limit,FrameWriter& writer) const;
+        // 近期消息占用的总字节数
+        size_t cachedBytes() const;
+    private:
+        ConversationIndex();
+        ~ConversationIndex() = default;
+        // 禁止拷贝和赋值
+        ConversationIndex(const ConversationIndex&) = delete;
+        ConversationIndex& operator=(const ConversationIndex&) = delete;
+        // 分片
+        struct Shard{
+            std::mutex mutex;
+            std::atomic<size_t> bytes{0}; // 分片内近期消息总字节数（追加时在会话锁内更新，无需分片锁）
+            std::list<std::pair<uint64_t,std::shared_ptr<Conversation>>> lru;
+            std::unordered_map<uint64_t,std::list<std::pair<uint64_t,std::shared_ptr<Conversation>>>::iterator> index;
+        };
+        static constexpr size_t kShardCount = 16;
+        Shard& shardFor(uint64_t key) const {return *shards_[std::hash<uint64_t>{}(key)%kShardCount];}
+        // 一条近期消息占用的字节数
+        static size_t messageBytes(const RecentMessage& message){return sizeof(RecentMessage)+message.content.size();}
+        // 淘汰超出容量且没有其他引用的会话（调用者持有分片锁）
+        void evict(Shard& shard) const;
+        std::vector<std::unique_ptr<Shard>> shards_;
+        size_t recent_messages_;
+        size_t shard_capacity_;
+        size_t shard_byte_budget_;
+    };
+}
+
+#endif //EASYCHATSERVER_CONVERSATION_INDEX_H
@@ -0,0 +1,46 @@
+//
+// Created by Cando on 2026/10/19.
+//
+
+#ifndef EASYCHATSERVER_DELIVERY_WRITER_H
+#define EASYCHATSERVER_DELIVERY_WRITER_H
+
+#include "common/write_behind_batcher.h"
+#include "database/message_store.h"
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace easychat{
+    // 投递状态异步写入器（write-behind）
+    // 客户端确认的消息先记入待写表（多个设备确认同一条消息只记一次），后台线程按周期整批写入存储
+    // （一批一条语句/一条日志记录）；待写表有上限，存储长时间不可用时丢弃新的确认。
+    // 写入前进程崩溃或确认被丢弃只会导致消息在新设备上重复下发，不会丢失
+    class DeliveryWriter{
+    public:
+        DeliveryWriter();
+        ~DeliveryWriter();
+        // 设置存储后端（启动前为同步写入）
+        void init(std::shared_ptr<MessageStore> store);
+        // 启动后台线程（flush_interval_ms为刷新周期，不大于0时保持同步写入；max_batch为单批最大消息数）
+        void start(int flush_interval_ms,size_t max_batch);
+        // 记录一批已确认的消息（接收者ID，消息ID）
+        void delivered(int user_id,const std::vector<int64_t>& message_ids);
+        // 待写入的消息数
+        size_t pendingCount();
+        // 写完剩余状态并停止后台线程
+        void stop();
+    private:
+        using Delivery = std::pair<int,int64_t>; // 接收者ID，消息ID
+        struct DeliveryHash{
+            size_t operator()(const Delivery& delivery) const{
+                return std::hash<int64_t>()(delivery.second)^(static_cast<size_t>(delivery.first)*0x9e3779b97f4a7c15ULL);
+            }
+        };
+
+        std::shared_ptr<MessageStore> store_;
+        WriteBehindBatcher<Delivery,Delivery,DeliveryHash> batcher_;
+    };
+}
+
+#endif //EASYCHATSERVER_DELIVERY_WRITER_H
@@ -0,0 +1,114 @@
+//
+// Created by Cando on 2026/10/19.
+//
+
+#ifndef EASYCHATSERVER_INBOX_INDEX_H
+#define EASYCHATSERVER_INBOX_INDEX_H
+
+#include "common/protocol.h"
+#include "database/message_store.h"
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace easychat{
+    // 收件箱中的一个单聊会话
+    struct InboxConversation{
+        int64_t last_message_id = 0;
+        int64_t last_seq = 0;
+        int last_sender_id = 0;
+        std::string preview;               // 最后一条消息的预览（截断）
+        std::deque<int64_t> unread_seqs;   // 对方发来的未读消息序号（递增，至多kMaxTrackedUnread条）
+        int64_t overflow_unread = 0;       // 超出跟踪上限的更早未读消息数
+        int64_t overflow_max_seq = 0;      // 其中的最大序号
+        int64_t unreadCount() const {return overflow_unread+static_cast<int64_t>(unread_seqs.size());}
+    };
+    // 加载期间到达的新消息
+    struct PendingInboxMessage{
+        int peer_id;
+        bool incoming;
+        MessageInfo message;
+    };
+    // 用户的收件箱：对方用户ID->会话
+    struct Inbox{
+        std::mutex mutex;
+        bool loaded = false; // 是否已从存储加载
+        std::unordered_map<int,InboxConversation> conversations;
+        // 从存储加载时不持有mutex，期间到达的更新暂存，加载完成后重放（按序号跳过已加载的消息）
+        int loaders = 0;                                   // 正在从存储加载的请求数
+        std::vector<PendingInboxMessage> pending_messages;
+        std::vector<std::pair<int,int64_t>> pending_reads; // (对方ID,已读序号)
+        bool pending_dropped = false;                      // 暂存超过上限或已失效，本轮加载结果不安装
+    };
+
+    // 收件箱索引类-单例模式
+    // 每个用户的收件箱（各单聊会话的最后一条消息与未读数）在存储消息和已读回执时增量更新；
+    // 不单独持久化，重启或被淘汰后首次查询时从存储（消息与已读状态）重新加载。
+    // 只更新已加载的收件箱，未加载的用户下次查询时从存储读到最新状态
+    class InboxIndex{
+    public:
+        static InboxIndex& getInstance();
+        // 初始化（内存中最多保留的收件箱数）
+        void init(size_t max_users);
+        // 获取用户的收件箱（不存在时创建，需调用者加载），返回的指针在使用期间不会被淘汰
+        std::shared_ptr<Inbox> acquire(int user_id);
+        // 开始从存储加载：之后到达的更新暂存（调用者持有收件箱锁，随后释放锁读取存储）
+        void beginLoad(Inbox& inbox) const;
+        // 加载失败（调用者重新持有收件箱锁）
+        void abortLoad(Inbox& inbox) const;
+        // 用存储中的数据初始化收件箱并重放暂存的更新（调用者重新持有收件箱锁）；
+        // 暂存的更新被丢弃时不安装，返回false，调用者只用本次结果应答
+        bool load(Inbox& inbox,std::vector<InboxEntry>& entries) const;
+        // 新消息：更新发送者与接收者已加载的收件箱（同一会话的消息按序号顺序调用）
+        void onMessage(const MessageInfo& message);
+        // 已读回执：reader_id已读完peer_id发来的、序号不超过seq的消息
+        void onRead(int reader_id,int peer_id,int64_t seq);
+        // 消息过期删除：已加载的收件箱标记为未加载，下次查询时从存储重新加载
+        void invalidate(int user_id);
+        // 按最后一条消息由新到旧写出至多limit个会话（调用者持有收件箱锁），
+        // 格式：peer_id:未读数:last_seq:last_sender_id:预览字节数:预览|...
+        void writeTop(const Inbox& inbox,int limit,FrameWriter& writer) const;
+    private:
+        InboxIndex();
+        ~InboxIndex() = default;
+        // 禁止拷贝和赋值
+        InboxIndex(const InboxIndex&) = delete;
+        InboxIndex& operator=(const InboxIndex&) = delete;
+        // 查找内存中的收件箱（不存在时返回nullptr，不创建）
+        std::shared_ptr<Inbox> findLoaded(int user_id);
+        // 更新一个会话的最后一条消息（调用者持有收件箱锁）
+        static void applyMessage(InboxConversation& conversation,const MessageInfo& message,bool incoming);
+        // 截断预览（不截断UTF-8字符）
+        static std::string makePreview(const std::string& content);
+        // 用存储中的数据填充会话
+        static void fill(Inbox& inbox,std::vector<InboxEntry>& entries);
+        // 已读回执（调用者持有收件箱锁）
+        static void applyRead(InboxConversation& conversation,int64_t seq);
+        // 一次加载结束（调用者持有收件箱锁）
+        static void finishLoad(Inbox& inbox);
+        // 加载期间最多暂存的更新数
+        static constexpr size_t kMaxPendingUpdates = 1000;
+        // 每个会话最多跟踪的未读序号数
+        static constexpr size_t kMaxTrackedUnread = 1000;
+        // 预览最大字节数
+        static constexpr size_t kPreviewBytes = 64;
+        struct Shard{
+            std::mutex mutex;
+            std::list<std::pair<int,std::shared_ptr<Inbox>>> lru;
+            std::unordered_map<int,std::list<std::pair<int,std::shared_ptr<Inbox>>>::iterator> index;
+        };
+        static constexpr size_t kShardCount = 16;
+        Shard& shardFor(int user_id) {return *shards_[static_cast<uint32_t>(user_id)%kShardCount];}
+        // 淘汰超出容量且没有其他引用的收件箱（调用者持有分片锁）
+        void evict(Shard& shard) const;
+        std::vector<std::unique_ptr<Shard>> shards_;
+        size_t shard_capacity_;
+    };
+}
+
+#endif //EASYCHATSERVER_INBOX_INDEX_H
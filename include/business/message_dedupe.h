@@ -0,0 +1,68 @@
+//
+// Created by Cando on 2026/10/19.
+//
+
+#ifndef EASYCHATSERVER_MESSAGE_DEDUPE_H
+#define EASYCHATSERVER_MESSAGE_DEDUPE_H
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace easychat{
+    // 客户端消息ID去重表
+    // 记录(发送者, 客户端消息ID)->服务器消息ID，客户端超时重发同一条消息时直接返回已分配的消息ID，不再存储和推送；
+    // 条目按插入顺序保存在每个分片的队列中，超过有效期或超出容量时从最早的一端淘汰（滑动窗口）
+    class MessageDedupe{
+    public:
+        MessageDedupe();
+        // 配置有效期（毫秒）与最多保留的条目数
+        void configure(int ttl_ms,size_t max_entries);
+        // 登记一条消息：未见过时记为处理中并返回true；重复时返回false，
+        // existing_id为已存储的消息ID（原消息仍在处理中时为0）
+        bool claim(int sender_id,uint64_t client_id,int64_t message_id,int64_t& existing_id);
+        // 消息已存储，之后的重发直接确认
+        void commit(int sender_id,uint64_t client_id);
+        // 消息存储失败，移除登记，允许客户端重发
+        void release(int sender_id,uint64_t client_id);
+        // 当前条目数
+        size_t size();
+    private:
+        using Clock = std::chrono::steady_clock;
+        struct Key{
+            int sender_id;
+            uint64_t client_id;
+            bool operator==(const Key& other) const {
+                return sender_id==other.sender_id && client_id==other.client_id;
+            }
+        };
+        struct KeyHash{
+            size_t operator()(const Key& key) const {
+                return std::hash<uint64_t>{}(key.client_id*31+static_cast<uint32_t>(key.sender_id));
+            }
+        };
+        struct Entry{
+            int64_t message_id;
+            bool committed;
+            Clock::time_point expire_at;
+        };
+        struct Shard{
+            std::mutex mutex;
+            std::unordered_map<Key,Entry,KeyHash> entries;
+            std::deque<std::pair<Key,Clock::time_point>> order; // 按插入顺序
+        };
+        static constexpr size_t kShardCount = 16;
+        Shard& shardFor(int sender_id);
+        // 淘汰过期与超出容量的条目（调用者持有分片锁）
+        void evict(Shard& shard,Clock::time_point now) const;
+        std::vector<std::unique_ptr<Shard>> shards_;
+        std::chrono::milliseconds ttl_;
+        size_t shard_capacity_;
+    };
+}
+
+#endif //EASYCHATSERVER_MESSAGE_DEDUPE_H
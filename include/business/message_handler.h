@@ -6,38 +6,96 @@
 #define EASYCHATSERVER_MESSAGE_HANDLER_H
 
 #include "common/protocol.h"
-#include "database/connection_pool.h"
+#include "database/message_store.h"
+#include "database/message_spool.h"
 #include "business/user_manager.h"
+#include "business/room_manager.h"
+#include "business/conversation_index.h"
+#include "business/inbox_index.h"
+#include "business/search_index.h"
+#include "business/delivery_writer.h"
+#include "business/receipt_batcher.h"
+#include "business/message_dedupe.h"
 #include <string>
+#include <string_view>
 #include <vector>
+#include <memory>
+#include <mutex>
+#include <map>
+#include <unordered_map>
 
 namespace easychat{
-    // 消息信息结构体
-    struct MessageInfo{
-        int id;
-        int sender_id;
-        int receiver_id;
-        std::string content;
-        int message_type; // 0-文本，1-图片，2-文件
-        int is_offline; // 0-否，1-是
-        int is_read; //0-未读，1-已读
-        std::string created_at;
-    };
+    class ClientConnection;
     // 消息处理类
     class MessageHandler{
     public:
         static MessageHandler& getInstance();
-        // 初始化
-        void init();
-        // 发送消息
+        // 初始化（注入存储后端；spool不为空时，存储失败的消息写入本地溢写区）
+        void init(std::shared_ptr<MessageStore> store,std::shared_ptr<MessageSpool> spool = nullptr);
+        // 设置增量同步时每个会话单次最多返回的消息条数
+        void setMaxSyncDelta(int max_delta);
+        // 配置投递确认（每个连接最多保留的未确认帧数，最多暂存的下线设备数，投递状态刷新周期毫秒与单批最大消息数，
+        // 上线同步时从游标往前回看的毫秒数）
+        void configureDelivery(size_t max_unacked,size_t max_parked,int flush_interval_ms,size_t max_batch,
+                               int cursor_grace_ms);
+        // 配置已读回执合并（窗口毫秒，不大于0时立即写入并转发；单批最大会话数）
+        void configureReceipts(int window_ms,size_t max_batch);
+        // 配置客户端消息ID去重（有效期毫秒，最多保留的条目数）
+        void configureDedupe(int ttl_ms,size_t max_entries);
+        // 写完剩余的投递状态与已读回执（关闭服务器时调用）
+        void shutdown(){delivery_writer_.stop();receipt_batcher_.stop();}
+        // 每个连接最多保留的未确认帧数
+        size_t maxUnacked() const {return max_unacked_;}
+        // 客户端确认收到的消息，批量持久化为已投递（只更新接收者为该用户的消息）
+        void acknowledge(int user_id,const std::vector<int64_t>& message_ids);
+        // 设备下线时暂存未确认的帧（确认水位与已推送的最大消息ID），同一设备重连时直接重发
+        void parkOutbox(int user_id,const std::string& device_id,int64_t watermark,int64_t pushed_id,
+                        std::vector<std::pair<int64_t,SharedFrame>>&& frames);
+        // 消息过期删除后，从下线设备暂存的未确认帧中移除这些消息（message_ids递增）
+        void dropExpired(const std::vector<int64_t>& message_ids);
+        // 发送消息（分配会话内序号，推送消息体格式：message_id:seq:content；message_id为0时由服务器分配）
         bool sendMessage(int sender_id,int receiver_id,
-                         const std::string &content,int message_type=0);
-        // 处理接收消息
-        void handleReceivedMessage(const Message& msg);
+                         const std::string &content,int message_type=0,int64_t message_id=0);
+        // 处理接收消息（消息体格式：receiver_id:content，或c<客户端消息ID>:receiver_id:content）
+        // 带客户端消息ID时，receipt返回发送确认（client_id:message_id），重发的消息只确认、不再存储和推送；
+        // 原消息仍在处理中的重发不确认，由客户端稍后再次重发
+        bool handleReceivedMessage(const Message& msg,std::string& receipt);
+        // 发送群聊消息：只存一行，只序列化一次，推送给除发送者外所有在线成员的所有设备（消息体格式：room_id:seq:content）
+        // 发送者不是成员或房间不存在时返回false（message_id为0时由服务器分配）
+        bool sendRoomMessage(int sender_id,int room_id,const std::string& content,int message_type=0,
+                             int64_t message_id=0);
+        // 处理群聊消息（消息体格式：room_id:content），发送者为连接上已认证的用户
+        bool handleRoomMessage(int sender_id,const Message& msg);
+        // 增量同步：请求体为客户端已收到的各会话最大序号（格式：u<对方用户ID>=seq,r<房间ID>=seq,...）
+        // 每个会话序号之后的消息写为MSG_TYPE_SYNC_RESP帧（消息体为u<ID>:seq:content或r<ID>:seq:content），
+        // 近期消息直接从内存返回，更早的回源存储；最后写一个MSG_TYPE_SYNC帧汇总各会话（格式：u<ID>=已同步序号:最新序号,...），
+        // 已同步序号小于最新序号说明超出单次上限，客户端以已同步序号再次请求
+        void syncConversations(int user_id,const std::string& request,FrameWriter& writer);
         // 获取离线消息
         bool getOfflineMessage(int user_id,std::vector<MessageInfo>&messages);
-        // 标记消息已读
-        bool markMessageAsRead(int message_id);
+        // 本进程启动后是否有发给该用户的消息在该设备的游标之后，或有暂存的未确认帧（游标未知时返回true）
+        bool hasUnsyncedMessages(int user_id,const std::string& device_id);
+        // 设备上线同步：将该设备游标之后的消息写为MSG_TYPE_OFFLINE_MSG帧，所在房间的群聊消息写为MSG_TYPE_ROOM_CHAT帧，
+        // 消息ID不是按写入顺序分配的（不同线程槽、同一毫秒），游标往前回看cursor_grace_ms补发，客户端按消息ID去重；
+        // from返回同步起点（确认前的确认水位），cursor返回同步后已推送到的位置
+        // 首次上线的设备只补发离线（未确认）消息，群聊消息从该用户其他设备的最大游标之后开始
+        // 上一个连接暂存的未确认帧覆盖了游标之后的所有消息时，不访问存储，帧通过retransmit返回
+        bool syncDevice(int user_id,const std::string& device_id,FrameWriter& writer,int64_t& from,int64_t& cursor,
+                        std::vector<std::pair<int64_t,SharedFrame>>& retransmit);
+        // 保存设备游标（设备下线时调用，只前进不后退）
+        void saveDeviceCursor(int user_id,const std::string& device_id,int64_t message_id);
+        // 将离线消息直接写为帧（每条一个MSG_TYPE_OFFLINE_MSG帧）
+        bool writeOfflineMessages(int user_id,FrameWriter& writer);
+        // 将聊天记录直接写入当前帧的消息体
+        bool writeChatHistory(int user_id1,int user_id2,int limit,FrameWriter& writer);
+        // 处理已读回执（消息体：对方用户ID:seq，表示对方发来的、序号不超过seq的消息都已读）
+        // 序号不超过会话当前序号；合并后批量写入存储，并以MSG_TYPE_READ（消息体：reader_id:seq）转发给对方
+        bool handleReadReceipt(int reader_id,const std::string& data);
+        // 收件箱：按最后一条消息由新到旧写出至多limit个单聊会话（当前帧的消息体），首次查询时从存储加载
+        bool writeInbox(int user_id,int limit,FrameWriter& writer);
+        // 全文搜索（消息体：条数:before_id:关键词，before_id为0表示从最新开始），结果由新到旧写入当前帧的消息体
+        // 格式：消息ID:对方用户ID:发送者ID:摘要长度:摘要|...，候选消息回读正文确认包含全部关键词
+        bool writeSearch(int user_id,const std::string& data,FrameWriter& writer);
         // 获取用户聊天记录
         bool getChatHistory(int user_id1,int user_id2,std::vector<MessageInfo>&messages,int limit=100);
     private:
@@ -46,15 +104,57 @@ namespace easychat{
         // 禁止拷贝和赋值
         MessageHandler(const MessageHandler&) = delete;
         MessageHandler& operator=(const MessageHandler&) = delete;
-        // 存储消息到数据库
-        bool storeMessage(int sender_id,int receiver_id,const std::string& content,
-                          int message_type,int is_offline);
-        // 转发消息到在线用户
-        bool forwardMessage(int receiver_id,const Message& msg);
-        // 连接池引用
-        ConnectionPool& conn_pool_;
-        // 用户管理引用
+        // 存储消息到数据库（消息ID已预先分配）
+        bool storeMessage(MessageInfo& msg_info);
+        // 消息内容为附件引用时检查发送者有权引用该附件并记录引用，message_type返回附件类型；
+        // 不是附件引用时直接返回true
+        bool referenceAttachment(std::string_view content,int64_t message_id,int sender_id,int receiver_id,
+                                 int room_id,int& message_type);
+        // 加载会话的当前序号（调用者持有会话锁，room_id不为0时为群聊会话），包括溢写区中待回放的消息；
+        // 存储不可用或溢写区中还有该会话未分配序号的消息时返回false
+        bool loadConversationSeq(Conversation& conversation,int user_id1,int user_id2,int room_id);
+        // 同步单个会话（kind为'u'单聊或'r'群聊），summary追加该会话的同步结果
+        bool syncConversation(int user_id,char kind,int target_id,int64_t after_seq,FrameWriter& writer,std::string& summary);
+        // 上线同步的起点：游标往前回看cursor_grace_ms对应的最小消息ID
+        int64_t syncFloor(int64_t cursor) const;
+        // 记录用户收到一条消息（调用者持有cursor_mutex_）
+        void noteReceived(int user_id,int64_t message_id);
+        // 将已持久化的回执转发给对方的所有在线设备
+        void forwardReceipts(const std::vector<ReadReceipt>& receipts);
+        // 转发已序列化的消息到接收者的一个设备连接
+        bool forwardMessage(int receiver_id,ClientConnection& receiver,const SharedFrame& frame,int64_t message_id);
+        // 存储后端
+        std::shared_ptr<MessageStore> store_;
+        // 本地溢写区（可选）
+        std::shared_ptr<MessageSpool> spool_;
+        // 本进程启动后各用户收到的最大消息ID（晚到的较小ID会让它前进一位），以及已知的设备游标（会话恢复时据此跳过同步）
+        std::unordered_map<int,int64_t> latest_received_;
+        std::map<std::pair<int,std::string>,int64_t> device_cursors_;
+        std::mutex cursor_mutex_; // 同时保护parked_outboxes_
+        // 增量同步时每个会话单次最多返回的消息条数
+        int max_sync_delta_;
+        // 下线设备暂存的未确认帧
+        struct ParkedOutbox{
+            int64_t watermark;
+            int64_t pushed_id;
+            std::vector<std::pair<int64_t,SharedFrame>> frames;
+        };
+        std::map<std::pair<int,std::string>,ParkedOutbox> parked_outboxes_;
+        size_t max_unacked_;
+        size_t max_parked_;
+        int cursor_grace_ms_;
+        // 投递状态批量写入
+        DeliveryWriter delivery_writer_;
+        // 已读回执合并写入
+        ReceiptBatcher receipt_batcher_;
+        // 客户端消息ID去重
+        MessageDedupe dedupe_;
+        // 用户管理、群聊管理、会话索引、收件箱索引与搜索索引引用
         UserManager& user_manager_;
+        RoomManager& room_manager_;
+        ConversationIndex& conversation_index_;
+        InboxIndex& inbox_index_;
+        SearchIndex& search_index_;
     };
 }
 
@@ -0,0 +1,113 @@
+//
+// Created by Cando on 2026/10/19.
+//
+
+#ifndef EASYCHATSERVER_ONLINE_REGISTRY_H
+#define EASYCHATSERVER_ONLINE_REGISTRY_H
+
+#include "common/connection_handle.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace easychat{
+    // 用户的在线设备连接
+    struct DeviceHandles{
+        static constexpr size_t kMaxDevices = 8; // 每个用户最多同时在线的设备数
+        ConnectionHandle handles[kMaxDevices];
+        size_t count = 0;
+    };
+    // 在线用户注册表（用户ID -> 各设备的连接句柄），为读多写少优化
+    // 按用户ID分片，每个分片是一张开放寻址表，槽位的键和各设备句柄都是原子变量：
+    // - 读（每次转发消息）不加锁，在本线程的读者记录中公布纪元后做有限次原子读，无等待
+    // - 写（登录/下线）持分片锁；用户下线只清空值，键保留，因此槽位不会被删除，读者无需处理墓碑
+    // - 表中占用的槽（含已离线用户的键）超过一半时按当前在线数重建新表（可以更小）并原子发布，
+    //   旧表按纪元延迟释放：读者进入时公布所见的纪元，没有读者仍停留在旧表退休时的纪元后才释放
+    class OnlineRegistry{
+    public:
+        explicit OnlineRegistry(size_t shard_count=16,size_t initial_capacity=256);
+        ~OnlineRegistry();
+        // 禁止拷贝和赋值
+        OnlineRegistry(const OnlineRegistry&) = delete;
+        OnlineRegistry& operator=(const OnlineRegistry&) = delete;
+
+        // 查找用户所有设备的连接句柄（无锁）
+        bool lookup(int user_id,DeviceHandles& devices) const;
+        // 查找用户任一设备的连接句柄（无锁）
+        bool lookup(int user_id,ConnectionHandle& handle) const;
+        bool isOnline(int user_id) const;
+        // 添加一个设备连接（已达设备上限时失败）
+        bool add(int user_id,const ConnectionHandle& handle);
+        // 移除一个设备连接，handle无效时移除该用户的所有连接；now_offline返回用户是否已没有在线设备
+        bool remove(int user_id,const ConnectionHandle& handle,bool* now_offline=nullptr);
+        // 在线用户快照
+        void snapshot(std::vector<int>& user_ids) const;
+        // 分片数（广播时按分片并行遍历）
+        size_t shardCount() const {return shard_count_;}
+        // 单个分片内所有在线设备的连接句柄快照（无锁）
+        void snapshotShard(size_t shard,std::vector<ConnectionHandle>& handles) const;
+        // 在线用户数
+        size_t size() const {return online_count_.load(std::memory_order_relaxed);}
+    private:
+        struct Slot{
+            std::atomic<int64_t> key;   // 用户ID，kEmptyKey表示空槽
+            std::atomic<uint64_t> devices[DeviceHandles::kMaxDevices];// 打包的连接句柄，0表示空位；全部为0表示离线
+        };
+        struct Table{
+            explicit Table(size_t capacity);
+            size_t capacity; // 2的幂
+            size_t used;     // 已占用的槽数（含已离线用户的键，仅写者访问）
+            std::unique_ptr<Slot[]> slots;
+        };
+        struct Shard{
+            std::atomic<Table*> table;
+            std::mutex write_mutex;
+            std::unique_ptr<Table> owned; // 当前表
+        };
+        // 读者记录（每个线程一个）：读期间为进入时的纪元，不在读时为0
+        struct ReaderRecord{
+            std::atomic<uint64_t> epoch{0};
+            std::thread::id owner;
+            ReaderRecord* next = nullptr;
+        };
+        // 读期间公布纪元，期间读到的表不会被释放
+        class ReadGuard{
+        public:
+            explicit ReadGuard(const OnlineRegistry& registry);
+            ~ReadGuard();
+        private:
+            ReaderRecord* record_;
+        };
+        static constexpr int64_t kEmptyKey = INT64_MIN;
+        // 在表中查找用户所在的槽，找不到返回nullptr
+        static Slot* findSlot(Table* table,int user_id);
+        // 槽位中的在线设备数
+        static size_t deviceCount(const Slot& slot);
+        // 按在线数重建（调用者持有分片写锁），旧表退休
+        Table* rebuild(Shard& shard,Table* table);
+        // 当前线程的读者记录（首次使用时登记，之后按线程缓存）
+        ReaderRecord* readerRecord() const;
+        // 退休旧表：推进纪元，之后进入的读者只能看到新表
+        void retire(std::unique_ptr<Table> table);
+        // 释放没有读者可能仍在访问的旧表（调用者持有retired_mutex_）
+        void reclaim();
+        Shard& shardFor(int user_id) const;
+        static size_t hashOf(int user_id);
+
+        std::unique_ptr<Shard[]> shards_;
+        size_t shard_count_;
+        size_t min_capacity_;
+        std::atomic<size_t> online_count_;
+        uint64_t instance_id_; // 区分注册表实例（线程缓存读者记录）
+        std::atomic<uint64_t> epoch_;
+        mutable std::atomic<ReaderRecord*> readers_;
+        std::mutex retired_mutex_;
+        std::vector<std::pair<uint64_t,std::unique_ptr<Table>>> retired_; // (退休时的纪元,旧表)
+        std::atomic<size_t> retired_count_;
+    };
+}
+
+#endif //EASYCHATSERVER_ONLINE_REGISTRY_H
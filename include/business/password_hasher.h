@@ -0,0 +1,29 @@
+//
+// Created by Cando on 2026/10/19.
+//
+
+#ifndef EASYCHATSERVER_PASSWORD_HASHER_H
+#define EASYCHATSERVER_PASSWORD_HASHER_H
+
+#include <string>
+
+namespace easychat{
+    // 密码哈希
+    // 存储格式：pbkdf2_sha256$迭代次数$盐(hex)$哈希(hex)，迭代次数随哈希一起保存，
+    // 调高配置后旧哈希在下次登录时自动升级；兼容旧版无盐MD5哈希（登录成功后升级）
+    class PasswordHasher{
+    public:
+        // 生成密码哈希
+        static std::string hash(const std::string& password,int iterations);
+        // 校验密码；needs_upgrade表示哈希算法或迭代次数低于目标，应重新哈希
+        static bool verify(const std::string& password,const std::string& stored,
+                           int target_iterations,bool& needs_upgrade);
+    private:
+        // PBKDF2-HMAC-SHA256
+        static std::string pbkdf2(const std::string& password,const std::string& salt,int iterations);
+        // 旧版MD5哈希
+        static std::string legacyMd5(const std::string& password);
+    };
+}
+
+#endif //EASYCHATSERVER_PASSWORD_HASHER_H
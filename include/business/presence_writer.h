@@ -0,0 +1,47 @@
+//
+// Created by Cando on 2026/10/19.
+//
+
+#ifndef EASYCHATSERVER_PRESENCE_WRITER_H
+#define EASYCHATSERVER_PRESENCE_WRITER_H
+
+#include "common/write_behind_batcher.h"
+#include "database/message_store.h"
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace easychat{
+    // 在线状态异步写入器（write-behind）
+    // 内存中的在线注册表是在线状态的唯一依据，数据库中的状态只供外部查询。
+    // 状态变更先记入待写表，同一用户在一个刷新周期内的多次上线/下线只保留最后一次，
+    // 后台线程按周期批量写入存储；最终状态与已持久化状态相同时（如快速断线重连）不写库
+    class PresenceWriter{
+    public:
+        PresenceWriter();
+        ~PresenceWriter();
+        // 设置存储后端（启动前为同步写入）
+        void init(std::shared_ptr<MessageStore> store);
+        // 启动后台线程（flush_interval_ms为刷新周期，不大于0时保持同步写入；max_batch为单批最大用户数）
+        void start(int flush_interval_ms,size_t max_batch);
+        // 记录状态变更（未启动时同步写入）
+        void online(int user_id,int socket_fd,const std::string& ip,int port);
+        void offline(int user_id);
+        // 待写入的用户数
+        size_t pendingCount();
+        // 写完剩余变更并停止后台线程
+        void stop();
+    private:
+        // 跳过与已持久化状态相同的变更后写入存储（只在刷新回调中调用，由写入器串行化）
+        bool flush(std::vector<PresenceUpdate>& batch);
+
+        std::shared_ptr<MessageStore> store_;
+        // 已持久化的状态（用户ID->SocketFd，-1表示离线；不在表中表示未知）
+        std::unordered_map<int,int> persisted_;
+        // 待写表（用户ID->最新状态）
+        WriteBehindBatcher<int,PresenceUpdate> batcher_;
+    };
+}
+
+#endif //EASYCHATSERVER_PRESENCE_WRITER_H
@@ -0,0 +1,42 @@
+//
+// Created by Cando on 2026/10/19.
+//
+
+#ifndef EASYCHATSERVER_RECEIPT_BATCHER_H
+#define EASYCHATSERVER_RECEIPT_BATCHER_H
+
+#include "common/write_behind_batcher.h"
+#include "database/message_store.h"
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace easychat{
+    // 已读回执合并器
+    // 同一会话在一个窗口内的多次回执只保留最大序号；窗口结束时整批写入存储（每个会话一条语句），
+    // 写入成功后每个会话只向发送者转发一个回执帧
+    class ReceiptBatcher{
+    public:
+        // 回执转发回调（持久化成功后调用）
+        using Forwarder = std::function<void(const std::vector<ReadReceipt>&)>;
+        ReceiptBatcher();
+        ~ReceiptBatcher();
+        // 设置存储后端与转发回调（启动前为同步写入）
+        void init(std::shared_ptr<MessageStore> store,Forwarder forwarder);
+        // 启动后台线程（window_ms为合并窗口，不大于0时保持同步写入；max_batch为单批最大会话数）
+        void start(int window_ms,size_t max_batch);
+        // 记录回执（reader_id已读完peer_id发来的、序号不超过seq的消息）
+        void read(int reader_id,int peer_id,int64_t seq);
+        // 待写入的会话数
+        size_t pendingCount();
+        // 写完剩余回执并停止后台线程
+        void stop();
+    private:
+        std::shared_ptr<MessageStore> store_;
+        Forwarder forwarder_;
+        // 待写表（(读者ID<<32|对方ID)->回执）
+        WriteBehindBatcher<uint64_t,ReadReceipt> batcher_;
+    };
+}
+
+#endif //EASYCHATSERVER_RECEIPT_BATCHER_H
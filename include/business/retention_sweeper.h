@@ -0,0 +1,71 @@
+//
+// Created by Cando on 2026/10/19.
+//
+
+#ifndef EASYCHATSERVER_RETENTION_SWEEPER_H
+#define EASYCHATSERVER_RETENTION_SWEEPER_H
+
+#include "database/message_store.h"
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace easychat{
+    // 消息过期清理类-单例模式
+    // 后台线程按周期删除超过保留期的消息：消息ID按时间递增，保留期换算为ID上限，
+    // 每批按ID递增删除一小段（存储只锁定这一段），批与批之间按限速等待，不长时间占用存储。
+    // 每批删除后同步清理内存中的副本：会话近期消息、收件箱（重新加载）与下线设备暂存的未确认帧；
+    // 搜索索引跳过过期的消息ID并在段合并时丢弃。每轮结束后删除过期消息对附件的引用并回收附件
+    class RetentionSweeper{
+    public:
+        static RetentionSweeper& getInstance();
+        // 配置保留期（秒，0为永久保留；群聊默认值，按房间覆盖：房间ID:秒,房间ID:秒,...）并启动后台线程
+        // batch_size为每批删除的消息数，max_rate为每秒最多删除的消息数（不大于0时不限速），interval_seconds为扫描周期
+        void start(std::shared_ptr<MessageStore> store,int ttl_seconds,int room_ttl_seconds,
+                   const std::string& room_overrides,int batch_size,int max_rate,int interval_seconds);
+        // 停止后台线程（正在删除的一批完成后退出）
+        void stop();
+        // 启动以来删除的消息数
+        uint64_t expiredCount();
+    private:
+        RetentionSweeper();
+        ~RetentionSweeper();
+        // 禁止拷贝和赋值
+        RetentionSweeper(const RetentionSweeper&) = delete;
+        RetentionSweeper& operator=(const RetentionSweeper&) = delete;
+        void backgroundLoop();
+        // 扫描一轮：单聊消息与每个房间的群聊消息
+        void sweep();
+        // 分批删除一个会话范围（room_id为0时为全部单聊消息）中ID小于before_id的消息，after_id为已删除到的位置
+        bool sweepRange(int room_id,int64_t before_id,int64_t& after_id);
+        // 清理一批已删除消息在内存中的副本
+        void forgetDeleted(int room_id,const std::vector<MessageInfo>& deleted);
+        // 限速等待（返回false表示已停止）
+        bool throttle(size_t deleted);
+        // 房间的保留期（秒）
+        int roomTtl(int room_id) const;
+
+        std::shared_ptr<MessageStore> store_;
+        int ttl_seconds_;
+        int room_ttl_seconds_;
+        std::unordered_map<int,int> room_overrides_; // 房间ID->保留期（秒）
+        int batch_size_;
+        int max_rate_;
+        int interval_seconds_;
+        // 已删除到的位置（单聊与各房间），下一轮从这里继续，不重复扫描已删除的主键范围
+        int64_t direct_after_id_;
+        std::unordered_map<int,int64_t> room_after_ids_;
+        uint64_t expired_count_;
+        bool running_;
+        std::mutex mutex_;
+        std::condition_variable cond_;
+        std::thread thread_;
+    };
+}
+
+#endif //EASYCHATSERVER_RETENTION_SWEEPER_H
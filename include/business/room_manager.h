@@ -0,0 +1,72 @@
+//
+// Created by Cando on 2026/10/19.
+//
+
+#ifndef EASYCHATSERVER_ROOM_MANAGER_H
+#define EASYCHATSERVER_ROOM_MANAGER_H
+
+#include "database/message_store.h"
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace easychat{
+    // 群聊成员
+    struct RoomMember{
+        int user_id;
+        int64_t joined_message_id; // 加入时的消息ID位置，只补发之后的群聊消息
+    };
+    // 成员列表快照（按用户ID排序，不可变；成员变更时整体替换，扇出时只需复制指针）
+    using RoomMembers = std::shared_ptr<const std::vector<RoomMember>>;
+
+    // 群聊管理类-单例模式
+    // 房间与成员关系启动时从存储整体加载，之后全部在内存中维护，变更同步写入存储。
+    // 同一房间的成员变更由房间的变更锁串行化，写存储时只持有变更锁，全局写锁只在替换快照时短暂持有
+    class RoomManager{
+    public:
+        static RoomManager& getInstance();
+        // 初始化（注入存储后端并加载所有房间）
+        bool init(std::shared_ptr<MessageStore> store,size_t max_members=1000);
+        // 创建房间，创建者自动加入
+        bool createRoom(int owner_id,const std::string& name,int& room_id);
+        // 加入/退出房间（房间不存在或人数已满返回false，重复加入视为成功）
+        bool joinRoom(int room_id,int user_id);
+        bool leaveRoom(int room_id,int user_id);
+        // 获取成员列表快照（房间不存在返回nullptr）
+        RoomMembers getMembers(int room_id) const;
+        // 检查用户是否为房间成员
+        bool isMember(int room_id,int user_id) const;
+        // 获取所有房间ID
+        void getRoomIds(std::vector<int>& room_ids) const;
+        // 获取用户加入的所有房间（房间ID，加入时的消息ID位置）
+        void getUserRooms(int user_id,std::vector<std::pair<int,int64_t>>& rooms) const;
+    private:
+        RoomManager();
+        ~RoomManager() = default;
+        // 禁止拷贝和赋值
+        RoomManager(const RoomManager&) = delete;
+        RoomManager& operator=(const RoomManager&) = delete;
+        // 房间
+        struct Room{
+            std::string name;
+            int owner_id;
+            RoomMembers members;
+            std::shared_ptr<std::mutex> mutation_mutex = std::make_shared<std::mutex>(); // 成员变更锁
+        };
+        // 获取房间的变更锁与当前成员快照（房间不存在返回false）
+        bool lockRoom(int room_id,std::unique_lock<std::mutex>& mutation_lock,RoomMembers& members) const;
+        // 存储后端
+        std::shared_ptr<MessageStore> store_;
+        // 单个房间的成员上限
+        size_t max_members_;
+        // 房间索引（房间ID->房间）与用户加入的房间（用户ID->房间ID列表）
+        std::unordered_map<int,Room> rooms_;
+        std::unordered_map<int,std::vector<int>> user_rooms_;
+        mutable std::shared_mutex mutex_;
+    };
+}
+
+#endif //EASYCHATSERVER_ROOM_MANAGER_H
@@ -0,0 +1,92 @@
+//
+// Created by Cando on 2026/10/19.
+//
+
+#ifndef EASYCHATSERVER_SEARCH_INDEX_H
+#define EASYCHATSERVER_SEARCH_INDEX_H
+
+#include "database/message_store.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace easychat{
+    // 全文搜索索引类-单例模式
+    // 倒排索引按(用户ID, 词项)组织，单聊消息同时计入发送者与接收者；
+    // 分词：ASCII字母数字按词切分并转小写，中日韩文字按相邻两字（二元组）切分，单独的一个字作为一个词项。
+    // 新消息先写入可变的内存段，达到阈值后由后台线程封存为不可变段（消息ID排序去重，差值+varint压缩），
+    // 段数超过上限时后台线程合并最小的两个段，封存与合并时丢弃已过期的消息ID。词项只存哈希，查询结果由调用者回读正文校验
+    class SearchIndex{
+    public:
+        static SearchIndex& getInstance();
+        // 配置（可变段的倒排项上限，不可变段数上限）并启动后台线程；backfill为true时先从存储重建已有消息的索引
+        void start(std::shared_ptr<MessageStore> store,size_t seal_postings,size_t max_segments,bool backfill);
+        // 停止后台线程
+        void stop();
+        // 索引一条单聊消息
+        void add(const MessageInfo& message);
+        // 查找该用户包含所有查询词项的消息ID（由新到旧，至多limit条候选，before_id不为0时只返回更早的消息）
+        void search(int user_id,const std::vector<std::string>& terms,size_t limit,int64_t before_id,
+                    std::vector<int64_t>& message_ids);
+        // 分词（去重）
+        static void tokenize(std::string_view text,std::vector<std::string>& terms);
+        // 当前不可变段数
+        size_t segmentCount();
+        // 保留期清理后调用：ID小于before_id的消息已过期，查询时跳过，封存与合并时从段中丢弃
+        void expireBefore(int64_t before_id);
+    private:
+        SearchIndex();
+        ~SearchIndex();
+        // 禁止拷贝和赋值
+        SearchIndex(const SearchIndex&) = delete;
+        SearchIndex& operator=(const SearchIndex&) = delete;
+        // 不可变段：键->压缩后的消息ID列表（递增，差值varint编码）
+        struct Segment{
+            std::unordered_map<uint64_t,std::string> postings;
+            size_t posting_count = 0;
+        };
+        // 可变段：键->未排序的消息ID
+        using RawPostings = std::unordered_map<uint64_t,std::vector<int64_t>>;
+        // (用户ID, 词项)的键
+        static uint64_t termKey(int user_id,std::string_view term);
+        static void encodePostings(std::vector<int64_t>& ids,std::string& out);
+        static void decodePostings(const std::string& data,std::vector<int64_t>& ids);
+        // 去掉已过期的消息ID
+        void dropExpired(std::vector<int64_t>& ids) const;
+        // 封存可变段（后台线程）
+        void sealActive();
+        // 合并最小的两个段（后台线程）
+        void mergeSmallest();
+        // 从存储重建索引（后台线程）
+        void backfill();
+        void backgroundLoop(bool backfill_first);
+
+        std::shared_ptr<MessageStore> store_;
+        size_t seal_postings_;
+        size_t max_segments_;
+        // 可变段与正在封存的段（查询时两者都要读）
+        std::mutex active_mutex_;
+        RawPostings active_;
+        size_t active_postings_;
+        RawPostings sealing_;
+        // 不可变段（只由后台线程替换，查询持有共享锁）
+        std::shared_mutex segments_mutex_;
+        std::vector<std::shared_ptr<const Segment>> segments_;
+        // 过期位置：ID小于它的消息已被保留期清理删除
+        std::atomic<int64_t> expired_before_;
+        bool running_;
+        std::mutex mutex_;
+        std::condition_variable cond_;
+        std::thread thread_;
+    };
+}
+
+#endif //EASYCHATSERVER_SEARCH_INDEX_H
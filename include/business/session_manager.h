@@ -0,0 +1,41 @@
+//
+// Created by Cando on 2026/10/19.
+//
+
+#ifndef EASYCHATSERVER_SESSION_MANAGER_H
+#define EASYCHATSERVER_SESSION_MANAGER_H
+
+#include <cstdint>
+#include <string>
+
+namespace easychat{
+    // 会话令牌管理-单例模式
+    // 令牌格式：user_id.issued_at.nonce.signature，签名为HMAC-SHA256，
+    // 校验只依赖服务器密钥，不访问数据库
+    class SessionManager{
+    public:
+        static SessionManager& getInstance();
+        // 初始化：secret为空时随机生成（重启后旧令牌失效），ttl为令牌有效期（秒）
+        bool init(const std::string& secret,int64_t ttl);
+        // 为用户签发令牌
+        std::string issueToken(int user_id);
+        // 校验令牌，成功时返回用户ID与签发时间
+        bool verifyToken(const std::string& token,int& user_id,int64_t& issued_at) const;
+        // 服务器启动时间（秒）
+        int64_t getStartTime() const {return start_time_;}
+    private:
+        SessionManager();
+        ~SessionManager() = default;
+        // 禁止拷贝和赋值
+        SessionManager(const SessionManager&) = delete;
+        SessionManager& operator=(const SessionManager&) = delete;
+        // 计算签名（十六进制）
+        std::string sign(const std::string& payload) const;
+
+        std::string secret_;
+        int64_t ttl_;
+        int64_t start_time_;
+    };
+}
+
+#endif //EASYCHATSERVER_SESSION_MANAGER_H
@@ -0,0 +1,57 @@
+//
+// Created by Cando on 2026/10/19.
+//
+
+#ifndef EASYCHATSERVER_USER_CACHE_H
+#define EASYCHATSERVER_USER_CACHE_H
+
+#include "common/lru_cache.h"
+#include "database/message_store.h"
+#include <atomic>
+#include <memory>
+#include <string>
+
+namespace easychat{
+    // 用户资料缓存：按用户ID和用户名各建一个分片LRU索引，条目带过期时间；
+    // 查询不到的用户也会短暂缓存（负缓存），避免反复查询不存在的用户名
+    class UserCache{
+    public:
+        // 查找结果
+        enum class Lookup{
+            MISS,       // 未缓存，需要查询存储
+            HIT,        // 命中
+            NOT_FOUND   // 命中负缓存：用户不存在
+        };
+        UserCache();
+        // 配置容量（每个索引）与过期时间（毫秒）
+        void configure(size_t capacity,int ttl_ms,int negative_ttl_ms);
+        // 按ID/用户名查找
+        Lookup getById(int user_id,UserInfo& user_info);
+        Lookup getByName(const std::string& username,UserInfo& user_info);
+        // 写入查询结果
+        void put(const UserInfo& user_info);
+        // 写入负缓存
+        void putMissing(int user_id);
+        void putMissing(const std::string& username);
+        // 使缓存失效
+        void invalidate(int user_id);
+        void invalidate(const std::string& username);
+        // 统计信息
+        std::string stats() const;
+    private:
+        using Entry = std::shared_ptr<const UserInfo>;
+        // 记录查找结果并更新计数
+        Lookup resolve(bool found,const Entry& entry,UserInfo& user_info);
+
+        ShardedLruCache<int,Entry> by_id_;
+        ShardedLruCache<std::string,Entry> by_name_;
+        std::chrono::milliseconds ttl_;
+        std::chrono::milliseconds negative_ttl_;
+        // 命中计数
+        std::atomic<uint64_t> hits_;
+        std::atomic<uint64_t> negative_hits_;
+        std::atomic<uint64_t> misses_;
+    };
+}
+
+#endif //EASYCHATSERVER_USER_CACHE_H
@@ -5,27 +5,33 @@
 #ifndef EASYCHATSERVER_USER_MANAGER_H
 #define EASYCHATSERVER_USER_MANAGER_H
 
-#include "database/connection_pool.h"
+#include "database/message_store.h"
+#include "business/user_cache.h"
+#include "business/online_registry.h"
+#include "business/presence_writer.h"
 #include <string>
 #include <unordered_map>
 #include <mutex>
+#include <memory>
+#include <atomic>
 
 namespace easychat{
-    // 用户信息结构体
-    struct UserInfo{
-        int id;
-        std::string username;
-        std::string password;
-        std::string nickname;
-        std::string avatar; //头像
-        int status; // 0-离线，1-在线
-    };
     // 用户管理类
     class UserManager{
     public:
         static UserManager& getInstance();
-        //初始化
-        void init();
+        //初始化（注入存储后端）
+        void init(std::shared_ptr<MessageStore> store);
+        // 配置用户资料缓存（容量、过期时间、负缓存过期时间，单位毫秒）
+        void configureCache(size_t capacity,int ttl_ms,int negative_ttl_ms);
+        // 启动在线状态异步写入（刷新周期毫秒，不大于0时同步写入；单批最大用户数）
+        void configurePresence(int flush_interval_ms,size_t max_batch);
+        // 写完剩余的在线状态变更（关闭服务器时调用）
+        void shutdown(){presence_writer_.stop();}
+        // 设置密码哈希迭代次数（低于该值的已有哈希在登录时升级）
+        void setPasswordIterations(int iterations){password_iterations_ = iterations;}
+        // 用户资料缓存统计
+        std::string getCacheStats() const {return user_cache_.stats();}
         //用户注册
         bool registerUser(const std::string& username,
                           const std::string& password,
@@ -39,12 +45,19 @@ namespace easychat{
         bool getUserInfo(const std::string& username,UserInfo& user_info);
         //更新用户状态
         bool updateUserStatus(int user_id,int status);
-        // 用户上线
-        bool userOnline(int user_id,int socket_fd,const std::string& ip,int port);
-        // 用户下线
-        bool userOffline(int user_id);
+        // 用户的一个设备上线（同时在线的设备数已达上限时返回false），resumed表示凭令牌恢复会话（只影响日志）
+        bool userOnline(int user_id,const ConnectionHandle& handle,const std::string& ip,int port,bool resumed = false);
+        // 用户的一个设备下线，所有设备都下线后用户才离线（handle无效时下线该用户的所有设备）
+        bool userOffline(int user_id,const ConnectionHandle& handle=ConnectionHandle{});
         // 检查用户是否在线
-        bool isUserOnline(int user_id);
+        bool isUserOnline(int user_id) const {return online_users_.isOnline(user_id);}
+        // 获取用户所有在线设备的连接句柄（无锁，转发消息时只查一次）
+        bool getConnectionHandles(int user_id,DeviceHandles& devices) const {return online_users_.lookup(user_id,devices);}
+        // 按分片遍历在线设备（广播用）
+        size_t onlineShardCount() const {return online_users_.shardCount();}
+        void snapshotOnlineShard(size_t shard,std::vector<ConnectionHandle>& handles) const {online_users_.snapshotShard(shard,handles);}
+        // 在线用户数
+        size_t onlineUserCount() const {return online_users_.size();}
         //获取在线用户列表
         std::unordered_map<int,UserInfo>getOnlineUsers();
         // 根据用户ID获取SocketFd
@@ -55,13 +68,16 @@ namespace easychat{
         // 禁止拷贝和赋值
         UserManager(const UserManager&) = delete;
         UserManager& operator=(const UserManager&) = delete;
-        // 密码加密
-        std::string encryptPassword(const std::string & password);
-        //在线用户映射（用户ID->SocketFd）
-        std::unordered_map<int,int> online_users_;
-        std::mutex online_user_mutex_;
-        // 连接池引用
-        ConnectionPool& conn_pool_;
+        //在线用户注册表（用户ID->各设备连接句柄），在线状态以此为准
+        OnlineRegistry online_users_;
+        // 在线状态异步持久化
+        PresenceWriter presence_writer_;
+        // 存储后端
+        std::shared_ptr<MessageStore> store_;
+        // 用户资料缓存
+        UserCache user_cache_;
+        // 密码哈希迭代次数
+        std::atomic<int> password_iterations_;
     };
 }
 
@@ -0,0 +1,37 @@
+//
+// Created by Cando on 2026/10/19.
+//
+
+#ifndef EASYCHATSERVER_CONNECTION_HANDLE_H
+#define EASYCHATSERVER_CONNECTION_HANDLE_H
+
+#include <cstdint>
+
+namespace easychat{
+    // 连接句柄：文件描述符 + 代数
+    // 文件描述符关闭后会被新连接复用，代数在每次建立连接时递增，用于区分新旧连接
+    struct ConnectionHandle{
+        int fd = -1;
+        uint32_t generation = 0;
+
+        bool valid() const {return fd>=0 && generation!=0;}
+        bool operator==(const ConnectionHandle& other) const {
+            return fd==other.fd && generation==other.generation;
+        }
+        bool operator!=(const ConnectionHandle& other) const {return !(*this==other);}
+        // 打包为64位整数（0表示无效句柄），便于原子存储
+        uint64_t pack() const {
+            return valid() ? (static_cast<uint64_t>(generation)<<32) | static_cast<uint32_t>(fd) : 0;
+        }
+        static ConnectionHandle unpack(uint64_t value){
+            ConnectionHandle handle;
+            if (value!=0){
+                handle.fd = static_cast<int>(static_cast<uint32_t>(value));
+                handle.generation = static_cast<uint32_t>(value>>32);
+            }
+            return handle;
+        }
+    };
+}
+
+#endif //EASYCHATSERVER_CONNECTION_HANDLE_H
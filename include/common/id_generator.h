@@ -0,0 +1,69 @@
+//
+// Created by Cando on 2026/10/19.
+//
+
+#ifndef EASYCHATSERVER_ID_GENERATOR_H
+#define EASYCHATSERVER_ID_GENERATOR_H
+
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+
+namespace easychat{
+    // Snowflake风格的64位消息ID生成器-单例模式
+    // 布局（高位到低位）：1位符号 | 41位毫秒时间戳 | 10位节点ID | 5位线程槽 | 7位序列号
+    // 每个线程占用独立的线程槽并维护自己的序列号，生成ID时无需加锁；
+    // 线程槽用尽时退化为加锁的共享槽。ID按时间递增，跨节点也可排序
+    class IdGenerator{
+    public:
+        static IdGenerator& getInstance();
+        // 初始化节点ID（0~1023）
+        void init(int node_id);
+        // 生成下一个ID
+        int64_t nextId();
+        // 从ID中解析毫秒时间戳（Unix时间）
+        static int64_t extractTimestamp(int64_t id);
+        // 从ID中解析节点ID
+        static int extractNodeId(int64_t id);
+        // 指定毫秒时间戳对应的最小ID（用于按时间范围查询）
+        static int64_t minIdForTimestamp(int64_t timestamp_ms);
+
+        static constexpr int kNodeBits = 10;
+        static constexpr int kSlotBits = 5;
+        static constexpr int kSequenceBits = 7;
+        // 自定义纪元：2026-01-01 00:00:00 UTC
+        static constexpr int64_t kEpochMs = 1767225600000LL;
+    private:
+        IdGenerator();
+        ~IdGenerator() = default;
+        // 禁止拷贝和赋值
+        IdGenerator(const IdGenerator&) = delete;
+        IdGenerator& operator=(const IdGenerator&) = delete;
+
+        // 线程私有状态
+        struct ThreadState{
+            int slot;
+            int64_t last_ms;
+            uint32_t sequence;
+            ~ThreadState();
+        };
+        // 获取当前线程的状态（首次调用时分配线程槽）
+        ThreadState& localState();
+        // 申请/释放线程槽
+        int acquireSlot();
+        void releaseSlot(int slot,int64_t last_ms);
+        // 用给定状态生成ID
+        int64_t generate(ThreadState& state);
+
+        std::atomic<int> node_id_;
+        // 线程槽占用位图
+        std::atomic<uint32_t> slot_bitmap_;
+        // 线程槽释放时的最后时间戳，槽被复用时从此继续，避免产生重复ID
+        std::atomic<int64_t> slot_last_ms_[(1<<kSlotBits)-1];
+        // 共享槽（线程槽用尽时使用）
+        std::mutex shared_mutex_;
+        ThreadState shared_state_;
+    };
+}
+
+#endif //EASYCHATSERVER_ID_GENERATOR_H
@@ -0,0 +1,124 @@
+//
+// Created by Cando on 2026/10/19.
+//
+
+#ifndef EASYCHATSERVER_LRU_CACHE_H
+#define EASYCHATSERVER_LRU_CACHE_H
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace easychat{
+    // 分片LRU缓存（带过期时间）
+    // 键按哈希分布到多个分片，每个分片独立加锁，降低并发访问时的锁竞争；
+    // 每个分片的容量为总容量/分片数，超出时淘汰最久未使用的条目
+    template<typename Key,typename Value>
+    class ShardedLruCache{
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        explicit ShardedLruCache(size_t shard_count=16,size_t capacity=10000)
+        :evictions_(0){
+            if (shard_count==0) shard_count = 1;
+            for (size_t i=0;i<shard_count;++i){
+                shards_.emplace_back(std::make_unique<Shard>());
+            }
+            setCapacity(capacity);
+        }
+        // 设置总容量
+        void setCapacity(size_t capacity){
+            size_t per_shard = capacity/shards_.size();
+            if (per_shard==0) per_shard = 1;
+            for (auto& shard:shards_){
+                std::lock_guard<std::mutex> lock(shard->mutex);
+                shard->capacity = per_shard;
+                evict(*shard);
+            }
+        }
+        // 查找未过期的条目，命中时移到LRU头部
+        bool get(const Key& key,Value& value){
+            Shard& shard = shardFor(key);
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto it = shard.index.find(key);
+            if (it==shard.index.end()) return false;
+            if (it->second->expires<=Clock::now()){
+                shard.lru.erase(it->second);
+                shard.index.erase(it);
+                return false;
+            }
+            shard.lru.splice(shard.lru.begin(),shard.lru,it->second);
+            value = it->second->value;
+            return true;
+        }
+        // 插入或覆盖条目
+        void put(const Key& key,const Value& value,std::chrono::milliseconds ttl){
+            Shard& shard = shardFor(key);
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto it = shard.index.find(key);
+            if (it!=shard.index.end()){
+                it->second->value = value;
+                it->second->expires = Clock::now()+ttl;
+                shard.lru.splice(shard.lru.begin(),shard.lru,it->second);
+                return;
+            }
+            shard.lru.push_front(Node{key,value,Clock::now()+ttl});
+            shard.index[key] = shard.lru.begin();
+            evict(shard);
+        }
+        // 删除条目，old不为空时返回被删除的值
+        bool erase(const Key& key,Value* old= nullptr){
+            Shard& shard = shardFor(key);
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto it = shard.index.find(key);
+            if (it==shard.index.end()) return false;
+            if (old) *old = it->second->value;
+            shard.lru.erase(it->second);
+            shard.index.erase(it);
+            return true;
+        }
+        // 当前条目数
+        size_t size() const{
+            size_t total = 0;
+            for (const auto& shard:shards_){
+                std::lock_guard<std::mutex> lock(shard->mutex);
+                total += shard->index.size();
+            }
+            return total;
+        }
+        // 因容量不足被淘汰的条目数
+        uint64_t evictions() const {return evictions_.load();}
+    private:
+        struct Node{
+            Key key;
+            Value value;
+            Clock::time_point expires;
+        };
+        struct Shard{
+            mutable std::mutex mutex;
+            std::list<Node> lru;
+            std::unordered_map<Key,typename std::list<Node>::iterator> index;
+            size_t capacity = 1;
+        };
+        Shard& shardFor(const Key& key){
+            return *shards_[std::hash<Key>{}(key)%shards_.size()];
+        }
+        // 淘汰超出容量的条目（调用者持有分片锁）
+        void evict(Shard& shard){
+            while (shard.index.size()>shard.capacity){
+                shard.index.erase(shard.lru.back().key);
+                shard.lru.pop_back();
+                evictions_.fetch_add(1,std::memory_order_relaxed);
+            }
+        }
+        std::vector<std::unique_ptr<Shard>> shards_;
+        std::atomic<uint64_t> evictions_;
+    };
+}
+
+#endif //EASYCHATSERVER_LRU_CACHE_H
@@ -8,6 +8,8 @@
 #include<cstdint>
 #include<string>
 #include<vector>
+#include<string_view>
+#include<memory>
 #include<arpa/inet.h>
 
 namespace easychat {
@@ -17,9 +19,9 @@ namespace easychat {
         MSG_TYPE_LOGIN_RESP, // 登陆响应
         MSG_TYPE_REGISTER,  // 注册请求
         MSG_TYPE_REGISTER_RESP, // 注册响应
-        MSG_TYPE_CHAT, // 聊天信息
-        MSG_TYPE_CHAT_RESP, // 聊天响应
-        MSG_TYPE_OFFLINE_MSG, // 离线消息推送
+        MSG_TYPE_CHAT, // 聊天信息（发送：[c<客户端消息ID>:]receiver_id:content；推送：message_id:seq:content）
+        MSG_TYPE_CHAT_RESP, // 聊天响应（发送时带客户端消息ID才回复，消息体：client_id:message_id，重发的消息返回原消息ID）
+        MSG_TYPE_OFFLINE_MSG, // 离线消息推送（message_id:seq:content）
         MSG_TYPE_HEARTBEAT, // 心跳消息
         MSG_TYPE_ERROR, // 错误消息
         MSG_TYPE_HISTORY,        // 获取聊天记录
@@ -27,7 +29,34 @@ namespace easychat {
         MSG_TYPE_HISTORY_RESP,    // 聊天记录响应
         MSG_TYPE_USERS_RESP,      // 在线用户响应
         MSG_TYPE_GET_USER_BY_NAME,  // 根据用户名获取用户信息
-        MSG_TYPE_GET_USER_BY_NAME_RESP  // 根据用户名获取用户信息响应
+        MSG_TYPE_GET_USER_BY_NAME_RESP,  // 根据用户名获取用户信息响应
+        MSG_TYPE_RESUME,  // 会话恢复（携带登录时下发的令牌）
+        MSG_TYPE_ROOM_CREATE,    // 创建群聊（消息体：房间名）
+        MSG_TYPE_ROOM_JOIN,      // 加入群聊（消息体：room_id）
+        MSG_TYPE_ROOM_LEAVE,     // 退出群聊（消息体：room_id）
+        MSG_TYPE_ROOM_CHAT,      // 群聊消息（消息体：room_id:content，推送时user_id为发送者，消息体为room_id:message_id:seq:content）
+        MSG_TYPE_ROOM_RESP,      // 群聊操作响应（created/joined/left:room_id）
+        MSG_TYPE_BROADCAST,      // 全服公告（管理员发起；推送时user_id为0）
+        MSG_TYPE_BROADCAST_RESP, // 公告已受理（消息体：queued:在线用户数）
+        MSG_TYPE_SYNC,           // 增量同步请求（消息体：会话=已读到的序号,...，会话为u<对方ID>或r<房间ID>）；
+                                 // 同步结束时服务器以同类型回复（会话=已同步到的序号:最新序号,...）
+        MSG_TYPE_SYNC_RESP,      // 增量同步的一条消息（user_id为发送者，消息体：会话:seq:content）
+        MSG_TYPE_ACK,            // 投递确认（客户端：message_id,message_id,...）；上线同步批次末尾服务器发送一个确认号，客户端原样确认
+        MSG_TYPE_READ,           // 已读回执（客户端：对方用户ID:seq；转发给对方时user_id为读者，消息体：reader_id:seq）
+        MSG_TYPE_INBOX,          // 收件箱（请求：会话数，可为空；响应：peer_id:未读数:last_seq:last_sender_id:预览字节数:预览|...）
+        MSG_TYPE_SEARCH,         // 全文搜索（请求：条数:before_id:关键词；响应：消息ID:对方用户ID:发送者ID:摘要字节数:摘要|...）
+        MSG_TYPE_BLOB_BEGIN,     // 开始/续传附件上传（请求：sha256:字节数；响应MSG_TYPE_BLOB_RESP）
+        MSG_TYPE_BLOB_CHUNK,     // 上传一块附件（请求：sha256:偏移:原始字节，每块至多256KB，完成时回复MSG_TYPE_BLOB_RESP）
+        MSG_TYPE_BLOB_RESP,      // 上传进度（消息体：sha256:已收到字节数:总字节数，两者相等表示附件已存储）
+        MSG_TYPE_BLOB_GET,       // 下载附件（请求：sha256:偏移:字节数，字节数为0表示到末尾；响应若干MSG_TYPE_BLOB_DATA）
+        MSG_TYPE_BLOB_DATA,      // 附件数据（消息体：sha256:偏移:总字节数:原始字节）
+        MSG_TYPE_RELAY_BEGIN,    // 在线直传（请求：接收者ID:字节数:文件名；响应MSG_TYPE_RELAY_RESP）
+        MSG_TYPE_RELAY_RESP,     // 直传响应（wait:id，等待接收者接受；go:id，接收者已接受，发送MSG_TYPE_RELAY_START；
+                                 // store[:id]，回退到附件上传；done:id，直传完成）
+        MSG_TYPE_RELAY_DATA,     // 直传数据（消息体：id:发送者ID:字节数:文件名:原始字节）
+        MSG_TYPE_RELAY_OFFER,    // 直传邀请（推送给接收者：id:发送者ID:字节数:文件名）
+        MSG_TYPE_RELAY_ACCEPT,   // 接收者答复邀请（id:1接受，id:0拒绝）
+        MSG_TYPE_RELAY_START     // 开始直传（发送者收到go后：id:字节数，帧之后紧接着发送原始字节）
     };
 // 消息头部结构（固定12字节）
 #pragma pack(push ,1)
@@ -81,6 +110,47 @@ namespace easychat {
         uint32_t user_id_;
         std::string data_;
     };
+// 已序列化的帧：扇出给多个连接时共享同一份数据，只序列化一次
+    using SharedFrame = std::shared_ptr<const std::vector<char>>;
+    SharedFrame makeSharedFrame(const Message &msg);
+
+// 帧写入器：直接在输出缓冲区中构建一个或多个连续的消息帧
+// 头部先占位，endFrame()时回填长度，消息体无需先拼接成std::string
+    class FrameWriter {
+    public:
+        explicit FrameWriter(size_t reserve_size = 0);
+
+        // 开始一个新帧
+        void beginFrame(MessageType type, uint32_t user_id);
+
+        // 追加消息体内容
+        void append(const char *data, size_t length);
+
+        void append(std::string_view data) { append(data.data(), data.size()); }
+
+        void append(char c) { buffer_.push_back(c); }
+
+        // 以十进制文本追加整数
+        void appendInt(int64_t value);
+
+        // 结束当前帧并回填头部长度
+        void endFrame();
+
+        // 当前帧的消息体长度
+        size_t currentBodySize() const;
+
+        size_t frameCount() const { return frame_count_; }
+
+        bool empty() const { return buffer_.empty(); }
+
+        const std::vector<char> &buffer() const { return buffer_; }
+
+    private:
+        std::vector<char> buffer_;
+        size_t frame_start_;
+        size_t frame_count_;
+        bool in_frame_;
+    };
 // 工具函数：将主机字节序转换为网络字节序
 // htonl: host to network long (32位整数)
     inline uint32_t hostToNetwork32(uint32_t host){
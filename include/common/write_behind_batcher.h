@@ -0,0 +1,174 @@
+//
+// Created by Cando on 2026/10/19.
+//
+
+#ifndef EASYCHATSERVER_WRITE_BEHIND_BATCHER_H
+#define EASYCHATSERVER_WRITE_BEHIND_BATCHER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace easychat{
+    // 异步批量写入器（write-behind），已读回执、投递状态与在线状态共用
+    // 变更按键合并进待写表（同一键只保留合并后的一项），后台线程按周期取出至多max_batch项交给刷新回调整批写入；
+    // 写入失败时放回待写表，与期间到达的新变更合并后等下个周期重试。未启动时每次变更同步刷新
+    template<typename Key,typename Value,typename Hash = std::hash<Key>>
+    class WriteBehindBatcher{
+    public:
+        // 刷新回调：整批写入，成功返回true。在锁外调用，同一时刻只有一个刷新；回调可以从批中移除无需写入的项
+        using Flush = std::function<bool(std::vector<Value>& batch)>;
+        // 变更的键
+        using KeyOf = std::function<Key(const Value&)>;
+        // 合并同一键的两次变更：older为较早的变更，newer为较晚的变更，结果写回older
+        using Merge = std::function<void(Value& older,Value&& newer)>;
+
+        // name用于日志（如"read receipts"）
+        WriteBehindBatcher(std::string name,KeyOf key_of,Merge merge)
+        :name_(std::move(name)),key_of_(std::move(key_of)),merge_(std::move(merge)),
+        interval_ms_(0),max_batch_(0),max_pending_(0),dropped_(0),running_(false){}
+        ~WriteBehindBatcher(){
+            stop();
+        }
+        WriteBehindBatcher(const WriteBehindBatcher&) = delete;
+        WriteBehindBatcher& operator=(const WriteBehindBatcher&) = delete;
+
+        // 设置刷新回调（设置前的变更只进入待写表）
+        void setFlush(Flush flush){
+            std::lock_guard<std::mutex> lock(mutex_);
+            flush_ = std::move(flush);
+        }
+        // 启动后台线程（interval_ms为刷新周期，不大于0时保持同步写入；max_batch为单批最大项数；
+        // max_pending为待写表上限，0表示不限）
+        void start(int interval_ms,size_t max_batch,size_t max_pending = 0){
+            std::lock_guard<std::mutex> lock(mutex_);
+            max_pending_ = max_pending;
+            if (running_ || interval_ms<=0 || !flush_) return;
+            interval_ms_ = interval_ms;
+            max_batch_ = max_batch==0 ? 1 : max_batch;
+            running_ = true;
+            thread_ = std::thread(&WriteBehindBatcher::backgroundLoop,this);
+        }
+        // 记录一项变更（与同一键尚未写入的变更合并）；待写表已满时丢弃新键的变更并返回false
+        bool add(Value value){
+            std::unique_lock<std::mutex> lock(mutex_);
+            bool added = insert(std::move(value));
+            if (!running_ && flush_) flushBatch(lock);
+            return added;
+        }
+        // 记录一批变更（只加锁一次），返回记录的项数
+        size_t add(std::vector<Value> values){
+            std::unique_lock<std::mutex> lock(mutex_);
+            size_t added = 0;
+            for (auto& value:values){
+                if (insert(std::move(value))) ++added;
+            }
+            if (!running_ && flush_) flushBatch(lock);
+            return added;
+        }
+        // 待写入的项数
+        size_t pendingCount(){
+            std::lock_guard<std::mutex> lock(mutex_);
+            return pending_.size();
+        }
+        // 写完剩余变更并停止后台线程
+        void stop(){
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!running_) return;
+                running_ = false;
+            }
+            cond_.notify_all();
+            if (thread_.joinable()) thread_.join();
+        }
+    private:
+        // 合并进待写表（调用者持有mutex_）
+        bool insert(Value&& value){
+            Key key = key_of_(value);
+            auto it = pending_.find(key);
+            if (it!=pending_.end()){
+                merge_(it->second,std::move(value));
+            }else if (max_pending_>0 && pending_.size()>=max_pending_){
+                if (dropped_++==0) std::cerr<<"Pending "<<name_<<" full, dropping updates"<<std::endl;
+                return false;
+            }else{
+                pending_.emplace(std::move(key),std::move(value));
+            }
+            return true;
+        }
+        // 取出一批交给刷新回调，失败时放回待写表（调用者持有mutex_）
+        bool flushBatch(std::unique_lock<std::mutex>& lock){
+            std::vector<Value> batch;
+            for (auto it = pending_.begin();it!=pending_.end() && (max_batch_==0 || batch.size()<max_batch_);){
+                batch.push_back(std::move(it->second));
+                it = pending_.erase(it);
+            }
+            if (batch.empty()) return true;
+            Flush flush = flush_;
+            lock.unlock();
+            bool ok;
+            {
+                std::lock_guard<std::mutex> flush_lock(flush_mutex_);
+                ok = flush(batch);
+            }
+            lock.lock();
+            if (!ok){
+                // 写入失败：放回待写表，期间有新变更的键以失败的一项为较早的变更合并
+                for (auto& value:batch){
+                    Key key = key_of_(value);
+                    auto it = pending_.find(key);
+                    if (it==pending_.end()){
+                        pending_.emplace(std::move(key),std::move(value));
+                    }else{
+                        merge_(value,std::move(it->second));
+                        it->second = std::move(value);
+                    }
+                }
+                std::cerr<<"Failed to persist "<<name_<<" for "<<batch.size()<<" items, will retry"<<std::endl;
+            }
+            if (dropped_>0){
+                std::cerr<<"Dropped "<<dropped_<<" "<<name_<<" while pending was full"<<std::endl;
+                dropped_ = 0;
+            }
+            return ok;
+        }
+        void backgroundLoop(){
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (true){
+                cond_.wait_for(lock,std::chrono::milliseconds(interval_ms_),[this](){return !running_;});
+                // 一个周期内写完所有待写变更，失败则等下个周期重试
+                while (!pending_.empty()){
+                    if (!flushBatch(lock)) break;
+                }
+                if (!running_) break;
+            }
+            if (!pending_.empty()){
+                std::cerr<<"Writer for "<<name_<<" stopped with "<<pending_.size()<<" unsaved items"<<std::endl;
+            }
+        }
+
+        std::string name_;
+        KeyOf key_of_;
+        Merge merge_;
+        Flush flush_;
+        int interval_ms_;
+        size_t max_batch_;
+        size_t max_pending_;
+        size_t dropped_;
+        std::unordered_map<Key,Value,Hash> pending_;
+        bool running_;
+        std::mutex mutex_;
+        std::mutex flush_mutex_;
+        std::condition_variable cond_;
+        std::thread thread_;
+    };
+}
+
+#endif //EASYCHATSERVER_WRITE_BEHIND_BATCHER_H
@@ -0,0 +1,151 @@
+//
+// Created by Cando on 2026/10/19.
+//
+
+#ifndef EASYCHATSERVER_BLOB_STORE_H
+#define EASYCHATSERVER_BLOB_STORE_H
+
+#include <openssl/evp.h>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace easychat{
+    // 只读打开的附件文件（最后一个引用释放时关闭，发送队列持有引用直到sendfile发送完）
+    class BlobFile{
+    public:
+        BlobFile(int fd,uint64_t size) :fd_(fd),size_(size){}
+        ~BlobFile();
+        BlobFile(const BlobFile&) = delete;
+        BlobFile& operator=(const BlobFile&) = delete;
+        int fd() const {return fd_;}
+        uint64_t size() const {return size_;}
+    private:
+        int fd_;
+        uint64_t size_;
+    };
+
+    // 附件存储类-单例模式
+    // 附件按SHA-256内容寻址存放在磁盘（objects/前两位/完整哈希），相同内容只存一份；
+    // 上传按块顺序追加到每个用户自己的临时文件（tmp/用户ID-哈希），边写边计算哈希，
+    // 完成后校验哈希并原子重命名为正式文件。临时文件保留到完成或过期，断线或重启后可从已收到的位置续传。
+    // 消息表只保存引用（file:哈希:字节数:文件名），下载由调用者用sendfile直接从文件发送。
+    // 每个附件在refs/下有一个引用文件，记录上传者与引用它的消息：只有上传过（证明持有内容）、
+    // 或发送/接收过引用它的消息的用户（群聊为房间成员）才能引用和下载；消息过期后引用随之删除，
+    // 没有引用且上传已超过保留期的附件被回收。每个用户的附件与未完成上传计入配额
+    class BlobStore{
+    public:
+        // 保留期截止位置：会话（房间ID，0为单聊）中ID小于返回值的消息已过期，返回0表示永久保留
+        using RefCutoff = std::function<int64_t(int room_id)>;
+        // 用户是否为房间成员
+        using RoomMembership = std::function<bool(int room_id,int user_id)>;
+
+        static BlobStore& getInstance();
+        // 创建目录，统计各用户的用量并清理过期的临时文件
+        // user_quota_bytes为每个用户的附件与未完成上传的总字节数上限，max_pending_uploads为每个用户未完成的上传数上限（不大于0时不限）
+        bool init(const std::string& root_dir,uint64_t max_blob_bytes,int upload_ttl_seconds,
+                  uint64_t user_quota_bytes,int max_pending_uploads);
+        // 设置房间成员检查（群聊附件的下载权限）
+        void setRoomMembership(RoomMembership membership);
+        // 开始（或续传）上传：用户已有权访问该附件时exists为true（无需上传），否则received为已收到的字节数；
+        // 其他用户上传过相同内容时仍需上传，不透露附件是否存在
+        bool beginUpload(int user_id,const std::string& sha256,uint64_t size,bool& exists,uint64_t& received,
+                         std::string& error);
+        // 追加一块（offset必须等于已收到的字节数），最后一块写入后校验并落盘，completed为true
+        bool appendChunk(int user_id,const std::string& sha256,uint64_t offset,const char* data,size_t length,
+                         bool& completed,uint64_t& received,std::string& error);
+        // 打开附件用于下载（不存在返回nullptr）
+        std::shared_ptr<const BlobFile> open(const std::string& sha256);
+        // 附件是否存在且大小一致
+        bool exists(const std::string& sha256,uint64_t size);
+        // 用户是否有权下载附件
+        bool canAccess(int user_id,const std::string& sha256);
+        // 记录消息对附件的引用（room_id为0时receiver_id为接收者）；附件不存在、大小不一致或发送者无权访问时返回false
+        bool addReference(const std::string& sha256,uint64_t size,int64_t message_id,int sender_id,int receiver_id,
+                          int room_id);
+        // 删除已过期消息的引用，回收没有引用且上传已超过保留期的附件（cutoff为空时只回收没有引用的附件）
+        void collectGarbage(const RefCutoff& cutoff);
+        // 解析附件引用（image:或file:开头，哈希:字节数:文件名），message_type为1（图片）或2（文件）
+        static bool parseReference(std::string_view content,std::string& sha256,uint64_t& size,int& message_type);
+        // 是否为64位小写十六进制的SHA-256
+        static bool isValidHash(std::string_view sha256);
+        bool isEnabled() const {return !root_dir_.empty();}
+    private:
+        BlobStore();
+        ~BlobStore();
+        BlobStore(const BlobStore&) = delete;
+        BlobStore& operator=(const BlobStore&) = delete;
+        // 进行中的上传（文件描述符与哈希上下文，长时间不活动时释放，临时文件保留）
+        struct Upload{
+            std::mutex mutex;
+            int fd = -1;
+            EVP_MD_CTX* digest = nullptr;
+            uint64_t size = 0;
+            uint64_t received = 0;
+            int64_t last_active_ms = 0;
+            bool finished = false;
+            ~Upload();
+        };
+        // 引用文件的内容：上传者（u 用户ID 字节数 上传时间）与引用消息（m 消息ID 发送者 接收者 房间ID）
+        struct BlobUploader{
+            int user_id;
+            uint64_t size;
+            int64_t uploaded_at; // 秒
+        };
+        struct BlobRef{
+            int64_t message_id;
+            int sender_id;
+            int receiver_id;
+            int room_id;
+        };
+        struct BlobRefs{
+            std::vector<BlobUploader> uploaders;
+            std::vector<BlobRef> refs;
+        };
+        // 用户的用量：已上传的附件与未完成的上传（哈希->声明的字节数）
+        struct UserUsage{
+            uint64_t stored_bytes = 0;
+            uint64_t pending_bytes = 0;
+            std::unordered_map<std::string,uint64_t> pending;
+        };
+        std::string objectPath(const std::string& sha256) const;
+        std::string tempPath(int user_id,const std::string& sha256) const;
+        std::string refsPath(const std::string& sha256) const;
+        // 读取/追加/重写引用文件（调用者持有refs_mutex_）
+        bool loadRefs(const std::string& sha256,BlobRefs& refs) const;
+        bool appendRefs(const std::string& sha256,const std::string& line);
+        bool writeRefs(const std::string& sha256,const BlobRefs& refs);
+        bool hasAccess(int user_id,const BlobRefs& refs) const;
+        // 登记/释放用户未完成的上传（调用者持有mutex_）
+        bool reservePending(int user_id,const std::string& sha256,uint64_t size,std::string& error);
+        void releasePending(int user_id,const std::string& sha256);
+        // 扫描引用文件与临时文件，统计各用户的用量
+        void loadUsage();
+        // 打开临时文件并重新计算已收到部分的哈希（续传）
+        bool openUpload(Upload& upload,const std::string& path,std::string& error);
+        // 释放长时间不活动的上传，定期删除过期的临时文件（调用者持有mutex_）
+        void releaseIdleUploads(int64_t now_ms);
+        void removeExpiredTemps();
+
+        std::string root_dir_;
+        uint64_t max_blob_bytes_;
+        int upload_ttl_seconds_;
+        uint64_t user_quota_bytes_;
+        int max_pending_uploads_;
+        int64_t last_sweep_ms_;
+        bool gc_due_; // 周期检查时回收没有引用的附件（未开启消息过期时也会执行）
+        RoomMembership room_membership_;
+        std::mutex mutex_;
+        std::unordered_map<std::string,std::shared_ptr<Upload>> uploads_; // 用户ID-哈希->上传
+        std::unordered_map<int,UserUsage> usage_; // 用户ID->用量
+        // 引用文件与正式文件的增删（重命名落盘、记录引用、回收）
+        std::mutex refs_mutex_;
+    };
+}
+
+#endif //EASYCHATSERVER_BLOB_STORE_H
@@ -0,0 +1,40 @@
+//
+// Created by Cando on 2026/10/19.
+//
+
+#ifndef EASYCHATSERVER_CIRCUIT_BREAKER_H
+#define EASYCHATSERVER_CIRCUIT_BREAKER_H
+
+#include <atomic>
+#include <cstdint>
+
+namespace easychat{
+    // 熔断器：连续失败达到阈值后断开，断开期间请求直接失败；
+    // 冷却时间过后放行一个探测请求（半开），成功则恢复，失败则继续断开
+    class CircuitBreaker{
+    public:
+        enum class State : int{
+            CLOSED = 0,   // 正常
+            OPEN = 1,     // 断开，快速失败
+            HALF_OPEN = 2 // 半开，探测中
+        };
+        CircuitBreaker();
+        // 配置失败阈值与断开冷却时间（毫秒）
+        void configure(int failure_threshold,int open_timeout_ms);
+        // 是否允许请求通过（probe为本次放行的是否为半开探测请求）
+        bool allowRequest(bool& probe);
+        // 记录请求结果：只有实际执行成功的语句计为成功；半开与断开期间只有探测请求的成功能恢复熔断器
+        void recordSuccess(bool probe);
+        void recordFailure();
+        State getState() const {return static_cast<State>(state_.load());}
+    private:
+        static int64_t nowMs();
+        std::atomic<int> state_;
+        std::atomic<int> consecutive_failures_;
+        std::atomic<int64_t> opened_at_ms_;
+        std::atomic<int> failure_threshold_;
+        std::atomic<int> open_timeout_ms_;
+    };
+}
+
+#endif //EASYCHATSERVER_CIRCUIT_BREAKER_H
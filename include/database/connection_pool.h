@@ -5,6 +5,7 @@
 #ifndef EASYCHATSERVER_CONNECTION_POOL_H
 #define EASYCHATSERVER_CONNECTION_POOL_H
 
+#include "database/circuit_breaker.h"
 #include <mysql/mysql.h>
 #include <memory>
 #include <queue>
@@ -25,19 +26,52 @@ namespace easychat{
                      const std::string& user,
                      const std::string& password,
                      const std::string& database);
+        // 设置连接/读/写超时（秒），需在connect之前调用
+        void setTimeouts(int connect_timeout,int read_timeout,int write_timeout);
+        // 使用上次的参数重新连接
+        bool reconnect();
+        // 最近一次失败是否为连接级错误（服务器断开、超时等）
+        bool lastErrorIsConnectionLoss() const {return connection_lost_;}
         // 执行sql语言
         bool execute(const std::string& sql);
         // 查询数据
         MYSQL_RES* query(const std::string& sql);
+        // 转义字符串，防止SQL注入
+        std::string escape(const std::string& value);
         // 获取连接对象
         MYSQL* getMySQL(){return mysql_;}
         //检查连接是否有效
         bool isConnected() const {return connected_;}
+        // 记录本次从连接池取出连接的等待时间（微秒），计入下一条语句的统计
+        void setPoolWait(int64_t wait_us){pool_wait_us_ = wait_us;}
+        // 从连接池取出时重置本次使用的状态（probe为是否为熔断器的半开探测）
+        void beginLease(bool probe){probe_ = probe;statement_succeeded_ = false;}
+        // 本次使用是否为半开探测
+        bool isProbe() const {return probe_;}
+        // 本次使用中是否有语句实际执行成功
+        bool statementSucceeded() const {return statement_succeeded_;}
         // 关闭连接
         void close();
     private:
+        // 上报语句耗时到QueryStats
+        void recordStatement(const std::string& sql,int64_t exec_us,int64_t rows,bool ok);
+        // 检查错误码，连接级错误时标记连接失效
+        void checkError();
         MYSQL * mysql_;
         bool connected_;
+        bool connection_lost_;
+        int64_t pool_wait_us_;
+        bool probe_;
+        bool statement_succeeded_;
+        // 连接参数（用于重连）
+        std::string host_;
+        uint16_t port_;
+        std::string user_;
+        std::string password_;
+        std::string database_;
+        unsigned int connect_timeout_;
+        unsigned int read_timeout_;
+        unsigned int write_timeout_;
     };
     // 数据库连接池类
     class ConnectionPool{
@@ -50,7 +84,11 @@ namespace easychat{
                   const std::string& password,
                   const std::string& database,
                   size_t pool_size);
-        // 获取连接
+        // 配置容错参数：超时（秒）、获取连接最长等待（毫秒）、熔断阈值与冷却时间（毫秒）
+        // 需在init之前调用
+        void configureResilience(int connect_timeout,int read_timeout,int write_timeout,
+                                 int acquire_timeout_ms,int failure_threshold,int open_timeout_ms);
+        // 获取连接（熔断断开或等待超时返回nullptr）
         std::shared_ptr<MySQLConnection> getConnection();
         // 归还连接
         void returnConnection(std::shared_ptr<MySQLConnection> conn);
@@ -63,6 +101,8 @@ namespace easychat{
             std::lock_guard<std::mutex> lock(mutex_);
             return connections_.size();
         }
+        // 数据库当前是否可用（熔断器未断开）
+        bool isHealthy() const {return breaker_.getState()==CircuitBreaker::State::CLOSED;}
         // 关闭连接池
         void close();
     private:
@@ -84,6 +124,13 @@ namespace easychat{
         std::string database_;
         size_t pool_size_;
         std::atomic<bool> initialized_;
+        // 超时配置
+        int connect_timeout_;
+        int read_timeout_;
+        int write_timeout_;
+        int acquire_timeout_ms_;
+        // 熔断器
+        CircuitBreaker breaker_;
     };
 }
 
@@ -0,0 +1,238 @@
+//
+// Created by Cando on 2026/10/19.
+//
+
+#ifndef EASYCHATSERVER_LOG_MESSAGE_STORE_H
+#define EASYCHATSERVER_LOG_MESSAGE_STORE_H
+
+#include "database/message_store.h"
+#include <cstdint>
+#include <string_view>
+#include <map>
+#include <unordered_map>
+#include <shared_mutex>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+
+namespace easychat{
+    // 嵌入式日志结构存储：无需MySQL
+    // 所有写入以记录形式追加到段文件（segment-XXXXXX.log），内存中只保留索引，
+    // 消息正文按位置从段文件读取；后台线程定期刷盘并压缩已封存的段
+    class LogMessageStore : public MessageStore{
+    public:
+        LogMessageStore();
+        ~LogMessageStore() override;
+        // 禁止拷贝和赋值
+        LogMessageStore(const LogMessageStore&) = delete;
+        LogMessageStore& operator=(const LogMessageStore&) = delete;
+
+        // 初始化：打开（或创建）数据目录并重放所有段文件
+        bool init(const std::string& data_dir,size_t segment_size,
+                  int compaction_interval,int sync_interval_ms);
+        // 关闭存储，停止后台线程
+        void close();
+        // 压缩已封存的段（后台线程周期调用，也可手动触发）
+        bool compact();
+
+        bool storeMessage(MessageInfo& message) override;
+        bool fetchOfflineMessages(int user_id,std::vector<MessageInfo>& messages) override;
+        bool getChatHistory(int user_id1,int user_id2,std::vector<MessageInfo>& messages,int limit) override;
+        bool writeOfflineMessages(int user_id,FrameWriter& writer) override;
+        bool writeChatHistory(int user_id1,int user_id2,int limit,FrameWriter& writer) override;
+        bool writeMessagesSince(int user_id,int64_t after_id,FrameWriter& writer,int64_t& max_id) override;
+        bool getDeviceCursor(int user_id,const std::string& device_id,int64_t& message_id,bool& found) override;
+        bool updateDeviceCursor(int user_id,const std::string& device_id,int64_t message_id) override;
+        bool getUserCursor(int user_id,int64_t& message_id) override;
+        bool createRoom(const std::string& name,int owner_id,int& room_id) override;
+        bool addRoomMember(int room_id,int user_id,int64_t joined_message_id) override;
+        bool removeRoomMember(int room_id,int user_id) override;
+        bool loadRooms(std::vector<RoomInfo>& rooms) override;
+        bool storeRoomMessage(MessageInfo& message) override;
+        bool writeRoomMessagesSince(int room_id,int64_t after_id,FrameWriter& writer,int64_t& max_id) override;
+        bool getConversationSeq(int user_id1,int user_id2,int64_t& seq) override;
+        bool getRoomSeq(int room_id,int64_t& seq) override;
+        bool writeConversationSince(int user_id1,int user_id2,int64_t after_seq,int limit,
+                                    std::string_view prefix,FrameWriter& writer,int64_t& last_seq) override;
+        bool writeRoomSince(int room_id,int64_t after_seq,int64_t after_id,int limit,
+                            std::string_view prefix,FrameWriter& writer,int64_t& last_seq) override;
+        bool markConversationsRead(const std::vector<ReadReceipt>& receipts) override;
+        bool loadInbox(int user_id,std::vector<InboxEntry>& entries) override;
+        bool scanMessages(int64_t after_id,int limit,std::vector<MessageInfo>& messages) override;
+        bool getMessagesByIds(const std::vector<int64_t>& message_ids,std::vector<MessageInfo>& messages) override;
+        bool expireMessages(int64_t after_id,int64_t before_id,int limit,std::vector<MessageInfo>& deleted) override;
+        bool expireRoomMessages(int room_id,int64_t after_id,int64_t before_id,int limit,
+                                std::vector<MessageInfo>& deleted) override;
+        bool getUserById(int user_id,UserInfo& user_info,bool& found) override;
+        bool getUserByName(const std::string& username,UserInfo& user_info,bool& found) override;
+        bool createUser(const std::string& username,const std::string& password,
+                        const std::string& nickname,int& user_id) override;
+        bool updateUserStatus(int user_id,int status) override;
+        bool updateUserPassword(int user_id,const std::string& password) override;
+        bool addOnlineUser(int user_id,int socket_fd,const std::string& ip,int port) override;
+        bool removeOnlineUser(int user_id) override;
+        bool getOnlineUserIds(std::vector<int>& user_ids) override;
+        bool updatePresence(const std::vector<PresenceUpdate>& updates) override;
+        bool markDelivered(const std::vector<std::pair<int,int64_t>>& deliveries) override;
+        const char* name() const override {return "log";}
+    private:
+        // 记录类型
+        enum RecordType : uint8_t{
+            RECORD_MESSAGE = 1,      // 完整消息
+            RECORD_MESSAGE_FLAGS = 2,// 消息状态更新（is_offline/is_read）
+            RECORD_USER = 3,         // 完整用户
+            RECORD_USER_STATUS = 4,  // 用户状态更新
+            RECORD_DEVICE_CURSOR = 5,// 设备投递游标
+            RECORD_ROOM = 6,         // 群聊
+            RECORD_ROOM_MEMBER = 7,  // 群聊成员加入/退出
+            RECORD_ROOM_MESSAGE = 8, // 群聊消息（格式同RECORD_MESSAGE，receiver_id为房间ID）
+            RECORD_DELIVERED = 9,    // 一批消息已投递（接收者ID+消息ID列表）
+            RECORD_READ = 10,        // 一批已读回执（读者ID+对方ID+序号列表）
+            RECORD_EXPIRED = 11,     // 一批过期删除的消息（房间ID，单聊为0+消息ID列表）
+            RECORD_SEQ_FLOOR = 12    // 会话序号下限（消息全部过期的会话，之后的序号从此继续）
+        };
+        // 记录在段文件中的位置
+        struct RecordLocation{
+            uint32_t segment;
+            uint64_t offset;
+            uint32_t length;
+        };
+        // 消息索引项（正文留在磁盘上）
+        struct MessageEntry{
+            int sender_id;
+            int receiver_id;
+            int message_type;
+            int is_offline;
+            int is_read;
+            int64_t created_at;
+            int64_t seq; // 会话内序号（旧格式记录为0）
+            RecordLocation location;
+        };
+        // 用户索引项
+        struct UserEntry{
+            UserInfo info;
+            RecordLocation location;
+        };
+        // 设备投递游标
+        struct DeviceCursor{
+            int64_t message_id;
+            RecordLocation location;
+        };
+        // 群聊索引项
+        struct RoomEntry{
+            std::string name;
+            int owner_id;
+            RecordLocation location;
+        };
+        // 群聊成员索引项
+        struct RoomMemberEntry{
+            int64_t joined_message_id;
+            RecordLocation location;
+        };
+        // 会话序号下限
+        struct SeqFloor{
+            int64_t seq;
+            RecordLocation location;
+        };
+        // 段文件
+        struct Segment{
+            int fd;
+            uint64_t size;
+            uint64_t dead_bytes; // 压缩后可回收的字节数
+        };
+
+        // 段文件路径
+        std::string segmentPath(uint32_t segment_id) const;
+        // 打开新的活动段
+        bool openActiveSegment(uint32_t segment_id);
+        // 重放单个段文件，返回有效数据长度
+        uint64_t replaySegment(uint32_t segment_id,int fd);
+        // 应用一条记录到内存索引
+        void applyRecord(uint8_t type,const char* payload,uint32_t length,const RecordLocation& location);
+        // 追加记录到活动段（调用者持有写锁）
+        bool appendRecord(uint8_t type,const std::string& payload,RecordLocation& location);
+        // 读取消息记录到record，content指向其中的正文（调用者持有锁）
+        bool readContent(int64_t message_id,const MessageEntry& entry,std::string& record,std::string_view& content);
+        // 从段文件读取消息正文（调用者持有锁）
+        bool readMessage(int64_t message_id,const MessageEntry& entry,MessageInfo& message);
+        // 重建会话与离线索引
+        void rebuildIndexes();
+        // 从按到达顺序排列的消息ID列表末尾向前，找出序号大于after_seq且消息ID大于after_id的消息（按序号递增，至多limit条）
+        static void collectSince(const std::vector<int64_t>& message_ids,const std::unordered_map<int64_t,MessageEntry>& entries,
+                                 int64_t after_seq,int64_t after_id,int limit,std::vector<std::pair<int64_t,int64_t>>& found);
+        // 将collectSince的结果写为增量同步帧（调用者持有锁）
+        void writeSyncFrames(const std::vector<std::pair<int64_t,int64_t>>& found,const std::unordered_map<int64_t,MessageEntry>& entries,
+                             std::string_view prefix,FrameWriter& writer,int64_t& last_seq);
+        // 后台线程：定期刷盘与压缩
+        void backgroundLoop();
+        // 是否值得压缩（调用者持有锁）
+        bool shouldCompact() const;
+
+        // 会话键（与方向无关）
+        static uint64_t conversationKey(int user_id1,int user_id2);
+        // 同一会话的消息按序号顺序写入，但重启后按消息ID重建索引，同一毫秒内不同线程生成的ID
+        // 可能与序号顺序相反，按ID倒序扫描时越过目标序号后再多看这么多条
+        static constexpr int64_t kSeqReorderSlack = 64;
+        // 编码记录
+        static std::string encodeMessage(int64_t message_id,const MessageEntry& entry,const std::string& content);
+        static std::string encodeUser(const UserInfo& info);
+        static std::string encodeDeviceCursor(int user_id,const std::string& device_id,int64_t message_id);
+        static std::string encodeRoom(int room_id,const RoomEntry& entry);
+        static std::string encodeRoomMember(int room_id,int user_id,int64_t joined_message_id,bool joined);
+        static std::string encodeSeqFloor(int room_id,uint64_t conversation_key,int64_t seq);
+        // 写入序号下限（调用者持有写锁）
+        bool appendSeqFloor(int room_id,uint64_t conversation_key,int64_t seq);
+        // 写入过期删除记录并从消息索引中删除（调用者持有写锁，message_ids递增）
+        bool appendExpired(int room_id,const std::vector<int64_t>& message_ids,std::vector<MessageInfo>& deleted);
+
+        std::string data_dir_;
+        size_t segment_size_;
+        int compaction_interval_;
+        int sync_interval_ms_;
+
+        // 索引读写锁
+        mutable std::shared_mutex mutex_;
+        // 段文件（段ID->段），最大ID为活动段
+        std::map<uint32_t,Segment> segments_;
+        uint32_t active_segment_;
+        // 消息索引（消息ID->索引项）
+        std::unordered_map<int64_t,MessageEntry> messages_;
+        // 会话索引（会话键->按ID递增的消息ID列表）
+        std::unordered_map<uint64_t,std::vector<int64_t>> conversations_;
+        // 离线消息索引（接收者ID->消息ID列表）
+        std::unordered_map<int,std::vector<int64_t>> offline_;
+        // 收件索引（接收者ID->按ID递增的消息ID列表）
+        std::unordered_map<int,std::vector<int64_t>> inbox_;
+        // 已读位置（(读者ID,对方ID)->已读到的序号），重启时由已读消息和RECORD_READ记录重建
+        std::map<std::pair<int,int>,int64_t> read_cursors_;
+        // 设备投递游标（(用户ID,设备ID)->游标）
+        std::map<std::pair<int,std::string>,DeviceCursor> device_cursors_;
+        // 群聊索引（房间ID->房间）与成员索引（(房间ID,用户ID)->成员）
+        std::map<int,RoomEntry> rooms_;
+        std::map<std::pair<int,int>,RoomMemberEntry> room_members_;
+        // 群聊消息索引（消息ID->索引项），房间时间线（房间ID->按ID递增的消息ID列表）
+        std::unordered_map<int64_t,MessageEntry> room_messages_;
+        std::unordered_map<int,std::vector<int64_t>> room_timelines_;
+        // 序号下限（(房间ID,单聊会话键)->下限，单聊的房间ID为0，群聊的会话键为0）
+        std::map<std::pair<int,uint64_t>,SeqFloor> seq_floors_;
+        int next_room_id_;
+        // 用户索引
+        std::unordered_map<int,UserEntry> users_;
+        std::unordered_map<std::string,int> user_names_;
+        // 在线用户（仅内存）
+        std::unordered_map<int,int> online_users_;
+        int next_user_id_;
+        bool dirty_; // 是否有未刷盘的写入
+
+        // 压缩互斥锁（同一时间只允许一个压缩任务）
+        std::mutex compaction_mutex_;
+        // 后台线程
+        std::thread background_thread_;
+        std::mutex background_mutex_;
+        std::condition_variable background_cv_;
+        std::atomic<bool> running_;
+    };
+}
+
+#endif //EASYCHATSERVER_LOG_MESSAGE_STORE_H
@@ -0,0 +1,76 @@
+//
+// Created by Cando on 2026/10/19.
+//
+
+#ifndef EASYCHATSERVER_MESSAGE_SPOOL_H
+#define EASYCHATSERVER_MESSAGE_SPOOL_H
+
+#include "database/message_store.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace easychat{
+    // 本地消息溢写区：数据库不可用时将消息追加到本地文件（批量fsync），
+    // 后台线程在数据库恢复后按写入顺序回放到存储后端，全部回放完成后清空文件。
+    // 消息ID在写入前已分配，回放是幂等的，崩溃后重复回放不会产生重复消息。
+    // 数据库不可用时无法加载会话序号，这类消息以序号0写入，回放时按存储中的最大序号依次分配
+    class MessageSpool{
+    public:
+        MessageSpool();
+        ~MessageSpool();
+        // 打开（或创建）溢写文件并启动后台线程，文件中遗留的消息会被回放
+        bool init(const std::string& path,std::shared_ptr<MessageStore> store,
+                  int sync_interval_ms,int retry_interval_ms);
+        // 追加一条消息（message.id必须已分配）
+        bool append(const MessageInfo& message);
+        // 是否有待回放的消息
+        bool hasPending() const {return pending_.load()>0;}
+        // 待回放的消息数
+        size_t pendingCount() const {return pending_.load();}
+        // 两人会话中待回放消息的最大序号（没有时为0）；
+        // 该会话还有未分配序号的消息时返回false，序号要等这些消息回放后才能确定
+        bool pendingSeq(int user_id1,int user_id2,int64_t& max_seq);
+        // 停止后台线程并关闭文件
+        void close();
+    private:
+        // 后台线程：批量刷盘与回放
+        void backgroundLoop();
+        // 回放至多max_records条消息，遇到失败返回false
+        bool replay(size_t max_records);
+        // 扫描文件，截断写了一半的尾部记录，返回有效记录数
+        size_t recover();
+        // 登记/注销一条待回放消息的会话序号（调用者持有mutex_）
+        void trackPending(const MessageInfo& message);
+        void untrackPending(const MessageInfo& message,bool sequenced);
+
+        // 会话中待回放的消息
+        struct PendingConversation{
+            int64_t max_seq = 0;
+            size_t unsequenced = 0; // 序号为0，回放时分配
+            size_t pending = 0;
+        };
+
+        std::string path_;
+        int fd_;
+        std::shared_ptr<MessageStore> store_;
+        int sync_interval_ms_;
+        int retry_interval_ms_;
+        // 写入位置与回放位置（回放位置只由后台线程修改）
+        uint64_t write_offset_;
+        uint64_t replay_offset_;
+        std::atomic<size_t> pending_;
+        std::unordered_map<uint64_t,PendingConversation> conversations_; // 会话键->待回放消息
+        bool dirty_;
+        bool running_;
+        std::mutex mutex_;
+        std::condition_variable cond_;
+        std::thread thread_;
+    };
+}
+
+#endif //EASYCHATSERVER_MESSAGE_SPOOL_H
@@ -0,0 +1,149 @@
+//
+// Created by Cando on 2026/10/19.
+//
+
+#ifndef EASYCHATSERVER_MESSAGE_STORE_H
+#define EASYCHATSERVER_MESSAGE_STORE_H
+
+#include "common/protocol.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace easychat{
+    // 消息信息结构体
+    struct MessageInfo{
+        int64_t id; // Snowflake消息ID
+        int sender_id;
+        int receiver_id;
+        std::string content;
+        int message_type; // 0-文本，1-图片，2-文件
+        int is_offline; // 0-否，1-是
+        int is_read; //0-未读，1-已读
+        std::string created_at;
+        int64_t seq = 0; // 会话内序号（单聊按两人会话、群聊按房间递增）
+    };
+    // 用户信息结构体
+    struct UserInfo{
+        int id;
+        std::string username;
+        std::string password;
+        std::string nickname;
+        std::string avatar; //头像
+        int status; // 0-离线，1-在线
+    };
+    // 在线状态变更（批量持久化）
+    struct PresenceUpdate{
+        int user_id;
+        int status; // 0-离线，1-在线
+        int socket_fd;
+        std::string ip;
+        int port;
+    };
+    // 已读回执：reader_id已读完peer_id发来的、序号不超过seq的消息（批量持久化）
+    struct ReadReceipt{
+        int reader_id;
+        int peer_id;
+        int64_t seq;
+    };
+    // 收件箱中的一个单聊会话（重启后首次查询收件箱时从存储加载）
+    struct InboxEntry{
+        int peer_id;
+        int64_t last_message_id; // 最后一条消息
+        int64_t last_seq;
+        int last_sender_id;
+        std::string last_content;
+        std::vector<int64_t> unread_seqs; // 对方发来的未读消息序号（递增）
+    };
+    // 群聊信息（启动时整体加载到内存）
+    struct RoomInfo{
+        int id;
+        std::string name;
+        int owner_id;
+        // 成员（用户ID，加入时的消息ID位置；只补发加入之后的群聊消息）
+        std::vector<std::pair<int,int64_t>> members;
+    };
+    // 存储接口：业务层只依赖该接口，不直接访问具体数据库
+    // 实现：MySQLMessageStore（MySQL）、LogMessageStore（嵌入式追加日志）
+    class MessageStore{
+    public:
+        virtual ~MessageStore() = default;
+        // 存储消息；message.id为0时由存储层生成并回填
+        virtual bool storeMessage(MessageInfo& message) = 0;
+        // 获取离线消息，并将其标记为已投递
+        virtual bool fetchOfflineMessages(int user_id,std::vector<MessageInfo>& messages) = 0;
+        // 获取两个用户之间的聊天记录（按时间倒序）
+        virtual bool getChatHistory(int user_id1,int user_id2,std::vector<MessageInfo>& messages,int limit) = 0;
+        // 将离线（尚未确认投递）消息逐条写为MSG_TYPE_OFFLINE_MSG帧（user_id为发送者，消息体message_id:seq:content）
+        // 直接序列化到输出缓冲区，不构造中间MessageInfo；投递状态在客户端确认后由markDelivered更新
+        virtual bool writeOfflineMessages(int user_id,FrameWriter& writer) = 0;
+        // 将发给该用户、ID大于after_id的消息逐条写为MSG_TYPE_OFFLINE_MSG帧（按ID递增），
+        // max_id返回写出的最大消息ID（没有消息时不变）
+        virtual bool writeMessagesSince(int user_id,int64_t after_id,FrameWriter& writer,int64_t& max_id) = 0;
+        // 设备投递游标：该设备已收到的最大消息ID，found返回是否有记录；返回false表示存储出错，不能据此当作新设备
+        virtual bool getDeviceCursor(int user_id,const std::string& device_id,int64_t& message_id,bool& found) = 0;
+        virtual bool updateDeviceCursor(int user_id,const std::string& device_id,int64_t message_id) = 0;
+        // 将聊天记录追加到当前帧的消息体（格式：sender_id:content|sender_id:content|...，按时间倒序）
+        virtual bool writeChatHistory(int user_id1,int user_id2,int limit,FrameWriter& writer) = 0;
+        // 该用户所有设备游标中的最大值（没有任何设备记录时返回false）
+        virtual bool getUserCursor(int user_id,int64_t& message_id) = 0;
+        // 群聊：创建房间（回填room_id）、成员增删、启动时加载全部房间与成员
+        virtual bool createRoom(const std::string& name,int owner_id,int& room_id) = 0;
+        virtual bool addRoomMember(int room_id,int user_id,int64_t joined_message_id) = 0;
+        virtual bool removeRoomMember(int room_id,int user_id) = 0;
+        virtual bool loadRooms(std::vector<RoomInfo>& rooms) = 0;
+        // 存储群聊消息（receiver_id为房间ID），每条消息只存一行，不按成员复制
+        virtual bool storeRoomMessage(MessageInfo& message) = 0;
+        // 将该房间ID大于after_id的消息逐条写为MSG_TYPE_ROOM_CHAT帧（消息体room_id:message_id:seq:content，按ID递增），
+        // max_id返回写出的最大消息ID（没有消息时不变）
+        virtual bool writeRoomMessagesSince(int room_id,int64_t after_id,FrameWriter& writer,int64_t& max_id) = 0;
+        // 会话当前最大序号（没有消息时为0），重启后据此继续分配序号
+        virtual bool getConversationSeq(int user_id1,int user_id2,int64_t& seq) = 0;
+        virtual bool getRoomSeq(int room_id,int64_t& seq) = 0;
+        // 增量同步：将会话中序号大于after_seq的消息（按序号递增，至多limit条）写为MSG_TYPE_SYNC_RESP帧
+        // （user_id为发送者，消息体prefix+seq:content），last_seq返回写出的最大序号（没有消息时不变）
+        virtual bool writeConversationSince(int user_id1,int user_id2,int64_t after_seq,int limit,
+                                            std::string_view prefix,FrameWriter& writer,int64_t& last_seq) = 0;
+        // 群聊只写出消息ID大于after_id的消息（不早于成员加入的位置）
+        virtual bool writeRoomSince(int room_id,int64_t after_seq,int64_t after_id,int limit,
+                                    std::string_view prefix,FrameWriter& writer,int64_t& last_seq) = 0;
+        // 批量标记已读：每条回执将对方发来的、序号不超过seq的未读消息标记为已读（每个会话一条语句）
+        virtual bool markConversationsRead(const std::vector<ReadReceipt>& receipts) = 0;
+        // 按ID递增分页扫描单聊消息（ID大于after_id，至多limit条），用于启动时重建搜索索引
+        virtual bool scanMessages(int64_t after_id,int limit,std::vector<MessageInfo>& messages) = 0;
+        // 按ID批量读取单聊消息（不存在的ID跳过，顺序不保证）
+        virtual bool getMessagesByIds(const std::vector<int64_t>& message_ids,std::vector<MessageInfo>& messages) = 0;
+        // 过期删除：按ID递增删除ID在(after_id,before_id)之间的至多limit条单聊消息（每批一个主键范围），
+        // deleted返回被删除消息的ID、双方与序号（不含正文）；被删除消息的最大序号保留为会话的序号下限，
+        // 会话的消息全部过期后getConversationSeq仍从该序号继续
+        virtual bool expireMessages(int64_t after_id,int64_t before_id,int limit,std::vector<MessageInfo>& deleted) = 0;
+        // 同上，删除一个房间的群聊消息（deleted中receiver_id为房间ID）
+        virtual bool expireRoomMessages(int room_id,int64_t after_id,int64_t before_id,int limit,
+                                        std::vector<MessageInfo>& deleted) = 0;
+        // 加载用户参与的所有单聊会话（最后一条消息与未读消息序号）
+        virtual bool loadInbox(int user_id,std::vector<InboxEntry>& entries) = 0;
+        // 根据ID/用户名查找用户：found返回用户是否存在；返回false表示存储出错，不能据此断定用户不存在
+        virtual bool getUserById(int user_id,UserInfo& user_info,bool& found) = 0;
+        virtual bool getUserByName(const std::string& username,UserInfo& user_info,bool& found) = 0;
+        // 创建用户（用户名已存在返回false），password为加密后的密码，user_id返回新用户的ID
+        virtual bool createUser(const std::string& username,const std::string& password,
+                                const std::string& nickname,int& user_id) = 0;
+        // 更新用户状态
+        virtual bool updateUserStatus(int user_id,int status) = 0;
+        // 更新密码哈希（哈希算法升级）
+        virtual bool updateUserPassword(int user_id,const std::string& password) = 0;
+        // 在线用户表维护
+        virtual bool addOnlineUser(int user_id,int socket_fd,const std::string& ip,int port) = 0;
+        virtual bool removeOnlineUser(int user_id) = 0;
+        virtual bool getOnlineUserIds(std::vector<int>& user_ids) = 0;
+        // 批量写入在线状态（用户状态+在线用户表），每个用户至多一条
+        virtual bool updatePresence(const std::vector<PresenceUpdate>& updates) = 0;
+        // 批量标记消息已投递（接收者ID，消息ID）；接收者不匹配的消息忽略
+        virtual bool markDelivered(const std::vector<std::pair<int,int64_t>>& deliveries) = 0;
+        // 后端名称（用于日志）
+        virtual const char* name() const = 0;
+    };
+}
+
+#endif //EASYCHATSERVER_MESSAGE_STORE_H
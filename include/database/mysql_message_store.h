@@ -0,0 +1,75 @@
+//
+// Created by Cando on 2026/10/19.
+//
+
+#ifndef EASYCHATSERVER_MYSQL_MESSAGE_STORE_H
+#define EASYCHATSERVER_MYSQL_MESSAGE_STORE_H
+
+#include "database/message_store.h"
+#include "database/connection_pool.h"
+
+namespace easychat{
+    // 基于MySQL连接池的存储实现
+    class MySQLMessageStore : public MessageStore{
+    public:
+        MySQLMessageStore();
+        ~MySQLMessageStore() override = default;
+
+        bool storeMessage(MessageInfo& message) override;
+        bool fetchOfflineMessages(int user_id,std::vector<MessageInfo>& messages) override;
+        bool getChatHistory(int user_id1,int user_id2,std::vector<MessageInfo>& messages,int limit) override;
+        bool writeOfflineMessages(int user_id,FrameWriter& writer) override;
+        bool writeChatHistory(int user_id1,int user_id2,int limit,FrameWriter& writer) override;
+        bool writeMessagesSince(int user_id,int64_t after_id,FrameWriter& writer,int64_t& max_id) override;
+        bool getDeviceCursor(int user_id,const std::string& device_id,int64_t& message_id,bool& found) override;
+        bool updateDeviceCursor(int user_id,const std::string& device_id,int64_t message_id) override;
+        bool getUserCursor(int user_id,int64_t& message_id) override;
+        bool createRoom(const std::string& name,int owner_id,int& room_id) override;
+        bool addRoomMember(int room_id,int user_id,int64_t joined_message_id) override;
+        bool removeRoomMember(int room_id,int user_id) override;
+        bool loadRooms(std::vector<RoomInfo>& rooms) override;
+        bool storeRoomMessage(MessageInfo& message) override;
+        bool writeRoomMessagesSince(int room_id,int64_t after_id,FrameWriter& writer,int64_t& max_id) override;
+        bool getConversationSeq(int user_id1,int user_id2,int64_t& seq) override;
+        bool getRoomSeq(int room_id,int64_t& seq) override;
+        bool writeConversationSince(int user_id1,int user_id2,int64_t after_seq,int limit,
+                                    std::string_view prefix,FrameWriter& writer,int64_t& last_seq) override;
+        bool writeRoomSince(int room_id,int64_t after_seq,int64_t after_id,int limit,
+                            std::string_view prefix,FrameWriter& writer,int64_t& last_seq) override;
+        bool markConversationsRead(const std::vector<ReadReceipt>& receipts) override;
+        bool loadInbox(int user_id,std::vector<InboxEntry>& entries) override;
+        bool scanMessages(int64_t after_id,int limit,std::vector<MessageInfo>& messages) override;
+        bool getMessagesByIds(const std::vector<int64_t>& message_ids,std::vector<MessageInfo>& messages) override;
+        bool expireMessages(int64_t after_id,int64_t before_id,int limit,std::vector<MessageInfo>& deleted) override;
+        bool expireRoomMessages(int room_id,int64_t after_id,int64_t before_id,int limit,
+                                std::vector<MessageInfo>& deleted) override;
+        bool getUserById(int user_id,UserInfo& user_info,bool& found) override;
+        bool getUserByName(const std::string& username,UserInfo& user_info,bool& found) override;
+        bool createUser(const std::string& username,const std::string& password,
+                        const std::string& nickname,int& user_id) override;
+        bool updateUserStatus(int user_id,int status) override;
+        bool updateUserPassword(int user_id,const std::string& password) override;
+        bool addOnlineUser(int user_id,int socket_fd,const std::string& ip,int port) override;
+        bool removeOnlineUser(int user_id) override;
+        bool getOnlineUserIds(std::vector<int>& user_ids) override;
+        bool updatePresence(const std::vector<PresenceUpdate>& updates) override;
+        bool markDelivered(const std::vector<std::pair<int,int64_t>>& deliveries) override;
+        const char* name() const override {return "mysql";}
+    private:
+        // 执行查询并读取第一行用户信息
+        bool queryUser(const std::string& query_sql,UserInfo& user_info,bool& found);
+        // 执行不返回结果集的SQL
+        bool executeSql(const std::string& sql);
+        // 读取单个max(seq)结果
+        bool querySeq(const std::string& query_sql,int64_t& seq);
+        // 过期删除table中满足condition（以and结尾或为空）、ID在(after_id,before_id)之间的至多limit条消息
+        bool expireRange(const std::string& table,const std::string& condition,int64_t after_id,int64_t before_id,
+                         int limit,std::vector<MessageInfo>& deleted);
+        // 将(seq,sender_id,content)结果集写为增量同步帧
+        bool writeSeqRange(const std::string& query_sql,std::string_view prefix,FrameWriter& writer,int64_t& last_seq);
+        // 连接池引用
+        ConnectionPool& conn_pool_;
+    };
+}
+
+#endif //EASYCHATSERVER_MYSQL_MESSAGE_STORE_H
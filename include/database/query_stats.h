@@ -0,0 +1,71 @@
+//
+// Created by Cando on 2026/10/19.
+//
+
+#ifndef EASYCHATSERVER_QUERY_STATS_H
+#define EASYCHATSERVER_QUERY_STATS_H
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+
+namespace easychat{
+    // SQL执行统计-单例模式
+    // 按语句模板（数字与字符串字面量替换为?）聚合耗时直方图，记录路径全部为原子操作，不加锁；
+    // 超过阈值的语句写入独立的慢查询日志，连接池等待时间与执行时间分开记录
+    class QueryStats{
+    public:
+        static QueryStats& getInstance();
+        // 初始化慢查询阈值（毫秒，<0关闭）与慢查询日志路径
+        bool init(int slow_query_ms,const std::string& slow_log_path);
+        // 记录一次语句执行（时间单位：微秒）
+        void record(const std::string& sql,int64_t wait_us,int64_t exec_us,int64_t rows,bool ok);
+        // 生成统计报告（按总耗时降序）
+        std::string report() const;
+        // 将SQL归一化为语句模板
+        static std::string normalize(const std::string& sql);
+        // 关闭慢查询日志
+        void close();
+
+        // 直方图桶数：第i个桶统计耗时在[2^(i-1),2^i)微秒内的语句
+        static constexpr int kBucketCount = 32;
+        // 最多跟踪的语句模板数，超出后计入溢出项
+        static constexpr int kMaxTemplates = 256;
+    private:
+        QueryStats();
+        ~QueryStats();
+        // 禁止拷贝和赋值
+        QueryStats(const QueryStats&) = delete;
+        QueryStats& operator=(const QueryStats&) = delete;
+
+        // 单个语句模板的统计
+        struct StatementStats{
+            std::atomic<uint64_t> hash;                  // 模板哈希（0为空槽）
+            std::atomic<const std::string*> text;        // 模板文本（写入后不再修改）
+            std::atomic<uint64_t> count;
+            std::atomic<uint64_t> errors;
+            std::atomic<uint64_t> total_us;
+            std::atomic<uint64_t> max_us;
+            std::atomic<uint64_t> total_wait_us;
+            std::atomic<uint64_t> rows;
+            std::atomic<uint64_t> buckets[kBucketCount];
+        };
+        // 查找或占用模板对应的槽
+        StatementStats* findSlot(uint64_t hash,const std::string& text);
+        // 根据直方图估算分位数（返回桶上界，微秒）
+        static uint64_t percentile(const StatementStats& stats,double ratio);
+        // 写入慢查询日志
+        void writeSlowLog(const std::string& sql,int64_t wait_us,int64_t exec_us,int64_t rows,bool ok);
+
+        StatementStats slots_[kMaxTemplates];
+        // 模板数超出上限时的汇总项
+        StatementStats overflow_;
+        std::atomic<int64_t> slow_threshold_us_;
+        std::mutex slow_log_mutex_;
+        std::ofstream slow_log_;
+    };
+}
+
+#endif //EASYCHATSERVER_QUERY_STATS_H
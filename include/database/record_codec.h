@@ -0,0 +1,89 @@
+//
+// Created by Cando on 2026/10/19.
+//
+
+#ifndef EASYCHATSERVER_RECORD_CODEC_H
+#define EASYCHATSERVER_RECORD_CODEC_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+namespace easychat{
+    // 追加日志文件（LogMessageStore段文件、MessageSpool）共用的记录编解码
+    namespace record{
+        // 记录头部：有效载荷长度 + 校验和 + 记录类型
+#pragma pack(push,1)
+        struct RecordHeader{
+            uint32_t length;
+            uint32_t checksum;
+            uint8_t type;
+        };
+#pragma pack(pop)
+
+        // FNV-1a校验和，用于发现写了一半的记录
+        uint32_t checksum(uint8_t type,const char* data,size_t length);
+
+        // 有效载荷编码
+        void putInt32(std::string& out,int32_t value);
+        void putInt64(std::string& out,int64_t value);
+        void putString(std::string& out,const std::string& value);
+
+        // 组装一条完整记录（头部+有效载荷）
+        std::string buildRecord(uint8_t type,const std::string& payload);
+
+        // 完整读写文件指定区间（处理短读写与EINTR）
+        bool preadFull(int fd,char* buffer,size_t length,uint64_t offset);
+        bool pwriteFull(int fd,const char* buffer,size_t length,uint64_t offset);
+
+        // 有效载荷解码（越界时ok置为false）
+        class PayloadReader{
+        public:
+            PayloadReader(const char* data,size_t length):data_(data),length_(length),pos_(0),ok_(true){}
+            int32_t getInt32(){
+                int32_t value = 0;
+                read(&value,sizeof (value));
+                return value;
+            }
+            int64_t getInt64(){
+                int64_t value = 0;
+                read(&value,sizeof (value));
+                return value;
+            }
+            std::string getString(){
+                std::string_view view = getStringView();
+                return std::string(view.data(),view.size());
+            }
+            // 返回指向原缓冲区的视图，不拷贝
+            std::string_view getStringView(){
+                int32_t size = getInt32();
+                if (!ok_ || size<0 || pos_+size>length_){
+                    ok_ = false;
+                    return {};
+                }
+                std::string_view value(data_+pos_,size);
+                pos_ += size;
+                return value;
+            }
+            bool ok() const {return ok_;}
+            // 是否还有未读取的字段（兼容旧格式记录末尾新增的字段）
+            bool hasMore() const {return ok_ && pos_<length_;}
+        private:
+            void read(void* out,size_t size){
+                if (!ok_ || pos_+size>length_){
+                    ok_ = false;
+                    return;
+                }
+                std::memcpy(out,data_+pos_,size);
+                pos_ += size;
+            }
+            const char* data_;
+            size_t length_;
+            size_t pos_;
+            bool ok_;
+        };
+    }
+}
+
+#endif //EASYCHATSERVER_RECORD_CODEC_H
@@ -0,0 +1,38 @@
+//
+// Created by Cando on 2026/10/19.
+//
+
+#ifndef EASYCHATSERVER_ROW_DECODER_H
+#define EASYCHATSERVER_ROW_DECODER_H
+
+#include <mysql/mysql.h>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace easychat{
+    // MySQL结果集行解码器
+    // 借助mysql_fetch_lengths直接得到列长度，数值列用std::from_chars解析，
+    // 字符串列以string_view形式返回，避免std::stoi和中间std::string拷贝
+    class RowDecoder{
+    public:
+        explicit RowDecoder(MYSQL_RES* result);
+        // 读取下一行，没有更多行时返回false
+        bool next();
+        // 列是否为NULL
+        bool isNull(int column) const {return row_[column]==nullptr;}
+        // 列值视图（NULL返回空视图），仅在下一次next()之前有效
+        std::string_view getView(int column) const;
+        // 列值拷贝为字符串
+        std::string getString(int column) const;
+        // 解析整数列（NULL或格式错误返回默认值）
+        int32_t getInt32(int column,int32_t default_value=0) const;
+        int64_t getInt64(int column,int64_t default_value=0) const;
+    private:
+        MYSQL_RES* result_;
+        MYSQL_ROW row_;
+        unsigned long* lengths_;
+    };
+}
+
+#endif //EASYCHATSERVER_ROW_DECODER_H
@@ -0,0 +1,58 @@
+//
+// Created by Cando on 2026/10/19.
+//
+
+#ifndef EASYCHATSERVER_CONNECTION_TABLE_H
+#define EASYCHATSERVER_CONNECTION_TABLE_H
+
+#include "common/connection_handle.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace easychat{
+    class ClientConnection;
+    // 连接表：按连接句柄（槽位+代数）O(1)查找客户端连接
+    // 槽位即文件描述符：内核总是分配最小的空闲描述符，天然构成紧凑的槽位空闲链表。
+    // 槽位按块分配（每块1024个），块一经分配不再移动，查找只需一次原子读和槽位锁；
+    // 句柄代数与槽位中的代数不一致时说明原连接已关闭、描述符已被复用，查找失败
+    class ConnectionTable{
+    public:
+        ConnectionTable();
+        ~ConnectionTable();
+        // 禁止拷贝和赋值
+        ConnectionTable(const ConnectionTable&) = delete;
+        ConnectionTable& operator=(const ConnectionTable&) = delete;
+
+        // 插入连接（槽位已被占用时失败）
+        bool insert(const ConnectionHandle& handle,std::shared_ptr<ClientConnection> conn);
+        // 查找连接，句柄失效返回nullptr
+        std::shared_ptr<ClientConnection> find(const ConnectionHandle& handle) const;
+        // 移除连接（代数不一致时不移除）
+        bool remove(const ConnectionHandle& handle);
+        // 所有连接的快照
+        void snapshot(std::vector<std::shared_ptr<ClientConnection>>& conns) const;
+        // 连接数
+        size_t size() const {return size_.load(std::memory_order_relaxed);}
+    private:
+        static constexpr size_t kChunkSize = 1024;
+        static constexpr size_t kMaxChunks = 1024;
+        struct Slot{
+            mutable std::mutex mutex;
+            uint32_t generation = 0;
+            std::shared_ptr<ClientConnection> conn;
+        };
+        struct Chunk{
+            Slot slots[kChunkSize];
+        };
+        // 获取槽位，create为true时按需分配所在的块
+        Slot* slotFor(int fd,bool create) const;
+
+        mutable std::atomic<Chunk*> chunks_[kMaxChunks];
+        mutable std::mutex grow_mutex_;
+        std::atomic<size_t> size_;
+    };
+}
+
+#endif //EASYCHATSERVER_CONNECTION_TABLE_H
@@ -8,6 +8,7 @@
 #include <sys/epoll.h>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
 
 namespace easychat{
@@ -61,11 +62,14 @@ namespace easychat{
         // 处理就绪事件
         void handleEvents(int num_events);
     private:
+        // 复制回调（在锁外调用，回调中可以安全地移除自身）
+        EventCallback findCallback(const std::unordered_map<int,EventCallback>& callbacks,int fd);
         int epoll_fd_;
         int max_events_;
         struct epoll_event* events_;
 
-        //回调函数映射表
+        //回调函数映射表（连接可能在工作线程中关闭并移除回调，需加锁）
+        std::mutex callback_mutex_;
         std::unordered_map<int,EventCallback> read_callbacks_;
         std::unordered_map<int,EventCallback> write_callbacks_;
         std::unordered_map<int,EventCallback> error_callbacks_;
@@ -0,0 +1,77 @@
+//
+// Created by Cando on 2026/10/19.
+//
+
+#ifndef EASYCHATSERVER_RATE_LIMITER_H
+#define EASYCHATSERVER_RATE_LIMITER_H
+
+#include "common/protocol.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace easychat{
+    // 限流类别：聊天类（单聊、群聊、公告、已读回执）、查询类（聊天记录、增量同步、收件箱、在线用户等需要访问存储的请求）
+    // 与认证类（登录、注册、会话恢复，按连接限流：认证前的所有帧都计入连接的令牌桶）
+    enum class RateClass{
+        CHAT = 0,
+        QUERY,
+        AUTH,
+        NONE // 确认、心跳、附件分块等不限流
+    };
+    constexpr int kRateClassCount = 3;
+
+    // 令牌桶（GCRA实现）：状态只有一个原子变量（理论到达时间，微秒），检查为无锁CAS
+    class TokenBucket{
+    public:
+        TokenBucket() :tat_(0){}
+        // 取一个令牌；rate_per_sec不大于0时不限流。失败时retry_after_ms返回需等待的毫秒数
+        bool take(int rate_per_sec,int burst,int64_t now_us,int64_t& retry_after_ms);
+    private:
+        std::atomic<int64_t> tat_;
+    };
+
+    // 同一用户所有设备共享的令牌桶（登录时获取，连接持有引用）
+    struct UserRateState{
+        TokenBucket buckets[kRateClassCount];
+    };
+
+    // 限流器类-单例模式
+    // 分发消息前先检查用户的令牌桶，再检查全服的令牌桶；两者都在消息处理线程内无锁完成，
+    // 被限流的请求不会占用数据库连接。只有登录时查找用户的令牌桶需要加锁
+    class RateLimiter{
+    public:
+        static RateLimiter& getInstance();
+        // 配置每个类别的速率（每秒）与突发量，以及全服速率（不大于0时不限流）
+        void configure(RateClass rate_class,int user_rate,int user_burst,int global_rate);
+        // 消息类型所属的限流类别
+        static RateClass classify(MessageType type);
+        // 获取用户的令牌桶（多设备共享，最后一个连接释放后回收）
+        std::shared_ptr<UserRateState> acquire(int user_id);
+        // 检查是否放行；被限流时retry_after_ms返回建议的重试等待毫秒数
+        bool allow(UserRateState* state,MessageType type,int64_t& retry_after_ms);
+        // 检查未认证连接的帧（任何类型都按认证类计入连接的令牌桶与全服令牌桶）
+        bool allowUnauthenticated(TokenBucket& connection_bucket,int64_t& retry_after_ms);
+    private:
+        RateLimiter();
+        ~RateLimiter() = default;
+        // 禁止拷贝和赋值
+        RateLimiter(const RateLimiter&) = delete;
+        RateLimiter& operator=(const RateLimiter&) = delete;
+        struct ClassLimit{
+            int user_rate = 0;
+            int user_burst = 0;
+            int global_rate = 0;
+        };
+        ClassLimit limits_[kRateClassCount];
+        TokenBucket global_buckets_[kRateClassCount];
+        // 用户ID->令牌桶（弱引用，超过清理阈值时移除已释放的条目）
+        std::mutex users_mutex_;
+        std::unordered_map<int,std::weak_ptr<UserRateState>> users_;
+        size_t prune_threshold_;
+    };
+}
+
+#endif //EASYCHATSERVER_RATE_LIMITER_H
@@ -7,15 +7,62 @@
 
 #include "network/epoll.h"
 #include "network/socket.h"
+#include "network/connection_table.h"
+#include "network/rate_limiter.h"
 #include "threadpool/threadpool.h"
 #include "business/user_manager.h"
 #include "business/message_handler.h"
-#include <unordered_map>
+#include "business/room_manager.h"
+#include "database/blob_store.h"
 #include <memory>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <deque>
+#include <map>
+#include <unordered_map>
 
 namespace easychat{
-    // 客户端连接类
-    class ClientConnection{
+    class ClientConnection;
+    // 直传状态：已邀请（等待接收者接受）->已接受（等待发送者开始）->传输中
+    enum class RelayState{
+        OFFERED,
+        ACCEPTED,
+        STREAMING
+    };
+    // 在线直传：接收者接受邀请后，发送者socket中的原始字节经管道splice到接收者socket，不经过用户态。
+    // 只有管道中的数据写给接收者后才继续从发送者读取，接收者发送缓冲区满时发送者由TCP窗口限速；
+    // 邀请与传输都有超时，停滞的一方被断开，不会长期占住对方的发送队列
+    struct Relay{
+        ~Relay();
+        std::mutex mutex;
+        int64_t id = 0;
+        RelayState state = RelayState::OFFERED;
+        uint64_t size = 0;
+        std::string name;
+        int64_t last_progress_ms = 0;  // 最近一次状态变化或转发数据的时间（单调时钟）
+        std::shared_ptr<ClientConnection> sender;
+        ConnectionHandle receiver;
+        int pipe_fds[2] = {-1,-1};
+        std::string head;              // 开始直传时已读入发送者缓冲区的字节（先发送）
+        size_t head_offset = 0;
+        uint64_t from_sender = 0;      // 尚未从发送者socket读取的字节数
+        size_t in_pipe = 0;            // 管道中尚未写给接收者的字节数
+        bool sender_failed = false;    // 发送者中途断开，接收者的剩余部分以0填充
+        bool receiver_failed = false;  // 接收者断开，发送者的剩余字节读出后丢弃
+    };
+    // 发送队列中的一项：内存中的帧，可带一段从文件或直传管道发送的消息体（帧头部的长度已包含这部分）
+    struct OutboundFrame{
+        SharedFrame frame;
+        std::shared_ptr<const BlobFile> file;
+        std::shared_ptr<Relay> relay;
+        uint64_t file_offset = 0;
+        size_t file_length = 0;
+        size_t size() const {return frame->size()+file_length;}
+    };
+    // 客户端连接类（由连接表以shared_ptr持有，其他线程通过句柄查找后持有引用，
+    // 连接关闭后从连接表移除，最后一个引用释放时才关闭文件描述符，避免描述符被复用后写错客户端）
+    class ClientConnection : public std::enable_shared_from_this<ClientConnection>{
     public:
         ClientConnection(int fd,const std::string& ip ,int port);
         ~ClientConnection();
@@ -29,33 +76,118 @@ namespace easychat{
         // 处理关闭事件
         void handleClose();
         // 发送消息
-        void sendMessage(const Message& msg);
+        bool sendMessage(const Message& msg);
+        // 发送已构建好的帧（可包含多个连续帧）
+        bool sendFrames(const FrameWriter& writer);
+        // 发送共享帧：能立即发送的部分直接写入，其余进入发送队列，由可写事件继续发送
+        bool sendFrame(const SharedFrame& frame);
+        // 发送帧，消息体的后续部分用sendfile从文件发送（文件部分不计入发送队列积压上限）
+        bool sendFileFrame(const SharedFrame& frame,std::shared_ptr<const BlobFile> file,uint64_t offset,size_t length);
+        // 发送直传帧，消息体的length字节经管道从发送者socket转发；发送队列不为空时返回false
+        bool sendRelayFrame(const SharedFrame& frame,std::shared_ptr<Relay> relay,size_t length);
+        // 记录已推送、等待客户端确认的消息帧（连接已关闭时返回false）；
+        // 超出上限时丢弃最早的帧，确认水位停在该消息之前，下次上线由存储补发
+        bool trackUnacked(int64_t message_id,const SharedFrame& frame,size_t max_unacked);
+        // 确认水位：不超过该位置的消息都已确认（下线时保存为设备游标）
+        int64_t ackedWatermark();
+        // 获取设备ID
+        const std::string& getDeviceId() const {return device_id_;}
         // 获取SocketFd
         int getFd() const {return fd_;}
+        // 获取连接句柄（文件描述符+代数）
+        ConnectionHandle getHandle() const {return ConnectionHandle{fd_,generation_};}
         // 获取IP地址
         const std::string& getIp() const {return ip_;}
         // 获取端口
         int getPort() const {return port_;}
         // 获取用户ID
-        int getUserId() const {return user_id_;}
+        int getUserId() const {return user_id_.load();}
         // 设置用户ID
         void setUserId(int user_id){user_id_=user_id;}
         // 检查是否认证
         bool isAuthenticated() const{return user_id_!=-1;}
     private:
+        // 在认证线程池中执行登录/注册（密码哈希耗时较长）
+        void completeLogin(const std::string& username,const std::string& password);
+        void completeRegister(const std::string& username,const std::string& password);
+        // 提交认证任务，队列已满时回复繁忙
+        void submitAuth(std::function<void()> task);
+        // 设备上线后补发游标之后的消息
+        void syncDevice();
+        // 处理客户端确认（消息体：message_id,message_id,...）
+        void handleAck(const std::string& data);
+        // 处理创建/加入/退出群聊请求
+        void handleRoomRequest(const Message& msg);
+        // 处理管理员公告请求
+        void handleBroadcastRequest(const Message& msg);
+        // 处理附件上传/下载请求
+        void handleBlobRequest(const Message& msg);
+        // 处理在线直传请求：向接收者发送邀请
+        void handleRelayRequest(const Message& msg);
+        // 处理接收者对直传邀请的答复
+        void handleRelayAccept(const Message& msg);
+        // 处理发送者开始直传（frame_length为当前帧长度，其后已读入缓冲区的字节属于直传数据）；
+        // 请求无效、无法保持帧边界时返回false
+        bool handleRelayStart(const Message& msg,size_t frame_length);
+        // 直传期间的可读事件：推动接收者发送，接收者已断开时丢弃剩余字节；发送者的数据读完返回true
+        bool relayRead(const std::shared_ptr<Relay>& relay);
+        // 作为接收者从直传管道（必要时先从发送者读取）写入至多length字节，返回写入的字节数，出错返回-1
+        ssize_t pumpRelay(Relay& relay,size_t length);
+        // 当前作为发送者的直传
+        std::shared_ptr<Relay> currentRelay();
+        // 接收缓冲区中是否已有完整的开始直传帧（或非法帧），此时停止从socket读取
+        bool relayStartBuffered();
+        // 将发送队列项从offset开始尽量写入socket，返回本次写入的字节数，出错返回-1
+        ssize_t writeOutbound(const OutboundFrame& item,size_t offset);
+        // 发送队列项：能立即发送的部分直接写入，其余排队
+        bool enqueue(OutboundFrame item);
+        // 房间名最大长度
+        static constexpr size_t kMaxRoomNameLength = 64;
+        // 收件箱默认与最多返回的会话数
+        static constexpr int kDefaultInboxLimit = 20;
+        static constexpr int kMaxInboxLimit = 200;
+        // 发送队列积压上限，超过时断开（慢速客户端）
+        static constexpr size_t kMaxPendingBytes = 8*1024*1024;
+        // 客户端帧长度上限（大附件走分块上传），超过时断开
+        static constexpr uint32_t kMaxFrameLength = 1024*1024;
+        // 附件上传/下载每块的最大字节数
+        static constexpr size_t kBlobChunkBytes = 256*1024;
+        // 直传每次从发送者读入管道的最大字节数（不超过默认管道容量）
+        static constexpr size_t kRelayPipeBytes = 64*1024;
         int fd_; //socket文件描述符
+        uint32_t generation_; // 连接代数（区分复用同一文件描述符的新旧连接）
         std::string ip_;    //客户端IP地址
         int port_;  // 客户端端口
-        int user_id_;   //用户ID(未认证为-1）
+        std::atomic<int> user_id_;   //用户ID(未认证为-1）
+        std::atomic<bool> auth_pending_; // 认证进行中，暂停处理后续消息
+        std::atomic<bool> closed_; // 已关闭（已从连接表移除）
         Socket socket_; //socket对象
         std::string buffer_;    //接收缓冲区
+        size_t scan_offset_;    // 接收缓冲区中下一个未检查的帧头位置
+        std::mutex read_mutex_; // 同一连接的读事件串行处理
+        std::mutex send_mutex_; // 保护发送队列，多个线程向同一连接发送时保证帧不交错
+        std::deque<OutboundFrame> send_queue_; // 待发送的帧
+        size_t send_offset_;    // 队首帧已发送的字节数
+        size_t pending_bytes_;  // 队列中未发送的内存字节数（不含文件部分）
+        std::string device_id_; // 设备ID（登录时指定，未指定为default）
+        std::mutex outbox_mutex_; // 保护以下确认状态
+        std::map<int64_t,SharedFrame> unacked_; // 已推送未确认的消息帧（消息ID->帧）
+        int64_t pushed_id_;     // 已推送的最大消息ID
+        int64_t evicted_floor_; // 因超出上限被丢弃的未确认消息中最小ID-1（没有时为INT64_MAX）
+        int64_t sync_floor_;    // 上线同步批次未确认时为同步起点（没有时为INT64_MAX）
+        int64_t sync_token_;    // 上线同步批次末尾确认帧携带的确认号
+        std::shared_ptr<UserRateState> rate_state_; // 用户的令牌桶（认证后设置，同一用户的设备共享）
+        TokenBucket auth_bucket_; // 认证前的帧按连接限流
+        std::mutex relay_mutex_; // 保护relay_
+        std::shared_ptr<Relay> relay_; // 作为发送者正在进行的直传（期间不解析帧）
     };
     // Reactor类
     class Reactor{
     public:
         static Reactor& getInstance();
         // 初始化
-        bool init(const std::string &ip,uint16_t port,int thread_count=4);
+        bool init(const std::string &ip,uint16_t port,int thread_count=4,
+                  int auth_thread_count=2,size_t auth_queue_size=256);
         // 启动事件循环
         void start();
         // 停止事件循环
@@ -63,7 +195,29 @@ namespace easychat{
         // 处理新连接
         void handleNewConnection();
         // 处理客户端消息
-        void handleClientMessage(int client_fd);
+        void handleClientMessage(const ConnectionHandle& handle);
+        // 在工作线程池中重新处理该连接缓冲区中的数据
+        void scheduleRead(const ConnectionHandle& handle);
+        // 根据句柄查找连接（连接已关闭返回nullptr）
+        std::shared_ptr<ClientConnection> findConnection(const ConnectionHandle& handle) const {return connections_.find(handle);}
+        // 移除客户端连接（连接关闭时调用）
+        void removeClientConnection(const ConnectionHandle& handle);
+        // 开启/关闭连接的可写事件监听（发送队列非空时开启）
+        void updateWriteInterest(const ConnectionHandle& handle,bool enable);
+        // 提交普通任务到工作线程池（与消息处理共用队列）
+        void submitTask(std::function<void()> task);
+        // 提交认证任务（有界队列，满时返回false）
+        bool submitAuthTask(std::function<void()> task);
+        // 在线直传的最大字节数（0表示关闭，总是回退到附件上传）
+        void setRelayLimit(uint64_t max_bytes){relay_max_bytes_ = max_bytes;}
+        uint64_t relayLimit() const {return relay_max_bytes_;}
+        // 直传超时：邀请未被接受或接受后发送者未开始的秒数，传输中没有进展的秒数
+        void setRelayTimeouts(int accept_seconds,int idle_seconds);
+        // 登记/查找/移除直传
+        void addRelay(const std::shared_ptr<Relay>& relay);
+        std::shared_ptr<Relay> findRelay(int64_t id);
+        // relay不为空时只在登记的正是该直传时移除（同一ID可能已被其他直传占用）
+        void removeRelay(int64_t id,const Relay* relay = nullptr);
     private:
         Reactor();
         ~Reactor();
@@ -71,9 +225,9 @@ namespace easychat{
         Reactor(const Reactor&) = delete;
         Reactor& operator=(const Reactor&) = delete;
         // 注册客户端连接
-        void registerClientConnection(std::unique_ptr<ClientConnection> conn);
-        // 移除客户端连接
-        void removeClientConnection(int client_fd);
+        void registerClientConnection(std::shared_ptr<ClientConnection> conn);
+        // 检查直传超时：过期的邀请回退到附件上传，传输中停滞的一方断开
+        void checkRelays();
         int server_fd_;        // 服务器socketFd
         std::string server_ip;  //服务器IP
         uint16_t server_port_;  //服务器端口
@@ -81,9 +235,16 @@ namespace easychat{
         std::unique_ptr<Epoll> epoll_;//Epoll对象
         std::unique_ptr<Socket> server_socket_;//服务器
         std::unique_ptr<ThreadPool> thread_pool_;//线程池
-        //客户端连接映射
-        std::unordered_map<int,std::unique_ptr<ClientConnection>> clients_;
-        std::mutex client_mutex_;
+        std::unique_ptr<ThreadPool> auth_pool_;//认证线程池（登录/注册的密码哈希与聊天投递隔离）
+        size_t auth_queue_size_;//认证任务队列上限
+        uint64_t relay_max_bytes_;//在线直传的最大字节数
+        int64_t relay_accept_timeout_ms_;//直传邀请超时
+        int64_t relay_idle_timeout_ms_;//直传无进展超时
+        int64_t last_relay_check_ms_;//上次检查直传超时的时间
+        std::mutex relays_mutex_;//保护relays_
+        std::unordered_map<int64_t,std::shared_ptr<Relay>> relays_;//直传ID->直传
+        //客户端连接表（句柄->连接）
+        ConnectionTable connections_;
         //业务模块引用
         UserManager& user_manager_;
         MessageHandler& message_handler_;
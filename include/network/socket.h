@@ -34,6 +34,10 @@ namespace easychat{
         ssize_t recv(char* buffer,size_t length);
         // 发送数据
         ssize_t send(const char* data,size_t length);
+        // 非阻塞发送：尽量发送，缓冲区满时立即返回已发送字节数（可能为0），出错返回-1
+        ssize_t trySend(const char* data,size_t length);
+        // 非阻塞发送文件内容（sendfile，数据不经过用户态），返回值同trySend
+        ssize_t trySendFile(int file_fd,off_t offset,size_t length);
         // 设置为非阻塞模式
         bool setNonBlocking();
         // 关闭close();
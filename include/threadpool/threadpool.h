@@ -53,6 +53,18 @@ namespace easychat{
             condition_.notify_one();
             return result;
         }
+        // 有界提交：队列中等待的任务数达到max_pending时拒绝，返回false（用于准入控制）
+        bool trySubmit(Task task,size_t max_pending){
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex_);
+                if (stop_ || tasks_.size()>=max_pending){
+                    return false;
+                }
+                tasks_.emplace(std::move(task));
+            }
+            condition_.notify_one();
+            return true;
+        }
         // 获取线程数
         size_t getThreadCount() const{
             return threads_.size();
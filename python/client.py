@@ -5,8 +5,11 @@ import socket
 import threading
 import time
 import sys
+import os
+import random
+import hashlib
 
-from protocol import MessageProtocol,MSG_TYPE_LOGIN,MSG_TYPE_CHAT,MSG_TYPE_ERROR,MSG_TYPE_OFFLINE_MSG,MSG_TYPE_LOGIN_RESP,MSG_TYPE_REGISTER,MSG_TYPE_HISTORY,MSG_TYPE_GET_USERS,MSG_TYPE_HISTORY_RESP,MSG_TYPE_GET_USER_BY_NAME,MSG_TYPE_GET_USER_BY_NAME_RESP,MSG_TYPE_USERS_RESP
+from protocol import MessageProtocol,MSG_TYPE_LOGIN,MSG_TYPE_CHAT,MSG_TYPE_CHAT_RESP,MSG_TYPE_ERROR,MSG_TYPE_OFFLINE_MSG,MSG_TYPE_LOGIN_RESP,MSG_TYPE_REGISTER,MSG_TYPE_HISTORY,MSG_TYPE_GET_USERS,MSG_TYPE_HISTORY_RESP,MSG_TYPE_GET_USER_BY_NAME,MSG_TYPE_GET_USER_BY_NAME_RESP,MSG_TYPE_USERS_RESP,MSG_TYPE_RESUME,MSG_TYPE_ROOM_CREATE,MSG_TYPE_ROOM_JOIN,MSG_TYPE_ROOM_LEAVE,MSG_TYPE_ROOM_CHAT,MSG_TYPE_ROOM_RESP,MSG_TYPE_SYNC,MSG_TYPE_SYNC_RESP,MSG_TYPE_ACK,MSG_TYPE_READ,MSG_TYPE_INBOX,MSG_TYPE_SEARCH,MSG_TYPE_BLOB_BEGIN,MSG_TYPE_BLOB_CHUNK,MSG_TYPE_BLOB_RESP,MSG_TYPE_BLOB_GET,MSG_TYPE_BLOB_DATA,MSG_TYPE_RELAY_BEGIN,MSG_TYPE_RELAY_RESP,MSG_TYPE_RELAY_DATA,MSG_TYPE_RELAY_OFFER,MSG_TYPE_RELAY_ACCEPT,MSG_TYPE_RELAY_START,BLOB_CHUNK_SIZE
 
 class EasyChatClient:
     """EasyChat客户端类"""
@@ -18,11 +21,21 @@ class EasyChatClient:
         self.connected = False  # 连接状态
         self.user_id = -1       # 用户ID(未登录为-1)
         self.username = ""      # 当前登录的用户名
+        self.session_token = "" # 会话令牌（用于断线重连）
+        self.device_id = ""     # 设备ID（同一用户多设备同时在线时区分设备，离线消息按设备同步）
         self.receive_thread = None #接收线程
         self.running = False    #运行标志
         self.message_callback = None #消息回调函数
         self.user_map = {}      # 用户名到ID的映射
         self.online_users = {}   # 在线用户列表 {user_id: username}
+        self.conversation_seqs = {} # 各会话已收到的最大序号 {'u<对方ID>'或'r<房间ID>': seq}
+        self.unconfirmed_chats = {} # 未收到发送确认的消息 {客户端消息ID: 已打包的消息}，重连后原样重发
+        self.pending_uploads = {}   # 上传中的附件 {sha256: (接收者, 文件路径, 附件引用)}
+        self.downloads = {}         # 下载中的附件 {sha256: {'path','file','received'}}
+        self.send_lock = threading.Lock() # 上传线程与接收线程共用socket，整帧发送不交错
+        self.pending_relay = None   # 等待服务器响应的在线直传 (接收者, 文件路径)
+        self.relays = {}            # 已发出邀请或传输中的直传 {id: (接收者, 文件路径)}，回退时改为上传附件
+        self.accept_relays = True   # 是否接受对方的直传邀请
 
     def connect(self):
         """连接服务器"""
@@ -57,13 +70,17 @@ class EasyChatClient:
             print(f"❌ 连接失败：{e}")
             return False
 
-    def login(self,username,password):
-        """用户登录"""
+    def login(self,username,password,device_id=None):
+        """用户登录（device_id可选，不指定时使用服务器默认设备）"""
         if not self.connected:
             print("❌ 未连接服务器")
             return False
-        #构造登陆数据
+        if device_id is not None:
+            self.device_id = device_id
+        #构造登陆数据（username:password[:device_id]）
         data = f"{username}:{password}"
+        if self.device_id:
+            data += f":{self.device_id}"
         # 打包并发送消息
         message = MessageProtocol.pack_message(MSG_TYPE_LOGIN,0,data)
         self._send_raw(message)
@@ -72,6 +89,22 @@ class EasyChatClient:
         print(f"-> 发送登录请求：{username}")
         return True
 
+    def resume(self):
+        """使用会话令牌恢复登录（无需密码）"""
+        if not self.connected:
+            print("❌ 未连接服务器")
+            return False
+        if not self.session_token:
+            print("❌ 没有可用的会话令牌")
+            return False
+        data = self.session_token
+        if self.device_id:
+            data += f":{self.device_id}"
+        message = MessageProtocol.pack_message(MSG_TYPE_RESUME,0,data)
+        self._send_raw(message)
+        print("-> 发送会话恢复请求")
+        return True
+
     def register(self,username,password,nickname=""):
         """用户注册"""
         if not self.connected:
@@ -105,16 +138,319 @@ class EasyChatClient:
                 print(f"❌ 未找到用户：{receiver}")
                 return False
 
-        #构造聊天数据
-        data = f"{receiver_id}:{content}"
+        #构造聊天数据（带客户端消息ID，重发时服务器据此去重）
+        client_id = random.getrandbits(63)
+        data = f"c{client_id}:{receiver_id}:{content}"
         #打包并发送消息
         message = MessageProtocol.pack_message(MSG_TYPE_CHAT,self.user_id,data)
+        self.unconfirmed_chats[client_id] = message
         self._send_raw(message)
 
         receiver_name = self._get_user_name_by_id(receiver_id)
         print(f"-> 发送消息到{receiver_name}({receiver_id})：{content}")
         return True
 
+    def _send_room_request(self,msg_type,data):
+        """发送群聊请求（创建/加入/退出/群聊消息）"""
+        if not self.connected:
+            print("❌ 未连接服务器")
+            return False
+        if self.user_id == -1:
+            print("❌ 请登录")
+            return False
+        message = MessageProtocol.pack_message(msg_type,self.user_id,data)
+        self._send_raw(message)
+        return True
+
+    def create_room(self,name):
+        """创建群聊（创建者自动加入）"""
+        return self._send_room_request(MSG_TYPE_ROOM_CREATE,name)
+
+    def join_room(self,room_id):
+        """加入群聊"""
+        return self._send_room_request(MSG_TYPE_ROOM_JOIN,str(room_id))
+
+    def leave_room(self,room_id):
+        """退出群聊"""
+        return self._send_room_request(MSG_TYPE_ROOM_LEAVE,str(room_id))
+
+    def send_room_chat(self,room_id,content):
+        """发送群聊消息"""
+        if self._send_room_request(MSG_TYPE_ROOM_CHAT,f"{room_id}:{content}"):
+            print(f"-> 发送群聊消息到房间{room_id}：{content}")
+            return True
+        return False
+
+    def sync(self,conversations=None):
+        """
+        增量同步：发送各会话已收到的最大序号，服务器只返回之后的消息
+        conversations为空时同步所有已知会话
+        """
+        if not self.connected or self.user_id == -1:
+            print("❌ 请登录")
+            return False
+        if conversations is None:
+            conversations = self.conversation_seqs
+        data = ",".join(f"{key}={seq}" for key,seq in conversations.items())
+        message = MessageProtocol.pack_message(MSG_TYPE_SYNC,self.user_id,data)
+        self._send_raw(message)
+        return True
+
+    def mark_read(self,peer):
+        """已读回执：对方发来的、已收到的消息全部标记为已读（支持用户名或用户ID）"""
+        if not self.connected or self.user_id == -1:
+            print("❌ 请登录")
+            return False
+        try:
+            peer_id = int(peer)
+        except ValueError:
+            peer_id = self._get_user_id_by_name(peer)
+            if peer_id == -1:
+                print(f"❌ 未找到用户：{peer}")
+                return False
+        seq = self.conversation_seqs.get(f"u{peer_id}",0)
+        if seq == 0:
+            print("没有需要标记的消息")
+            return False
+        message = MessageProtocol.pack_message(MSG_TYPE_READ,self.user_id,f"{peer_id}:{seq}")
+        self._send_raw(message)
+        print(f"-> 已读到与{peer}的会话序号{seq}")
+        return True
+
+    def get_inbox(self,limit=20):
+        """查询收件箱（最近的单聊会话与未读数）"""
+        if not self.connected or self.user_id == -1:
+            print("❌ 请登录")
+            return False
+        message = MessageProtocol.pack_message(MSG_TYPE_INBOX,self.user_id,str(limit))
+        self._send_raw(message)
+        return True
+
+    def _handle_inbox_response(self,data):
+        """处理收件箱响应（预览按字节数截取，可包含分隔符）"""
+        raw = data.encode('utf-8')
+        pos = 0
+        print("📥 收件箱：")
+        while pos < len(raw):
+            fields = []
+            for _ in range(5):
+                end = raw.index(b':',pos)
+                fields.append(int(raw[pos:end]))
+                pos = end+1
+            peer_id,unread,last_seq,last_sender,length = fields
+            preview = raw[pos:pos+length].decode('utf-8')
+            pos += length+1
+            name = self._get_user_name_by_id(peer_id)
+            print(f"  {name}({peer_id}) 未读:{unread} 最后一条[{last_seq}] {last_sender}: {preview}")
+
+    def search(self,query,limit=20,before_id=0):
+        """全文搜索自己的单聊消息（before_id用于向更早的结果翻页）"""
+        if not self.connected or self.user_id == -1:
+            print("❌ 请登录")
+            return False
+        message = MessageProtocol.pack_message(MSG_TYPE_SEARCH,self.user_id,f"{limit}:{before_id}:{query}")
+        self._send_raw(message)
+        return True
+
+    def _handle_search_response(self,data):
+        """处理搜索响应（摘要按字节数截取，可包含分隔符）"""
+        raw = data.encode('utf-8')
+        pos = 0
+        if not raw:
+            print("🔍 没有找到匹配的消息")
+            return
+        print("🔍 搜索结果：")
+        while pos < len(raw):
+            fields = []
+            for _ in range(4):
+                end = raw.index(b':',pos)
+                fields.append(int(raw[pos:end]))
+                pos = end+1
+            message_id,peer_id,sender_id,length = fields
+            snippet = raw[pos:pos+length].decode('utf-8')
+            pos += length+1
+            name = self._get_user_name_by_id(peer_id)
+            print(f"  [{message_id}] 与{name}({peer_id}) {sender_id}: ...{snippet}...")
+
+    def send_file(self,receiver,path):
+        """上传附件（服务器按SHA-256去重，可断点续传），上传完成后发送附件引用消息"""
+        if not self.connected or self.user_id == -1:
+            print("❌ 请登录")
+            return False
+        try:
+            digest = hashlib.sha256()
+            with open(path,'rb') as f:
+                for block in iter(lambda: f.read(1024*1024),b''):
+                    digest.update(block)
+            size = os.path.getsize(path)
+        except OSError as e:
+            print(f"❌ 无法读取文件：{e}")
+            return False
+        if size == 0:
+            print("❌ 不能发送空文件")
+            return False
+        sha256 = digest.hexdigest()
+        kind = 'image' if os.path.splitext(path)[1].lower() in ('.png','.jpg','.jpeg','.gif','.webp') else 'file'
+        self.pending_uploads[sha256] = (receiver,path,f"{kind}:{sha256}:{size}:{os.path.basename(path)}")
+        self._send_raw(MessageProtocol.pack_message(MSG_TYPE_BLOB_BEGIN,self.user_id,f"{sha256}:{size}"))
+        return True
+
+    def _handle_blob_response(self,data):
+        """处理上传进度：已存储则发送引用消息，否则从已收到的位置继续上传"""
+        sha256,received,size = data.split(':')
+        upload = self.pending_uploads.get(sha256)
+        if not upload:
+            return
+        receiver,path,reference = upload
+        if int(received) >= int(size):
+            self.pending_uploads.pop(sha256,None)
+            print(f"✔ 附件已上传：{os.path.basename(path)}")
+            self.send_chat(receiver,reference)
+        else:
+            threading.Thread(target=self._send_chunks,args=(sha256,path,int(received)),daemon=True).start()
+
+    def _send_chunks(self,sha256,path,offset):
+        """按块上传附件（只有最后一块完成后服务器才回复）"""
+        with open(path,'rb') as f:
+            f.seek(offset)
+            while self.connected:
+                chunk = f.read(BLOB_CHUNK_SIZE)
+                if not chunk:
+                    break
+                self._send_raw(MessageProtocol.pack_message(MSG_TYPE_BLOB_CHUNK,self.user_id,f"{sha256}:{offset}:".encode()+chunk))
+                offset += len(chunk)
+
+    def download(self,sha256,path=None):
+        """下载附件"""
+        if not self.connected or self.user_id == -1:
+            print("❌ 请登录")
+            return False
+        path = path or sha256
+        self.downloads[sha256] = {'path':path,'file':open(path,'wb'),'received':0}
+        self._send_raw(MessageProtocol.pack_message(MSG_TYPE_BLOB_GET,self.user_id,f"{sha256}:0:0"))
+        return True
+
+    def _handle_blob_data(self,data):
+        """处理附件数据（原始字节，不按UTF-8解码）"""
+        sha256,offset,total,payload = data.split(b':',3)
+        download = self.downloads.get(sha256.decode())
+        if not download:
+            return
+        download['file'].seek(int(offset))
+        download['file'].write(payload)
+        download['received'] += len(payload)
+        if download['received'] >= int(total):
+            download['file'].close()
+            self.downloads.pop(sha256.decode(),None)
+            print(f"✔ 附件已下载：{download['path']}（{total.decode()}字节）")
+
+    def relay_file(self,receiver,path):
+        """在线直传文件（对方在线时服务器直接转发，不落盘；否则回退到附件上传）"""
+        if not self.connected or self.user_id == -1:
+            print("❌ 请登录")
+            return False
+        if self.pending_relay:
+            print("❌ 上一个直传尚未开始")
+            return False
+        try:
+            size = os.path.getsize(path)
+        except OSError as e:
+            print(f"❌ 无法读取文件：{e}")
+            return False
+        receiver_id = self._get_user_id_by_name(receiver) if not str(receiver).isdigit() else int(receiver)
+        if receiver_id == -1:
+            print(f"❌ 未找到用户：{receiver}")
+            return False
+        self.pending_relay = (receiver,path)
+        self._send_raw(MessageProtocol.pack_message(MSG_TYPE_RELAY_BEGIN,self.user_id,f"{receiver_id}:{size}:{os.path.basename(path)}"))
+        return True
+
+    def _handle_relay_response(self,data):
+        """处理直传响应：wait等待对方接受；go之后发送RELAY_START并紧接着发送文件的原始字节（期间不能发送其他帧）"""
+        status,_,relay_id = data.partition(':')
+        if status == 'done':
+            self.relays.pop(relay_id,None)
+            print(f"✔ 直传完成：{relay_id}")
+            return
+        if status == 'wait':
+            if self.pending_relay:
+                self.relays[relay_id] = self.pending_relay
+                self.pending_relay = None
+                print(f"等待对方接受直传：{relay_id}")
+            return
+        if status == 'store':
+            # 对方不在线、拒绝、超时或中途停止接收
+            relay = self.relays.pop(relay_id,None) if relay_id else self.pending_relay
+            if not relay_id:
+                self.pending_relay = None
+            if relay:
+                print("对方未接收直传，改为上传附件")
+                self.send_file(*relay)
+            return
+        if status != 'go' or relay_id not in self.relays:
+            return
+        receiver,path = self.relays[relay_id]
+        try:
+            size = os.path.getsize(path)
+            with self.send_lock, open(path,'rb') as f:
+                self.sock.sendall(MessageProtocol.pack_message(MSG_TYPE_RELAY_START,self.user_id,f"{relay_id}:{size}"))
+                for block in iter(lambda: f.read(BLOB_CHUNK_SIZE),b''):
+                    self.sock.sendall(block)
+        except Exception as e:
+            print(f"❌ 直传失败：{e}")
+            self.connected = False
+
+    def _handle_relay_offer(self,data):
+        """处理直传邀请（id:发送者ID:字节数:文件名）"""
+        relay_id,sender_id,size,name = data.split(':',3)
+        accept = 1 if self.accept_relays else 0
+        print(f"📎 用户{sender_id}想直传文件：{name}（{size}字节），{'接受' if accept else '拒绝'}")
+        self._send_raw(MessageProtocol.pack_message(MSG_TYPE_RELAY_ACCEPT,self.user_id,f"{relay_id}:{accept}"))
+
+    def _handle_relay_data(self,data):
+        """保存直传收到的文件（id:发送者ID:字节数:文件名:原始字节）"""
+        relay_id,sender_id,size,name,payload = data.split(b':',4)
+        path = f"relay_{relay_id.decode()}_{os.path.basename(name.decode('utf-8','replace'))}"
+        with open(path,'wb') as f:
+            f.write(payload)
+        print(f"📎 收到用户{sender_id.decode()}直传的文件：{path}（{size.decode()}字节）")
+
+    def _retry_unconfirmed(self):
+        """重发未收到发送确认的消息（客户端消息ID不变，服务器不会重复存储）"""
+        for message in list(self.unconfirmed_chats.values()):
+            self._send_raw(message)
+
+    def _ack(self,message_id):
+        """确认收到消息（未确认的消息服务器会在重连时重发）"""
+        if self.connected:
+            self._send_raw(MessageProtocol.pack_message(MSG_TYPE_ACK,self.user_id,str(message_id)))
+
+    def _note_seq(self,key,seq_text):
+        """记录会话收到的序号"""
+        try:
+            seq = int(seq_text)
+        except ValueError:
+            return
+        if seq > self.conversation_seqs.get(key,0):
+            self.conversation_seqs[key] = seq
+
+    def _handle_sync_summary(self,data):
+        """处理增量同步汇总（格式：u<ID>=已同步序号:最新序号,...），未同步完的会话继续请求"""
+        pending = {}
+        for item in data.split(',') if data else []:
+            try:
+                key,seqs = item.split('=',1)
+                synced,latest = (int(x) for x in seqs.split(':',1))
+            except ValueError:
+                continue
+            self._note_seq(key,synced)
+            if synced < latest:
+                pending[key] = synced
+        if pending:
+            self.sync(pending)
+        else:
+            print("✔ 增量同步完成")
+
     def get_chat_history(self,receiver,limit=50):
         """
         获取聊天记录（支持用户名或用户ID）
@@ -195,7 +531,8 @@ class EasyChatClient:
     def _send_raw(self,data):
         """发送原始二进制数据"""
         try:
-            self.sock.sendall(data)
+            with self.send_lock:
+                self.sock.sendall(data)
         except Exception as e:
             print(f"❌ 发送消息失败：{e}")
             self.connected = False
@@ -220,6 +557,14 @@ class EasyChatClient:
                         print("❌ 连接被关闭（数据）")
                         self.connected = False
                         break
+                    if msg_type == MSG_TYPE_BLOB_DATA:
+                        # 附件数据是原始字节
+                        self._handle_blob_data(data)
+                        continue
+                    if msg_type == MSG_TYPE_RELAY_DATA:
+                        # 直传数据是原始字节
+                        self._handle_relay_data(data)
+                        continue
                     data_str = data.decode('utf-8')
                 else:
                     data_str = ""
@@ -249,18 +594,79 @@ class EasyChatClient:
             #登陆响应
             if user_id != -1:
                 self.user_id = user_id
+                # 保存会话令牌（格式：Login successful:<token>）
+                if data.startswith("Login successful:"):
+                    self.session_token = data.split(':',1)[1]
                 print(f"✔ 登陆成功，用户ID:{user_id}")
+                self._retry_unconfirmed()
             else:
                 print(f"❌ 登陆失败：{data}")
         elif msg_type==MSG_TYPE_CHAT:
-            # 聊天消息
+            # 聊天消息（message_id:seq:content）
+            parts = data.split(':',2)
+            if len(parts) == 3:
+                self._note_seq(f"u{user_id}",parts[1])
+                self._ack(parts[0])
             if self.message_callback:
                 self.message_callback('chat',user_id,data)
+        elif msg_type==MSG_TYPE_CHAT_RESP:
+            # 发送确认（client_id:message_id）
+            client_id = data.split(':',1)[0]
+            if client_id.isdigit():
+                self.unconfirmed_chats.pop(int(client_id),None)
+        elif msg_type==MSG_TYPE_ROOM_CHAT:
+            # 群聊消息（room_id:message_id:seq:content）
+            parts = data.split(':',3)
+            if len(parts) == 4:
+                self._note_seq(f"r{parts[0]}",parts[2])
+                self._ack(parts[1])
+            if self.message_callback:
+                self.message_callback('room',user_id,data)
+        elif msg_type==MSG_TYPE_ROOM_RESP:
+            # 群聊操作响应（created/joined/left:room_id）
+            print(f"✔ 群聊操作成功：{data}")
         elif msg_type==MSG_TYPE_OFFLINE_MSG:
             #离线消息
             print(f"📫 发离线消息 from {user_id}:{data}")
+            parts = data.split(':',2)
+            if len(parts) == 3:
+                self._note_seq(f"u{user_id}",parts[1])
+                self._ack(parts[0])
             if self.message_callback:
                 self.message_callback('offline',user_id,data)
+        elif msg_type==MSG_TYPE_SYNC_RESP:
+            # 增量同步的消息（u<ID>:seq:content或r<ID>:seq:content）
+            parts = data.split(':',2)
+            if len(parts) == 3:
+                self._note_seq(parts[0],parts[1])
+            if self.message_callback:
+                self.message_callback('sync',user_id,data)
+        elif msg_type==MSG_TYPE_READ:
+            # 已读回执（reader_id:seq）
+            print(f"✔ 用户{user_id}已读到序号{data.split(':',1)[-1]}")
+            if self.message_callback:
+                self.message_callback('read',user_id,data)
+        elif msg_type==MSG_TYPE_INBOX:
+            # 收件箱
+            self._handle_inbox_response(data)
+        elif msg_type==MSG_TYPE_SEARCH:
+            # 搜索结果
+            self._handle_search_response(data)
+        elif msg_type==MSG_TYPE_BLOB_RESP:
+            # 附件上传进度
+            self._handle_blob_response(data)
+        elif msg_type==MSG_TYPE_RELAY_RESP:
+            # 在线直传响应
+            self._handle_relay_response(data)
+        elif msg_type==MSG_TYPE_RELAY_OFFER:
+            # 在线直传邀请
+            self._handle_relay_offer(data)
+        elif msg_type==MSG_TYPE_ACK:
+            # 上线同步批次结束，原样确认
+            self._ack(data)
+        elif msg_type==MSG_TYPE_SYNC:
+            # 增量同步汇总
+            self._handle_sync_summary(data)
         elif msg_type==MSG_TYPE_USERS_RESP or msg_type==13: # 13是MSG_TYPE_USERS_RESP
             # 在线用户列表响应
             self._handle_online_users_response(data)
@@ -393,6 +799,44 @@ def interactive_client():
             elif cmd == 'users':
                 # 查看在线用户
                 client.get_online_users()
+            elif cmd.startswith('room '):
+                # 群聊命令：room create name | room join id | room leave id | room send id message
+                parts = cmd.split(' ',3)
+                if len(parts) >= 3 and parts[1] == 'create':
+                    client.create_room(parts[2])
+                elif len(parts) >= 3 and parts[1] == 'join':
+                    client.join_room(parts[2])
+                elif len(parts) >= 3 and parts[1] == 'leave':
+                    client.leave_room(parts[2])
+                elif len(parts) == 4 and parts[1] == 'send':
+                    client.send_room_chat(parts[2],parts[3])
+            elif cmd.startswith('read '):
+                # 已读回执
+                client.mark_read(cmd.split(' ',1)[1])
+            elif cmd == 'inbox' or cmd.startswith('inbox '):
+                # 收件箱
+                parts = cmd.split()
+                client.get_inbox(int(parts[1]) if len(parts) > 1 else 20)
+            elif cmd.startswith('sendfile '):
+                # 发送附件
+                parts = cmd.split(' ',2)
+                if len(parts) == 3:
+                    client.send_file(parts[1],parts[2])
+            elif cmd.startswith('relay '):
+                # 在线直传
+                parts = cmd.split(' ',2)
+                if len(parts) == 3:
+                    client.relay_file(parts[1],parts[2])
+            elif cmd.startswith('download '):
+                # 下载附件
+                parts = cmd.split()
+                client.download(parts[1],parts[2] if len(parts) > 2 else None)
+            elif cmd.startswith('search '):
+                # 全文搜索
+                client.search(cmd.split(' ',1)[1])
+            elif cmd == 'sync':
+                # 增量同步所有已知会话
+                client.sync()
             elif cmd=='quit' or cmd=='exit':
                 #退出命令
                 break
@@ -403,6 +847,14 @@ def interactive_client():
                 print("  send receiver message    - 发送消息（支持用户名或用户ID）")
                 print("  history user [limit]     - 查看聊天记录（支持用户名或用户ID）")
                 print("  users                     - 查看在线用户")
+                print("  room create|join|leave|send ... - 群聊（send需要房间ID和消息）")
+                print("  read user                 - 标记与该用户的会话已读")
+                print("  inbox [n]                 - 查看收件箱（最近的会话与未读数）")
+                print("  search keyword            - 搜索自己的单聊消息（多个关键词同时匹配）")
+                print("  sendfile receiver path    - 发送附件（分块上传，支持断点续传）")
+                print("  download sha256 [path]    - 下载附件")
+                print("  relay receiver path       - 在线直传文件（对方不在线时改为上传附件）")
+                print("  sync                      - 增量同步已知会话")
                 print("  quit                      - 退出")
         except KeyboardInterrupt:
             print("\n")
@@ -421,6 +873,14 @@ if __name__ == "__main__":
     print("  send receiver message    - 发送消息（支持用户名或用户ID）")
     print("  history user [limit]     - 查看聊天记录（支持用户名或用户ID）")
     print("  users                     - 查看在线用户")
+    print("  room create|join|leave|send ... - 群聊（send需要房间ID和消息）")
+    print("  read user                 - 标记与该用户的会话已读")
+    print("  inbox [n]                 - 查看收件箱（最近的会话与未读数）")
+    print("  search keyword            - 搜索自己的单聊消息（多个关键词同时匹配）")
+    print("  sendfile receiver path    - 发送附件（分块上传，支持断点续传）")
+    print("  download sha256 [path]    - 下载附件")
+    print("  relay receiver path       - 在线直传文件（对方不在线时改为上传附件）")
+    print("  sync                      - 增量同步已知会话")
     print("  quit                      - 退出")
     print("=" * 50)
 
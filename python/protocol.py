@@ -10,7 +10,7 @@ MSG_TYPE_LOGIN_RESP = 2     # 登录响应
 MSG_TYPE_REGISTER = 3       # 注册请求
 MSG_TYPE_REGISTER_RESP = 4   # 注册响应
 MSG_TYPE_CHAT = 5           # 聊天消息
-MSG_TYPE_CHAT_RESP = 6      # 聊天响应
+MSG_TYPE_CHAT_RESP = 6      # 聊天响应（发送确认：client_id:message_id）
 MSG_TYPE_OFFLINE_MSG = 7     # 离线消息
 MSG_TYPE_HEARTBEAT = 8      # 心跳消息
 MSG_TYPE_ERROR = 9          # 错误消息
@@ -20,6 +20,33 @@ MSG_TYPE_HISTORY_RESP = 12   # 聊天记录响应
 MSG_TYPE_USERS_RESP = 13      # 在线用户响应
 MSG_TYPE_GET_USER_BY_NAME = 14  # 根据用户名获取用户信息
 MSG_TYPE_GET_USER_BY_NAME_RESP = 15  # 根据用户名获取用户信息响应
+MSG_TYPE_RESUME = 16        # 会话恢复（携带登录时下发的令牌）
+MSG_TYPE_ROOM_CREATE = 17   # 创建群聊
+MSG_TYPE_ROOM_JOIN = 18     # 加入群聊
+MSG_TYPE_ROOM_LEAVE = 19    # 退出群聊
+MSG_TYPE_ROOM_CHAT = 20     # 群聊消息（room_id:content）
+MSG_TYPE_ROOM_RESP = 21     # 群聊操作响应
+MSG_TYPE_BROADCAST = 22     # 全服公告（管理员发起）
+MSG_TYPE_BROADCAST_RESP = 23  # 公告已受理
+MSG_TYPE_SYNC = 24          # 增量同步请求/结束（会话=序号,...）
+MSG_TYPE_SYNC_RESP = 25     # 增量同步的一条消息（会话:seq:content）
+MSG_TYPE_ACK = 26           # 投递确认（message_id,...；上线同步末尾服务器发来的确认号原样确认）
+MSG_TYPE_READ = 27          # 已读回执（发送：对方ID:seq；收到：reader_id:seq）
+MSG_TYPE_INBOX = 28         # 收件箱（发送：会话数；收到：peer_id:未读数:last_seq:last_sender_id:预览字节数:预览|...）
+MSG_TYPE_SEARCH = 29        # 全文搜索（发送：条数:before_id:关键词；收到：消息ID:对方用户ID:发送者ID:摘要字节数:摘要|...）
+MSG_TYPE_BLOB_BEGIN = 30    # 开始/续传附件上传（sha256:字节数）
+MSG_TYPE_BLOB_CHUNK = 31    # 上传一块附件（sha256:偏移:原始字节，每块至多256KB）
+MSG_TYPE_BLOB_RESP = 32     # 上传进度（sha256:已收到字节数:总字节数，两者相等表示已存储）
+MSG_TYPE_BLOB_GET = 33      # 下载附件（sha256:偏移:字节数，0表示到末尾）
+MSG_TYPE_BLOB_DATA = 34     # 附件数据（sha256:偏移:总字节数:原始字节）
+MSG_TYPE_RELAY_BEGIN = 35   # 在线直传（接收者ID:字节数:文件名）
+MSG_TYPE_RELAY_RESP = 36    # 直传响应（wait:id，等待对方接受；go:id，发送RELAY_START；store[:id]，改用附件上传；done:id）
+MSG_TYPE_RELAY_DATA = 37    # 直传数据（id:发送者ID:字节数:文件名:原始字节）
+MSG_TYPE_RELAY_OFFER = 38   # 直传邀请（id:发送者ID:字节数:文件名）
+MSG_TYPE_RELAY_ACCEPT = 39  # 答复直传邀请（id:1接受，id:0拒绝）
+MSG_TYPE_RELAY_START = 40   # 开始直传（id:字节数，随后紧接着发送原始字节）
+
+BLOB_CHUNK_SIZE = 256*1024  # 上传每块的字节数
 
 class MessageProtocol:
     """消息协议处理类"""
@@ -27,8 +54,8 @@ class MessageProtocol:
 
     @staticmethod
     def pack_message(msg_type,user_id,data):
-        """打包消息为二进制数据"""
-        data_bytes = data.encode('utf-8')
+        """打包消息为二进制数据（data为str或bytes）"""
+        data_bytes = data if isinstance(data,bytes) else data.encode('utf-8')
         data_size = len(data_bytes)
         total_length = MessageProtocol.HEADER_SIZE + data_size
         # 打包头部
@@ -53,6 +80,7 @@ class MessageProtocol:
             MSG_TYPE_REGISTER: 'REGISTER',
             MSG_TYPE_REGISTER_RESP: 'REGISTER_RESP',
             MSG_TYPE_CHAT: 'CHAT',
+            MSG_TYPE_CHAT_RESP: 'CHAT_RESP',
             MSG_TYPE_ERROR: 'ERROR',
             MSG_TYPE_HEARTBEAT: 'HEARTBEAT',
             MSG_TYPE_OFFLINE_MSG: 'OFFLINE_MSG',
@@ -61,6 +89,31 @@ class MessageProtocol:
             MSG_TYPE_GET_USERS: 'GET_USERS',
             MSG_TYPE_USERS_RESP: 'GET_USERS_RESP',
             MSG_TYPE_GET_USER_BY_NAME: 'GET_USER_BY_NAME',
-            MSG_TYPE_GET_USER_BY_NAME_RESP: 'GET_USER_BY_NAME_RESP'
+            MSG_TYPE_GET_USER_BY_NAME_RESP: 'GET_USER_BY_NAME_RESP',
+            MSG_TYPE_RESUME: 'RESUME',
+            MSG_TYPE_ROOM_CREATE: 'ROOM_CREATE',
+            MSG_TYPE_ROOM_JOIN: 'ROOM_JOIN',
+            MSG_TYPE_ROOM_LEAVE: 'ROOM_LEAVE',
+            MSG_TYPE_ROOM_CHAT: 'ROOM_CHAT',
+            MSG_TYPE_ROOM_RESP: 'ROOM_RESP',
+            MSG_TYPE_BROADCAST: 'BROADCAST',
+            MSG_TYPE_BROADCAST_RESP: 'BROADCAST_RESP',
+            MSG_TYPE_SYNC: 'SYNC',
+            MSG_TYPE_SYNC_RESP: 'SYNC_RESP',
+            MSG_TYPE_ACK: 'ACK',
+            MSG_TYPE_READ: 'READ',
+            MSG_TYPE_INBOX: 'INBOX',
+            MSG_TYPE_SEARCH: 'SEARCH',
+            MSG_TYPE_BLOB_BEGIN: 'BLOB_BEGIN',
+            MSG_TYPE_BLOB_CHUNK: 'BLOB_CHUNK',
+            MSG_TYPE_BLOB_RESP: 'BLOB_RESP',
+            MSG_TYPE_BLOB_GET: 'BLOB_GET',
+            MSG_TYPE_BLOB_DATA: 'BLOB_DATA',
+            MSG_TYPE_RELAY_BEGIN: 'RELAY_BEGIN',
+            MSG_TYPE_RELAY_RESP: 'RELAY_RESP',
+            MSG_TYPE_RELAY_DATA: 'RELAY_DATA',
+            MSG_TYPE_RELAY_OFFER: 'RELAY_OFFER',
+            MSG_TYPE_RELAY_ACCEPT: 'RELAY_ACCEPT',
+            MSG_TYPE_RELAY_START: 'RELAY_START'
         }
         return type_name.get(msg_type,f"UNKNOWN({msg_type})")
@@ -1,9 +1,9 @@
 use easychat;
-# 用户表
+# 用户表（旧库升级：alter table users modify password varchar(255) not null;）
 create table if not exists users(
                                     id int primary key auto_increment comment '用户ID',
                                     username varchar(50) not null unique comment '用户名',
-    password varchar(50) not null comment '密码（MD5加密）',
+    password varchar(255) not null comment '密码哈希（pbkdf2_sha256$迭代次数$盐$哈希，旧数据为MD5）',
     nickname varchar(50) comment '昵称',
     avatar varchar(255) comment '头像URL',
     status tinyint default 0 comment '状态：0-离线，1-在线',
@@ -12,9 +12,11 @@ create table if not exists users(
     index idx_username(username),
     index idx_status(status)
     )engine = InnoDB default charset =utf8mb4 comment ='用户表';
-# 消息表
+# 消息表（消息ID为服务器生成的64位Snowflake ID；旧库升级：alter table messages modify id bigint not null;
+#  alter table messages add seq bigint not null default 0, add index idx_conversation(sender_id,receiver_id,seq);
+#  alter table messages add index idx_receiver_conversation(receiver_id,sender_id,seq), add index idx_unread(receiver_id,is_read,sender_id,seq);）
 create table if not exists messages(
-                                       id int primary key auto_increment comment '消息ID',
+                                       id bigint primary key comment '消息ID（Snowflake，由服务器生成）',
                                        sender_id int not null comment '发送者ID',
                                        receiver_id int not null comment '接收者ID',
                                        content text not null comment '消息内容',
@@ -22,12 +24,64 @@ create table if not exists messages(
                                        is_offline tinyint default 0 comment '是否为离线消息：0-否，1-是',
                                        is_read tinyint default 0 comment '是否已读：0-未读，1-已读',
                                        created_at timestamp default current_timestamp comment '发送时间',
+                                       seq bigint not null default 0 comment '会话内序号（两人会话内递增，用于增量同步）',
                                        index idx_sender(sender_id),
+    index idx_conversation(sender_id,receiver_id,seq),
     index idx_receiver(receiver_id),
+    index idx_receiver_conversation(receiver_id,sender_id,seq),
+    index idx_unread(receiver_id,is_read,sender_id,seq),
     index idx_offline(receiver_id,is_offline),
     foreign key (sender_id) references users(id) on delete cascade ,
     foreign key (receiver_id) references users(id) on delete cascade
     ) engine = InnoDB default charset =utf8mb4 comment ='消息表';
+# 设备投递游标表（每个设备已收到的最大消息ID，设备上线时补发之后的消息）
+create table if not exists device_cursors(
+                                             user_id int not null comment '用户ID',
+                                             device_id varchar(64) not null comment '设备ID',
+    last_message_id bigint not null default 0 comment '已投递的最大消息ID',
+    updated_at timestamp default current_timestamp on update current_timestamp comment '更新时间',
+    primary key (user_id,device_id),
+    foreign key (user_id) references users(id) on delete cascade
+    )engine =InnoDB default charset =utf8mb4 comment='设备投递游标表';
+# 群聊表
+create table if not exists rooms(
+                                    id int primary key auto_increment comment '房间ID',
+                                    name varchar(64) not null comment '房间名',
+    owner_id int not null comment '创建者ID',
+    created_at timestamp default current_timestamp comment '创建时间',
+    foreign key (owner_id) references users(id) on delete cascade
+    )engine =InnoDB default charset =utf8mb4 comment='群聊表';
+# 群聊成员表（启动时加载到内存，joined_message_id之前的群聊消息不补发）
+create table if not exists room_members(
+                                           room_id int not null comment '房间ID',
+                                           user_id int not null comment '用户ID',
+    joined_message_id bigint not null default 0 comment '加入时的消息ID位置',
+    joined_at timestamp default current_timestamp comment '加入时间',
+    primary key (room_id,user_id),
+    index idx_user(user_id),
+    foreign key (room_id) references rooms(id) on delete cascade,
+    foreign key (user_id) references users(id) on delete cascade
+    )engine =InnoDB default charset =utf8mb4 comment='群聊成员表';
+# 群聊消息表（每条消息一行，离线成员上线时按设备游标补发）
+create table if not exists room_messages(
+                                            id bigint primary key comment '消息ID（Snowflake，由服务器生成）',
+                                            room_id int not null comment '房间ID',
+                                            sender_id int not null comment '发送者ID',
+    content text not null comment '消息内容',
+    message_type tinyint default 0 comment '消息类型：0-文本，1-图片，2-文件',
+    created_at timestamp default current_timestamp comment '发送时间',
+    seq bigint not null default 0 comment '房间内序号（用于增量同步）',
+    index idx_room(room_id,id),
+    index idx_room_seq(room_id,seq),
+    foreign key (room_id) references rooms(id) on delete cascade
+    )engine =InnoDB default charset =utf8mb4 comment='群聊消息表';
+# 会话序号下限（过期删除时保存被删除消息的最大序号，会话消息全部过期后序号从此继续）
+create table if not exists sequence_floors(
+                                              kind tinyint not null comment '会话类型：0-单聊，1-群聊',
+                                              conversation_id bigint not null comment '单聊为(较小用户ID<<32|较大用户ID)，群聊为房间ID',
+    seq bigint not null comment '已删除消息的最大序号',
+    primary key (kind,conversation_id)
+    )engine =InnoDB default charset =utf8mb4 comment='会话序号下限表';
 # 在线用户表（缓存表）
 create table if not exists online_users(
                                            user_id int primary key comment '用户ID',
@@ -38,6 +92,7 @@ create table if not exists online_users(
     index idx_heartbeat(last_heartbeat),
     foreign key (user_id) references users(id) on delete cascade
     )engine =InnoDB default charset =utf8mb4 comment='在线用户表';
+# 初始密码均为123456（MD5旧格式，首次登录后自动升级为PBKDF2）
 insert into users(username,password,nickname,status) values
                                                          ('admin','e10adc3949ba59abbe56e057f20f883e','管理员',0),
                                                          ('user1','e10adc3949ba59abbe56e057f20f883e','用户1',0),
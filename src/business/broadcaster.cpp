@@ -0,0 +1,95 @@
+//
+// Created by Cando on 2026/10/19.
+//
+#include "../../include/business/broadcaster.h"
+#include "../../include/business/user_manager.h"
+#include "../../include/network/reactor.h"
+#include "../../include/common/id_generator.h"
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+namespace easychat{
+    Broadcaster::Broadcaster() :batch_size_(1000),active_tasks_(0){}
+
+    Broadcaster &Broadcaster::getInstance() {
+        static Broadcaster instance;
+        return instance;
+    }
+
+    void Broadcaster::init(size_t batch_size, const std::string &admin_user_ids) {
+        batch_size_ = batch_size>0 ? batch_size : 1;
+        std::lock_guard<std::mutex> lock(admin_mutex_);
+        admin_user_ids_.clear();
+        std::stringstream ss(admin_user_ids);
+        std::string item;
+        while (std::getline(ss,item,',')){
+            // 去除首尾空白
+            size_t start = item.find_first_not_of(" \t");
+            if (start==std::string::npos) continue;
+            size_t end = item.find_last_not_of(" \t");
+            try {
+                size_t parsed = 0;
+                int user_id = std::stoi(item.substr(start,end-start+1),&parsed);
+                if (parsed!=end-start+1 || user_id<=0) throw std::invalid_argument("admin");
+                admin_user_ids_.insert(user_id);
+            }catch (const std::exception& e){
+                std::cerr<<"Ignoring invalid admin user id: "<<item<<std::endl;
+            }
+        }
+        std::cout<<"Broadcaster initialized, batch size: "<<batch_size_<<", admins: "<<admin_user_ids_.size()<<std::endl;
+    }
+
+    bool Broadcaster::isAdmin(int user_id) const {
+        std::lock_guard<std::mutex> lock(admin_mutex_);
+        return admin_user_ids_.count(user_id)>0;
+    }
+
+    size_t Broadcaster::broadcast(const std::string &content) {
+        UserManager& user_manager = UserManager::getInstance();
+        auto state = std::make_shared<Broadcast>();
+        state->id = IdGenerator::getInstance().nextId();
+        // 只序列化一次，所有连接共享同一帧（user_id为0表示系统消息）
+        state->frame = makeSharedFrame(Message(MessageType::MSG_TYPE_BROADCAST,0,content));
+        size_t shard_count = user_manager.onlineShardCount();
+        state->remaining_shards = shard_count;
+        state->delivered = 0;
+        size_t online = user_manager.onlineUserCount();
+        std::cout<<"Broadcast "<<state->id<<" started, online users: "<<online<<", shards: "<<shard_count<<std::endl;
+        for (size_t shard=0;shard<shard_count;++shard){
+            auto task = std::make_shared<ShardTask>();
+            task->broadcast = state;
+            task->shard = shard;
+            active_tasks_.fetch_add(1,std::memory_order_relaxed);
+            Reactor::getInstance().submitTask([this,task]{this->runTick(task);});
+        }
+        return online;
+    }
+
+    void Broadcaster::runTick(std::shared_ptr<ShardTask> task) {
+        Broadcast& state = *task->broadcast;
+        // 第一轮执行时才取分片快照，之后上线的用户不再推送
+        if (!task->started){
+            task->started = true;
+            UserManager::getInstance().snapshotOnlineShard(task->shard,task->handles);
+        }
+        size_t end = std::min(task->handles.size(),task->position+batch_size_);
+        size_t delivered = 0;
+        for (;task->position<end;++task->position){
+            // 句柄代数不一致说明连接已关闭，跳过
+            if (auto conn = Reactor::getInstance().findConnection(task->handles[task->position])){
+                if (conn->sendFrame(state.frame)) ++delivered;
+            }
+        }
+        state.delivered.fetch_add(delivered,std::memory_order_relaxed);
+        if (task->position<task->handles.size()){
+            // 本轮预算用完，排到队列末尾，让出工作线程
+            Reactor::getInstance().submitTask([this,task]{this->runTick(task);});
+            return;
+        }
+        active_tasks_.fetch_sub(1,std::memory_order_relaxed);
+        if (state.remaining_shards.fetch_sub(1,std::memory_order_acq_rel)==1){
+            std::cout<<"Broadcast "<<state.id<<" finished, delivered to "<<state.delivered.load()<<" devices"<<std::endl;
+        }
+    }
+}
@@ -0,0 +1,154 @@
+//
+// Created by Cando on 2026/10/19.
+//
+#include "../../include/business/conversation_index.h"
+#include <algorithm>
+#include <iostream>
+
+namespace easychat{
+    ConversationIndex::ConversationIndex() :recent_messages_(64),shard_capacity_(10000/kShardCount),
+    shard_byte_budget_((64<<20)/kShardCount){
+        for (size_t i=0;i<kShardCount;++i){
+            shards_.emplace_back(std::make_unique<Shard>());
+        }
+    }
+
+    ConversationIndex &ConversationIndex::getInstance() {
+        static ConversationIndex instance;
+        return instance;
+    }
+
+    void ConversationIndex::init(size_t recent_messages, size_t max_conversations, size_t max_bytes) {
+        recent_messages_ = recent_messages;
+        shard_capacity_ = std::max<size_t>(max_conversations/kShardCount,1);
+        shard_byte_budget_ = std::max<size_t>(max_bytes/kShardCount,1);
+        std::cout<<"ConversationIndex initialized, recent messages: "<<recent_messages_
+        <<", max conversations: "<<shard_capacity_*kShardCount<<", max bytes: "<<shard_byte_budget_*kShardCount<<std::endl;
+    }
+
+    uint64_t ConversationIndex::directKey(int user_id1, int user_id2) {
+        uint32_t low = static_cast<uint32_t>(std::min(user_id1,user_id2));
+        uint32_t high = static_cast<uint32_t>(std::max(user_id1,user_id2));
+        return (static_cast<uint64_t>(low)<<32)|high;
+    }
+
+    uint64_t ConversationIndex::roomKey(int room_id) {
+        // 最高位区分群聊，用户ID为正数，单聊键的最高位总是0
+        return (1ULL<<63)|static_cast<uint32_t>(room_id);
+    }
+
+    std::shared_ptr<Conversation> ConversationIndex::acquire(uint64_t key) {
+        Shard& shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(key);
+        if (it!=shard.index.end()){
+            shard.lru.splice(shard.lru.begin(),shard.lru,it->second);
+            // 已有会话的近期消息增长也可能超出字节配额（先持有引用，淘汰时跳过该会话）
+            std::shared_ptr<Conversation> conversation = it->second->second;
+            if (shard.bytes.load()>shard_byte_budget_) evict(shard);
+            return conversation;
+        }
+        auto conversation = std::make_shared<Conversation>();
+        conversation->key = key;
+        shard.lru.emplace_front(key,conversation);
+        shard.index[key] = shard.lru.begin();
+        evict(shard);
+        return conversation;
+    }
+
+    std::shared_ptr<Conversation> ConversationIndex::find(uint64_t key) {
+        Shard& shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(key);
+        if (it==shard.index.end()) return nullptr;
+        shard.lru.splice(shard.lru.begin(),shard.lru,it->second);
+        return it->second->second;
+    }
+
+    void ConversationIndex::evict(Shard &shard) const {
+        // 从最久未使用的一端开始，跳过仍在使用中的会话（分片锁内没有新的引用产生，
+        // 没有其他引用的会话也不会有并发的近期消息追加）
+        auto it = shard.lru.end();
+        while ((shard.index.size()>shard_capacity_ || shard.bytes.load()>shard_byte_budget_) && it!=shard.lru.begin()){
+            --it;
+            if (it->second.use_count()>1) continue;
+            shard.bytes -= it->second->bytes.load();
+            shard.index.erase(it->first);
+            it = shard.lru.erase(it);
+        }
+    }
+
+    void ConversationIndex::remember(Conversation &conversation, const MessageInfo &message) const {
+        if (recent_messages_==0) return;
+        conversation.recent.push_back(RecentMessage{message.seq,message.id,message.sender_id,message.content});
+        size_t added = messageBytes(conversation.recent.back());
+        size_t removed = 0;
+        while (conversation.recent.size()>recent_messages_){
+            removed += messageBytes(conversation.recent.front());
+            conversation.recent.pop_front();
+        }
+        // 字节数在会话锁内更新，超出配额的部分在下次获取该分片的会话时淘汰
+        Shard& shard = shardFor(conversation.key);
+        conversation.bytes += added;
+        conversation.bytes -= removed;
+        shard.bytes += added;
+        shard.bytes -= removed;
+    }
+
+    void ConversationIndex::forget(Conversation &conversation, int64_t max_message_id) const {
+        size_t removed = 0;
+        while (!conversation.recent.empty() && conversation.recent.front().message_id<=max_message_id){
+            removed += messageBytes(conversation.recent.front());
+            conversation.recent.pop_front();
+        }
+        if (removed==0) return;
+        Shard& shard = shardFor(conversation.key);
+        conversation.bytes -= removed;
+        shard.bytes -= removed;
+    }
+
+    size_t ConversationIndex::cachedBytes() const {
+        size_t total = 0;
+        for (const auto& shard:shards_){
+            total += shard->bytes.load();
+        }
+        return total;
+    }
+
+    bool ConversationIndex::writeHistory(const Conversation &conversation, int limit, FrameWriter &writer) const {
+        // 近期消息必须是会话的最新消息，且至少有limit条
+        if (!conversation.loaded || limit<=0 || conversation.recent.size()<static_cast<size_t>(limit) ||
+            conversation.recent.back().seq!=conversation.last_seq){
+            return false;
+        }
+        auto it = conversation.recent.rbegin();
+        for (int count=0;count<limit;++count,++it){
+            if (count>0) writer.append('|');
+            writer.appendInt(it->sender_id);
+            writer.append(':');
+            writer.append(it->content);
+        }
+        return true;
+    }
+
+    bool ConversationIndex::writeRecent(const Conversation &conversation, int64_t after_seq, int64_t after_id,
+                                        int limit, std::string_view prefix, FrameWriter &writer,
+                                        int64_t &last_seq) const {
+        if (after_seq>=conversation.last_seq) return true;
+        // 近期消息必须覆盖(after_seq,last_seq]，否则中间有缺口
+        if (conversation.recent.empty() || conversation.recent.front().seq>after_seq+1) return false;
+        auto it = conversation.recent.begin()+(after_seq+1-conversation.recent.front().seq);
+        for (int count=0;it!=conversation.recent.end() && count<limit;++it){
+            if (it->message_id<=after_id) continue;
+            ++count;
+            writer.beginFrame(MessageType::MSG_TYPE_SYNC_RESP,static_cast<uint32_t>(it->sender_id));
+            writer.append(prefix);
+            writer.appendInt(it->seq);
+            writer.append(':');
+            writer.append(it->content);
+            writer.endFrame();
+            last_seq = it->seq;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,47 @@
+//
+// Created by Cando on 2026/10/19.
+//
+#include "../../include/business/delivery_writer.h"
+
+namespace easychat{
+    namespace {
+        // 待写表上限：约为存储不可用时几分钟的确认量，超出后丢弃新的确认
+        constexpr size_t kMaxPendingDeliveries = 1000000;
+    }
+
+    DeliveryWriter::DeliveryWriter()
+    :batcher_("delivery state",[](const Delivery& delivery){return delivery;},[](Delivery&,Delivery&&){}){}
+
+    DeliveryWriter::~DeliveryWriter() {
+        stop();
+    }
+
+    void DeliveryWriter::init(std::shared_ptr<MessageStore> store) {
+        store_ = std::move(store);
+        batcher_.setFlush([this](std::vector<Delivery>& batch){
+            return store_->markDelivered(batch);
+        });
+    }
+
+    void DeliveryWriter::start(int flush_interval_ms, size_t max_batch) {
+        batcher_.start(flush_interval_ms,max_batch,kMaxPendingDeliveries);
+    }
+
+    void DeliveryWriter::delivered(int user_id, const std::vector<int64_t> &message_ids) {
+        if (message_ids.empty()) return;
+        std::vector<Delivery> deliveries;
+        deliveries.reserve(message_ids.size());
+        for (int64_t message_id:message_ids){
+            deliveries.emplace_back(user_id,message_id);
+        }
+        batcher_.add(std::move(deliveries));
+    }
+
+    size_t DeliveryWriter::pendingCount() {
+        return batcher_.pendingCount();
+    }
+
+    void DeliveryWriter::stop() {
+        batcher_.stop();
+    }
+}
@@ -0,0 +1,220 @@
+//
+// Created by Cando on 2026/10/19.
+//
+#include "../../include/business/inbox_index.h"
+#include <algorithm>
+#include <iostream>
+
+namespace easychat{
+    InboxIndex::InboxIndex() :shard_capacity_(10000/kShardCount){
+        for (size_t i=0;i<kShardCount;++i){
+            shards_.emplace_back(std::make_unique<Shard>());
+        }
+    }
+
+    InboxIndex &InboxIndex::getInstance() {
+        static InboxIndex instance;
+        return instance;
+    }
+
+    void InboxIndex::init(size_t max_users) {
+        shard_capacity_ = std::max<size_t>(max_users/kShardCount,1);
+        std::cout<<"InboxIndex initialized, max users: "<<shard_capacity_*kShardCount<<std::endl;
+    }
+
+    std::shared_ptr<Inbox> InboxIndex::acquire(int user_id) {
+        Shard& shard = shardFor(user_id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(user_id);
+        if (it!=shard.index.end()){
+            shard.lru.splice(shard.lru.begin(),shard.lru,it->second);
+            return it->second->second;
+        }
+        auto inbox = std::make_shared<Inbox>();
+        shard.lru.emplace_front(user_id,inbox);
+        shard.index[user_id] = shard.lru.begin();
+        evict(shard);
+        return inbox;
+    }
+
+    std::shared_ptr<Inbox> InboxIndex::findLoaded(int user_id) {
+        Shard& shard = shardFor(user_id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(user_id);
+        if (it==shard.index.end()) return nullptr;
+        return it->second->second;
+    }
+
+    void InboxIndex::evict(Shard &shard) const {
+        auto it = shard.lru.end();
+        while (shard.index.size()>shard_capacity_ && it!=shard.lru.begin()){
+            --it;
+            if (it->second.use_count()>1) continue;
+            shard.index.erase(it->first);
+            it = shard.lru.erase(it);
+        }
+    }
+
+    std::string InboxIndex::makePreview(const std::string &content) {
+        if (content.size()<=kPreviewBytes) return content;
+        size_t length = kPreviewBytes;
+        // 退到UTF-8字符的起始字节
+        while (length>0 && (static_cast<unsigned char>(content[length]) & 0xC0)==0x80) --length;
+        return content.substr(0,length);
+    }
+
+    void InboxIndex::applyMessage(InboxConversation &conversation, const MessageInfo &message, bool incoming) {
+        // 加载时已包含的消息不再重复计入
+        if (message.seq<=conversation.last_seq) return;
+        conversation.last_message_id = message.id;
+        conversation.last_seq = message.seq;
+        conversation.last_sender_id = message.sender_id;
+        conversation.preview = makePreview(message.content);
+        if (!incoming) return;
+        conversation.unread_seqs.push_back(message.seq);
+        if (conversation.unread_seqs.size()>kMaxTrackedUnread){
+            ++conversation.overflow_unread;
+            conversation.overflow_max_seq = conversation.unread_seqs.front();
+            conversation.unread_seqs.pop_front();
+        }
+    }
+
+    void InboxIndex::applyRead(InboxConversation &conversation, int64_t seq) {
+        while (!conversation.unread_seqs.empty() && conversation.unread_seqs.front()<=seq){
+            conversation.unread_seqs.pop_front();
+        }
+        if (conversation.overflow_unread>0 && conversation.overflow_max_seq<=seq) conversation.overflow_unread = 0;
+    }
+
+    void InboxIndex::beginLoad(Inbox &inbox) const {
+        ++inbox.loaders;
+    }
+
+    void InboxIndex::finishLoad(Inbox &inbox) {
+        if (--inbox.loaders>0) return;
+        inbox.pending_messages.clear();
+        inbox.pending_reads.clear();
+        inbox.pending_dropped = false;
+    }
+
+    void InboxIndex::abortLoad(Inbox &inbox) const {
+        finishLoad(inbox);
+    }
+
+    bool InboxIndex::load(Inbox &inbox, std::vector<InboxEntry> &entries) const {
+        if (inbox.loaded){
+            // 并发的另一次加载已安装
+            finishLoad(inbox);
+            return true;
+        }
+        if (inbox.pending_dropped){
+            finishLoad(inbox);
+            return false;
+        }
+        fill(inbox,entries);
+        // 重放加载期间的更新：存储结果已包含的消息按序号跳过
+        for (const auto& pending:inbox.pending_messages){
+            applyMessage(inbox.conversations[pending.peer_id],pending.message,pending.incoming);
+        }
+        for (const auto& [peer_id,seq]:inbox.pending_reads){
+            auto it = inbox.conversations.find(peer_id);
+            if (it!=inbox.conversations.end()) applyRead(it->second,seq);
+        }
+        inbox.loaded = true;
+        finishLoad(inbox);
+        inbox.pending_messages.clear();
+        inbox.pending_reads.clear();
+        return true;
+    }
+
+    void InboxIndex::fill(Inbox &inbox, std::vector<InboxEntry> &entries) {
+        inbox.conversations.clear();
+        for (auto& entry:entries){
+            InboxConversation& conversation = inbox.conversations[entry.peer_id];
+            conversation.last_message_id = entry.last_message_id;
+            conversation.last_seq = entry.last_seq;
+            conversation.last_sender_id = entry.last_sender_id;
+            conversation.preview = makePreview(entry.last_content);
+            size_t skip = entry.unread_seqs.size()>kMaxTrackedUnread ? entry.unread_seqs.size()-kMaxTrackedUnread : 0;
+            if (skip>0){
+                conversation.overflow_unread = static_cast<int64_t>(skip);
+                conversation.overflow_max_seq = entry.unread_seqs[skip-1];
+            }
+            conversation.unread_seqs.assign(entry.unread_seqs.begin()+skip,entry.unread_seqs.end());
+        }
+    }
+
+    void InboxIndex::onMessage(const MessageInfo &message) {
+        auto apply = [&message](Inbox& inbox,int peer_id,bool incoming){
+            std::lock_guard<std::mutex> lock(inbox.mutex);
+            if (inbox.loaded){
+                applyMessage(inbox.conversations[peer_id],message,incoming);
+            }else if (inbox.loaders>0 && !inbox.pending_dropped){
+                if (inbox.pending_messages.size()+inbox.pending_reads.size()>=kMaxPendingUpdates){
+                    inbox.pending_dropped = true;
+                    inbox.pending_messages.clear();
+                    inbox.pending_reads.clear();
+                }else{
+                    inbox.pending_messages.push_back({peer_id,incoming,message});
+                }
+            }
+        };
+        if (auto inbox = findLoaded(message.sender_id)) apply(*inbox,message.receiver_id,false);
+        if (message.receiver_id==message.sender_id) return;
+        if (auto inbox = findLoaded(message.receiver_id)) apply(*inbox,message.sender_id,true);
+    }
+
+    void InboxIndex::onRead(int reader_id, int peer_id, int64_t seq) {
+        auto inbox = findLoaded(reader_id);
+        if (!inbox) return;
+        std::lock_guard<std::mutex> lock(inbox->mutex);
+        if (!inbox->loaded){
+            if (inbox->loaders==0 || inbox->pending_dropped) return;
+            if (inbox->pending_messages.size()+inbox->pending_reads.size()>=kMaxPendingUpdates){
+                inbox->pending_dropped = true;
+                inbox->pending_messages.clear();
+                inbox->pending_reads.clear();
+            }else{
+                inbox->pending_reads.emplace_back(peer_id,seq);
+            }
+            return;
+        }
+        auto it = inbox->conversations.find(peer_id);
+        if (it==inbox->conversations.end()) return;
+        applyRead(it->second,seq);
+    }
+
+    void InboxIndex::invalidate(int user_id) {
+        auto inbox = findLoaded(user_id);
+        if (!inbox) return;
+        std::lock_guard<std::mutex> lock(inbox->mutex);
+        inbox->loaded = false;
+        // 正在进行的加载可能读到了删除前的数据
+        if (inbox->loaders>0) inbox->pending_dropped = true;
+    }
+
+    void InboxIndex::writeTop(const Inbox &inbox, int limit, FrameWriter &writer) const {
+        std::vector<std::pair<int64_t,int>> order;
+        order.reserve(inbox.conversations.size());
+        for (const auto& [peer_id,conversation]:inbox.conversations){
+            order.emplace_back(conversation.last_message_id,peer_id);
+        }
+        size_t count = std::min(order.size(),static_cast<size_t>(std::max(limit,0)));
+        std::partial_sort(order.begin(),order.begin()+count,order.end(),std::greater<>());
+        for (size_t i=0;i<count;++i){
+            const InboxConversation& conversation = inbox.conversations.at(order[i].second);
+            if (i>0) writer.append('|');
+            writer.appendInt(order[i].second);
+            writer.append(':');
+            writer.appendInt(conversation.unreadCount());
+            writer.append(':');
+            writer.appendInt(conversation.last_seq);
+            writer.append(':');
+            writer.appendInt(conversation.last_sender_id);
+            writer.append(':');
+            writer.appendInt(static_cast<int64_t>(conversation.preview.size()));
+            writer.append(':');
+            writer.append(conversation.preview);
+        }
+    }
+}
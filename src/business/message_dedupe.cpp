@@ -0,0 +1,74 @@
+//
+// Created by Cando on 2026/10/19.
+//
+#include "../../include/business/message_dedupe.h"
+#include <algorithm>
+
+namespace easychat{
+    MessageDedupe::MessageDedupe() :ttl_(300000),shard_capacity_(100000/kShardCount){
+        for (size_t i=0;i<kShardCount;++i){
+            shards_.emplace_back(std::make_unique<Shard>());
+        }
+    }
+
+    void MessageDedupe::configure(int ttl_ms, size_t max_entries) {
+        ttl_ = std::chrono::milliseconds(std::max(ttl_ms,1));
+        shard_capacity_ = std::max<size_t>(max_entries/kShardCount,1);
+    }
+
+    MessageDedupe::Shard &MessageDedupe::shardFor(int sender_id) {
+        // 同一发送者的条目在同一分片，淘汰顺序与该用户的发送顺序一致
+        return *shards_[static_cast<uint32_t>(sender_id)%kShardCount];
+    }
+
+    void MessageDedupe::evict(Shard &shard, Clock::time_point now) const {
+        while (!shard.order.empty() && (shard.order.front().second<=now || shard.entries.size()>shard_capacity_)){
+            auto it = shard.entries.find(shard.order.front().first);
+            // 同一键被释放后重新登记时，队列中的旧位置已失效
+            if (it!=shard.entries.end() && it->second.expire_at==shard.order.front().second){
+                shard.entries.erase(it);
+            }
+            shard.order.pop_front();
+        }
+    }
+
+    bool MessageDedupe::claim(int sender_id, uint64_t client_id, int64_t message_id, int64_t &existing_id) {
+        Shard& shard = shardFor(sender_id);
+        auto now = Clock::now();
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        evict(shard,now);
+        Key key{sender_id,client_id};
+        auto it = shard.entries.find(key);
+        if (it!=shard.entries.end()){
+            existing_id = it->second.committed ? it->second.message_id : 0;
+            return false;
+        }
+        auto expire_at = now+ttl_;
+        shard.entries.emplace(key,Entry{message_id,false,expire_at});
+        shard.order.emplace_back(key,expire_at);
+        evict(shard,now);
+        return true;
+    }
+
+    void MessageDedupe::commit(int sender_id, uint64_t client_id) {
+        Shard& shard = shardFor(sender_id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.entries.find(Key{sender_id,client_id});
+        if (it!=shard.entries.end()) it->second.committed = true;
+    }
+
+    void MessageDedupe::release(int sender_id, uint64_t client_id) {
+        Shard& shard = shardFor(sender_id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.entries.erase(Key{sender_id,client_id});
+    }
+
+    size_t MessageDedupe::size() {
+        size_t total = 0;
+        for (auto& shard:shards_){
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            total += shard->entries.size();
+        }
+        return total;
+    }
+}
@@ -2,14 +2,48 @@
 // Created by Cando on 2026/1/30.
 //
 #include "../../include/business/message_handler.h"
-#include "../../include/network/socket.h"
-#include <mysql/mysql.h>
+#include "../../include/network/reactor.h"
+#include "../../include/common/id_generator.h"
+#include "../../include/database/blob_store.h"
+#include <algorithm>
+#include <cctype>
 #include <iostream>
+#include <stdexcept>
 
 namespace easychat{
+    // 单次增量同步最多涉及的会话数
+    static const int kMaxSyncConversations = 256;
+    // 单次搜索的默认与最大条数、摘要长度（字节）、回读候选的最大轮数
+    static const int kDefaultSearchLimit = 20;
+    static const int kMaxSearchLimit = 100;
+    static const size_t kSnippetBytes = 48;
+    static const int kMaxSearchRounds = 4;
+
+    // 截取关键词附近的摘要（ASCII不区分大小写查找，边界对齐到UTF-8字符）
+    static std::string_view makeSnippet(std::string_view content,const std::string& term){
+        std::string lowered(content);
+        std::transform(lowered.begin(),lowered.end(),lowered.begin(),[](unsigned char c){
+            return c<0x80 ? static_cast<char>(std::tolower(c)) : static_cast<char>(c);
+        });
+        size_t pos = lowered.find(term);
+        if (pos==std::string::npos) pos = 0;
+        size_t start = pos>kSnippetBytes/4 ? pos-kSnippetBytes/4 : 0;
+        while (start>0 && (static_cast<unsigned char>(content[start]) & 0xC0)==0x80) --start;
+        size_t end = std::min(content.size(),start+kSnippetBytes);
+        while (end<content.size() && end>start && (static_cast<unsigned char>(content[end]) & 0xC0)==0x80) --end;
+        return content.substr(start,end-start);
+    }
+
     MessageHandler::MessageHandler() :
-    conn_pool_(ConnectionPool::getInstance()),
-    user_manager_(UserManager::getInstance()){}
+    max_sync_delta_(500),
+    max_unacked_(1000),
+    max_parked_(10000),
+    cursor_grace_ms_(5000),
+    user_manager_(UserManager::getInstance()),
+    room_manager_(RoomManager::getInstance()),
+    conversation_index_(ConversationIndex::getInstance()),
+    inbox_index_(InboxIndex::getInstance()),
+    search_index_(SearchIndex::getInstance()){}
 
     MessageHandler::~MessageHandler() {}
 
@@ -18,146 +52,613 @@ namespace easychat{
         return instance;
     }
 
-    void MessageHandler::init() {
-        std::cout<<"MessageHandler initialized"<<std::endl;
+    void MessageHandler::init(std::shared_ptr<MessageStore> store,std::shared_ptr<MessageSpool> spool) {
+        store_ = std::move(store);
+        spool_ = std::move(spool);
+        delivery_writer_.init(store_);
+        receipt_batcher_.init(store_,[this](const std::vector<ReadReceipt>& receipts){forwardReceipts(receipts);});
+        std::cout<<"MessageHandler initialized, store: "<<store_->name()<<(spool_ ? ", spool enabled" : "")<<std::endl;
+    }
+
+    void MessageHandler::setMaxSyncDelta(int max_delta) {
+        max_sync_delta_ = std::max(max_delta,1);
+    }
+
+    void MessageHandler::configureDelivery(size_t max_unacked, size_t max_parked, int flush_interval_ms, size_t max_batch,
+                                           int cursor_grace_ms) {
+        max_unacked_ = std::max<size_t>(max_unacked,1);
+        max_parked_ = max_parked;
+        cursor_grace_ms_ = std::max(cursor_grace_ms,0);
+        delivery_writer_.start(flush_interval_ms,max_batch);
+        std::cout<<"Delivery acks configured, max unacked: "<<max_unacked_<<", flush interval: "<<flush_interval_ms
+        <<"ms, batch: "<<max_batch<<", cursor grace: "<<cursor_grace_ms_<<"ms"<<std::endl;
+    }
+
+    void MessageHandler::configureReceipts(int window_ms, size_t max_batch) {
+        receipt_batcher_.start(window_ms,max_batch);
+        std::cout<<"Read receipts configured, window: "<<window_ms<<"ms, batch: "<<max_batch<<std::endl;
+    }
+
+    void MessageHandler::configureDedupe(int ttl_ms, size_t max_entries) {
+        dedupe_.configure(ttl_ms,max_entries);
+        std::cout<<"Message dedupe configured, ttl: "<<ttl_ms<<"ms, max entries: "<<max_entries<<std::endl;
+    }
+
+    void MessageHandler::acknowledge(int user_id, const std::vector<int64_t> &message_ids) {
+        delivery_writer_.delivered(user_id,message_ids);
     }
 
-    bool MessageHandler::storeMessage(int sender_id, int receiver_id, const std::string &content, int message_type,
-                                      int is_offline) {
-        auto conn = conn_pool_.getConnection();
-        if (!conn || !conn->isConnected()) return false;
+    void MessageHandler::parkOutbox(int user_id, const std::string &device_id, int64_t watermark, int64_t pushed_id,
+                                    std::vector<std::pair<int64_t, SharedFrame>> &&frames) {
+        std::lock_guard<std::mutex> lock(cursor_mutex_);
+        auto key = std::make_pair(user_id,device_id);
+        // 暂存数已满时不再暂存，重连时由存储按游标补发
+        if (parked_outboxes_.size()>=max_parked_ && parked_outboxes_.find(key)==parked_outboxes_.end()) return;
+        parked_outboxes_[key] = ParkedOutbox{watermark,pushed_id,std::move(frames)};
+    }
+
+    void MessageHandler::dropExpired(const std::vector<int64_t> &message_ids) {
+        if (message_ids.empty()) return;
+        std::lock_guard<std::mutex> lock(cursor_mutex_);
+        for (auto& [key,parked]:parked_outboxes_){
+            auto& frames = parked.frames;
+            // 暂存帧按消息ID递增，大多只含近期消息，不会与过期消息重叠
+            if (frames.empty() || frames.front().first>message_ids.back()) continue;
+            frames.erase(std::remove_if(frames.begin(),frames.end(),[&message_ids](const auto& frame){
+                return std::binary_search(message_ids.begin(),message_ids.end(),frame.first);
+            }),frames.end());
+        }
+    }
 
-        std::string insert_sql = "insert into messages(sender_id,receiver_id,content,message_type,is_offline) values("
-                +std::to_string(sender_id)+", "+std::to_string(receiver_id)+", '"+content+"', "
-                +std::to_string(message_type)+", "+std::to_string(is_offline)+")";
-        if (!conn->execute(insert_sql)){
-            std::cerr<<"Failed to store message"<<std::endl;
-            conn_pool_.returnConnection(conn);
+    bool MessageHandler::loadConversationSeq(Conversation &conversation, int user_id1, int user_id2, int room_id) {
+        if (conversation.loaded) return true;
+        // 先取溢写区再查存储：期间回放完成的消息已在存储中，不会漏掉
+        int64_t spooled_seq = 0;
+        if (room_id==0 && spool_ && !spool_->pendingSeq(user_id1,user_id2,spooled_seq)) return false;
+        bool ok = room_id!=0 ? store_->getRoomSeq(room_id,conversation.last_seq)
+                             : store_->getConversationSeq(user_id1,user_id2,conversation.last_seq);
+        if (!ok){
+            std::cerr<<"Failed to load conversation sequence"<<std::endl;
             return false;
         }
-        conn_pool_.returnConnection(conn);
+        conversation.last_seq = std::max(conversation.last_seq,spooled_seq);
+        conversation.loaded = true;
         return true;
     }
 
-    bool MessageHandler::forwardMessage(int receiver_id, const easychat::Message &msg) {
-        // 获取接收者SocketFd
-        int socket_fd = user_manager_.getSocketFdByUserId(receiver_id);
-        if (socket_fd==-1) return false;
-        // 序列化消息
-        auto buffer = msg.serialize();
-        // 创造Socket对象并发送信息，不拥有文件描述符
-        Socket socket(socket_fd, false);
-        ssize_t bytes_sent = socket.send(buffer.data(),buffer.size());
+    bool MessageHandler::storeMessage(MessageInfo &msg_info) {
+        // 溢写区还有未回放的消息时，新消息也写入溢写区，保证回放顺序
+        if (spool_ && spool_->hasPending()){
+            return spool_->append(msg_info);
+        }
+        if (store_->storeMessage(msg_info)) return true;
+        if (spool_){
+            std::cerr<<"Store unavailable, spooling message "<<msg_info.id<<std::endl;
+            return spool_->append(msg_info);
+        }
+        std::cerr<<"Failed to store message "<<msg_info.id<<std::endl;
+        return false;
+    }
 
-        if(bytes_sent==-1){
-            std::cerr<<"Failed to forward message to user "<<receiver_id<<std::endl;
+    bool MessageHandler::forwardMessage(int receiver_id, ClientConnection &receiver, const SharedFrame &frame,
+                                        int64_t message_id) {
+        // 先记入未确认帧再发送，确认不会早于记录到达
+        if (!receiver.trackUnacked(message_id,frame,max_unacked_) || !receiver.sendFrame(frame)){
+            std::cerr<<"Failed to forward message to user "<<receiver_id<<", FD: "<<receiver.getFd()<<std::endl;
             return false;
         }
-        std::cout<<"Message forwarded to user "<<receiver_id<<",bytes sent: "<<bytes_sent<<std::endl;
         return true;
     }
-    bool MessageHandler::sendMessage(int sender_id, int receiver_id, const std::string &content, int message_type) {
-        // 检查接收者是否在线
-        bool is_online = user_manager_.isUserOnline(receiver_id);
+    bool MessageHandler::sendMessage(int sender_id, int receiver_id, const std::string &content, int message_type,
+                                     int64_t message_id) {
+        // 查找接收者所有在线设备：用户->句柄->连接，句柄代数不一致说明连接已关闭，跳过
+        DeviceHandles devices;
+        std::vector<std::shared_ptr<ClientConnection>> receivers;
+        if (user_manager_.getConnectionHandles(receiver_id,devices)){
+            for (size_t i=0;i<devices.count;++i){
+                if (auto conn = Reactor::getInstance().findConnection(devices.handles[i])){
+                    receivers.push_back(std::move(conn));
+                }
+            }
+        }
+        bool is_online = !receivers.empty();
+        // 写入内核缓冲区不等于送达，客户端确认后才批量标记为已投递
+        // 持久化之前分配消息ID，无需等待数据库返回
+        MessageInfo msg_info;
+        msg_info.id = message_id!=0 ? message_id : IdGenerator::getInstance().nextId();
+        msg_info.sender_id = sender_id;
+        msg_info.receiver_id = receiver_id;
+        msg_info.content = content;
+        msg_info.message_type = message_type;
+        msg_info.is_offline = 1;
+        msg_info.is_read = 0;
+        // 分配序号、存储、推送都在会话锁内完成，同一会话的消息按序号顺序存储和推送
+        auto conversation = conversation_index_.acquire(ConversationIndex::directKey(sender_id,receiver_id));
+        std::lock_guard<std::mutex> conversation_lock(conversation->mutex);
+        // 序号无法加载时（存储不可用）消息以序号0写入溢写区，回放时再分配序号，接收者通过同步获得
+        bool sequenced = loadConversationSeq(*conversation,sender_id,receiver_id,0);
+        if (!sequenced && !spool_) return false;
+        msg_info.seq = sequenced ? conversation->last_seq+1 : 0;
         // 存储消息
-        int is_offline = is_online ? 0 : 1 ;
-        if (!storeMessage(sender_id,receiver_id,content,message_type,is_offline)) return false;
-        // 接收者在线转发消息
+        if (!(sequenced ? storeMessage(msg_info) : spool_->append(msg_info))) return false;
+        if (sequenced){
+            conversation->last_seq = msg_info.seq;
+            conversation_index_.remember(*conversation,msg_info);
+        }
+        inbox_index_.onMessage(msg_info);
+        search_index_.add(msg_info);
+        {
+            std::lock_guard<std::mutex> lock(cursor_mutex_);
+            noteReceived(receiver_id,msg_info.id);
+        }
+        // 接收者在线：只序列化一次，所有设备共享同一帧
         if (is_online){
-            Message msg(MessageType::MSG_TYPE_CHAT,sender_id,content);
-            forwardMessage(receiver_id,msg);
+            SharedFrame frame = makeSharedFrame(Message(MessageType::MSG_TYPE_CHAT,sender_id,
+                                                        std::to_string(msg_info.id)+":"+std::to_string(msg_info.seq)+":"+content));
+            for (auto& receiver:receivers){
+                forwardMessage(receiver_id,*receiver,frame,msg_info.id);
+            }
+            std::cout<<"Message forwarded to user "<<receiver_id<<", devices: "<<receivers.size()<<std::endl;
         }else{
             std::cout<<"Message stored as offline for user "<<receiver_id<<std::endl;
         }
         return true;
     }
 
-    void MessageHandler::handleReceivedMessage(const easychat::Message &msg) {
+    bool MessageHandler::handleReceivedMessage(const easychat::Message &msg, std::string &receipt) {
         int sender_id = msg.getUserId();
-        std::string content = msg.getData();
+        const std::string& content = msg.getData();
 
-        // 解析消息内容
-        size_t colon_pos = content.find(':');
-        if (colon_pos==std::string::npos){
+        // 解析消息内容（可选的客户端消息ID前缀c<client_id>:）
+        size_t start = 0;
+        bool has_client_id = false;
+        uint64_t client_id = 0;
+        int receiver_id;
+        try {
+            if (!content.empty() && content[0]=='c'){
+                start = content.find(':');
+                if (start==std::string::npos) throw std::invalid_argument("client id");
+                client_id = std::stoull(content.substr(1,start-1));
+                has_client_id = true;
+                ++start;
+            }
+            size_t colon_pos = content.find(':',start);
+            if (colon_pos==std::string::npos) throw std::invalid_argument("receiver id");
+            receiver_id = std::stoi(content.substr(start,colon_pos-start));
+            start = colon_pos+1;
+        }catch (const std::exception& e){
             std::cerr<<"Invalid message format: "<<content<<std::endl;
-            return;
+            return false;
+        }
+        std::string message_content = content.substr(start);
+        int message_type = static_cast<int>(msg.getType());
+        int64_t message_id = IdGenerator::getInstance().nextId();
+        if (!has_client_id){
+            return referenceAttachment(message_content,message_id,sender_id,receiver_id,0,message_type) &&
+                   sendMessage(sender_id,receiver_id,message_content,message_type,message_id);
         }
-        int receiver_id = std::stoi(content.substr(0,colon_pos));
-        std::string message_content = content.substr(colon_pos+1);
 
-        // 发送消息
-        sendMessage(sender_id,receiver_id,message_content,static_cast<int>(msg.getType()));
+        // 先登记再存储，同一条消息的并发重发只有一个会被存储
+        int64_t existing_id = 0;
+        if (!dedupe_.claim(sender_id,client_id,message_id,existing_id)){
+            std::cout<<"Duplicate message "<<client_id<<" from user "<<sender_id<<", original: "<<existing_id<<std::endl;
+            if (existing_id==0) return false;
+            receipt = std::to_string(client_id)+":"+std::to_string(existing_id);
+            return true;
+        }
+        if (!referenceAttachment(message_content,message_id,sender_id,receiver_id,0,message_type) ||
+            !sendMessage(sender_id,receiver_id,message_content,message_type,message_id)){
+            dedupe_.release(sender_id,client_id);
+            return false;
+        }
+        dedupe_.commit(sender_id,client_id);
+        receipt = std::to_string(client_id)+":"+std::to_string(message_id);
+        return true;
     }
+    bool MessageHandler::referenceAttachment(std::string_view content, int64_t message_id, int sender_id,
+                                             int receiver_id, int room_id, int &message_type) {
+        // 附件引用（image:/file:哈希:字节数:文件名）：附件必须已上传完成且发送者有权访问，消息只保存引用；
+        // 先记录引用再推送，接收者收到消息后即可下载
+        std::string sha256;
+        uint64_t blob_size;
+        int attachment_type;
+        if (!BlobStore::parseReference(content,sha256,blob_size,attachment_type)) return true;
+        if (!BlobStore::getInstance().addReference(sha256,blob_size,message_id,sender_id,receiver_id,room_id)){
+            std::cerr<<"Attachment not available to user "<<sender_id<<": "<<sha256<<std::endl;
+            return false;
+        }
+        message_type = attachment_type;
+        return true;
+    }
+
+    bool MessageHandler::sendRoomMessage(int sender_id, int room_id, const std::string &content, int message_type,
+                                         int64_t message_id) {
+        RoomMembers members = room_manager_.getMembers(room_id);
+        if (!members || !room_manager_.isMember(room_id,sender_id)){
+            std::cerr<<"User "<<sender_id<<" is not a member of room "<<room_id<<std::endl;
+            return false;
+        }
+        // 每条群聊消息只存一行，离线成员上线时按设备游标补发
+        MessageInfo msg_info;
+        msg_info.id = message_id!=0 ? message_id : IdGenerator::getInstance().nextId();
+        msg_info.sender_id = sender_id;
+        msg_info.receiver_id = room_id;
+        msg_info.content = content;
+        msg_info.message_type = message_type;
+        msg_info.is_offline = 0;
+        msg_info.is_read = 0;
+        auto conversation = conversation_index_.acquire(ConversationIndex::roomKey(room_id));
+        std::lock_guard<std::mutex> conversation_lock(conversation->mutex);
+        if (!loadConversationSeq(*conversation,0,0,room_id)) return false;
+        msg_info.seq = conversation->last_seq+1;
+        if (!store_->storeRoomMessage(msg_info)){
+            std::cerr<<"Failed to store room message "<<msg_info.id<<std::endl;
+            return false;
+        }
+        conversation->last_seq = msg_info.seq;
+        conversation_index_.remember(*conversation,msg_info);
+        {
+            // 会话恢复时据此判断成员是否需要同步
+            std::lock_guard<std::mutex> lock(cursor_mutex_);
+            for (const auto& member:*members){
+                if (member.user_id==sender_id) continue;
+                noteReceived(member.user_id,msg_info.id);
+            }
+        }
+        // 只序列化一次，所有成员的所有设备共享同一帧（发送队列中只持有引用）
+        SharedFrame frame = makeSharedFrame(Message(MessageType::MSG_TYPE_ROOM_CHAT,sender_id,
+                                                    std::to_string(room_id)+":"+std::to_string(msg_info.id)+":"+
+                                                    std::to_string(msg_info.seq)+":"+content));
+        size_t delivered = 0;
+        DeviceHandles devices;
+        for (const auto& member:*members){
+            if (member.user_id==sender_id) continue;
+            if (!user_manager_.getConnectionHandles(member.user_id,devices)) continue;
+            for (size_t i=0;i<devices.count;++i){
+                if (auto conn = Reactor::getInstance().findConnection(devices.handles[i])){
+                    if (forwardMessage(member.user_id,*conn,frame,msg_info.id)) ++delivered;
+                }
+            }
+        }
+        std::cout<<"Room message "<<msg_info.id<<" fanned out to room "<<room_id<<", members: "<<members->size()
+        <<", devices: "<<delivered<<std::endl;
+        return true;
+    }
+
+    bool MessageHandler::handleRoomMessage(int sender_id, const Message &msg) {
+        const std::string& data = msg.getData();
+        size_t colon_pos = data.find(':');
+        if (colon_pos==std::string::npos){
+            std::cerr<<"Invalid room message format: "<<data<<std::endl;
+            return false;
+        }
+        int room_id;
+        try {
+            room_id = std::stoi(data.substr(0,colon_pos));
+        }catch (const std::exception& e){
+            std::cerr<<"Invalid room id: "<<data.substr(0,colon_pos)<<std::endl;
+            return false;
+        }
+        // 非成员不能记录引用，附件只对房间成员开放
+        if (!room_manager_.isMember(room_id,sender_id)){
+            std::cerr<<"User "<<sender_id<<" is not a member of room "<<room_id<<std::endl;
+            return false;
+        }
+        int64_t message_id = IdGenerator::getInstance().nextId();
+        int message_type = 0;
+        if (!referenceAttachment(std::string_view(data).substr(colon_pos+1),message_id,sender_id,0,room_id,message_type)){
+            return false;
+        }
+        return sendRoomMessage(sender_id,room_id,data.substr(colon_pos+1),message_type,message_id);
+    }
+
+    void MessageHandler::syncConversations(int user_id, const std::string &request, FrameWriter &writer) {
+        std::string summary;
+        int count = 0;
+        size_t pos = 0;
+        while (pos<request.size() && count<kMaxSyncConversations){
+            size_t end = request.find(',',pos);
+            if (end==std::string::npos) end = request.size();
+            // 每一项格式：u<ID>=seq或r<ID>=seq
+            std::string item = request.substr(pos,end-pos);
+            pos = end+1;
+            size_t eq_pos = item.find('=');
+            if (item.size()<4 || (item[0]!='u' && item[0]!='r') || eq_pos==std::string::npos) continue;
+            int target_id;
+            int64_t after_seq;
+            try {
+                target_id = std::stoi(item.substr(1,eq_pos-1));
+                after_seq = std::stoll(item.substr(eq_pos+1));
+            }catch (const std::exception& e){
+                continue;
+            }
+            if (target_id<=0) continue;
+            ++count;
+            if (!syncConversation(user_id,item[0],target_id,std::max<int64_t>(after_seq,0),writer,summary)){
+                std::cerr<<"Failed to sync conversation "<<item<<" for user "<<user_id<<std::endl;
+            }
+        }
+        writer.beginFrame(MessageType::MSG_TYPE_SYNC,static_cast<uint32_t>(user_id));
+        writer.append(summary);
+        writer.endFrame();
+    }
+
+    bool MessageHandler::syncConversation(int user_id, char kind, int target_id, int64_t after_seq,
+                                          FrameWriter &writer, std::string &summary) {
+        bool is_room = kind=='r';
+        int64_t after_id = 0;
+        if (is_room){
+            // 只有成员可以同步群聊，且只返回加入之后的消息
+            RoomMembers members = room_manager_.getMembers(target_id);
+            if (!members) return false;
+            auto it = std::lower_bound(members->begin(),members->end(),user_id,
+                                       [](const RoomMember& member,int id){return member.user_id<id;});
+            if (it==members->end() || it->user_id!=user_id) return false;
+            after_id = it->joined_message_id;
+        }
+        std::string prefix = kind+std::to_string(target_id)+":";
+        size_t frames_before = writer.frameCount();
+        int64_t latest;
+        int64_t last_sent = after_seq;
+        bool served;
+        {
+            auto conversation = conversation_index_.acquire(is_room ? ConversationIndex::roomKey(target_id)
+                                                                    : ConversationIndex::directKey(user_id,target_id));
+            std::lock_guard<std::mutex> conversation_lock(conversation->mutex);
+            if (!loadConversationSeq(*conversation,user_id,target_id,is_room ? target_id : 0)) return false;
+            latest = conversation->last_seq;
+            served = conversation_index_.writeRecent(*conversation,after_seq,after_id,max_sync_delta_,prefix,writer,last_sent);
+        }
+        if (!served){
+            // 缺口超出近期消息范围，在会话锁外回源存储（序号不超过latest的消息都已存储）
+            bool ok = is_room ? store_->writeRoomSince(target_id,after_seq,after_id,max_sync_delta_,prefix,writer,last_sent)
+                              : store_->writeConversationSince(user_id,target_id,after_seq,max_sync_delta_,prefix,writer,last_sent);
+            if (!ok) return false;
+        }
+        // 未达到单次上限说明已同步到最新
+        if (writer.frameCount()-frames_before<static_cast<size_t>(max_sync_delta_)){
+            last_sent = std::max(last_sent,latest);
+        }
+        if (!summary.empty()) summary += ",";
+        summary += prefix.substr(0,prefix.size()-1)+"="+std::to_string(last_sent)+":"+std::to_string(std::max(latest,last_sent));
+        return true;
+    }
+
     bool MessageHandler::getOfflineMessage(int user_id, std::vector<MessageInfo> &messages) {
-        auto conn = conn_pool_.getConnection();
-        if (!conn || !conn->isConnected()) return false;
-
-        std::string query_sql = "select id,sender_id,receiver_id,content,message_type,is_offline,is_read,created_at "
-                                "from messages where receiver_id="+std::to_string(user_id)+" and is_offline=1 order by created_at asc";
-        MYSQL_RES* result = conn->query(query_sql);
-        if (!result) {
-            conn_pool_.returnConnection(conn);
+        return store_->fetchOfflineMessages(user_id,messages);
+    }
+
+    bool MessageHandler::hasUnsyncedMessages(int user_id, const std::string &device_id) {
+        std::lock_guard<std::mutex> lock(cursor_mutex_);
+        auto key = std::make_pair(user_id,device_id);
+        if (parked_outboxes_.count(key)) return true;
+        auto cursor_it = device_cursors_.find(key);
+        if (cursor_it==device_cursors_.end()) return true;
+        auto latest_it = latest_received_.find(user_id);
+        return latest_it!=latest_received_.end() && latest_it->second>cursor_it->second;
+    }
+
+    void MessageHandler::noteReceived(int user_id, int64_t message_id) {
+        // ID较小的消息可能晚于较大的消息写入：此时让最大ID前进一位，使游标与暂存帧判定为有新消息，由存储补发
+        int64_t& latest = latest_received_[user_id];
+        latest = message_id>latest ? message_id : latest+1;
+    }
+
+    int64_t MessageHandler::syncFloor(int64_t cursor) const {
+        if (cursor<=0 || cursor_grace_ms_==0) return cursor;
+        return std::min(cursor,IdGenerator::minIdForTimestamp(IdGenerator::extractTimestamp(cursor)-cursor_grace_ms_));
+    }
+
+    bool MessageHandler::syncDevice(int user_id, const std::string &device_id, FrameWriter &writer, int64_t &from,
+                                    int64_t &cursor, std::vector<std::pair<int64_t, SharedFrame>> &retransmit) {
+        auto key = std::make_pair(user_id,device_id);
+        bool known = false;
+        {
+            std::lock_guard<std::mutex> lock(cursor_mutex_);
+            auto it = device_cursors_.find(key);
+            if (it!=device_cursors_.end()){
+                cursor = it->second;
+                known = true;
+            }
+            auto parked_it = parked_outboxes_.find(key);
+            if (parked_it!=parked_outboxes_.end()){
+                ParkedOutbox parked = std::move(parked_it->second);
+                parked_outboxes_.erase(parked_it);
+                // 游标之后的消息都推送给了上一个连接（其中未确认的都在暂存帧中），直接重发，不访问存储
+                auto latest_it = latest_received_.find(user_id);
+                int64_t latest = latest_it!=latest_received_.end() ? latest_it->second : 0;
+                if (known && cursor==parked.watermark && latest<=parked.pushed_id){
+                    from = cursor;
+                    cursor = parked.pushed_id;
+                    retransmit = std::move(parked.frames);
+                    return true;
+                }
+            }
+        }
+        if (!known && !store_->getDeviceCursor(user_id,device_id,cursor,known)){
+            // 存储出错时不能当作新设备处理（会跳过游标之后已投递给其他设备的消息），本次不同步，下次上线再补发
+            std::cerr<<"Failed to load cursor for user "<<user_id<<", device "<<device_id<<std::endl;
             return false;
         }
-        MYSQL_ROW row;
-        while ((row= mysql_fetch_row(result))!= nullptr){
-            MessageInfo msg_info;
-            msg_info.id = std::stoi(row[0]);
-            msg_info.sender_id = std::stoi(row[1]);
-            msg_info.receiver_id = std::stoi(row[2]);
-            msg_info.content = row[3];
-            msg_info.message_type = std::stoi(row[4]);
-            msg_info.is_offline = std::stoi(row[5]);
-            msg_info.is_read = std::stoi(row[6]);
-            messages.push_back(msg_info);
-        }
-        mysql_free_result(result);
-
-        // 标记离线消息为已读
-        std::string update_sql = "update messages set is_offline=0,is_read=1 where receiver_id= "
-                +std::to_string(user_id)+" and is_offline=1";
-        conn->execute(update_sql);
-
-        conn_pool_.returnConnection(conn);
+        int64_t synced = 0;
+        int64_t room_after = 0;
+        if (known){
+            // 补发游标之后的所有消息（包括该设备离线期间投递给其他设备的消息）；
+            // 游标之前回看窗口内的消息也补发，覆盖ID小于游标但在游标保存后才写入的消息
+            synced = cursor;
+            room_after = syncFloor(cursor);
+            if (!store_->writeMessagesSince(user_id,room_after,writer,synced)) return false;
+        }else{
+            // 新设备：只补发离线消息，之前的消息通过聊天记录查看
+            if (!store_->writeOfflineMessages(user_id,writer)) return false;
+            // 群聊消息不按成员标记离线，从该用户其他设备收到的位置之后补发
+            if (store_->getUserCursor(user_id,room_after)) room_after = syncFloor(room_after);
+            synced = IdGenerator::getInstance().nextId();
+        }
+        // 所在房间的群聊消息（不早于加入房间的位置）
+        std::vector<std::pair<int,int64_t>> rooms;
+        room_manager_.getUserRooms(user_id,rooms);
+        for (const auto& [room_id,joined_message_id]:rooms){
+            if (!store_->writeRoomMessagesSince(room_id,std::max(room_after,joined_message_id),writer,synced)) return false;
+        }
+        // 游标在客户端确认后、下线时保存
+        from = known ? cursor : 0;
+        cursor = synced;
         return true;
     }
 
-    bool MessageHandler::markMessageAsRead(int message_id) {
-        auto conn = conn_pool_.getConnection();
-        if (!conn || !conn->isConnected()) return false;
+    void MessageHandler::saveDeviceCursor(int user_id, const std::string &device_id, int64_t message_id) {
+        {
+            std::lock_guard<std::mutex> lock(cursor_mutex_);
+            auto key = std::make_pair(user_id,device_id);
+            auto it = device_cursors_.find(key);
+            if (it!=device_cursors_.end() && it->second>=message_id) return;
+            device_cursors_[key] = message_id;
+        }
+        if (!store_->updateDeviceCursor(user_id,device_id,message_id)){
+            std::cerr<<"Failed to save cursor for user "<<user_id<<", device "<<device_id<<std::endl;
+        }
+    }
 
-        std::string update_sql = "update messages set is_read = 1 where id= "+std::to_string(message_id);
-        bool result = conn->execute(update_sql);
-        conn_pool_.returnConnection(conn);
-        return result;
+    bool MessageHandler::writeOfflineMessages(int user_id, FrameWriter &writer) {
+        return store_->writeOfflineMessages(user_id,writer);
     }
-    bool MessageHandler::getChatHistory(int user_id1, int user_id2, std::vector<MessageInfo> &messages, int limit) {
-        auto conn = conn_pool_.getConnection();
-        if (!conn || !conn->isConnected()) return false;
-        std::string query_sql = "select id,sender_id,receiver_id,content,message_type,is_offline,is_read,created_at "
-                                "from messages where (sender_id="+std::to_string(user_id1)+" and receiver_id = "+std::to_string(user_id2)+") "
-                                "or (sender_id="+std::to_string(user_id2)+" and receiver_id = "+std::to_string(user_id1)+") "
-                                "order by created_at desc limit "+std::to_string(limit);
-        MYSQL_RES *result = conn->query(query_sql);
-        if (!result) {
-            conn_pool_.returnConnection(conn);
+
+    bool MessageHandler::writeChatHistory(int user_id1, int user_id2, int limit, FrameWriter &writer) {
+        // 最近一页完全落在内存中的近期消息内时直接返回，否则回源存储（不为冷会话创建缓存条目）
+        if (auto conversation = conversation_index_.find(ConversationIndex::directKey(user_id1,user_id2))){
+            std::lock_guard<std::mutex> conversation_lock(conversation->mutex);
+            if (conversation_index_.writeHistory(*conversation,limit,writer)) return true;
+        }
+        return store_->writeChatHistory(user_id1,user_id2,limit,writer);
+    }
+
+    bool MessageHandler::writeInbox(int user_id, int limit, FrameWriter &writer) {
+        auto inbox = inbox_index_.acquire(user_id);
+        std::unique_lock<std::mutex> inbox_lock(inbox->mutex);
+        if (!inbox->loaded){
+            // 读取存储时不持有收件箱锁，期间到达的新消息与回执暂存，不被阻塞
+            inbox_index_.beginLoad(*inbox);
+            inbox_lock.unlock();
+            std::vector<InboxEntry> entries;
+            bool ok = store_->loadInbox(user_id,entries);
+            inbox_lock.lock();
+            if (!ok){
+                inbox_index_.abortLoad(*inbox);
+                std::cerr<<"Failed to load inbox for user "<<user_id<<std::endl;
+                return false;
+            }
+            if (!inbox_index_.load(*inbox,entries)){
+                // 暂存的更新已丢弃，只用本次读到的数据应答，下次查询重新加载
+                Inbox snapshot;
+                inbox_index_.beginLoad(snapshot);
+                inbox_index_.load(snapshot,entries);
+                inbox_index_.writeTop(snapshot,limit,writer);
+                return true;
+            }
+        }
+        inbox_index_.writeTop(*inbox,limit,writer);
+        return true;
+    }
+
+    bool MessageHandler::writeSearch(int user_id, const std::string &data, FrameWriter &writer) {
+        size_t first = data.find(':');
+        size_t second = first==std::string::npos ? std::string::npos : data.find(':',first+1);
+        if (second==std::string::npos) return false;
+        int limit;
+        int64_t before_id;
+        try {
+            limit = first==0 ? kDefaultSearchLimit : std::stoi(data.substr(0,first));
+            before_id = second==first+1 ? 0 : std::stoll(data.substr(first+1,second-first-1));
+        }catch (const std::exception& e){
             return false;
         }
-        MYSQL_ROW row;
-        while ((row= mysql_fetch_row(result))!= nullptr){
-            MessageInfo msg_info;
-            msg_info.id = std::stoi(row[0]);
-            msg_info.sender_id = std::stoi(row[1]);
-            msg_info.receiver_id = std::stoi(row[2]);
-            msg_info.content = row[3];
-            msg_info.message_type = std::stoi(row[4]);
-            msg_info.is_offline = std::stoi(row[5]);
-            msg_info.is_read = std::stoi(row[6]);
-            msg_info.created_at = row[7];
-            messages.push_back(msg_info);
-        }
-        mysql_free_result(result);
-        conn_pool_.returnConnection(conn);
+        limit = std::max(1,std::min(limit,kMaxSearchLimit));
+        std::vector<std::string> terms;
+        SearchIndex::tokenize(std::string_view(data).substr(second+1),terms);
+        if (terms.empty()) return true;
+        // 候选只按词项哈希求交，回读正文确认属于该用户且包含全部词项；不足时继续向更早的候选查找
+        int written = 0;
+        std::vector<int64_t> candidates;
+        std::vector<MessageInfo> messages;
+        std::vector<std::string> content_terms;
+        for (int round=0;round<kMaxSearchRounds && written<limit;++round){
+            candidates.clear();
+            search_index_.search(user_id,terms,static_cast<size_t>(limit-written)*2,before_id,candidates);
+            if (candidates.empty()) break;
+            before_id = candidates.back();
+            messages.clear();
+            if (!store_->getMessagesByIds(candidates,messages)) return false;
+            std::sort(messages.begin(),messages.end(),[](const MessageInfo& a,const MessageInfo& b){return a.id>b.id;});
+            for (const auto& message:messages){
+                if (written>=limit) break;
+                if (message.sender_id!=user_id && message.receiver_id!=user_id) continue;
+                content_terms.clear();
+                SearchIndex::tokenize(message.content,content_terms);
+                bool matched = std::all_of(terms.begin(),terms.end(),[&](const std::string& term){
+                    return std::binary_search(content_terms.begin(),content_terms.end(),term);
+                });
+                if (!matched) continue;
+                std::string_view snippet = makeSnippet(message.content,terms.front());
+                if (written>0) writer.append('|');
+                writer.appendInt(message.id);
+                writer.append(':');
+                writer.appendInt(message.sender_id==user_id ? message.receiver_id : message.sender_id);
+                writer.append(':');
+                writer.appendInt(message.sender_id);
+                writer.append(':');
+                writer.appendInt(static_cast<int64_t>(snippet.size()));
+                writer.append(':');
+                writer.append(snippet);
+                ++written;
+            }
+        }
+        return true;
+    }
+
+    bool MessageHandler::handleReadReceipt(int reader_id, const std::string &data) {
+        size_t colon_pos = data.find(':');
+        if (colon_pos==std::string::npos) return false;
+        int peer_id;
+        int64_t seq;
+        try {
+            peer_id = std::stoi(data.substr(0,colon_pos));
+            seq = std::stoll(data.substr(colon_pos+1));
+        }catch (const std::exception& e){
+            std::cerr<<"Invalid read receipt: "<<data<<std::endl;
+            return false;
+        }
+        if (peer_id<=0 || peer_id==reader_id) return false;
+        {
+            // 不能标记尚不存在的消息为已读
+            auto conversation = conversation_index_.acquire(ConversationIndex::directKey(reader_id,peer_id));
+            std::lock_guard<std::mutex> conversation_lock(conversation->mutex);
+            if (!loadConversationSeq(*conversation,reader_id,peer_id,0)) return false;
+            seq = std::min(seq,conversation->last_seq);
+            // 已读位置只前进，过期回执不再写入和转发
+            int64_t& read_seq = conversation->read_seq[reader_id<peer_id ? 0 : 1];
+            if (seq<=read_seq) return true;
+            read_seq = seq;
+            inbox_index_.onRead(reader_id,peer_id,seq);
+        }
+        receipt_batcher_.read(reader_id,peer_id,seq);
         return true;
     }
-}
\ No newline at end of file
+
+    void MessageHandler::forwardReceipts(const std::vector<ReadReceipt> &receipts) {
+        DeviceHandles devices;
+        for (const auto& receipt:receipts){
+            if (!user_manager_.getConnectionHandles(receipt.peer_id,devices)) continue;
+            SharedFrame frame = makeSharedFrame(Message(MessageType::MSG_TYPE_READ,receipt.reader_id,
+                                                        std::to_string(receipt.reader_id)+":"+std::to_string(receipt.seq)));
+            for (size_t i=0;i<devices.count;++i){
+                if (auto conn = Reactor::getInstance().findConnection(devices.handles[i])){
+                    conn->sendFrame(frame);
+                }
+            }
+        }
+    }
+    bool MessageHandler::getChatHistory(int user_id1, int user_id2, std::vector<MessageInfo> &messages, int limit) {
+        return store_->getChatHistory(user_id1,user_id2,messages,limit);
+    }
+}
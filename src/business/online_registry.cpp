@@ -0,0 +1,289 @@
+//
+// Created by Cando on 2026/10/19.
+//
+#include "../../include/business/online_registry.h"
+#include <algorithm>
+#include <limits>
+
+namespace easychat{
+    namespace {
+        size_t roundUpPowerOfTwo(size_t value){
+            size_t result = 1;
+            while (result<value) result <<= 1;
+            return result;
+        }
+        std::atomic<uint64_t> next_instance_id{1};
+    }
+
+    OnlineRegistry::Table::Table(size_t capacity_value)
+    :capacity(capacity_value),used(0),slots(new Slot[capacity_value]){
+        for (size_t i=0;i<capacity;++i){
+            slots[i].key.store(kEmptyKey,std::memory_order_relaxed);
+            for (auto& device:slots[i].devices){
+                device.store(0,std::memory_order_relaxed);
+            }
+        }
+    }
+
+    OnlineRegistry::OnlineRegistry(size_t shard_count, size_t initial_capacity)
+    :shards_(new Shard[shard_count==0 ? 1 : shard_count]),shard_count_(shard_count==0 ? 1 : shard_count),
+    min_capacity_(roundUpPowerOfTwo(initial_capacity<8 ? 8 : initial_capacity)),online_count_(0),
+    instance_id_(next_instance_id.fetch_add(1,std::memory_order_relaxed)),epoch_(1),readers_(nullptr),retired_count_(0){
+        for (size_t i=0;i<shard_count_;++i){
+            shards_[i].owned = std::make_unique<Table>(min_capacity_);
+            shards_[i].table.store(shards_[i].owned.get(),std::memory_order_seq_cst);
+        }
+    }
+
+    OnlineRegistry::~OnlineRegistry() {
+        ReaderRecord* record = readers_.load(std::memory_order_acquire);
+        while (record!= nullptr){
+            ReaderRecord* next = record->next;
+            delete record;
+            record = next;
+        }
+    }
+
+    OnlineRegistry::ReaderRecord *OnlineRegistry::readerRecord() const {
+        thread_local uint64_t cached_instance = 0;
+        thread_local ReaderRecord* cached_record = nullptr;
+        if (cached_instance==instance_id_) return cached_record;
+        // 同一线程交替访问多个注册表时复用已登记的记录
+        std::thread::id self = std::this_thread::get_id();
+        ReaderRecord* record = readers_.load(std::memory_order_acquire);
+        while (record!= nullptr && record->owner!=self) record = record->next;
+        if (record== nullptr){
+            record = new ReaderRecord;
+            record->owner = self;
+            record->next = readers_.load(std::memory_order_relaxed);
+            while (!readers_.compare_exchange_weak(record->next,record,std::memory_order_release,std::memory_order_relaxed)){}
+        }
+        cached_instance = instance_id_;
+        cached_record = record;
+        return record;
+    }
+
+    OnlineRegistry::ReadGuard::ReadGuard(const OnlineRegistry &registry) :record_(registry.readerRecord()){
+        // 先公布纪元再读取表指针：写者看不到该纪元时，本次读取一定看到的是之后发布的新表
+        record_->epoch.store(registry.epoch_.load(std::memory_order_seq_cst),std::memory_order_seq_cst);
+    }
+
+    OnlineRegistry::ReadGuard::~ReadGuard() {
+        record_->epoch.store(0,std::memory_order_release);
+    }
+
+    void OnlineRegistry::retire(std::unique_ptr<Table> table) {
+        std::lock_guard<std::mutex> lock(retired_mutex_);
+        // 新表已发布；纪元不超过退休纪元的读者可能仍在读旧表
+        uint64_t epoch = epoch_.fetch_add(1,std::memory_order_seq_cst);
+        retired_.emplace_back(epoch,std::move(table));
+        retired_count_.store(retired_.size(),std::memory_order_relaxed);
+        reclaim();
+    }
+
+    void OnlineRegistry::reclaim() {
+        uint64_t min_active = std::numeric_limits<uint64_t>::max();
+        for (ReaderRecord* record = readers_.load(std::memory_order_acquire);record!= nullptr;record = record->next){
+            uint64_t epoch = record->epoch.load(std::memory_order_seq_cst);
+            if (epoch!=0) min_active = std::min(min_active,epoch);
+        }
+        retired_.erase(std::remove_if(retired_.begin(),retired_.end(),[min_active](const auto& entry){
+            return entry.first<min_active;
+        }),retired_.end());
+        retired_count_.store(retired_.size(),std::memory_order_relaxed);
+    }
+
+    size_t OnlineRegistry::hashOf(int user_id) {
+        // 整数混洗，避免连续用户ID聚集在相邻槽位
+        uint64_t x = static_cast<uint32_t>(user_id);
+        x ^= x>>16;
+        x *= 0x45d9f3bULL;
+        x ^= x>>16;
+        x *= 0x45d9f3bULL;
+        x ^= x>>16;
+        return static_cast<size_t>(x);
+    }
+
+    OnlineRegistry::Shard &OnlineRegistry::shardFor(int user_id) const {
+        return shards_[static_cast<uint32_t>(user_id)%shard_count_];
+    }
+
+    OnlineRegistry::Slot *OnlineRegistry::findSlot(Table *table, int user_id) {
+        size_t mask = table->capacity-1;
+        size_t index = hashOf(user_id)&mask;
+        // 键只会从空变为某个用户ID，遇到空槽即可确定不存在
+        for (size_t probe=0;probe<table->capacity;++probe){
+            Slot& slot = table->slots[(index+probe)&mask];
+            int64_t key = slot.key.load(std::memory_order_acquire);
+            if (key==user_id) return &slot;
+            if (key==kEmptyKey) return nullptr;
+        }
+        return nullptr;
+    }
+
+    size_t OnlineRegistry::deviceCount(const Slot &slot) {
+        size_t count = 0;
+        for (const auto& device:slot.devices){
+            if (device.load(std::memory_order_relaxed)!=0) ++count;
+        }
+        return count;
+    }
+
+    bool OnlineRegistry::lookup(int user_id, DeviceHandles &devices) const {
+        devices.count = 0;
+        ReadGuard guard(*this);
+        Table* table = shardFor(user_id).table.load(std::memory_order_seq_cst);
+        Slot* slot = findSlot(table,user_id);
+        if (slot== nullptr) return false;
+        for (const auto& device:slot->devices){
+            uint64_t value = device.load(std::memory_order_acquire);
+            if (value!=0) devices.handles[devices.count++] = ConnectionHandle::unpack(value);
+        }
+        return devices.count>0;
+    }
+
+    bool OnlineRegistry::lookup(int user_id, ConnectionHandle &handle) const {
+        ReadGuard guard(*this);
+        Table* table = shardFor(user_id).table.load(std::memory_order_seq_cst);
+        Slot* slot = findSlot(table,user_id);
+        if (slot== nullptr) return false;
+        for (const auto& device:slot->devices){
+            uint64_t value = device.load(std::memory_order_acquire);
+            if (value!=0){
+                handle = ConnectionHandle::unpack(value);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool OnlineRegistry::isOnline(int user_id) const {
+        ConnectionHandle handle;
+        return lookup(user_id,handle);
+    }
+
+    OnlineRegistry::Table *OnlineRegistry::rebuild(Shard &shard, Table *table) {
+        // 只迁移在线用户；新表的负载因子不超过1/4，在线数减少后表随之缩小
+        size_t live = 1;
+        for (size_t i=0;i<table->capacity;++i){
+            if (table->slots[i].key.load(std::memory_order_relaxed)!=kEmptyKey && deviceCount(table->slots[i])>0) ++live;
+        }
+        auto rebuilt = std::make_unique<Table>(std::max(min_capacity_,roundUpPowerOfTwo(live*4)));
+        size_t mask = rebuilt->capacity-1;
+        for (size_t i=0;i<table->capacity;++i){
+            int64_t key = table->slots[i].key.load(std::memory_order_relaxed);
+            // 已离线的用户不迁移
+            if (key==kEmptyKey || deviceCount(table->slots[i])==0) continue;
+            size_t index = hashOf(static_cast<int>(key))&mask;
+            while (rebuilt->slots[index].key.load(std::memory_order_relaxed)!=kEmptyKey){
+                index = (index+1)&mask;
+            }
+            for (size_t d=0;d<DeviceHandles::kMaxDevices;++d){
+                rebuilt->slots[index].devices[d].store(table->slots[i].devices[d].load(std::memory_order_relaxed),
+                                                       std::memory_order_relaxed);
+            }
+            rebuilt->slots[index].key.store(key,std::memory_order_relaxed);
+            ++rebuilt->used;
+        }
+        Table* result = rebuilt.get();
+        // 发布新表，之后的读者看到完整内容；旧表等读者离开后释放
+        shard.table.store(result,std::memory_order_seq_cst);
+        std::unique_ptr<Table> old = std::move(shard.owned);
+        shard.owned = std::move(rebuilt);
+        retire(std::move(old));
+        return result;
+    }
+
+    bool OnlineRegistry::add(int user_id, const ConnectionHandle &handle) {
+        if (!handle.valid()) return false;
+        Shard& shard = shardFor(user_id);
+        std::lock_guard<std::mutex> lock(shard.write_mutex);
+        Table* table = shard.table.load(std::memory_order_relaxed);
+        Slot* slot = findSlot(table,user_id);
+        if (slot!= nullptr){
+            std::atomic<uint64_t>* free_device = nullptr;
+            for (auto& device:slot->devices){
+                uint64_t value = device.load(std::memory_order_relaxed);
+                if (value==handle.pack()) return true;
+                if (value==0 && free_device== nullptr) free_device = &device;
+            }
+            if (free_device== nullptr) return false;
+            if (deviceCount(*slot)==0){
+                online_count_.fetch_add(1,std::memory_order_relaxed);
+            }
+            free_device->store(handle.pack(),std::memory_order_release);
+            return true;
+        }
+        // 占用的槽超过一半时按在线数重建
+        if ((table->used+1)*2>table->capacity){
+            table = rebuild(shard,table);
+        }
+        size_t mask = table->capacity-1;
+        size_t index = hashOf(user_id)&mask;
+        while (table->slots[index].key.load(std::memory_order_relaxed)!=kEmptyKey){
+            index = (index+1)&mask;
+        }
+        // 先写值再发布键，读者看到键时值已就绪
+        table->slots[index].devices[0].store(handle.pack(),std::memory_order_relaxed);
+        table->slots[index].key.store(user_id,std::memory_order_release);
+        ++table->used;
+        online_count_.fetch_add(1,std::memory_order_relaxed);
+        return true;
+    }
+
+    bool OnlineRegistry::remove(int user_id, const ConnectionHandle &handle, bool *now_offline) {
+        Shard& shard = shardFor(user_id);
+        std::lock_guard<std::mutex> lock(shard.write_mutex);
+        Slot* slot = findSlot(shard.table.load(std::memory_order_relaxed),user_id);
+        if (slot== nullptr || deviceCount(*slot)==0){
+            if (now_offline) *now_offline = true;
+            return false;
+        }
+        bool removed = false;
+        for (auto& device:slot->devices){
+            uint64_t value = device.load(std::memory_order_relaxed);
+            if (value!=0 && (!handle.valid() || value==handle.pack())){
+                device.store(0,std::memory_order_release);
+                removed = true;
+            }
+        }
+        bool offline = deviceCount(*slot)==0;
+        if (removed && offline){
+            online_count_.fetch_sub(1,std::memory_order_relaxed);
+        }
+        if (now_offline) *now_offline = offline;
+        // 上次退休时仍有读者停留的旧表，在之后的写操作中释放
+        if (retired_count_.load(std::memory_order_relaxed)>0){
+            std::lock_guard<std::mutex> retired_lock(retired_mutex_);
+            reclaim();
+        }
+        return removed;
+    }
+
+    void OnlineRegistry::snapshot(std::vector<int> &user_ids) const {
+        user_ids.reserve(user_ids.size()+size());
+        ReadGuard guard(*this);
+        for (size_t i=0;i<shard_count_;++i){
+            Table* table = shards_[i].table.load(std::memory_order_seq_cst);
+            for (size_t j=0;j<table->capacity;++j){
+                int64_t key = table->slots[j].key.load(std::memory_order_acquire);
+                if (key==kEmptyKey) continue;
+                if (deviceCount(table->slots[j])>0) user_ids.push_back(static_cast<int>(key));
+            }
+        }
+    }
+
+    void OnlineRegistry::snapshotShard(size_t shard, std::vector<ConnectionHandle> &handles) const {
+        if (shard>=shard_count_) return;
+        ReadGuard guard(*this);
+        Table* table = shards_[shard].table.load(std::memory_order_seq_cst);
+        for (size_t j=0;j<table->capacity;++j){
+            const Slot& slot = table->slots[j];
+            if (slot.key.load(std::memory_order_acquire)==kEmptyKey) continue;
+            for (const auto& device:slot.devices){
+                uint64_t packed = device.load(std::memory_order_acquire);
+                if (packed!=0) handles.push_back(ConnectionHandle::unpack(packed));
+            }
+        }
+    }
+}
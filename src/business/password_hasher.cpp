@@ -0,0 +1,87 @@
+//
+// Created by Cando on 2026/10/19.
+//
+#include "../../include/business/password_hasher.h"
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <charconv>
+#include <iostream>
+
+namespace easychat{
+    namespace {
+        const std::string kPbkdf2Prefix = "pbkdf2_sha256$";
+        constexpr int kSaltBytes = 16;
+        constexpr int kHashBytes = 32;
+        // 迭代次数上限，防止恶意构造的哈希消耗CPU
+        constexpr int kMaxIterations = 10000000;
+
+        std::string toHex(const unsigned char* data,size_t length){
+            static const char digits[] = "0123456789abcdef";
+            std::string hex(length*2,'0');
+            for (size_t i=0;i<length;++i){
+                hex[i*2] = digits[data[i]>>4];
+                hex[i*2+1] = digits[data[i]&0x0f];
+            }
+            return hex;
+        }
+
+        bool constantTimeEquals(const std::string& a,const std::string& b){
+            return a.size()==b.size() && CRYPTO_memcmp(a.data(),b.data(),a.size())==0;
+        }
+    }
+
+    std::string PasswordHasher::pbkdf2(const std::string &password, const std::string &salt, int iterations) {
+        unsigned char derived[kHashBytes];
+        if (PKCS5_PBKDF2_HMAC(password.data(),static_cast<int>(password.size()),
+                              reinterpret_cast<const unsigned char*>(salt.data()),static_cast<int>(salt.size()),
+                              iterations,EVP_sha256(),sizeof (derived),derived)!=1){
+            return "";
+        }
+        return toHex(derived,sizeof (derived));
+    }
+
+    std::string PasswordHasher::legacyMd5(const std::string &password) {
+        unsigned char digest[EVP_MAX_MD_SIZE];
+        unsigned int digest_length = 0;
+        EVP_Digest(password.data(),password.size(),digest,&digest_length,EVP_md5(),nullptr);
+        return toHex(digest,digest_length);
+    }
+
+    std::string PasswordHasher::hash(const std::string &password, int iterations) {
+        unsigned char salt[kSaltBytes];
+        if (RAND_bytes(salt,sizeof (salt))!=1){
+            std::cerr<<"Failed to generate password salt"<<std::endl;
+            return "";
+        }
+        std::string salt_hex = toHex(salt,sizeof (salt));
+        std::string derived = pbkdf2(password,salt_hex,iterations);
+        if (derived.empty()) return "";
+        return kPbkdf2Prefix+std::to_string(iterations)+"$"+salt_hex+"$"+derived;
+    }
+
+    bool PasswordHasher::verify(const std::string &password, const std::string &stored, int target_iterations,
+                                bool &needs_upgrade) {
+        needs_upgrade = false;
+        if (stored.compare(0,kPbkdf2Prefix.size(),kPbkdf2Prefix)!=0){
+            // 旧版无盐MD5
+            needs_upgrade = true;
+            return constantTimeEquals(legacyMd5(password),stored);
+        }
+        size_t iterations_end = stored.find('$',kPbkdf2Prefix.size());
+        if (iterations_end==std::string::npos) return false;
+        size_t salt_end = stored.find('$',iterations_end+1);
+        if (salt_end==std::string::npos) return false;
+        int iterations = 0;
+        const char* begin = stored.data()+kPbkdf2Prefix.size();
+        auto [ptr,ec] = std::from_chars(begin,stored.data()+iterations_end,iterations);
+        if (ec!=std::errc() || ptr!=stored.data()+iterations_end || iterations<=0 || iterations>kMaxIterations){
+            return false;
+        }
+        std::string salt = stored.substr(iterations_end+1,salt_end-iterations_end-1);
+        std::string expected = stored.substr(salt_end+1);
+        if (!constantTimeEquals(pbkdf2(password,salt,iterations),expected)) return false;
+        needs_upgrade = iterations<target_iterations;
+        return true;
+    }
+}
@@ -0,0 +1,59 @@
+//
+// Created by Cando on 2026/10/19.
+//
+#include "../../include/business/presence_writer.h"
+#include <algorithm>
+
+namespace easychat{
+    PresenceWriter::PresenceWriter()
+    :batcher_("presence",[](const PresenceUpdate& update){return update.user_id;},
+              [](PresenceUpdate& older,PresenceUpdate&& newer){
+        // 覆盖同一用户尚未写入的旧状态
+        older = std::move(newer);
+    }){}
+
+    PresenceWriter::~PresenceWriter() {
+        stop();
+    }
+
+    void PresenceWriter::init(std::shared_ptr<MessageStore> store) {
+        store_ = std::move(store);
+        batcher_.setFlush([this](std::vector<PresenceUpdate>& batch){return flush(batch);});
+    }
+
+    void PresenceWriter::start(int flush_interval_ms, size_t max_batch) {
+        batcher_.start(flush_interval_ms,max_batch);
+    }
+
+    void PresenceWriter::online(int user_id, int socket_fd, const std::string &ip, int port) {
+        batcher_.add(PresenceUpdate{user_id,1,socket_fd,ip,port});
+    }
+
+    void PresenceWriter::offline(int user_id) {
+        batcher_.add(PresenceUpdate{user_id,0,-1,"",0});
+    }
+
+    size_t PresenceWriter::pendingCount() {
+        return batcher_.pendingCount();
+    }
+
+    bool PresenceWriter::flush(std::vector<PresenceUpdate> &batch) {
+        // 最终状态与已持久化状态相同（断线后又在同一连接上恢复等），无需写库
+        batch.erase(std::remove_if(batch.begin(),batch.end(),[this](const PresenceUpdate& update){
+            auto persisted = persisted_.find(update.user_id);
+            return persisted!=persisted_.end() && persisted->second==(update.status==1 ? update.socket_fd : -1);
+        }),batch.end());
+        if (batch.empty()) return true;
+        bool ok = store_->updatePresence(batch);
+        for (const auto& update:batch){
+            // 写入失败时数据库状态未知，放回待写表后重新写入
+            if (ok) persisted_[update.user_id] = update.status==1 ? update.socket_fd : -1;
+            else persisted_.erase(update.user_id);
+        }
+        return ok;
+    }
+
+    void PresenceWriter::stop() {
+        batcher_.stop();
+    }
+}
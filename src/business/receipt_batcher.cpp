@@ -0,0 +1,49 @@
+//
+// Created by Cando on 2026/10/19.
+//
+#include "../../include/business/receipt_batcher.h"
+#include <algorithm>
+
+namespace easychat{
+    namespace {
+        uint64_t receiptKey(const ReadReceipt& receipt){
+            return (static_cast<uint64_t>(static_cast<uint32_t>(receipt.reader_id))<<32)|static_cast<uint32_t>(receipt.peer_id);
+        }
+    }
+
+    ReceiptBatcher::ReceiptBatcher()
+    :batcher_("read receipts",receiptKey,[](ReadReceipt& older,ReadReceipt&& newer){
+        // 合并同一会话尚未写入的回执，只保留最大序号
+        older.seq = std::max(older.seq,newer.seq);
+    }){}
+
+    ReceiptBatcher::~ReceiptBatcher() {
+        stop();
+    }
+
+    void ReceiptBatcher::init(std::shared_ptr<MessageStore> store, Forwarder forwarder) {
+        store_ = std::move(store);
+        forwarder_ = std::move(forwarder);
+        batcher_.setFlush([this](std::vector<ReadReceipt>& batch){
+            if (!store_->markConversationsRead(batch)) return false;
+            if (forwarder_) forwarder_(batch);
+            return true;
+        });
+    }
+
+    void ReceiptBatcher::start(int window_ms, size_t max_batch) {
+        batcher_.start(window_ms,max_batch);
+    }
+
+    void ReceiptBatcher::read(int reader_id, int peer_id, int64_t seq) {
+        batcher_.add(ReadReceipt{reader_id,peer_id,seq});
+    }
+
+    size_t ReceiptBatcher::pendingCount() {
+        return batcher_.pendingCount();
+    }
+
+    void ReceiptBatcher::stop() {
+        batcher_.stop();
+    }
+}
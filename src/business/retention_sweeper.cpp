@@ -0,0 +1,185 @@
+//
+// Created by Cando on 2026/10/19.
+//
+#include "../../include/business/retention_sweeper.h"
+#include "../../include/business/conversation_index.h"
+#include "../../include/business/inbox_index.h"
+#include "../../include/business/message_handler.h"
+#include "../../include/business/room_manager.h"
+#include "../../include/business/search_index.h"
+#include "../../include/common/id_generator.h"
+#include "../../include/database/blob_store.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <unordered_set>
+
+namespace easychat{
+    RetentionSweeper::RetentionSweeper()
+    :ttl_seconds_(0),room_ttl_seconds_(0),batch_size_(500),max_rate_(2000),interval_seconds_(600),
+    direct_after_id_(0),expired_count_(0),running_(false){}
+
+    RetentionSweeper::~RetentionSweeper() {
+        stop();
+    }
+
+    RetentionSweeper &RetentionSweeper::getInstance() {
+        static RetentionSweeper instance;
+        return instance;
+    }
+
+    void RetentionSweeper::start(std::shared_ptr<MessageStore> store, int ttl_seconds, int room_ttl_seconds,
+                                 const std::string &room_overrides, int batch_size, int max_rate, int interval_seconds) {
+        store_ = std::move(store);
+        ttl_seconds_ = std::max(ttl_seconds,0);
+        room_ttl_seconds_ = std::max(room_ttl_seconds,0);
+        batch_size_ = std::max(batch_size,1);
+        max_rate_ = max_rate;
+        interval_seconds_ = std::max(interval_seconds,1);
+        room_overrides_.clear();
+        std::stringstream ss(room_overrides);
+        std::string item;
+        while (std::getline(ss,item,',')){
+            size_t colon = item.find(':');
+            if (colon==std::string::npos) continue;
+            try {
+                room_overrides_[std::stoi(item.substr(0,colon))] = std::max(std::stoi(item.substr(colon+1)),0);
+            }catch (const std::exception& e){
+                std::cerr<<"Ignoring invalid retention override: "<<item<<std::endl;
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            running_ = true;
+        }
+        thread_ = std::thread(&RetentionSweeper::backgroundLoop,this);
+        std::cout<<"RetentionSweeper started, ttl: "<<ttl_seconds_<<"s, room ttl: "<<room_ttl_seconds_<<"s, overrides: "
+        <<room_overrides_.size()<<", batch: "<<batch_size_<<", max rate: "<<max_rate_<<"/s"<<std::endl;
+    }
+
+    void RetentionSweeper::stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!running_) return;
+            running_ = false;
+        }
+        cond_.notify_all();
+        if (thread_.joinable()) thread_.join();
+    }
+
+    uint64_t RetentionSweeper::expiredCount() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return expired_count_;
+    }
+
+    int RetentionSweeper::roomTtl(int room_id) const {
+        auto it = room_overrides_.find(room_id);
+        return it!=room_overrides_.end() ? it->second : room_ttl_seconds_;
+    }
+
+    void RetentionSweeper::backgroundLoop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (running_){
+            lock.unlock();
+            sweep();
+            lock.lock();
+            cond_.wait_for(lock,std::chrono::seconds(interval_seconds_),[this]{return !running_;});
+        }
+    }
+
+    void RetentionSweeper::sweep() {
+        int64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+        // 保留期换算为消息ID上限：早于该时间的消息ID都小于它
+        auto cutoff = [now_ms](int ttl_seconds){
+            return ttl_seconds>0 ? IdGenerator::minIdForTimestamp(now_ms-static_cast<int64_t>(ttl_seconds)*1000) : 0;
+        };
+        uint64_t before = expiredCount();
+        int64_t before_id = cutoff(ttl_seconds_);
+        if (before_id>0){
+            if (!sweepRange(0,before_id,direct_after_id_)) return;
+            // 搜索索引只收录单聊消息，过期的消息ID在段合并时丢弃
+            SearchIndex::getInstance().expireBefore(before_id);
+        }
+        std::vector<int> room_ids;
+        RoomManager::getInstance().getRoomIds(room_ids);
+        for (int room_id:room_ids){
+            before_id = cutoff(roomTtl(room_id));
+            if (before_id>0 && !sweepRange(room_id,before_id,room_after_ids_[room_id])) return;
+        }
+        uint64_t expired = expiredCount()-before;
+        if (expired>0) std::cout<<"Retention sweep expired "<<expired<<" messages"<<std::endl;
+        // 附件的引用随消息过期，没有引用的附件被回收
+        BlobStore::getInstance().collectGarbage([this,&cutoff](int room_id){
+            return cutoff(room_id==0 ? ttl_seconds_ : roomTtl(room_id));
+        });
+    }
+
+    bool RetentionSweeper::sweepRange(int room_id, int64_t before_id, int64_t &after_id) {
+        while (true){
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!running_) return false;
+            }
+            std::vector<MessageInfo> deleted;
+            bool ok = room_id==0 ? store_->expireMessages(after_id,before_id,batch_size_,deleted)
+                                 : store_->expireRoomMessages(room_id,after_id,before_id,batch_size_,deleted);
+            if (!ok){
+                // 存储不可用，下一轮重试
+                std::cerr<<"Retention sweep failed"<<(room_id!=0 ? " for room "+std::to_string(room_id) : "")<<std::endl;
+                return false;
+            }
+            if (deleted.empty()) return true;
+            for (const auto& message:deleted){
+                after_id = std::max(after_id,message.id);
+            }
+            forgetDeleted(room_id,deleted);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                expired_count_ += deleted.size();
+            }
+            if (deleted.size()<static_cast<size_t>(batch_size_)) return true;
+            if (!throttle(deleted.size())) return false;
+        }
+    }
+
+    void RetentionSweeper::forgetDeleted(int room_id, const std::vector<MessageInfo> &deleted) {
+        ConversationIndex& conversation_index = ConversationIndex::getInstance();
+        // 每个会话删除的是一段前缀，近期消息丢弃到其中最大的消息ID为止
+        std::unordered_map<uint64_t,int64_t> conversations;
+        std::unordered_set<int> users;
+        std::vector<int64_t> message_ids;
+        message_ids.reserve(deleted.size());
+        for (const auto& message:deleted){
+            uint64_t key = room_id!=0 ? ConversationIndex::roomKey(room_id)
+                                      : ConversationIndex::directKey(message.sender_id,message.receiver_id);
+            int64_t& max_id = conversations[key];
+            max_id = std::max(max_id,message.id);
+            if (room_id==0){
+                users.insert(message.sender_id);
+                users.insert(message.receiver_id);
+            }
+            message_ids.push_back(message.id);
+        }
+        for (const auto& [key,max_id]:conversations){
+            auto conversation = conversation_index.find(key);
+            if (!conversation) continue;
+            std::lock_guard<std::mutex> lock(conversation->mutex);
+            conversation_index.forget(*conversation,max_id);
+        }
+        // 收件箱的最后一条消息与未读数可能来自已删除的消息，从存储重新加载
+        for (int user_id:users){
+            InboxIndex::getInstance().invalidate(user_id);
+        }
+        std::sort(message_ids.begin(),message_ids.end());
+        MessageHandler::getInstance().dropExpired(message_ids);
+    }
+
+    bool RetentionSweeper::throttle(size_t deleted) {
+        if (max_rate_<=0) return true;
+        auto wait = std::chrono::milliseconds(static_cast<int64_t>(deleted)*1000/max_rate_);
+        std::unique_lock<std::mutex> lock(mutex_);
+        return !cond_.wait_for(lock,wait,[this]{return !running_;});
+    }
+}
@@ -0,0 +1,156 @@
+//
+// Created by Cando on 2026/10/19.
+//
+#include "../../include/business/room_manager.h"
+#include "../../include/common/id_generator.h"
+#include <algorithm>
+#include <iostream>
+#include <mutex>
+
+namespace easychat{
+    namespace {
+        bool memberLess(const RoomMember& member,int user_id){
+            return member.user_id<user_id;
+        }
+    }
+
+    RoomManager::RoomManager() :max_members_(1000){}
+
+    RoomManager &RoomManager::getInstance() {
+        static RoomManager instance;
+        return instance;
+    }
+
+    bool RoomManager::init(std::shared_ptr<MessageStore> store, size_t max_members) {
+        store_ = std::move(store);
+        max_members_ = max_members;
+        std::vector<RoomInfo> rooms;
+        if (!store_->loadRooms(rooms)){
+            std::cerr<<"Failed to load rooms from store"<<std::endl;
+            return false;
+        }
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        rooms_.clear();
+        user_rooms_.clear();
+        size_t member_count = 0;
+        for (auto& info:rooms){
+            auto members = std::make_shared<std::vector<RoomMember>>();
+            members->reserve(info.members.size());
+            for (const auto& [user_id,joined_message_id]:info.members){
+                members->push_back(RoomMember{user_id,joined_message_id});
+                user_rooms_[user_id].push_back(info.id);
+            }
+            std::sort(members->begin(),members->end(),
+                      [](const RoomMember& a,const RoomMember& b){return a.user_id<b.user_id;});
+            member_count += members->size();
+            rooms_[info.id] = Room{std::move(info.name),info.owner_id,std::move(members)};
+        }
+        std::cout<<"RoomManager initialized, rooms: "<<rooms_.size()<<", members: "<<member_count<<std::endl;
+        return true;
+    }
+
+    bool RoomManager::createRoom(int owner_id, const std::string &name, int &room_id) {
+        if (!store_->createRoom(name,owner_id,room_id)) return false;
+        {
+            std::unique_lock<std::shared_mutex> lock(mutex_);
+            rooms_[room_id] = Room{name,owner_id,std::make_shared<const std::vector<RoomMember>>()};
+        }
+        std::cout<<"Room created ID="<<room_id<<", owner: "<<owner_id<<std::endl;
+        return joinRoom(room_id,owner_id);
+    }
+
+    bool RoomManager::lockRoom(int room_id, std::unique_lock<std::mutex> &mutation_lock, RoomMembers &members) const {
+        std::shared_ptr<std::mutex> mutation_mutex;
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex_);
+            auto it = rooms_.find(room_id);
+            if (it==rooms_.end()) return false;
+            mutation_mutex = it->second.mutation_mutex;
+        }
+        mutation_lock = std::unique_lock<std::mutex>(*mutation_mutex);
+        // 持有变更锁后重新读取快照，之后到释放变更锁前该房间的成员不会再变化
+        // （房间不会被删除，持有的互斥量始终有效）
+        members = getMembers(room_id);
+        return members!=nullptr;
+    }
+
+    bool RoomManager::joinRoom(int room_id, int user_id) {
+        int64_t joined_message_id = IdGenerator::getInstance().nextId();
+        // 持房间的变更锁写入存储，保证同一房间的成员变更与内存顺序一致，其他房间与读者不受影响
+        std::unique_lock<std::mutex> mutation_lock;
+        RoomMembers current;
+        if (!lockRoom(room_id,mutation_lock,current)) return false;
+        const auto& members = *current;
+        auto pos = std::lower_bound(members.begin(),members.end(),user_id,memberLess);
+        if (pos!=members.end() && pos->user_id==user_id) return true;
+        if (members.size()>=max_members_){
+            std::cerr<<"Room "<<room_id<<" is full"<<std::endl;
+            return false;
+        }
+        if (!store_->addRoomMember(room_id,user_id,joined_message_id)) return false;
+        // 复制后替换，正在扇出的线程仍持有旧快照；全局写锁只用于替换指针
+        auto updated = std::make_shared<std::vector<RoomMember>>(members);
+        updated->insert(updated->begin()+(pos-members.begin()),RoomMember{user_id,joined_message_id});
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        rooms_[room_id].members = std::move(updated);
+        user_rooms_[user_id].push_back(room_id);
+        return true;
+    }
+
+    bool RoomManager::leaveRoom(int room_id, int user_id) {
+        std::unique_lock<std::mutex> mutation_lock;
+        RoomMembers current;
+        if (!lockRoom(room_id,mutation_lock,current)) return false;
+        const auto& members = *current;
+        auto pos = std::lower_bound(members.begin(),members.end(),user_id,memberLess);
+        if (pos==members.end() || pos->user_id!=user_id) return false;
+        if (!store_->removeRoomMember(room_id,user_id)) return false;
+        auto updated = std::make_shared<std::vector<RoomMember>>(members);
+        updated->erase(updated->begin()+(pos-members.begin()));
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        rooms_[room_id].members = std::move(updated);
+        auto user_it = user_rooms_.find(user_id);
+        if (user_it!=user_rooms_.end()){
+            auto& room_ids = user_it->second;
+            room_ids.erase(std::remove(room_ids.begin(),room_ids.end(),room_id),room_ids.end());
+            if (room_ids.empty()) user_rooms_.erase(user_it);
+        }
+        return true;
+    }
+
+    RoomMembers RoomManager::getMembers(int room_id) const {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto it = rooms_.find(room_id);
+        return it!=rooms_.end() ? it->second.members : nullptr;
+    }
+
+    bool RoomManager::isMember(int room_id, int user_id) const {
+        RoomMembers members = getMembers(room_id);
+        if (!members) return false;
+        auto pos = std::lower_bound(members->begin(),members->end(),user_id,memberLess);
+        return pos!=members->end() && pos->user_id==user_id;
+    }
+
+    void RoomManager::getRoomIds(std::vector<int> &room_ids) const {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        room_ids.reserve(rooms_.size());
+        for (const auto& [room_id,room]:rooms_){
+            room_ids.push_back(room_id);
+        }
+    }
+
+    void RoomManager::getUserRooms(int user_id, std::vector<std::pair<int, int64_t>> &rooms) const {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto user_it = user_rooms_.find(user_id);
+        if (user_it==user_rooms_.end()) return;
+        for (int room_id:user_it->second){
+            auto it = rooms_.find(room_id);
+            if (it==rooms_.end()) continue;
+            const auto& members = *it->second.members;
+            auto pos = std::lower_bound(members.begin(),members.end(),user_id,memberLess);
+            if (pos!=members.end() && pos->user_id==user_id){
+                rooms.emplace_back(room_id,pos->joined_message_id);
+            }
+        }
+    }
+}
@@ -0,0 +1,351 @@
+//
+// Created by Cando on 2026/10/19.
+//
+#include "../../include/business/search_index.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <iostream>
+
+namespace easychat{
+    namespace {
+        // 启动时重建索引每页读取的消息数
+        const int kBackfillPageSize = 1000;
+
+        // 解码一个UTF-8字符，返回码点并推进pos（非法字节按单字节处理）
+        uint32_t nextCodePoint(std::string_view text,size_t& pos){
+            unsigned char c = static_cast<unsigned char>(text[pos]);
+            size_t length = c<0x80 ? 1 : (c>>5)==0x6 ? 2 : (c>>4)==0xE ? 3 : (c>>3)==0x1E ? 4 : 1;
+            if (pos+length>text.size()) length = 1;
+            uint32_t cp = length==1 ? c : c & (0xFF>>(length+1));
+            for (size_t i=1;i<length;++i){
+                cp = (cp<<6)|(static_cast<unsigned char>(text[pos+i]) & 0x3F);
+            }
+            pos += length;
+            return cp;
+        }
+        // 中日韩文字（按二元组切分）
+        bool isCjk(uint32_t cp){
+            return (cp>=0x3400 && cp<=0x4DBF) || (cp>=0x4E00 && cp<=0x9FFF) || (cp>=0xF900 && cp<=0xFAFF) ||
+                   (cp>=0x3040 && cp<=0x30FF) || (cp>=0xAC00 && cp<=0xD7AF);
+        }
+        // 分隔符：ASCII非字母数字、通用标点、中日韩标点与全角符号
+        bool isSeparator(uint32_t cp){
+            if (cp<0x80) return !std::isalnum(static_cast<int>(cp));
+            return (cp>=0x2000 && cp<=0x206F) || (cp>=0x3000 && cp<=0x303F) || (cp>=0xFF00 && cp<=0xFFEF);
+        }
+        void putVarint(std::string& out,uint64_t value){
+            while (value>=0x80){
+                out.push_back(static_cast<char>((value & 0x7F)|0x80));
+                value >>= 7;
+            }
+            out.push_back(static_cast<char>(value));
+        }
+    }
+
+    SearchIndex::SearchIndex() :seal_postings_(65536),max_segments_(8),active_postings_(0),expired_before_(0),running_(false){}
+
+    SearchIndex::~SearchIndex() {
+        stop();
+    }
+
+    SearchIndex &SearchIndex::getInstance() {
+        static SearchIndex instance;
+        return instance;
+    }
+
+    void SearchIndex::start(std::shared_ptr<MessageStore> store, size_t seal_postings, size_t max_segments, bool backfill) {
+        store_ = std::move(store);
+        seal_postings_ = std::max<size_t>(seal_postings,1);
+        max_segments_ = std::max<size_t>(max_segments,1);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            running_ = true;
+        }
+        thread_ = std::thread(&SearchIndex::backgroundLoop,this,backfill);
+        std::cout<<"SearchIndex started, seal postings: "<<seal_postings_<<", max segments: "<<max_segments_
+        <<(backfill ? ", backfilling from store" : "")<<std::endl;
+    }
+
+    void SearchIndex::stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!running_) return;
+            running_ = false;
+        }
+        cond_.notify_all();
+        if (thread_.joinable()) thread_.join();
+    }
+
+    uint64_t SearchIndex::termKey(int user_id, std::string_view term) {
+        // FNV-1a，混入用户ID；哈希冲突由查询结果回读正文校验
+        uint64_t hash = 14695981039346656037ULL;
+        for (char c:term){
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 1099511628211ULL;
+        }
+        return hash ^ (static_cast<uint64_t>(static_cast<uint32_t>(user_id))*0x9E3779B97F4A7C15ULL);
+    }
+
+    void SearchIndex::tokenize(std::string_view text, std::vector<std::string> &terms) {
+        size_t pos = 0;
+        std::string word;
+        // 当前连续的中日韩文字（每个元素为一个字的UTF-8字节）
+        std::vector<std::string_view> run;
+        auto flushWord = [&]{
+            if (!word.empty()) terms.push_back(std::move(word));
+            word.clear();
+        };
+        auto flushRun = [&]{
+            // 单字与相邻两字都作为词项，查询单字和词语都能命中
+            for (size_t i=0;i<run.size();++i){
+                terms.emplace_back(run[i]);
+                if (i+1<run.size()){
+                    terms.emplace_back(std::string(run[i]).append(run[i+1]));
+                }
+            }
+            run.clear();
+        };
+        while (pos<text.size()){
+            size_t start = pos;
+            uint32_t cp = nextCodePoint(text,pos);
+            if (isCjk(cp)){
+                flushWord();
+                run.push_back(text.substr(start,pos-start));
+            }else if (isSeparator(cp)){
+                flushWord();
+                flushRun();
+            }else{
+                flushRun();
+                if (cp<0x80) word.push_back(static_cast<char>(std::tolower(static_cast<int>(cp))));
+                else word.append(text.substr(start,pos-start));
+            }
+        }
+        flushWord();
+        flushRun();
+        std::sort(terms.begin(),terms.end());
+        terms.erase(std::unique(terms.begin(),terms.end()),terms.end());
+    }
+
+    void SearchIndex::encodePostings(std::vector<int64_t> &ids, std::string &out) {
+        std::sort(ids.begin(),ids.end());
+        ids.erase(std::unique(ids.begin(),ids.end()),ids.end());
+        out.clear();
+        out.reserve(ids.size()*3);
+        int64_t previous = 0;
+        for (int64_t id:ids){
+            putVarint(out,static_cast<uint64_t>(id-previous));
+            previous = id;
+        }
+    }
+
+    void SearchIndex::decodePostings(const std::string &data, std::vector<int64_t> &ids) {
+        int64_t value = 0;
+        uint64_t delta = 0;
+        int shift = 0;
+        for (char c:data){
+            delta |= static_cast<uint64_t>(static_cast<unsigned char>(c) & 0x7F)<<shift;
+            if (static_cast<unsigned char>(c) & 0x80){
+                shift += 7;
+                continue;
+            }
+            value += static_cast<int64_t>(delta);
+            ids.push_back(value);
+            delta = 0;
+            shift = 0;
+        }
+    }
+
+    void SearchIndex::dropExpired(std::vector<int64_t> &ids) const {
+        int64_t before_id = expired_before_.load();
+        if (before_id==0) return;
+        ids.erase(std::remove_if(ids.begin(),ids.end(),[before_id](int64_t id){return id<before_id;}),ids.end());
+    }
+
+    void SearchIndex::expireBefore(int64_t before_id) {
+        int64_t current = expired_before_.load();
+        while (before_id>current && !expired_before_.compare_exchange_weak(current,before_id)){}
+    }
+
+    void SearchIndex::add(const MessageInfo &message) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!running_) return;
+        }
+        std::vector<std::string> terms;
+        tokenize(message.content,terms);
+        if (terms.empty()) return;
+        size_t postings;
+        {
+            std::lock_guard<std::mutex> lock(active_mutex_);
+            for (const auto& term:terms){
+                active_[termKey(message.sender_id,term)].push_back(message.id);
+                if (message.receiver_id!=message.sender_id){
+                    active_[termKey(message.receiver_id,term)].push_back(message.id);
+                }
+            }
+            active_postings_ += terms.size()*(message.receiver_id!=message.sender_id ? 2 : 1);
+            postings = active_postings_;
+        }
+        if (postings>=seal_postings_) cond_.notify_one();
+    }
+
+    void SearchIndex::search(int user_id, const std::vector<std::string> &terms, size_t limit, int64_t before_id,
+                             std::vector<int64_t> &message_ids) {
+        if (terms.empty() || limit==0) return;
+        // 每个词项在所有段中的消息ID（先读可变段再读不可变段，封存过程中可能重复，合并时去重）
+        std::vector<std::vector<int64_t>> lists(terms.size());
+        std::vector<uint64_t> keys;
+        for (const auto& term:terms) keys.push_back(termKey(user_id,term));
+        {
+            std::lock_guard<std::mutex> lock(active_mutex_);
+            for (size_t i=0;i<keys.size();++i){
+                for (const RawPostings* raw:{&active_,&sealing_}){
+                    auto it = raw->find(keys[i]);
+                    if (it!=raw->end()) lists[i].insert(lists[i].end(),it->second.begin(),it->second.end());
+                }
+            }
+        }
+        {
+            std::shared_lock<std::shared_mutex> lock(segments_mutex_);
+            for (const auto& segment:segments_){
+                for (size_t i=0;i<keys.size();++i){
+                    auto it = segment->postings.find(keys[i]);
+                    if (it!=segment->postings.end()) decodePostings(it->second,lists[i]);
+                }
+            }
+        }
+        for (auto& list:lists){
+            dropExpired(list);
+            std::sort(list.begin(),list.end());
+            list.erase(std::unique(list.begin(),list.end()),list.end());
+        }
+        // 从最短的列表开始求交集
+        std::sort(lists.begin(),lists.end(),[](const auto& a,const auto& b){return a.size()<b.size();});
+        std::vector<int64_t> result = std::move(lists[0]);
+        std::vector<int64_t> merged;
+        for (size_t i=1;i<lists.size() && !result.empty();++i){
+            merged.clear();
+            std::set_intersection(result.begin(),result.end(),lists[i].begin(),lists[i].end(),std::back_inserter(merged));
+            result.swap(merged);
+        }
+        for (auto it=result.rbegin();it!=result.rend() && message_ids.size()<limit;++it){
+            if (before_id!=0 && *it>=before_id) continue;
+            message_ids.push_back(*it);
+        }
+    }
+
+    size_t SearchIndex::segmentCount() {
+        std::shared_lock<std::shared_mutex> lock(segments_mutex_);
+        return segments_.size();
+    }
+
+    void SearchIndex::sealActive() {
+        {
+            std::lock_guard<std::mutex> lock(active_mutex_);
+            if (active_.empty()) return;
+            sealing_.swap(active_);
+            active_postings_ = 0;
+        }
+        // sealing_只由本线程修改，查询只读，封存期间无需加锁
+        auto segment = std::make_shared<Segment>();
+        std::vector<int64_t> ids;
+        for (const auto& [key,raw_ids]:sealing_){
+            ids.assign(raw_ids.begin(),raw_ids.end());
+            dropExpired(ids);
+            if (ids.empty()) continue;
+            encodePostings(ids,segment->postings[key]);
+            segment->posting_count += ids.size();
+        }
+        {
+            std::unique_lock<std::shared_mutex> lock(segments_mutex_);
+            segments_.push_back(segment);
+        }
+        std::lock_guard<std::mutex> lock(active_mutex_);
+        sealing_.clear();
+    }
+
+    void SearchIndex::mergeSmallest() {
+        std::vector<std::shared_ptr<const Segment>> segments;
+        {
+            std::shared_lock<std::shared_mutex> lock(segments_mutex_);
+            segments = segments_;
+        }
+        if (segments.size()<2) return;
+        std::sort(segments.begin(),segments.end(),[](const auto& a,const auto& b){return a->posting_count<b->posting_count;});
+        const Segment& first = *segments[0];
+        const Segment& second = *segments[1];
+        // 逐个键解码两段的消息ID，丢弃已过期的后重新编码，过期的倒排项随合并回收
+        auto merged = std::make_shared<Segment>();
+        std::vector<int64_t> ids;
+        auto mergeKey = [&](uint64_t key,const std::string& data,const Segment& other){
+            ids.clear();
+            decodePostings(data,ids);
+            auto it = other.postings.find(key);
+            if (it!=other.postings.end()) decodePostings(it->second,ids);
+            dropExpired(ids);
+            if (ids.empty()) return;
+            encodePostings(ids,merged->postings[key]);
+            merged->posting_count += ids.size();
+        };
+        for (const auto& [key,data]:first.postings){
+            mergeKey(key,data,second);
+        }
+        for (const auto& [key,data]:second.postings){
+            if (first.postings.count(key)==0) mergeKey(key,data,first);
+        }
+        std::unique_lock<std::shared_mutex> lock(segments_mutex_);
+        auto& current = segments_;
+        current.erase(std::remove_if(current.begin(),current.end(),[&](const auto& segment){
+            return segment==segments[0] || segment==segments[1];
+        }),current.end());
+        current.push_back(merged);
+    }
+
+    void SearchIndex::backfill() {
+        int64_t after_id = 0;
+        size_t indexed = 0;
+        std::vector<MessageInfo> page;
+        while (true){
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!running_) return;
+            }
+            page.clear();
+            if (!store_->scanMessages(after_id,kBackfillPageSize,page)){
+                std::cerr<<"Search backfill failed after message "<<after_id<<std::endl;
+                return;
+            }
+            if (page.empty()) break;
+            for (const auto& message:page){
+                add(message);
+                after_id = std::max(after_id,message.id);
+            }
+            indexed += page.size();
+            size_t postings;
+            {
+                std::lock_guard<std::mutex> active_lock(active_mutex_);
+                postings = active_postings_;
+            }
+            if (postings>=seal_postings_) sealActive();
+        }
+        std::cout<<"Search backfill indexed "<<indexed<<" messages"<<std::endl;
+    }
+
+    void SearchIndex::backgroundLoop(bool backfill_first) {
+        if (backfill_first) backfill();
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (running_){
+            cond_.wait_for(lock,std::chrono::seconds(1));
+            lock.unlock();
+            size_t postings;
+            {
+                std::lock_guard<std::mutex> active_lock(active_mutex_);
+                postings = active_postings_;
+            }
+            if (postings>=seal_postings_) sealActive();
+            while (segmentCount()>max_segments_) mergeSmallest();
+            lock.lock();
+        }
+    }
+}
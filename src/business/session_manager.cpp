@@ -0,0 +1,99 @@
+//
+// Created by Cando on 2026/10/19.
+//
+#include "../../include/business/session_manager.h"
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+#include <charconv>
+#include <ctime>
+#include <iostream>
+
+namespace easychat{
+    namespace {
+        // 随机数长度（字节）
+        constexpr int kNonceBytes = 8;
+        // 令牌最大长度
+        constexpr size_t kMaxTokenLength = 256;
+
+        std::string toHex(const unsigned char* data,size_t length){
+            static const char digits[] = "0123456789abcdef";
+            std::string hex(length*2,'0');
+            for (size_t i=0;i<length;++i){
+                hex[i*2] = digits[data[i]>>4];
+                hex[i*2+1] = digits[data[i]&0x0f];
+            }
+            return hex;
+        }
+
+        template<typename T> bool parseNumber(const std::string& text,T& value){
+            auto [ptr,ec] = std::from_chars(text.data(),text.data()+text.size(),value);
+            return ec==std::errc() && ptr==text.data()+text.size();
+        }
+    }
+
+    SessionManager::SessionManager() : ttl_(7*24*3600),start_time_(static_cast<int64_t>(time(nullptr))){}
+
+    SessionManager &SessionManager::getInstance() {
+        static SessionManager instance;
+        return instance;
+    }
+
+    bool SessionManager::init(const std::string &secret, int64_t ttl) {
+        ttl_ = ttl;
+        start_time_ = static_cast<int64_t>(time(nullptr));
+        if (!secret.empty()){
+            secret_ = secret;
+        }else{
+            unsigned char key[32];
+            if (RAND_bytes(key,sizeof (key))!=1){
+                std::cerr<<"Failed to generate session secret"<<std::endl;
+                return false;
+            }
+            secret_.assign(reinterpret_cast<const char*>(key),sizeof (key));
+            std::cout<<"Session secret not configured, tokens will not survive restart"<<std::endl;
+        }
+        std::cout<<"SessionManager initialized, token ttl: "<<ttl_<<"s"<<std::endl;
+        return true;
+    }
+
+    std::string SessionManager::sign(const std::string &payload) const {
+        unsigned char digest[EVP_MAX_MD_SIZE];
+        unsigned int digest_length = 0;
+        HMAC(EVP_sha256(),secret_.data(),static_cast<int>(secret_.size()),
+             reinterpret_cast<const unsigned char*>(payload.data()),payload.size(),digest,&digest_length);
+        return toHex(digest,digest_length);
+    }
+
+    std::string SessionManager::issueToken(int user_id) {
+        unsigned char nonce[kNonceBytes];
+        RAND_bytes(nonce,sizeof (nonce));
+        std::string payload = std::to_string(user_id)+"."+std::to_string(time(nullptr))+"."+toHex(nonce,sizeof (nonce));
+        return payload+"."+sign(payload);
+    }
+
+    bool SessionManager::verifyToken(const std::string &token, int &user_id, int64_t &issued_at) const {
+        if (token.size()>kMaxTokenLength) return false;
+        size_t signature_pos = token.rfind('.');
+        if (signature_pos==std::string::npos) return false;
+        std::string payload = token.substr(0,signature_pos);
+        std::string signature = token.substr(signature_pos+1);
+        std::string expected = sign(payload);
+        // 常量时间比较，避免时序攻击
+        if (signature.size()!=expected.size() ||
+            CRYPTO_memcmp(signature.data(),expected.data(),expected.size())!=0){
+            return false;
+        }
+        size_t first_dot = payload.find('.');
+        size_t second_dot = payload.find('.',first_dot==std::string::npos ? 0 : first_dot+1);
+        if (first_dot==std::string::npos || second_dot==std::string::npos) return false;
+        if (!parseNumber(payload.substr(0,first_dot),user_id) ||
+            !parseNumber(payload.substr(first_dot+1,second_dot-first_dot-1),issued_at)){
+            return false;
+        }
+        // 检查是否过期
+        if (ttl_>0 && static_cast<int64_t>(time(nullptr))-issued_at>ttl_) return false;
+        return user_id>0;
+    }
+}
@@ -0,0 +1,89 @@
+//
+// Created by Cando on 2026/10/19.
+//
+#include "../../include/business/user_cache.h"
+#include <sstream>
+
+namespace easychat{
+    UserCache::UserCache()
+    :ttl_(60000),negative_ttl_(5000),hits_(0),negative_hits_(0),misses_(0){}
+
+    void UserCache::configure(size_t capacity, int ttl_ms, int negative_ttl_ms) {
+        by_id_.setCapacity(capacity);
+        by_name_.setCapacity(capacity);
+        ttl_ = std::chrono::milliseconds(ttl_ms);
+        negative_ttl_ = std::chrono::milliseconds(negative_ttl_ms);
+    }
+
+    UserCache::Lookup UserCache::resolve(bool found, const Entry &entry, UserInfo &user_info) {
+        if (!found){
+            misses_.fetch_add(1,std::memory_order_relaxed);
+            return Lookup::MISS;
+        }
+        // 空条目表示负缓存
+        if (!entry){
+            negative_hits_.fetch_add(1,std::memory_order_relaxed);
+            return Lookup::NOT_FOUND;
+        }
+        hits_.fetch_add(1,std::memory_order_relaxed);
+        user_info = *entry;
+        return Lookup::HIT;
+    }
+
+    UserCache::Lookup UserCache::getById(int user_id, UserInfo &user_info) {
+        Entry entry;
+        bool found = by_id_.get(user_id,entry);
+        return resolve(found,entry,user_info);
+    }
+
+    UserCache::Lookup UserCache::getByName(const std::string &username, UserInfo &user_info) {
+        Entry entry;
+        bool found = by_name_.get(username,entry);
+        return resolve(found,entry,user_info);
+    }
+
+    void UserCache::put(const UserInfo &user_info) {
+        if (ttl_.count()<=0) return;
+        auto entry = std::make_shared<const UserInfo>(user_info);
+        by_id_.put(user_info.id,entry,ttl_);
+        by_name_.put(user_info.username,entry,ttl_);
+    }
+
+    void UserCache::putMissing(int user_id) {
+        if (negative_ttl_.count()<=0) return;
+        by_id_.put(user_id,nullptr,negative_ttl_);
+    }
+
+    void UserCache::putMissing(const std::string &username) {
+        if (negative_ttl_.count()<=0) return;
+        by_name_.put(username,nullptr,negative_ttl_);
+    }
+
+    void UserCache::invalidate(int user_id) {
+        // 同时移除用户名索引中的同一条目
+        Entry entry;
+        if (by_id_.erase(user_id,&entry) && entry){
+            by_name_.erase(entry->username);
+        }
+    }
+
+    void UserCache::invalidate(const std::string &username) {
+        Entry entry;
+        if (by_name_.erase(username,&entry) && entry){
+            by_id_.erase(entry->id);
+        }
+    }
+
+    std::string UserCache::stats() const {
+        uint64_t hits = hits_.load();
+        uint64_t negative_hits = negative_hits_.load();
+        uint64_t misses = misses_.load();
+        uint64_t total = hits+negative_hits+misses;
+        std::ostringstream out;
+        out<<"hits="<<hits<<" negative_hits="<<negative_hits<<" misses="<<misses
+           <<" hit_rate="<<(total==0 ? 0.0 : 100.0*(hits+negative_hits)/total)<<"%"
+           <<" entries="<<by_id_.size()<<"/"<<by_name_.size()
+           <<" evictions="<<by_id_.evictions()+by_name_.evictions();
+        return out.str();
+    }
+}
@@ -2,225 +2,167 @@
 // Created by Cando on 2026/1/30.
 //
 #include "../../include/business/user_manager.h"
-#include <mysql/mysql.h>
+#include "../../include/business/password_hasher.h"
 #include <cstring>
 #include <iostream>
-#include <openssl/md5.h>
-#include <iomanip>
-#include <sstream>
 
 namespace easychat{
-    UserManager::UserManager() : conn_pool_(ConnectionPool::getInstance()){}
+    UserManager::UserManager() : password_iterations_(100000){}
     UserManager::~UserManager(){}
 
     UserManager &UserManager::getInstance() {
         static UserManager instance;
         return instance;
     }
-    void UserManager::init(){
-        std::cout<<"UserManager initialized"<<std::endl;
+    void UserManager::init(std::shared_ptr<MessageStore> store){
+        store_ = std::move(store);
+        presence_writer_.init(store_);
+        std::cout<<"UserManager initialized, store: "<<store_->name()<<std::endl;
     }
 
-    std::string UserManager::encryptPassword(const std::string &password) {
-        // 使用OpenSSL的MD5函数对密码加密
-        unsigned char md5_hash[MD5_DIGEST_LENGTH];
-        MD5(reinterpret_cast<const unsigned char*>(password.c_str()),password.length(),md5_hash);
-        // 将MD5哈希转化为十六进制字符串
-        std::stringstream ss;
-        for (int i=0;i<MD5_DIGEST_LENGTH;++i){
-            ss<<std::hex<<std::setw(2)<<std::setfill('0')<<static_cast<int>(md5_hash[i]);
-        }
-        return ss.str();
+    void UserManager::configureCache(size_t capacity, int ttl_ms, int negative_ttl_ms) {
+        user_cache_.configure(capacity,ttl_ms,negative_ttl_ms);
+        std::cout<<"User cache configured, capacity: "<<capacity<<", ttl: "<<ttl_ms<<"ms"<<std::endl;
+    }
+
+    void UserManager::configurePresence(int flush_interval_ms, size_t max_batch) {
+        presence_writer_.start(flush_interval_ms,max_batch);
+        std::cout<<"Presence writer configured, flush interval: "<<flush_interval_ms<<"ms, batch: "<<max_batch<<std::endl;
     }
+
     bool UserManager::registerUser(const std::string &username, const std::string &password,
                                   const std::string &nickname) {
-        // 获取数据库连接
-        auto conn = conn_pool_.getConnection();
-        if (!conn||!conn->isConnected()){
-            std::cerr<<"Failed to get database connection"<<std::endl;
-            return false;
-        }
-        // 检查用户名是否存在
-        std::string check_sql = "select id from users where username='"+username+"'";
-        MYSQL_RES* result = conn->query(check_sql);
-        if (result && mysql_num_rows(result)>0){
-            mysql_free_result(result);
-            std::cerr<<"Username already exists: "<<username<<std::endl;
-            conn_pool_.returnConnection(conn);
-            return false;
-        }
-        if (result){
-            mysql_free_result(result);
-        }
-        // 加密密码
-        std::string encrypted_pwd = encryptPassword(password);
-        // 插入新用户
-        std::string insert_sql = "insert into users (username,password,nickname) values('"+username+"','"+encrypted_pwd+"','"+nickname+"')";
-        if (!conn->execute(insert_sql)){
+        // 加密密码（PBKDF2，耗时较长，应在认证线程池中调用）
+        std::string encrypted_pwd = PasswordHasher::hash(password,password_iterations_);
+        if (encrypted_pwd.empty()) return false;
+        // 插入新用户（用户名已存在时失败）
+        int user_id = 0;
+        if (!store_->createUser(username,encrypted_pwd,nickname,user_id)){
             std::cerr<<"Failed to register user: "<<username<<std::endl;
-            conn_pool_.returnConnection(conn);
             return false;
         }
+        // 清除该用户名与新用户ID的负缓存
+        user_cache_.invalidate(username);
+        user_cache_.invalidate(user_id);
         std::cout<<"User registered successfully: "<<username<<std::endl;
-        conn_pool_.returnConnection(conn);
         return true;
     }
 
     bool UserManager::loginUser(const std::string &username, const std::string &password, int &user_id) {
-        // 获取数据库连接
-        auto conn = conn_pool_.getConnection();
-        if (!conn || !conn->isConnected()){
-            std::cerr<<"Failed to get database connection"<<std::endl;
-            return false;
-        }
-        // 加密密码
-        std::string encrypted_pwd = encryptPassword(password);
         // 查询用户
-        std::string query_sql = "select id from users where username='"+username+"' and password='"+encrypted_pwd+"'";
-        MYSQL_RES* result = conn->query(query_sql);
-        if (!result || mysql_num_rows(result)==0){
-            if (result){
-                mysql_free_result(result);
-            }
+        UserInfo user_info;
+        bool needs_upgrade = false;
+        bool found = false;
+        if (!store_->getUserByName(username,user_info,found) || !found ||
+            !PasswordHasher::verify(password,user_info.password,password_iterations_,needs_upgrade)){
             std::cerr<<"Login failed: invalid username or password"<<std::endl;
-            conn_pool_.returnConnection(conn);
             return false;
         }
-        // 获取用户ID
-        MYSQL_ROW row = mysql_fetch_row(result);
-        user_id = std::stoi(row[0]);
-        mysql_free_result(result);
-        conn_pool_.returnConnection(conn);
-        // 更新用户状态为在线
-        updateUserStatus(user_id, 1);
+        // 旧哈希（MD5或迭代次数不足）在登录成功后透明升级
+        if (needs_upgrade){
+            std::string upgraded = PasswordHasher::hash(password,password_iterations_);
+            if (!upgraded.empty() && store_->updateUserPassword(user_info.id,upgraded)){
+                user_cache_.invalidate(user_info.id);
+                std::cout<<"Password hash upgraded for user "<<user_info.id<<std::endl;
+            }
+        }
+        // 获取用户ID（在线状态由userOnline记录）
+        user_id = user_info.id;
         std::cout<<"User logged in successfully: "<<username<<"(ID:"<<user_id<<")"<<std::endl;
         return true;
     }
     bool UserManager::getUserInfo(int user_id, easychat::UserInfo &user_info) {
-        auto conn = conn_pool_.getConnection();
-        if (!conn || !conn->isConnected()) return false;
-        std::string query_sql = "select id,username,password,nickname,avatar,status from users where id="+std::to_string(user_id);
-        MYSQL_RES *result = conn->query(query_sql);
-        if (!result|| mysql_num_rows(result)==0){
-            if (result) mysql_free_result(result);
-            conn_pool_.returnConnection(conn);
+        switch (user_cache_.getById(user_id,user_info)) {
+            case UserCache::Lookup::HIT:
+                user_info.status = isUserOnline(user_info.id) ? 1 : 0;
+                return true;
+            case UserCache::Lookup::NOT_FOUND:
+                return false;
+            case UserCache::Lookup::MISS:
+                break;
+        }
+        bool found = false;
+        // 存储出错时不缓存，只有确实不存在的用户才写入负缓存
+        if (!store_->getUserById(user_id,user_info,found)) return false;
+        if (!found){
+            user_cache_.putMissing(user_id);
             return false;
         }
-        MYSQL_ROW row = mysql_fetch_row(result);
-        user_info.id = std::stoi(row[0]);
-        user_info.username = row[1];
-        user_info.password = row[2];
-        user_info.nickname = row[3] ? row[3] : "";
-        user_info.avatar = row[4] ? row[4] : "";
-        user_info.status = std::stoi(row[5]);
-        mysql_free_result(result);
-        conn_pool_.returnConnection(conn);
+        user_cache_.put(user_info);
+        // 在线状态以内存注册表为准，数据库中的状态可能尚未写入
+        user_info.status = isUserOnline(user_info.id) ? 1 : 0;
         return true;
     }
 
     bool UserManager::getUserInfo(const std::string &username, easychat::UserInfo &user_info) {
-        auto conn = conn_pool_.getConnection();
-        if (!conn || !conn->isConnected()) return false;
-        std::string query_sql = "select id,username,password,nickname,avatar,status from users where username='"+username+"'";
-        MYSQL_RES *result = conn->query(query_sql);
-        if (!result|| mysql_num_rows(result)==0){
-            if (result) mysql_free_result(result);
-            conn_pool_.returnConnection(conn);
+        switch (user_cache_.getByName(username,user_info)) {
+            case UserCache::Lookup::HIT:
+                user_info.status = isUserOnline(user_info.id) ? 1 : 0;
+                return true;
+            case UserCache::Lookup::NOT_FOUND:
+                return false;
+            case UserCache::Lookup::MISS:
+                break;
+        }
+        bool found = false;
+        // 存储出错时不缓存，只有确实不存在的用户才写入负缓存
+        if (!store_->getUserByName(username,user_info,found)) return false;
+        if (!found){
+            user_cache_.putMissing(username);
             return false;
         }
-        MYSQL_ROW row = mysql_fetch_row(result);
-        user_info.id = std::stoi(row[0]);
-        user_info.username = row[1];
-        user_info.password = row[2];
-        user_info.nickname = row[3] ? row[3] : "";
-        user_info.avatar = row[4] ? row[4] : "";
-        user_info.status = std::stoi(row[5]);
-        mysql_free_result(result);
-        conn_pool_.returnConnection(conn);
+        user_cache_.put(user_info);
+        // 在线状态以内存注册表为准，数据库中的状态可能尚未写入
+        user_info.status = isUserOnline(user_info.id) ? 1 : 0;
         return true;
     }
 
     bool UserManager::updateUserStatus(int user_id, int status) {
-        auto conn = conn_pool_.getConnection();
-        if (!conn || !conn->isConnected()) return false;
-        std::string update_sql = "update users set status="+std::to_string(status)+" where id="+std::to_string(user_id);
-        bool result = conn->execute(update_sql);
-        conn_pool_.returnConnection(conn);
-        return result;
+        bool ok = store_->updateUserStatus(user_id,status);
+        // 缓存中的状态已过期
+        user_cache_.invalidate(user_id);
+        return ok;
     }
 
-    bool UserManager::userOnline(int user_id, int socket_fd, const std::string &ip, int port) {
-        // 更新数据库状态
-        if (!updateUserStatus(user_id,1)) return false;
-        // 更新在线用户映射
-        {
-            std::lock_guard<std::mutex> lock(online_user_mutex_);
-            online_users_[user_id] = socket_fd;
+    bool UserManager::userOnline(int user_id, const ConnectionHandle &handle, const std::string &ip, int port,
+                                 bool resumed) {
+        // 加入在线用户注册表，数据库状态异步批量写入
+        if (!online_users_.add(user_id,handle)){
+            std::cerr<<"Too many devices online for user "<<user_id<<std::endl;
+            return false;
         }
-        //将用户添加到在线用户表
-        auto conn = conn_pool_.getConnection();
-        if (!conn || !conn->isConnected()) return false;
-
-        std::string insert_sql = "insert ignore into online_users(user_id,socket_fd,ip,port) values("
-                +std::to_string(user_id)+", "+std::to_string(socket_fd)+", '"+ip+"', "+std::to_string(port)+")";
-        conn->execute(insert_sql);
-        conn_pool_.returnConnection(conn);
-        std::cout<<"User online: ID="<<user_id<<", SocketFd="<<socket_fd<<std::endl;
+        presence_writer_.online(user_id,handle.fd,ip,port);
+        std::cout<<(resumed ? "User resumed: ID=" : "User online: ID=")<<user_id<<", SocketFd="<<handle.fd<<std::endl;
         return true;
     }
 
-    bool UserManager::userOffline(int user_id) {
-        // 更新数据库状态
-        if (!updateUserStatus(user_id,0)) return false;
-        // 从在线用户映射中移除
-        {
-            std::lock_guard<std::mutex> lock(online_user_mutex_);
-            online_users_.erase(user_id);
-        }
-        // 从在线用户表中移除
-        auto conn = conn_pool_.getConnection();
-        if (!conn || !conn->isConnected()) return false;
-        std::string delete_sql = "delete from online_users where user_id = "+std::to_string(user_id);
-        conn->execute(delete_sql);
-        conn_pool_.returnConnection(conn);
-
+    bool UserManager::userOffline(int user_id,const ConnectionHandle &handle) {
+        bool now_offline = false;
+        online_users_.remove(user_id,handle,&now_offline);
+        // 用户还有其他设备在线时，只移除该设备
+        if (!now_offline) return true;
+        presence_writer_.offline(user_id);
         std::cout<<"User offline ID="<<user_id<<std::endl;
         return true;
     }
-    bool UserManager::isUserOnline(int user_id) {
-        std::lock_guard<std::mutex> lock(online_user_mutex_);
-        return online_users_.find(user_id)!=online_users_.end();
-    }
 
     std::unordered_map<int, UserInfo> UserManager::getOnlineUsers() {
         std::unordered_map<int,UserInfo> online_users;
-        auto conn = conn_pool_.getConnection();
-        if (!conn || !conn->isConnected()) return online_users;
-
-        std::string query_sql = "select user_id from online_users";
-        MYSQL_RES *result = conn->query(query_sql);
-        if (!result) {
-            conn_pool_.returnConnection(conn);
-            return online_users;
-        }
+        // 以内存中的在线注册表为准（数据库中的在线状态异步写入，可能滞后）
+        std::vector<int> user_ids;
+        online_users_.snapshot(user_ids);
 
-        MYSQL_ROW row;
-        while ((row= mysql_fetch_row(result))!= nullptr){
-            int user_id = std::stoi(row[0]);
+        for (int user_id:user_ids){
             UserInfo user_info;
             if (getUserInfo(user_id,user_info)){
                 online_users[user_id] = user_info;
             }
         }
-        mysql_free_result(result);
-        conn_pool_.returnConnection(conn);
         return online_users;
     }
 
     int UserManager::getSocketFdByUserId(int user_id) {
-        std::lock_guard<std::mutex> lock(online_user_mutex_);
-        auto it = online_users_.find(user_id);
-        if (it!=online_users_.end()) return it->second;
-        return -1;
+        ConnectionHandle handle;
+        return online_users_.lookup(user_id,handle) ? handle.fd : -1;
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,117 @@
+//
+// Created by Cando on 2026/10/19.
+//
+#include "../../include/common/id_generator.h"
+#include <chrono>
+#include <iostream>
+
+namespace easychat{
+    namespace {
+        constexpr int kSharedSlot = (1<<IdGenerator::kSlotBits)-1;
+        constexpr uint32_t kMaxSequence = (1u<<IdGenerator::kSequenceBits)-1;
+
+        int64_t currentMs(){
+            return std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()).count();
+        }
+    }
+
+    IdGenerator::IdGenerator() : node_id_(0),slot_bitmap_(0),shared_state_{kSharedSlot,0,0}{
+        for (auto& last_ms:slot_last_ms_){
+            last_ms = 0;
+        }
+    }
+
+    IdGenerator &IdGenerator::getInstance() {
+        static IdGenerator instance;
+        return instance;
+    }
+
+    void IdGenerator::init(int node_id) {
+        if (node_id<0 || node_id>=(1<<kNodeBits)){
+            std::cerr<<"Invalid node id "<<node_id<<", using 0"<<std::endl;
+            node_id = 0;
+        }
+        node_id_ = node_id;
+        std::cout<<"IdGenerator initialized, node id: "<<node_id<<std::endl;
+    }
+
+    IdGenerator::ThreadState::~ThreadState() {
+        if (slot>=0 && slot!=kSharedSlot){
+            IdGenerator::getInstance().releaseSlot(slot,last_ms);
+        }
+    }
+
+    IdGenerator::ThreadState &IdGenerator::localState() {
+        thread_local ThreadState state{-1,0,0};
+        if (state.slot==-1){
+            state.slot = acquireSlot();
+            if (state.slot!=kSharedSlot){
+                // 复用槽时从上一个持有者的时间戳之后开始
+                state.last_ms = slot_last_ms_[state.slot].load();
+                state.sequence = kMaxSequence;
+            }
+        }
+        return state;
+    }
+
+    int IdGenerator::acquireSlot() {
+        uint32_t bitmap = slot_bitmap_.load();
+        while (true){
+            int slot = -1;
+            for (int i=0;i<kSharedSlot;++i){
+                if (!(bitmap & (1u<<i))){
+                    slot = i;
+                    break;
+                }
+            }
+            if (slot==-1) return kSharedSlot;
+            if (slot_bitmap_.compare_exchange_weak(bitmap,bitmap | (1u<<slot))){
+                return slot;
+            }
+        }
+    }
+
+    void IdGenerator::releaseSlot(int slot,int64_t last_ms) {
+        slot_last_ms_[slot] = last_ms;
+        slot_bitmap_.fetch_and(~(1u<<slot));
+    }
+
+    int64_t IdGenerator::generate(ThreadState &state) {
+        int64_t now = currentMs();
+        if (now>state.last_ms){
+            state.last_ms = now;
+            state.sequence = 0;
+        }else if (++state.sequence>kMaxSequence){
+            // 同一毫秒内序列号用尽或时钟回拨：借用下一毫秒，保证单调递增
+            ++state.last_ms;
+            state.sequence = 0;
+        }
+        return ((state.last_ms-kEpochMs)<<(kNodeBits+kSlotBits+kSequenceBits))
+               | (static_cast<int64_t>(node_id_.load())<<(kSlotBits+kSequenceBits))
+               | (static_cast<int64_t>(state.slot)<<kSequenceBits)
+               | state.sequence;
+    }
+
+    int64_t IdGenerator::nextId() {
+        ThreadState& state = localState();
+        if (state.slot==kSharedSlot){
+            std::lock_guard<std::mutex> lock(shared_mutex_);
+            return generate(shared_state_);
+        }
+        return generate(state);
+    }
+
+    int64_t IdGenerator::extractTimestamp(int64_t id) {
+        return (id>>(kNodeBits+kSlotBits+kSequenceBits))+kEpochMs;
+    }
+
+    int IdGenerator::extractNodeId(int64_t id) {
+        return static_cast<int>((id>>(kSlotBits+kSequenceBits)) & ((1<<kNodeBits)-1));
+    }
+
+    int64_t IdGenerator::minIdForTimestamp(int64_t timestamp_ms) {
+        if (timestamp_ms<=kEpochMs) return 0;
+        return (timestamp_ms-kEpochMs)<<(kNodeBits+kSlotBits+kSequenceBits);
+    }
+}
@@ -3,6 +3,7 @@
 //
 #include "../../include/common/protocol.h"
 #include<cstring>
+#include<charconv>
 #include<arpa/inet.h>
 
 namespace easychat{
@@ -76,4 +77,50 @@ namespace easychat{
     size_t Message::getTotalLength() const {
         return sizeof (MessageHeader)+data_.size();
     }
-}
\ No newline at end of file
+
+    SharedFrame makeSharedFrame(const Message &msg) {
+        return std::make_shared<const std::vector<char>>(msg.serialize());
+    }
+
+    FrameWriter::FrameWriter(size_t reserve_size)
+    :frame_start_(0),frame_count_(0),in_frame_(false){
+        buffer_.reserve(reserve_size);
+    }
+
+    void FrameWriter::beginFrame(MessageType type, uint32_t user_id) {
+        if (in_frame_) endFrame();
+        frame_start_ = buffer_.size();
+        // 长度字段先占位，结束帧时回填
+        MessageHeader header;
+        header.length = 0;
+        header.type = hostToNetwork32(static_cast<uint32_t>(type));
+        header.user_id = hostToNetwork32(user_id);
+        const char* bytes = reinterpret_cast<const char*>(&header);
+        buffer_.insert(buffer_.end(),bytes,bytes+sizeof(MessageHeader));
+        in_frame_ = true;
+    }
+
+    void FrameWriter::append(const char *data, size_t length) {
+        buffer_.insert(buffer_.end(),data,data+length);
+    }
+
+    void FrameWriter::appendInt(int64_t value) {
+        char digits[24];
+        auto [ptr,ec] = std::to_chars(digits,digits+sizeof(digits),value);
+        buffer_.insert(buffer_.end(),digits,ptr);
+    }
+
+    void FrameWriter::endFrame() {
+        if (!in_frame_) return;
+        uint32_t total_length = hostToNetwork32(
+                static_cast<uint32_t>(buffer_.size()-frame_start_));
+        std::memcpy(buffer_.data()+frame_start_,&total_length,sizeof(total_length));
+        in_frame_ = false;
+        ++frame_count_;
+    }
+
+    size_t FrameWriter::currentBodySize() const {
+        if (!in_frame_) return 0;
+        return buffer_.size()-frame_start_-sizeof(MessageHeader);
+    }
+}
@@ -0,0 +1,588 @@
+//
+// Created by Cando on 2026/10/19.
+//
+#include "../../include/database/blob_store.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace easychat{
+    namespace {
+        const char* kObjectDir = "objects";
+        const char* kTempDir = "tmp";
+        const char* kRefsDir = "refs";
+        // 不活动超过该时间的上传释放文件描述符与哈希上下文（临时文件保留，可续传）
+        const int64_t kIdleUploadMs = 5*60*1000;
+        // 过期临时文件的检查间隔
+        const int64_t kSweepIntervalMs = 60*60*1000;
+        // 同时进行的上传数上限（每个上传占用一个文件描述符）
+        const size_t kMaxOpenUploads = 1024;
+
+        int64_t nowMs(){
+            return std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+        int64_t nowSeconds(){
+            return std::chrono::duration_cast<std::chrono::seconds>(
+                    std::chrono::system_clock::now().time_since_epoch()).count();
+        }
+        bool resetDigest(EVP_MD_CTX* digest){
+            return EVP_DigestInit_ex(digest,EVP_sha256(),nullptr)==1;
+        }
+    }
+
+    BlobFile::~BlobFile() {
+        if (fd_!=-1) ::close(fd_);
+    }
+
+    BlobStore::Upload::~Upload() {
+        if (fd!=-1) ::close(fd);
+        if (digest) EVP_MD_CTX_free(digest);
+    }
+
+    BlobStore::BlobStore()
+    :max_blob_bytes_(100*1024*1024),upload_ttl_seconds_(86400),user_quota_bytes_(0),max_pending_uploads_(0),
+    last_sweep_ms_(0),gc_due_(false){}
+
+    BlobStore::~BlobStore() {}
+
+    BlobStore &BlobStore::getInstance() {
+        static BlobStore instance;
+        return instance;
+    }
+
+    bool BlobStore::init(const std::string &root_dir, uint64_t max_blob_bytes, int upload_ttl_seconds,
+                         uint64_t user_quota_bytes, int max_pending_uploads) {
+        std::error_code ec;
+        std::filesystem::create_directories(std::filesystem::path(root_dir)/kObjectDir,ec);
+        if (!ec) std::filesystem::create_directories(std::filesystem::path(root_dir)/kTempDir,ec);
+        if (!ec) std::filesystem::create_directories(std::filesystem::path(root_dir)/kRefsDir,ec);
+        if (ec){
+            std::cerr<<"Failed to create blob directory "<<root_dir<<": "<<ec.message()<<std::endl;
+            return false;
+        }
+        root_dir_ = root_dir;
+        max_blob_bytes_ = max_blob_bytes;
+        upload_ttl_seconds_ = upload_ttl_seconds>0 ? upload_ttl_seconds : 86400;
+        user_quota_bytes_ = user_quota_bytes;
+        max_pending_uploads_ = max_pending_uploads;
+        loadUsage();
+        std::lock_guard<std::mutex> lock(mutex_);
+        removeExpiredTemps();
+        last_sweep_ms_ = nowMs();
+        std::cout<<"BlobStore initialized at "<<root_dir_<<", max blob size: "<<max_blob_bytes_<<" bytes, user quota: "
+        <<user_quota_bytes_<<" bytes, pending uploads per user: "<<max_pending_uploads_<<std::endl;
+        return true;
+    }
+
+    void BlobStore::setRoomMembership(RoomMembership membership) {
+        room_membership_ = std::move(membership);
+    }
+
+    void BlobStore::loadUsage() {
+        std::error_code ec;
+        std::lock_guard<std::mutex> refs_lock(refs_mutex_);
+        std::lock_guard<std::mutex> lock(mutex_);
+        usage_.clear();
+        for (const auto& item:std::filesystem::recursive_directory_iterator(std::filesystem::path(root_dir_)/kRefsDir,ec)){
+            std::string sha256 = item.path().filename().string();
+            if (!isValidHash(sha256)) continue;
+            BlobRefs refs;
+            if (!loadRefs(sha256,refs)) continue;
+            for (const auto& uploader:refs.uploaders){
+                usage_[uploader.user_id].stored_bytes += uploader.size;
+            }
+        }
+        // 临时文件（用户ID-哈希）按已写入的字节数计入，续传时更新为声明的字节数
+        for (const auto& item:std::filesystem::directory_iterator(std::filesystem::path(root_dir_)/kTempDir,ec)){
+            std::string name = item.path().filename().string();
+            size_t dash = name.find('-');
+            if (dash==std::string::npos || !isValidHash(std::string_view(name).substr(dash+1))) continue;
+            try {
+                UserUsage& usage = usage_[std::stoi(name.substr(0,dash))];
+                uint64_t size = std::filesystem::file_size(item.path(),ec);
+                if (ec) continue;
+                usage.pending[name.substr(dash+1)] = size;
+                usage.pending_bytes += size;
+            }catch (const std::exception& e){
+                continue;
+            }
+        }
+    }
+
+    std::string BlobStore::objectPath(const std::string &sha256) const {
+        return root_dir_+"/"+kObjectDir+"/"+sha256.substr(0,2)+"/"+sha256;
+    }
+
+    std::string BlobStore::tempPath(int user_id, const std::string &sha256) const {
+        return root_dir_+"/"+kTempDir+"/"+std::to_string(user_id)+"-"+sha256;
+    }
+
+    std::string BlobStore::refsPath(const std::string &sha256) const {
+        return root_dir_+"/"+kRefsDir+"/"+sha256.substr(0,2)+"/"+sha256;
+    }
+
+    bool BlobStore::loadRefs(const std::string &sha256, BlobRefs &refs) const {
+        std::ifstream file(refsPath(sha256));
+        if (!file.is_open()) return false;
+        std::string line;
+        while (std::getline(file,line)){
+            std::istringstream fields(line);
+            char kind;
+            if (!(fields>>kind)) continue;
+            if (kind=='u'){
+                BlobUploader uploader{};
+                if (fields>>uploader.user_id>>uploader.size>>uploader.uploaded_at) refs.uploaders.push_back(uploader);
+            }else if (kind=='m'){
+                BlobRef ref{};
+                if (fields>>ref.message_id>>ref.sender_id>>ref.receiver_id>>ref.room_id) refs.refs.push_back(ref);
+            }
+        }
+        return true;
+    }
+
+    bool BlobStore::appendRefs(const std::string &sha256, const std::string &line) {
+        std::string path = refsPath(sha256);
+        std::error_code ec;
+        std::filesystem::create_directories(std::filesystem::path(path).parent_path(),ec);
+        int fd = ::open(path.c_str(),O_WRONLY|O_CREAT|O_APPEND|O_CLOEXEC,0644);
+        if (fd==-1){
+            std::cerr<<"Failed to open blob refs "<<path<<": "<<strerror(errno)<<std::endl;
+            return false;
+        }
+        bool ok = ::write(fd,line.data(),line.size())==static_cast<ssize_t>(line.size());
+        ::close(fd);
+        return ok;
+    }
+
+    bool BlobStore::writeRefs(const std::string &sha256, const BlobRefs &refs) {
+        std::string content;
+        for (const auto& uploader:refs.uploaders){
+            content += "u "+std::to_string(uploader.user_id)+" "+std::to_string(uploader.size)+" "+
+                       std::to_string(uploader.uploaded_at)+"\n";
+        }
+        for (const auto& ref:refs.refs){
+            content += "m "+std::to_string(ref.message_id)+" "+std::to_string(ref.sender_id)+" "+
+                       std::to_string(ref.receiver_id)+" "+std::to_string(ref.room_id)+"\n";
+        }
+        // 写临时文件后原子替换
+        std::string path = refsPath(sha256);
+        std::string temp_path = path+".tmp";
+        {
+            std::ofstream file(temp_path,std::ios::trunc);
+            if (!(file<<content)) return false;
+        }
+        return ::rename(temp_path.c_str(),path.c_str())==0;
+    }
+
+    bool BlobStore::hasAccess(int user_id, const BlobRefs &refs) const {
+        for (const auto& uploader:refs.uploaders){
+            if (uploader.user_id==user_id) return true;
+        }
+        for (const auto& ref:refs.refs){
+            if (ref.sender_id==user_id) return true;
+            if (ref.room_id==0 ? ref.receiver_id==user_id
+                               : room_membership_ && room_membership_(ref.room_id,user_id)) return true;
+        }
+        return false;
+    }
+
+    bool BlobStore::canAccess(int user_id, const std::string &sha256) {
+        if (!isEnabled() || !isValidHash(sha256)) return false;
+        std::lock_guard<std::mutex> refs_lock(refs_mutex_);
+        BlobRefs refs;
+        return loadRefs(sha256,refs) && hasAccess(user_id,refs);
+    }
+
+    bool BlobStore::addReference(const std::string &sha256, uint64_t size, int64_t message_id, int sender_id,
+                                 int receiver_id, int room_id) {
+        if (!isEnabled() || !isValidHash(sha256)) return false;
+        // 与回收互斥：检查通过后附件不会在记录引用前被删除
+        std::lock_guard<std::mutex> refs_lock(refs_mutex_);
+        BlobRefs refs;
+        if (!exists(sha256,size) || !loadRefs(sha256,refs) || !hasAccess(sender_id,refs)) return false;
+        return appendRefs(sha256,"m "+std::to_string(message_id)+" "+std::to_string(sender_id)+" "+
+                                 std::to_string(receiver_id)+" "+std::to_string(room_id)+"\n");
+    }
+
+    void BlobStore::collectGarbage(const RefCutoff &cutoff) {
+        if (!isEnabled()) return;
+        std::vector<std::string> hashes;
+        std::error_code ec;
+        for (const auto& item:std::filesystem::recursive_directory_iterator(std::filesystem::path(root_dir_)/kRefsDir,ec)){
+            std::string sha256 = item.path().filename().string();
+            if (isValidHash(sha256)) hashes.push_back(std::move(sha256));
+        }
+        int64_t upload_before = nowSeconds()-upload_ttl_seconds_;
+        size_t removed = 0;
+        std::unordered_map<int,uint64_t> released; // 用户ID->回收的字节数
+        for (const auto& sha256:hashes){
+            // 每个附件单独加锁，不长时间阻塞上传与引用
+            std::lock_guard<std::mutex> refs_lock(refs_mutex_);
+            BlobRefs refs;
+            if (!loadRefs(sha256,refs)) continue;
+            size_t before = refs.refs.size();
+            if (cutoff){
+                refs.refs.erase(std::remove_if(refs.refs.begin(),refs.refs.end(),[&cutoff](const BlobRef& ref){
+                    return ref.message_id<cutoff(ref.room_id);
+                }),refs.refs.end());
+            }
+            bool recent_upload = std::any_of(refs.uploaders.begin(),refs.uploaders.end(),[upload_before](const BlobUploader& uploader){
+                return uploader.uploaded_at>=upload_before;
+            });
+            if (refs.refs.empty() && !recent_upload){
+                std::filesystem::remove(objectPath(sha256),ec);
+                std::filesystem::remove(refsPath(sha256),ec);
+                for (const auto& uploader:refs.uploaders){
+                    released[uploader.user_id] += uploader.size;
+                }
+                ++removed;
+            }else if (refs.refs.size()!=before && !writeRefs(sha256,refs)){
+                std::cerr<<"Failed to rewrite blob refs "<<sha256<<std::endl;
+            }
+        }
+        if (!released.empty()){
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (const auto& [user_id,bytes]:released){
+                UserUsage& usage = usage_[user_id];
+                usage.stored_bytes -= std::min(usage.stored_bytes,bytes);
+            }
+        }
+        if (removed>0) std::cout<<"Blob GC removed "<<removed<<" blobs"<<std::endl;
+    }
+
+    bool BlobStore::reservePending(int user_id, const std::string &sha256, uint64_t size, std::string &error) {
+        UserUsage& usage = usage_[user_id];
+        auto it = usage.pending.find(sha256);
+        uint64_t previous = it!=usage.pending.end() ? it->second : 0;
+        if (it==usage.pending.end() && max_pending_uploads_>0 && usage.pending.size()>=static_cast<size_t>(max_pending_uploads_)){
+            error = "Too many pending uploads";
+            return false;
+        }
+        if (user_quota_bytes_>0 && usage.stored_bytes+usage.pending_bytes-previous+size>user_quota_bytes_){
+            error = "Blob quota exceeded";
+            return false;
+        }
+        usage.pending_bytes += size-previous;
+        usage.pending[sha256] = size;
+        return true;
+    }
+
+    void BlobStore::releasePending(int user_id, const std::string &sha256) {
+        auto usage_it = usage_.find(user_id);
+        if (usage_it==usage_.end()) return;
+        UserUsage& usage = usage_it->second;
+        auto it = usage.pending.find(sha256);
+        if (it==usage.pending.end()) return;
+        usage.pending_bytes -= std::min(usage.pending_bytes,it->second);
+        usage.pending.erase(it);
+        if (usage.pending.empty() && usage.stored_bytes==0) usage_.erase(usage_it);
+    }
+
+    bool BlobStore::isValidHash(std::string_view sha256) {
+        if (sha256.size()!=64) return false;
+        for (char c:sha256){
+            if (!((c>='0' && c<='9') || (c>='a' && c<='f'))) return false;
+        }
+        return true;
+    }
+
+    bool BlobStore::parseReference(std::string_view content, std::string &sha256, uint64_t &size, int &message_type) {
+        if (content.rfind("image:",0)==0){
+            message_type = 1;
+            content.remove_prefix(6);
+        }else if (content.rfind("file:",0)==0){
+            message_type = 2;
+            content.remove_prefix(5);
+        }else{
+            return false;
+        }
+        if (content.size()<66 || !isValidHash(content.substr(0,64)) || content[64]!=':') return false;
+        size_t size_end = content.find(':',65);
+        if (size_end==std::string_view::npos || size_end==65 || size_end-65>19) return false;
+        uint64_t value = 0;
+        for (char c:content.substr(65,size_end-65)){
+            if (c<'0' || c>'9') return false;
+            value = value*10+static_cast<uint64_t>(c-'0');
+        }
+        sha256.assign(content.substr(0,64));
+        size = value;
+        return true;
+    }
+
+    bool BlobStore::exists(const std::string &sha256, uint64_t size) {
+        if (!isEnabled() || !isValidHash(sha256)) return false;
+        struct stat st{};
+        if (::stat(objectPath(sha256).c_str(),&st)==-1) return false;
+        return static_cast<uint64_t>(st.st_size)==size;
+    }
+
+    std::shared_ptr<const BlobFile> BlobStore::open(const std::string &sha256) {
+        if (!isEnabled() || !isValidHash(sha256)) return nullptr;
+        int fd = ::open(objectPath(sha256).c_str(),O_RDONLY|O_CLOEXEC);
+        if (fd==-1) return nullptr;
+        struct stat st{};
+        if (::fstat(fd,&st)==-1){
+            ::close(fd);
+            return nullptr;
+        }
+        return std::make_shared<const BlobFile>(fd,static_cast<uint64_t>(st.st_size));
+    }
+
+    bool BlobStore::openUpload(Upload &upload, const std::string &path, std::string &error) {
+        upload.fd = ::open(path.c_str(),O_RDWR|O_CREAT|O_CLOEXEC,0644);
+        if (upload.fd==-1){
+            error = "Blob storage unavailable";
+            std::cerr<<"Failed to open upload file "<<path<<": "<<strerror(errno)<<std::endl;
+            return false;
+        }
+        upload.digest = EVP_MD_CTX_new();
+        if (!upload.digest || !resetDigest(upload.digest)){
+            error = "Blob storage unavailable";
+            return false;
+        }
+        // 续传：重新计算已收到部分的哈希
+        char buf[64*1024];
+        ssize_t bytes;
+        upload.received = 0;
+        while ((bytes=::pread(upload.fd,buf,sizeof (buf),static_cast<off_t>(upload.received)))>0){
+            EVP_DigestUpdate(upload.digest,buf,static_cast<size_t>(bytes));
+            upload.received += static_cast<uint64_t>(bytes);
+        }
+        if (bytes==-1 || upload.received>upload.size){
+            // 临时文件不可读或比声明的大小还大，从头开始
+            if (::ftruncate(upload.fd,0)==-1 || !resetDigest(upload.digest)){
+                error = "Blob storage unavailable";
+                return false;
+            }
+            upload.received = 0;
+        }
+        return true;
+    }
+
+    void BlobStore::releaseIdleUploads(int64_t now_ms) {
+        for (auto it=uploads_.begin();it!=uploads_.end();){
+            // 正在被其他线程使用的上传不释放
+            if (it->second.use_count()==1 && now_ms-it->second->last_active_ms>kIdleUploadMs){
+                it = uploads_.erase(it);
+            }else{
+                ++it;
+            }
+        }
+        if (now_ms-last_sweep_ms_>kSweepIntervalMs){
+            removeExpiredTemps();
+            last_sweep_ms_ = now_ms;
+            gc_due_ = true;
+        }
+    }
+
+    void BlobStore::removeExpiredTemps() {
+        std::error_code ec;
+        auto expire_before = std::filesystem::file_time_type::clock::now()-std::chrono::seconds(upload_ttl_seconds_);
+        for (const auto& item:std::filesystem::directory_iterator(std::filesystem::path(root_dir_)/kTempDir,ec)){
+            std::string name = item.path().filename().string();
+            if (uploads_.count(name)) continue;
+            auto modified = std::filesystem::last_write_time(item.path(),ec);
+            if (ec || modified>=expire_before || !std::filesystem::remove(item.path(),ec)) continue;
+            size_t dash = name.find('-');
+            if (dash==std::string::npos) continue;
+            try {
+                releasePending(std::stoi(name.substr(0,dash)),name.substr(dash+1));
+            }catch (const std::exception& e){
+                continue;
+            }
+        }
+    }
+
+    bool BlobStore::beginUpload(int user_id, const std::string &sha256, uint64_t size, bool &exists,
+                                uint64_t &received, std::string &error) {
+        exists = false;
+        received = 0;
+        if (!isEnabled()){
+            error = "Attachments disabled";
+            return false;
+        }
+        if (!isValidHash(sha256) || size==0){
+            error = "Invalid blob";
+            return false;
+        }
+        if (size>max_blob_bytes_){
+            error = "Blob too large, max:"+std::to_string(max_blob_bytes_);
+            return false;
+        }
+        // 用户已有权访问（上传过或收发过引用它的消息）时无需上传；
+        // 只是其他用户上传过时照常上传，回复与附件不存在时相同
+        std::string key = std::to_string(user_id)+"-"+sha256;
+        if (this->exists(sha256,size) && canAccess(user_id,sha256)){
+            // 之前开始的上传不再需要，释放配额并删除临时文件
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto upload_it = uploads_.find(key);
+            if (upload_it!=uploads_.end() && upload_it->second.use_count()==1) upload_it = uploads_.erase(upload_it);
+            auto usage_it = usage_.find(user_id);
+            if (upload_it==uploads_.end() && usage_it!=usage_.end() && usage_it->second.pending.count(sha256)){
+                releasePending(user_id,sha256);
+                std::error_code ec;
+                std::filesystem::remove(tempPath(user_id,sha256),ec);
+            }
+            exists = true;
+            received = size;
+            return true;
+        }
+        int64_t now_ms = nowMs();
+        std::shared_ptr<Upload> upload;
+        bool collect = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            releaseIdleUploads(now_ms);
+            std::swap(collect,gc_due_);
+            auto& slot = uploads_[key];
+            if (!slot){
+                if (uploads_.size()>kMaxOpenUploads){
+                    uploads_.erase(key);
+                    error = "Too many uploads";
+                    return false;
+                }
+                if (!reservePending(user_id,sha256,size,error)){
+                    uploads_.erase(key);
+                    return false;
+                }
+                slot = std::make_shared<Upload>();
+            }
+            upload = slot;
+        }
+        if (collect) collectGarbage(nullptr);
+        std::lock_guard<std::mutex> upload_lock(upload->mutex);
+        upload->last_active_ms = now_ms;
+        if (upload->finished){
+            exists = true;
+            received = size;
+            return true;
+        }
+        if (upload->fd==-1){
+            upload->size = size;
+            if (!openUpload(*upload,tempPath(user_id,sha256),error)){
+                std::lock_guard<std::mutex> lock(mutex_);
+                uploads_.erase(key);
+                releasePending(user_id,sha256);
+                return false;
+            }
+        }else if (upload->size!=size){
+            error = "Blob size mismatch";
+            return false;
+        }
+        received = upload->received;
+        return true;
+    }
+
+    bool BlobStore::appendChunk(int user_id, const std::string &sha256, uint64_t offset, const char *data,
+                                size_t length, bool &completed, uint64_t &received, std::string &error) {
+        completed = false;
+        received = 0;
+        std::string key = std::to_string(user_id)+"-"+sha256;
+        std::shared_ptr<Upload> upload;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = uploads_.find(key);
+            if (it!=uploads_.end()) upload = it->second;
+        }
+        if (!upload){
+            error = "Upload not started";
+            return false;
+        }
+        std::lock_guard<std::mutex> upload_lock(upload->mutex);
+        received = upload->received;
+        if (upload->fd==-1 || upload->finished){
+            error = "Upload not started";
+            return false;
+        }
+        if (offset!=upload->received || length==0 || upload->received+length>upload->size){
+            error = "Offset mismatch";
+            return false;
+        }
+        size_t written = 0;
+        while (written<length){
+            ssize_t bytes = ::pwrite(upload->fd,data+written,length-written,static_cast<off_t>(offset+written));
+            if (bytes==-1){
+                if (errno==EINTR) continue;
+                std::cerr<<"Failed to write upload "<<key<<": "<<strerror(errno)<<std::endl;
+                error = "Blob storage unavailable";
+                return false;
+            }
+            written += static_cast<size_t>(bytes);
+        }
+        EVP_DigestUpdate(upload->digest,data,length);
+        upload->received += length;
+        upload->last_active_ms = nowMs();
+        received = upload->received;
+        if (upload->received<upload->size) return true;
+
+        // 最后一块：校验哈希，刷盘后原子重命名为正式文件
+        unsigned char digest[EVP_MAX_MD_SIZE];
+        unsigned int digest_length = 0;
+        EVP_DigestFinal_ex(upload->digest,digest,&digest_length);
+        static const char kHex[] = "0123456789abcdef";
+        std::string actual;
+        for (unsigned int i=0;i<digest_length;++i){
+            actual.push_back(kHex[digest[i]>>4]);
+            actual.push_back(kHex[digest[i] & 0xF]);
+        }
+        std::string temp_path = tempPath(user_id,sha256);
+        if (actual!=sha256){
+            // 内容与声明的哈希不一致，丢弃后从头上传
+            if (::ftruncate(upload->fd,0)==-1 || !resetDigest(upload->digest)){
+                error = "Blob storage unavailable";
+                return false;
+            }
+            upload->received = 0;
+            received = 0;
+            error = "Hash mismatch";
+            return false;
+        }
+        std::string object_path = objectPath(sha256);
+        bool uploaded_before = false;
+        {
+            // 落盘与记录上传者在引用锁内完成，回收不会删除刚完成的附件
+            std::lock_guard<std::mutex> refs_lock(refs_mutex_);
+            std::error_code ec;
+            if (exists(sha256,upload->size)){
+                // 其他用户上传过相同内容，内容已校验一致，丢弃临时文件
+                std::filesystem::remove(temp_path,ec);
+            }else{
+                std::filesystem::create_directories(std::filesystem::path(object_path).parent_path(),ec);
+                if (ec || ::fdatasync(upload->fd)==-1 || ::rename(temp_path.c_str(),object_path.c_str())==-1){
+                    std::cerr<<"Failed to store blob "<<sha256<<": "<<(ec ? ec.message() : strerror(errno))<<std::endl;
+                    error = "Blob storage unavailable";
+                    return false;
+                }
+            }
+            BlobRefs refs;
+            loadRefs(sha256,refs);
+            for (const auto& uploader:refs.uploaders){
+                if (uploader.user_id==user_id) uploaded_before = true;
+            }
+            if (!uploaded_before && !appendRefs(sha256,"u "+std::to_string(user_id)+" "+std::to_string(upload->size)+" "+
+                                                       std::to_string(nowSeconds())+"\n")){
+                error = "Blob storage unavailable";
+                return false;
+            }
+        }
+        ::close(upload->fd);
+        upload->fd = -1;
+        upload->finished = true;
+        completed = true;
+        std::lock_guard<std::mutex> lock(mutex_);
+        uploads_.erase(key);
+        releasePending(user_id,sha256);
+        if (!uploaded_before) usage_[user_id].stored_bytes += upload->size;
+        std::cout<<"Blob stored: "<<sha256<<", "<<upload->size<<" bytes"<<std::endl;
+        return true;
+    }
+}
@@ -0,0 +1,59 @@
+//
+// Created by Cando on 2026/10/19.
+//
+#include "../../include/database/circuit_breaker.h"
+#include <chrono>
+#include <iostream>
+
+namespace easychat{
+    CircuitBreaker::CircuitBreaker()
+    : state_(static_cast<int>(State::CLOSED)),consecutive_failures_(0),opened_at_ms_(0),
+    failure_threshold_(5),open_timeout_ms_(5000){}
+
+    int64_t CircuitBreaker::nowMs() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void CircuitBreaker::configure(int failure_threshold, int open_timeout_ms) {
+        failure_threshold_ = failure_threshold>0 ? failure_threshold : 1;
+        open_timeout_ms_ = open_timeout_ms>0 ? open_timeout_ms : 0;
+    }
+
+    bool CircuitBreaker::allowRequest(bool& probe) {
+        probe = false;
+        int state = state_.load();
+        if (state==static_cast<int>(State::CLOSED)) return true;
+        // 冷却结束后每个冷却周期只放行一个探测请求（探测请求迟迟没有结果时也会再放行）
+        int64_t now = nowMs();
+        int64_t opened_at = opened_at_ms_.load();
+        if (now-opened_at<open_timeout_ms_.load()) return false;
+        if (!opened_at_ms_.compare_exchange_strong(opened_at,now)) return false;
+        if (state_.exchange(static_cast<int>(State::HALF_OPEN))==static_cast<int>(State::OPEN)){
+            std::cout<<"Circuit breaker half-open, probing database"<<std::endl;
+        }
+        probe = true;
+        return true;
+    }
+
+    void CircuitBreaker::recordSuccess(bool probe) {
+        // 断开前已取出的连接迟到的成功不代表数据库已恢复
+        if (!probe && state_.load()!=static_cast<int>(State::CLOSED)) return;
+        consecutive_failures_ = 0;
+        if (state_.exchange(static_cast<int>(State::CLOSED))!=static_cast<int>(State::CLOSED)){
+            std::cout<<"Circuit breaker closed, database recovered"<<std::endl;
+        }
+    }
+
+    void CircuitBreaker::recordFailure() {
+        int failures = consecutive_failures_.fetch_add(1)+1;
+        int state = state_.load();
+        if (state==static_cast<int>(State::HALF_OPEN) ||
+            (state==static_cast<int>(State::CLOSED) && failures>=failure_threshold_.load())){
+            opened_at_ms_ = nowMs();
+            if (state_.exchange(static_cast<int>(State::OPEN))!=static_cast<int>(State::OPEN)){
+                std::cerr<<"Circuit breaker opened after "<<failures<<" consecutive failures"<<std::endl;
+            }
+        }
+    }
+}
@@ -2,9 +2,19 @@
 // Created by Cando on 2026/1/29.
 //
 #include "../../include/database/connection_pool.h"
+#include "../../include/database/query_stats.h"
+#include <mysql/errmsg.h>
+#include <chrono>
 #include <iostream>
 namespace easychat {
-    MySQLConnection::MySQLConnection() : mysql_(nullptr),connected_(false){
+    namespace {
+        int64_t elapsedUs(std::chrono::steady_clock::time_point start){
+            return std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now()-start).count();
+        }
+    }
+    MySQLConnection::MySQLConnection() : mysql_(nullptr),connected_(false),connection_lost_(false),pool_wait_us_(0),
+    probe_(false),statement_succeeded_(false),port_(3306),connect_timeout_(0),read_timeout_(0),write_timeout_(0){
         //初始化MySQL连接对象
         mysql_ = mysql_init(nullptr);
         if (mysql_== nullptr){
@@ -17,6 +27,15 @@ namespace easychat {
     bool MySQLConnection::connect(const std::string &host, uint16_t port, const std::string &user,
                                   const std::string &password, const std::string &database) {
         if (mysql_== nullptr) return false;
+        host_ = host;
+        port_ = port;
+        user_ = user;
+        password_ = password;
+        database_ = database;
+        // 设置超时，避免数据库卡死时工作线程无限阻塞
+        if (connect_timeout_>0) mysql_options(mysql_,MYSQL_OPT_CONNECT_TIMEOUT,&connect_timeout_);
+        if (read_timeout_>0) mysql_options(mysql_,MYSQL_OPT_READ_TIMEOUT,&read_timeout_);
+        if (write_timeout_>0) mysql_options(mysql_,MYSQL_OPT_WRITE_TIMEOUT,&write_timeout_);
         // 连接到mysql服务器
         MYSQL* result = mysql_real_connect(
                 mysql_,
@@ -39,28 +58,92 @@ namespace easychat {
         }
 
         connected_ = true;
+        connection_lost_ = false;
         std::cout<<"MySQL connection established"<<std::endl;
         return true;
     }
+
+    void MySQLConnection::setTimeouts(int connect_timeout, int read_timeout, int write_timeout) {
+        connect_timeout_ = connect_timeout>0 ? static_cast<unsigned int>(connect_timeout) : 0;
+        read_timeout_ = read_timeout>0 ? static_cast<unsigned int>(read_timeout) : 0;
+        write_timeout_ = write_timeout>0 ? static_cast<unsigned int>(write_timeout) : 0;
+    }
+
+    bool MySQLConnection::reconnect() {
+        close();
+        mysql_ = mysql_init(nullptr);
+        if (mysql_== nullptr){
+            std::cerr<<"Failed to initialize MySQL connection"<<std::endl;
+            return false;
+        }
+        if (!connect(host_,port_,user_,password_,database_)){
+            connection_lost_ = true;
+            return false;
+        }
+        return true;
+    }
+
+    void MySQLConnection::checkError() {
+        unsigned int error = mysql_errno(mysql_);
+        if (error==CR_SERVER_GONE_ERROR || error==CR_SERVER_LOST ||
+            error==CR_CONNECTION_ERROR || error==CR_CONN_HOST_ERROR){
+            // 连接已失效，下次取出时重连
+            connection_lost_ = true;
+            connected_ = false;
+        }
+    }
     bool MySQLConnection::execute(const std::string &sql) {
         if (!connected_ || mysql_ == nullptr) return false;
-        // 执行SQL语句
+        // 执行SQL语句（使用单调时钟计时）
+        auto start = std::chrono::steady_clock::now();
         if (mysql_query(mysql_,sql.c_str())!=0){
+            recordStatement(sql,elapsedUs(start),0,false);
             std::cerr<<"Failed to execute SQL: "<<mysql_error(mysql_)<<std::endl;
+            checkError();
             return false;
         }
+        recordStatement(sql,elapsedUs(start),static_cast<int64_t>(mysql_affected_rows(mysql_)),true);
+        statement_succeeded_ = true;
         return true;
     }
 
     MYSQL_RES *MySQLConnection::query(const std::string &sql) {
-        if (!execute(sql)) return nullptr;
+        if (!connected_ || mysql_ == nullptr) return nullptr;
+        // 执行时间包含结果集传输
+        auto start = std::chrono::steady_clock::now();
+        if (mysql_query(mysql_,sql.c_str())!=0){
+            recordStatement(sql,elapsedUs(start),0,false);
+            std::cerr<<"Failed to execute SQL: "<<mysql_error(mysql_)<<std::endl;
+            checkError();
+            return nullptr;
+        }
         // 获取查询结果
         MYSQL_RES* result = mysql_store_result(mysql_);
+        int64_t exec_us = elapsedUs(start);
         if (result== nullptr){
+            recordStatement(sql,exec_us,0,false);
             std::cerr<<"Failed to get query result: "<<mysql_error(mysql_)<<std::endl;
+            checkError();
+            return nullptr;
         }
+        recordStatement(sql,exec_us,static_cast<int64_t>(mysql_num_rows(result)),true);
+        statement_succeeded_ = true;
         return result;
     }
+
+    void MySQLConnection::recordStatement(const std::string &sql, int64_t exec_us, int64_t rows, bool ok) {
+        // 等待时间只计入取出连接后的第一条语句
+        QueryStats::getInstance().record(sql,pool_wait_us_,exec_us,rows,ok);
+        pool_wait_us_ = 0;
+    }
+    std::string MySQLConnection::escape(const std::string &value) {
+        if (mysql_ == nullptr) return value;
+        // 转义后的长度最多为原长度的2倍+1
+        std::string escaped(value.size()*2+1,'\0');
+        unsigned long length = mysql_real_escape_string(mysql_,&escaped[0],value.c_str(),value.size());
+        escaped.resize(length);
+        return escaped;
+    }
     void MySQLConnection::close() {
         // 关闭MySQL连接
         if (mysql_!= nullptr){
@@ -69,7 +152,8 @@ namespace easychat {
         }
         connected_ = false;
     }
-    ConnectionPool::ConnectionPool() :port_(3306),pool_size_(10),initialized_(false){}
+    ConnectionPool::ConnectionPool() :port_(3306),pool_size_(10),initialized_(false),
+    connect_timeout_(3),read_timeout_(5),write_timeout_(5),acquire_timeout_ms_(1000){}
     ConnectionPool::~ConnectionPool() {close();}
 
     ConnectionPool &ConnectionPool::getInstance() {
@@ -93,6 +177,7 @@ namespace easychat {
         // 创建指定数量的连接
         for (size_t i=0;i<pool_size;++i){
             auto conn = std::make_shared<MySQLConnection>();
+            conn->setTimeouts(connect_timeout_,read_timeout_,write_timeout_);
             if (!conn->connect(host_,port_,user_,password_,database_)){
                 std::cout << "Failed to create connection "<< i << std::endl;
                 continue;
@@ -109,24 +194,64 @@ namespace easychat {
         return true;
     }
 
+    void ConnectionPool::configureResilience(int connect_timeout, int read_timeout, int write_timeout,
+                                             int acquire_timeout_ms, int failure_threshold, int open_timeout_ms) {
+        connect_timeout_ = connect_timeout;
+        read_timeout_ = read_timeout;
+        write_timeout_ = write_timeout;
+        acquire_timeout_ms_ = acquire_timeout_ms;
+        breaker_.configure(failure_threshold,open_timeout_ms);
+    }
+
     std::shared_ptr<MySQLConnection> ConnectionPool::getConnection() {
-        std::unique_lock<std::mutex> lock(mutex_);
-        // 等待可用连接
-        condition_.wait(lock,[this]{
-            return !this->connections_.empty() || !this->initialized_;
-        });
-        if (!initialized_){
+        // 熔断断开时快速失败，避免工作线程堆积在故障数据库上
+        bool probe = false;
+        if (!breaker_.allowRequest(probe)){
             return nullptr;
         }
-        // 从队列中取出连接
-        auto conn = connections_.front();
-        connections_.pop();
-
+        auto wait_start = std::chrono::steady_clock::now();
+        std::shared_ptr<MySQLConnection> conn;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            // 等待可用连接（有上限）
+            bool ready = condition_.wait_for(lock,std::chrono::milliseconds(acquire_timeout_ms_),[this]{
+                return !this->connections_.empty() || !this->initialized_;
+            });
+            if (!initialized_){
+                return nullptr;
+            }
+            if (!ready){
+                // 所有连接都卡在数据库上
+                std::cerr<<"Timed out waiting for database connection"<<std::endl;
+                breaker_.recordFailure();
+                return nullptr;
+            }
+            // 从队列中取出连接
+            conn = connections_.front();
+            connections_.pop();
+        }
+        // 失效的连接在锁外重连
+        if (!conn->isConnected() && !conn->reconnect()){
+            breaker_.recordFailure();
+            std::lock_guard<std::mutex> lock(mutex_);
+            connections_.push(conn);
+            condition_.notify_one();
+            return nullptr;
+        }
+        conn->setPoolWait(elapsedUs(wait_start));
+        conn->beginLease(probe);
         return conn;
     }
 
     void ConnectionPool::returnConnection(std::shared_ptr<MySQLConnection> conn) {
         if (conn== nullptr) return;
+        // 根据本次使用结果更新熔断器：连接级错误计为失败，有语句实际执行成功才计为成功
+        // （没有执行语句或只有SQL级错误的使用不改变熔断器）
+        if (conn->lastErrorIsConnectionLoss()){
+            breaker_.recordFailure();
+        }else if (conn->statementSucceeded()){
+            breaker_.recordSuccess(conn->isProbe());
+        }
         std::lock_guard<std::mutex> lock(mutex_);
         // 将连接归还队列
         connections_.push(conn);
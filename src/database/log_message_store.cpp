@@ -0,0 +1,1491 @@
+//
+// Created by Cando on 2026/10/19.
+//
+#include "../../include/database/log_message_store.h"
+#include "../../include/database/record_codec.h"
+#include "../../include/common/id_generator.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <ctime>
+#include <chrono>
+#include <filesystem>
+#include <algorithm>
+#include <iostream>
+#include <unordered_set>
+
+namespace easychat{
+    using namespace record;
+
+    namespace {
+        // 将时间戳格式化为与MySQL一致的字符串
+        std::string formatTime(int64_t timestamp){
+            time_t t = static_cast<time_t>(timestamp);
+            struct tm tm_value;
+            localtime_r(&t,&tm_value);
+            char buffer[32];
+            strftime(buffer,sizeof (buffer),"%Y-%m-%d %H:%M:%S",&tm_value);
+            return buffer;
+        }
+
+        // 按消息ID有序插入：ID在加锁前预先分配，并发发送或溢写区回放时较小的ID可能晚于较大的ID写入
+        void insertSorted(std::vector<int64_t>& message_ids,int64_t message_id){
+            if (message_ids.empty() || message_ids.back()<message_id){
+                message_ids.push_back(message_id);
+                return;
+            }
+            message_ids.insert(std::upper_bound(message_ids.begin(),message_ids.end(),message_id),message_id);
+        }
+
+        // 段文件命名
+        const char* kSegmentPrefix = "segment-";
+        const char* kSegmentSuffix = ".log";
+    }
+
+    LogMessageStore::LogMessageStore()
+    :segment_size_(64*1024*1024),compaction_interval_(300),sync_interval_ms_(100),
+    active_segment_(0),next_room_id_(1),next_user_id_(1),dirty_(false),running_(false){}
+
+    LogMessageStore::~LogMessageStore() {
+        close();
+    }
+
+    std::string LogMessageStore::segmentPath(uint32_t segment_id) const {
+        char name[32];
+        snprintf(name,sizeof (name),"%s%06u%s",kSegmentPrefix,segment_id,kSegmentSuffix);
+        return data_dir_+"/"+name;
+    }
+
+    uint64_t LogMessageStore::conversationKey(int user_id1, int user_id2) {
+        uint32_t low = static_cast<uint32_t>(std::min(user_id1,user_id2));
+        uint32_t high = static_cast<uint32_t>(std::max(user_id1,user_id2));
+        return (static_cast<uint64_t>(low)<<32) | high;
+    }
+
+    std::string LogMessageStore::encodeMessage(int64_t message_id, const MessageEntry &entry, const std::string &content) {
+        std::string payload;
+        payload.reserve(48+content.size());
+        putInt64(payload,message_id);
+        putInt32(payload,entry.sender_id);
+        putInt32(payload,entry.receiver_id);
+        putInt32(payload,entry.message_type);
+        putInt32(payload,entry.is_offline);
+        putInt32(payload,entry.is_read);
+        putInt64(payload,entry.created_at);
+        putString(payload,content);
+        // 序号追加在正文之后，旧格式记录没有该字段
+        putInt64(payload,entry.seq);
+        return payload;
+    }
+
+    std::string LogMessageStore::encodeUser(const UserInfo &info) {
+        std::string payload;
+        putInt32(payload,info.id);
+        putInt32(payload,info.status);
+        putString(payload,info.username);
+        putString(payload,info.password);
+        putString(payload,info.nickname);
+        putString(payload,info.avatar);
+        return payload;
+    }
+
+    std::string LogMessageStore::encodeDeviceCursor(int user_id, const std::string &device_id, int64_t message_id) {
+        std::string payload;
+        putInt32(payload,user_id);
+        putInt64(payload,message_id);
+        putString(payload,device_id);
+        return payload;
+    }
+
+    std::string LogMessageStore::encodeRoom(int room_id, const RoomEntry &entry) {
+        std::string payload;
+        putInt32(payload,room_id);
+        putInt32(payload,entry.owner_id);
+        putString(payload,entry.name);
+        return payload;
+    }
+
+    std::string LogMessageStore::encodeRoomMember(int room_id, int user_id, int64_t joined_message_id, bool joined) {
+        std::string payload;
+        putInt32(payload,room_id);
+        putInt32(payload,user_id);
+        putInt64(payload,joined_message_id);
+        putInt32(payload,joined ? 1 : 0);
+        return payload;
+    }
+
+    std::string LogMessageStore::encodeSeqFloor(int room_id, uint64_t conversation_key, int64_t seq) {
+        std::string payload;
+        putInt32(payload,room_id);
+        putInt64(payload,static_cast<int64_t>(conversation_key));
+        putInt64(payload,seq);
+        return payload;
+    }
+
+    bool LogMessageStore::init(const std::string &data_dir, size_t segment_size,
+                               int compaction_interval, int sync_interval_ms) {
+        data_dir_ = data_dir;
+        segment_size_ = segment_size;
+        compaction_interval_ = compaction_interval;
+        sync_interval_ms_ = sync_interval_ms;
+
+        // 创建数据目录
+        std::error_code ec;
+        std::filesystem::create_directories(data_dir_,ec);
+        if (ec){
+            std::cerr<<"Failed to create data directory "<<data_dir_<<": "<<ec.message()<<std::endl;
+            return false;
+        }
+        // 收集段文件，清理上次压缩残留的临时文件
+        std::vector<uint32_t> segment_ids;
+        for (const auto& item:std::filesystem::directory_iterator(data_dir_)){
+            std::string file_name = item.path().filename().string();
+            if (item.path().extension()==".compact"){
+                std::filesystem::remove(item.path(),ec);
+                continue;
+            }
+            if (file_name.rfind(kSegmentPrefix,0)!=0 || item.path().extension()!=kSegmentSuffix) continue;
+            try {
+                segment_ids.push_back(static_cast<uint32_t>(std::stoul(file_name.substr(strlen(kSegmentPrefix)))));
+            }catch (const std::exception& e){
+                std::cerr<<"Ignoring unexpected file in data directory: "<<file_name<<std::endl;
+            }
+        }
+        std::sort(segment_ids.begin(),segment_ids.end());
+
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        // 按顺序重放所有段
+        for (uint32_t segment_id:segment_ids){
+            std::string path = segmentPath(segment_id);
+            int fd = ::open(path.c_str(),O_RDWR);
+            if (fd==-1){
+                std::cerr<<"Failed to open segment "<<path<<": "<<strerror(errno)<<std::endl;
+                return false;
+            }
+            segments_[segment_id] = Segment{fd,0,0};
+            uint64_t valid_size = replaySegment(segment_id,fd);
+            uint64_t file_size = std::filesystem::file_size(path,ec);
+            if (valid_size<file_size){
+                // 截掉尾部不完整的记录（上次写入时崩溃）
+                std::cerr<<"Truncating torn tail of "<<path<<" at offset "<<valid_size<<std::endl;
+                if (::ftruncate(fd,static_cast<off_t>(valid_size))==-1){
+                    std::cerr<<"Failed to truncate segment: "<<strerror(errno)<<std::endl;
+                }
+            }
+            segments_[segment_id].size = valid_size;
+        }
+        // 最后一个段继续作为活动段
+        if (segments_.empty()){
+            if (!openActiveSegment(1)) return false;
+        }else{
+            active_segment_ = segments_.rbegin()->first;
+        }
+        rebuildIndexes();
+
+        running_ = true;
+        background_thread_ = std::thread([this]{this->backgroundLoop();});
+        std::cout<<"LogMessageStore initialized at "<<data_dir_<<": "<<segments_.size()<<" segments, "
+        <<messages_.size()<<" messages, "<<users_.size()<<" users, "<<rooms_.size()<<" rooms"<<std::endl;
+        return true;
+    }
+
+    bool LogMessageStore::openActiveSegment(uint32_t segment_id) {
+        std::string path = segmentPath(segment_id);
+        int fd = ::open(path.c_str(),O_RDWR | O_CREAT | O_TRUNC,0644);
+        if (fd==-1){
+            std::cerr<<"Failed to create segment "<<path<<": "<<strerror(errno)<<std::endl;
+            return false;
+        }
+        segments_[segment_id] = Segment{fd,0,0};
+        active_segment_ = segment_id;
+        return true;
+    }
+
+    uint64_t LogMessageStore::replaySegment(uint32_t segment_id, int fd) {
+        std::string data;
+        char buffer[64*1024];
+        uint64_t file_offset = 0;
+        ssize_t bytes;
+        while ((bytes=::pread(fd,buffer,sizeof (buffer),file_offset))>0){
+            data.append(buffer,bytes);
+            file_offset += bytes;
+        }
+        uint64_t offset = 0;
+        while (offset+sizeof (RecordHeader)<=data.size()){
+            RecordHeader header;
+            std::memcpy(&header,data.data()+offset,sizeof (RecordHeader));
+            uint64_t record_length = sizeof (RecordHeader)+header.length;
+            if (offset+record_length>data.size()) break;
+            const char* payload = data.data()+offset+sizeof (RecordHeader);
+            if (checksum(header.type,payload,header.length)!=header.checksum) break;
+            applyRecord(header.type,payload,header.length,
+                        RecordLocation{segment_id,offset,static_cast<uint32_t>(record_length)});
+            offset += record_length;
+        }
+        return offset;
+    }
+
+    void LogMessageStore::applyRecord(uint8_t type, const char *payload, uint32_t length,
+                                      const RecordLocation &location) {
+        PayloadReader reader(payload,length);
+        switch (type) {
+            case RECORD_MESSAGE:{
+                MessageEntry entry;
+                int64_t message_id = reader.getInt64();
+                entry.sender_id = reader.getInt32();
+                entry.receiver_id = reader.getInt32();
+                entry.message_type = reader.getInt32();
+                entry.is_offline = reader.getInt32();
+                entry.is_read = reader.getInt32();
+                entry.created_at = reader.getInt64();
+                reader.getStringView();
+                entry.seq = reader.hasMore() ? reader.getInt64() : 0;
+                entry.location = location;
+                if (!reader.ok()) return;
+                // 同一消息出现多次（压缩中途崩溃），旧记录变为垃圾
+                auto it = messages_.find(message_id);
+                if (it!=messages_.end()){
+                    segments_[it->second.location.segment].dead_bytes += it->second.location.length;
+                }
+                messages_[message_id] = entry;
+                break;
+            }
+            case RECORD_MESSAGE_FLAGS:{
+                int64_t message_id = reader.getInt64();
+                int is_offline = reader.getInt32();
+                int is_read = reader.getInt32();
+                if (!reader.ok()) return;
+                auto it = messages_.find(message_id);
+                if (it!=messages_.end()){
+                    it->second.is_offline = is_offline;
+                    it->second.is_read = is_read;
+                }
+                segments_[location.segment].dead_bytes += location.length;
+                break;
+            }
+            case RECORD_DELIVERED:{
+                uint32_t count = reader.getInt32();
+                for (uint32_t i=0;i<count && reader.ok();++i){
+                    int receiver_id = reader.getInt32();
+                    int64_t message_id = reader.getInt64();
+                    auto it = messages_.find(message_id);
+                    if (reader.ok() && it!=messages_.end() && it->second.receiver_id==receiver_id){
+                        it->second.is_offline = 0;
+                    }
+                }
+                segments_[location.segment].dead_bytes += location.length;
+                break;
+            }
+            case RECORD_READ:{
+                // 消息记录可能晚于回执出现（压缩后），重建索引时统一应用
+                uint32_t count = reader.getInt32();
+                for (uint32_t i=0;i<count && reader.ok();++i){
+                    int reader_id = reader.getInt32();
+                    int peer_id = reader.getInt32();
+                    int64_t seq = reader.getInt64();
+                    if (!reader.ok()) break;
+                    int64_t& cursor = read_cursors_[std::make_pair(reader_id,peer_id)];
+                    cursor = std::max(cursor,seq);
+                }
+                segments_[location.segment].dead_bytes += location.length;
+                break;
+            }
+            case RECORD_USER:{
+                UserEntry entry;
+                entry.info.id = reader.getInt32();
+                entry.info.status = reader.getInt32();
+                entry.info.username = reader.getString();
+                entry.info.password = reader.getString();
+                entry.info.nickname = reader.getString();
+                entry.info.avatar = reader.getString();
+                entry.location = location;
+                if (!reader.ok()) return;
+                auto it = users_.find(entry.info.id);
+                if (it!=users_.end()){
+                    segments_[it->second.location.segment].dead_bytes += it->second.location.length;
+                }
+                user_names_[entry.info.username] = entry.info.id;
+                next_user_id_ = std::max(next_user_id_,entry.info.id+1);
+                users_[entry.info.id] = std::move(entry);
+                break;
+            }
+            case RECORD_USER_STATUS:{
+                int user_id = reader.getInt32();
+                int status = reader.getInt32();
+                if (!reader.ok()) return;
+                auto it = users_.find(user_id);
+                if (it!=users_.end()){
+                    it->second.info.status = status;
+                }
+                segments_[location.segment].dead_bytes += location.length;
+                break;
+            }
+            case RECORD_DEVICE_CURSOR:{
+                int user_id = reader.getInt32();
+                int64_t message_id = reader.getInt64();
+                std::string device_id = reader.getString();
+                if (!reader.ok()) return;
+                auto key = std::make_pair(user_id,std::move(device_id));
+                auto it = device_cursors_.find(key);
+                if (it!=device_cursors_.end()){
+                    segments_[it->second.location.segment].dead_bytes += it->second.location.length;
+                }
+                device_cursors_[key] = DeviceCursor{message_id,location};
+                break;
+            }
+            case RECORD_ROOM:{
+                RoomEntry entry;
+                int room_id = reader.getInt32();
+                entry.owner_id = reader.getInt32();
+                entry.name = reader.getString();
+                entry.location = location;
+                if (!reader.ok()) return;
+                auto it = rooms_.find(room_id);
+                if (it!=rooms_.end()){
+                    segments_[it->second.location.segment].dead_bytes += it->second.location.length;
+                }
+                next_room_id_ = std::max(next_room_id_,room_id+1);
+                rooms_[room_id] = std::move(entry);
+                break;
+            }
+            case RECORD_ROOM_MEMBER:{
+                int room_id = reader.getInt32();
+                int user_id = reader.getInt32();
+                int64_t joined_message_id = reader.getInt64();
+                int joined = reader.getInt32();
+                if (!reader.ok()) return;
+                auto key = std::make_pair(room_id,user_id);
+                auto it = room_members_.find(key);
+                if (it!=room_members_.end()){
+                    segments_[it->second.location.segment].dead_bytes += it->second.location.length;
+                }
+                if (joined){
+                    room_members_[key] = RoomMemberEntry{joined_message_id,location};
+                }else{
+                    // 退出记录本身也是垃圾
+                    if (it!=room_members_.end()) room_members_.erase(it);
+                    segments_[location.segment].dead_bytes += location.length;
+                }
+                break;
+            }
+            case RECORD_ROOM_MESSAGE:{
+                MessageEntry entry;
+                int64_t message_id = reader.getInt64();
+                entry.sender_id = reader.getInt32();
+                entry.receiver_id = reader.getInt32();
+                entry.message_type = reader.getInt32();
+                entry.is_offline = reader.getInt32();
+                entry.is_read = reader.getInt32();
+                entry.created_at = reader.getInt64();
+                reader.getStringView();
+                entry.seq = reader.hasMore() ? reader.getInt64() : 0;
+                entry.location = location;
+                if (!reader.ok()) return;
+                auto it = room_messages_.find(message_id);
+                if (it!=room_messages_.end()){
+                    segments_[it->second.location.segment].dead_bytes += it->second.location.length;
+                }
+                room_messages_[message_id] = entry;
+                break;
+            }
+            case RECORD_EXPIRED:{
+                // 删除记录总在消息记录之后重放，会话与离线索引在重建时统一更新
+                int room_id = reader.getInt32();
+                uint32_t count = reader.getInt32();
+                auto& entries = room_id!=0 ? room_messages_ : messages_;
+                for (uint32_t i=0;i<count && reader.ok();++i){
+                    int64_t message_id = reader.getInt64();
+                    auto it = entries.find(message_id);
+                    if (!reader.ok() || it==entries.end()) continue;
+                    segments_[it->second.location.segment].dead_bytes += it->second.location.length;
+                    entries.erase(it);
+                }
+                segments_[location.segment].dead_bytes += location.length;
+                break;
+            }
+            case RECORD_SEQ_FLOOR:{
+                int room_id = reader.getInt32();
+                uint64_t conversation_key = static_cast<uint64_t>(reader.getInt64());
+                int64_t seq = reader.getInt64();
+                if (!reader.ok()) return;
+                auto key = std::make_pair(room_id,conversation_key);
+                auto it = seq_floors_.find(key);
+                if (it!=seq_floors_.end()){
+                    segments_[it->second.location.segment].dead_bytes += it->second.location.length;
+                }
+                seq_floors_[key] = SeqFloor{seq,location};
+                break;
+            }
+            default:
+                std::cerr<<"Unknown record type "<<static_cast<int>(type)<<" in segment "<<location.segment<<std::endl;
+                break;
+        }
+    }
+
+    void LogMessageStore::rebuildIndexes() {
+        conversations_.clear();
+        offline_.clear();
+        inbox_.clear();
+        std::vector<int64_t> message_ids;
+        message_ids.reserve(messages_.size());
+        for (const auto& [message_id,entry]:messages_){
+            message_ids.push_back(message_id);
+        }
+        // 按消息ID顺序重建，会话、收件与离线索引都按ID有序
+        std::sort(message_ids.begin(),message_ids.end());
+        for (int64_t message_id:message_ids){
+            MessageEntry& entry = messages_[message_id];
+            // 已读状态：RECORD_READ覆盖的消息标记为已读，已读消息推进已读位置（压缩后回执记录不再保留）
+            auto read_key = std::make_pair(entry.receiver_id,entry.sender_id);
+            auto read_it = read_cursors_.find(read_key);
+            if (read_it!=read_cursors_.end() && entry.seq>0 && entry.seq<=read_it->second) entry.is_read = 1;
+            if (entry.is_read && entry.seq>0){
+                int64_t& cursor = read_cursors_[read_key];
+                cursor = std::max(cursor,entry.seq);
+            }
+            conversations_[conversationKey(entry.sender_id,entry.receiver_id)].push_back(message_id);
+            inbox_[entry.receiver_id].push_back(message_id);
+            if (entry.is_offline){
+                offline_[entry.receiver_id].push_back(message_id);
+            }
+        }
+        room_timelines_.clear();
+        message_ids.clear();
+        for (const auto& [message_id,entry]:room_messages_){
+            message_ids.push_back(message_id);
+        }
+        std::sort(message_ids.begin(),message_ids.end());
+        for (int64_t message_id:message_ids){
+            room_timelines_[room_messages_[message_id].receiver_id].push_back(message_id);
+        }
+    }
+
+    bool LogMessageStore::appendRecord(uint8_t type, const std::string &payload, RecordLocation &location) {
+        std::string record = buildRecord(type,payload);
+        Segment* active = &segments_[active_segment_];
+        // 活动段写满则封存并滚动到新段
+        if (active->size>0 && active->size+record.size()>segment_size_){
+            ::fdatasync(active->fd);
+            if (!openActiveSegment(active_segment_+1)) return false;
+            active = &segments_[active_segment_];
+        }
+        if (!pwriteFull(active->fd,record.data(),record.size(),active->size)){
+            std::cerr<<"Failed to append record to segment "<<active_segment_<<": "<<strerror(errno)<<std::endl;
+            return false;
+        }
+        location = RecordLocation{active_segment_,active->size,static_cast<uint32_t>(record.size())};
+        active->size += record.size();
+        if (type==RECORD_MESSAGE_FLAGS || type==RECORD_USER_STATUS || type==RECORD_DELIVERED || type==RECORD_READ
+            || type==RECORD_EXPIRED){
+            active->dead_bytes += record.size();
+        }
+        dirty_ = true;
+        return true;
+    }
+
+    bool LogMessageStore::readContent(int64_t message_id, const MessageEntry &entry, std::string &record,
+                                      std::string_view &content) {
+        auto segment_it = segments_.find(entry.location.segment);
+        if (segment_it==segments_.end()) return false;
+        record.resize(entry.location.length);
+        if (!preadFull(segment_it->second.fd,&record[0],record.size(),entry.location.offset)){
+            std::cerr<<"Failed to read message "<<message_id<<": "<<strerror(errno)<<std::endl;
+            return false;
+        }
+        // 跳过固定字段，只解析正文
+        PayloadReader reader(record.data()+sizeof (RecordHeader),record.size()-sizeof (RecordHeader));
+        reader.getInt64();
+        for (int i=0;i<5;++i) reader.getInt32();
+        reader.getInt64();
+        content = reader.getStringView();
+        return reader.ok();
+    }
+
+    bool LogMessageStore::readMessage(int64_t message_id, const MessageEntry &entry, MessageInfo &message) {
+        std::string record;
+        std::string_view content;
+        if (!readContent(message_id,entry,record,content)) return false;
+        message.content.assign(content.data(),content.size());
+        message.id = message_id;
+        message.sender_id = entry.sender_id;
+        message.receiver_id = entry.receiver_id;
+        message.message_type = entry.message_type;
+        message.is_offline = entry.is_offline;
+        message.is_read = entry.is_read;
+        message.created_at = formatTime(entry.created_at);
+        message.seq = entry.seq;
+        return true;
+    }
+
+    bool LogMessageStore::storeMessage(MessageInfo &message) {
+        MessageEntry entry;
+        entry.sender_id = message.sender_id;
+        entry.receiver_id = message.receiver_id;
+        entry.message_type = message.message_type;
+        entry.is_offline = message.is_offline;
+        entry.is_read = 0;
+        entry.created_at = static_cast<int64_t>(time(nullptr));
+        entry.seq = message.seq;
+
+        int64_t message_id = message.id!=0 ? message.id : IdGenerator::getInstance().nextId();
+
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        if (!appendRecord(RECORD_MESSAGE,encodeMessage(message_id,entry,message.content),entry.location)){
+            return false;
+        }
+        messages_[message_id] = entry;
+        // 会话、收件与离线索引保持按ID有序（过期清理按ID区间二分删除）
+        insertSorted(conversations_[conversationKey(entry.sender_id,entry.receiver_id)],message_id);
+        insertSorted(inbox_[entry.receiver_id],message_id);
+        if (entry.is_offline){
+            insertSorted(offline_[entry.receiver_id],message_id);
+        }
+        message.id = message_id;
+        message.is_read = 0;
+        message.created_at = formatTime(entry.created_at);
+        return true;
+    }
+
+    bool LogMessageStore::fetchOfflineMessages(int user_id, std::vector<MessageInfo> &messages) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        auto offline_it = offline_.find(user_id);
+        if (offline_it==offline_.end()) return true;
+        for (int64_t message_id:offline_it->second){
+            auto it = messages_.find(message_id);
+            if (it==messages_.end()) continue;
+            MessageInfo msg_info;
+            if (!readMessage(message_id,it->second,msg_info)) continue;
+            messages.push_back(std::move(msg_info));
+            // 标记为已投递、已读
+            std::string payload;
+            putInt64(payload,message_id);
+            putInt32(payload,0);
+            putInt32(payload,1);
+            RecordLocation location;
+            if (!appendRecord(RECORD_MESSAGE_FLAGS,payload,location)) return false;
+            it->second.is_offline = 0;
+            it->second.is_read = 1;
+        }
+        offline_.erase(offline_it);
+        return true;
+    }
+
+    bool LogMessageStore::writeOfflineMessages(int user_id, FrameWriter &writer) {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto offline_it = offline_.find(user_id);
+        if (offline_it==offline_.end()) return true;
+        // 复用同一块读缓冲区，正文直接写入输出帧
+        std::string record;
+        std::string_view content;
+        for (int64_t message_id:offline_it->second){
+            auto it = messages_.find(message_id);
+            if (it==messages_.end()) continue;
+            if (!readContent(message_id,it->second,record,content)) continue;
+            writer.beginFrame(MessageType::MSG_TYPE_OFFLINE_MSG,static_cast<uint32_t>(it->second.sender_id));
+            writer.appendInt(message_id);
+            writer.append(':');
+            writer.appendInt(it->second.seq);
+            writer.append(':');
+            writer.append(content);
+            writer.endFrame();
+        }
+        return true;
+    }
+
+    bool LogMessageStore::writeMessagesSince(int user_id, int64_t after_id, FrameWriter &writer, int64_t &max_id) {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto inbox_it = inbox_.find(user_id);
+        if (inbox_it==inbox_.end()) return true;
+        const std::vector<int64_t>& message_ids = inbox_it->second;
+        std::string record;
+        std::string_view content;
+        int64_t last_id = 0;
+        for (auto id_it = std::upper_bound(message_ids.begin(),message_ids.end(),after_id);id_it!=message_ids.end();++id_it){
+            auto it = messages_.find(*id_it);
+            if (it==messages_.end()) continue;
+            if (!readContent(*id_it,it->second,record,content)) continue;
+            writer.beginFrame(MessageType::MSG_TYPE_OFFLINE_MSG,static_cast<uint32_t>(it->second.sender_id));
+            writer.appendInt(*id_it);
+            writer.append(':');
+            writer.appendInt(it->second.seq);
+            writer.append(':');
+            writer.append(content);
+            writer.endFrame();
+            last_id = *id_it;
+        }
+        if (last_id!=0) max_id = std::max(max_id,last_id);
+        return true;
+    }
+
+    bool LogMessageStore::getDeviceCursor(int user_id, const std::string &device_id, int64_t &message_id,
+                                          bool &found) {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto it = device_cursors_.find(std::make_pair(user_id,device_id));
+        found = it!=device_cursors_.end();
+        if (found) message_id = it->second.message_id;
+        return true;
+    }
+
+    bool LogMessageStore::updateDeviceCursor(int user_id, const std::string &device_id, int64_t message_id) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        auto key = std::make_pair(user_id,device_id);
+        auto it = device_cursors_.find(key);
+        // 游标只前进不后退
+        if (it!=device_cursors_.end() && it->second.message_id>=message_id) return true;
+        RecordLocation location;
+        if (!appendRecord(RECORD_DEVICE_CURSOR,encodeDeviceCursor(user_id,device_id,message_id),location)) return false;
+        if (it!=device_cursors_.end()){
+            segments_[it->second.location.segment].dead_bytes += it->second.location.length;
+            it->second = DeviceCursor{message_id,location};
+        }else{
+            device_cursors_.emplace(std::move(key),DeviceCursor{message_id,location});
+        }
+        return true;
+    }
+
+    bool LogMessageStore::getUserCursor(int user_id, int64_t &message_id) {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        bool found = false;
+        // 同一用户的设备游标在有序索引中相邻
+        for (auto it = device_cursors_.lower_bound(std::make_pair(user_id,std::string()));
+             it!=device_cursors_.end() && it->first.first==user_id;++it){
+            message_id = found ? std::max(message_id,it->second.message_id) : it->second.message_id;
+            found = true;
+        }
+        return found;
+    }
+
+    bool LogMessageStore::createRoom(const std::string &name, int owner_id, int &room_id) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        RoomEntry entry;
+        entry.name = name;
+        entry.owner_id = owner_id;
+        if (!appendRecord(RECORD_ROOM,encodeRoom(next_room_id_,entry),entry.location)) return false;
+        room_id = next_room_id_++;
+        rooms_[room_id] = std::move(entry);
+        return true;
+    }
+
+    bool LogMessageStore::addRoomMember(int room_id, int user_id, int64_t joined_message_id) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        if (rooms_.count(room_id)==0) return false;
+        auto key = std::make_pair(room_id,user_id);
+        if (room_members_.count(key)>0) return true;
+        RecordLocation location;
+        if (!appendRecord(RECORD_ROOM_MEMBER,encodeRoomMember(room_id,user_id,joined_message_id,true),location)) return false;
+        room_members_[key] = RoomMemberEntry{joined_message_id,location};
+        return true;
+    }
+
+    bool LogMessageStore::removeRoomMember(int room_id, int user_id) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        auto it = room_members_.find(std::make_pair(room_id,user_id));
+        if (it==room_members_.end()) return true;
+        RecordLocation location;
+        if (!appendRecord(RECORD_ROOM_MEMBER,encodeRoomMember(room_id,user_id,0,false),location)) return false;
+        segments_[it->second.location.segment].dead_bytes += it->second.location.length;
+        segments_[location.segment].dead_bytes += location.length;
+        room_members_.erase(it);
+        return true;
+    }
+
+    bool LogMessageStore::loadRooms(std::vector<RoomInfo> &rooms) {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        std::unordered_map<int,size_t> positions;
+        for (const auto& [room_id,entry]:rooms_){
+            positions[room_id] = rooms.size();
+            rooms.push_back(RoomInfo{room_id,entry.name,entry.owner_id,{}});
+        }
+        for (const auto& [key,member]:room_members_){
+            auto it = positions.find(key.first);
+            if (it==positions.end()) continue;
+            rooms[it->second].members.emplace_back(key.second,member.joined_message_id);
+        }
+        return true;
+    }
+
+    bool LogMessageStore::storeRoomMessage(MessageInfo &message) {
+        MessageEntry entry;
+        entry.sender_id = message.sender_id;
+        entry.receiver_id = message.receiver_id;
+        entry.message_type = message.message_type;
+        entry.is_offline = 0;
+        entry.is_read = 0;
+        entry.created_at = static_cast<int64_t>(time(nullptr));
+        entry.seq = message.seq;
+
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        if (!appendRecord(RECORD_ROOM_MESSAGE,encodeMessage(message.id,entry,message.content),entry.location)){
+            return false;
+        }
+        room_messages_[message.id] = entry;
+        insertSorted(room_timelines_[entry.receiver_id],message.id);
+        message.created_at = formatTime(entry.created_at);
+        return true;
+    }
+
+    bool LogMessageStore::writeRoomMessagesSince(int room_id, int64_t after_id, FrameWriter &writer, int64_t &max_id) {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto timeline_it = room_timelines_.find(room_id);
+        if (timeline_it==room_timelines_.end()) return true;
+        const std::vector<int64_t>& message_ids = timeline_it->second;
+        std::string record;
+        std::string_view content;
+        for (auto id_it = std::upper_bound(message_ids.begin(),message_ids.end(),after_id);id_it!=message_ids.end();++id_it){
+            auto it = room_messages_.find(*id_it);
+            if (it==room_messages_.end()) continue;
+            if (!readContent(*id_it,it->second,record,content)) continue;
+            writer.beginFrame(MessageType::MSG_TYPE_ROOM_CHAT,static_cast<uint32_t>(it->second.sender_id));
+            writer.appendInt(room_id);
+            writer.append(':');
+            writer.appendInt(*id_it);
+            writer.append(':');
+            writer.appendInt(it->second.seq);
+            writer.append(':');
+            writer.append(content);
+            writer.endFrame();
+            max_id = std::max(max_id,*id_it);
+        }
+        return true;
+    }
+
+    void LogMessageStore::collectSince(const std::vector<int64_t> &message_ids,
+                                       const std::unordered_map<int64_t, MessageEntry> &entries, int64_t after_seq,
+                                       int64_t after_id, int limit, std::vector<std::pair<int64_t, int64_t>> &found) {
+        for (auto it=message_ids.rbegin();it!=message_ids.rend();++it){
+            auto entry_it = entries.find(*it);
+            if (entry_it==entries.end()) continue;
+            int64_t seq = entry_it->second.seq;
+            if (seq>after_seq){
+                if (*it>after_id) found.emplace_back(seq,*it);
+            }else if (seq<=after_seq-kSeqReorderSlack){
+                break;
+            }
+        }
+        std::sort(found.begin(),found.end());
+        if (found.size()>static_cast<size_t>(limit)) found.resize(limit);
+    }
+
+    void LogMessageStore::writeSyncFrames(const std::vector<std::pair<int64_t, int64_t>> &found,
+                                          const std::unordered_map<int64_t, MessageEntry> &entries, std::string_view prefix,
+                                          FrameWriter &writer, int64_t &last_seq) {
+        std::string record;
+        std::string_view content;
+        for (const auto& [seq,message_id]:found){
+            const MessageEntry& entry = entries.at(message_id);
+            if (!readContent(message_id,entry,record,content)) continue;
+            writer.beginFrame(MessageType::MSG_TYPE_SYNC_RESP,static_cast<uint32_t>(entry.sender_id));
+            writer.append(prefix);
+            writer.appendInt(seq);
+            writer.append(':');
+            writer.append(content);
+            writer.endFrame();
+            last_seq = std::max(last_seq,seq);
+        }
+    }
+
+    bool LogMessageStore::getConversationSeq(int user_id1, int user_id2, int64_t &seq) {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        uint64_t key = conversationKey(user_id1,user_id2);
+        auto floor_it = seq_floors_.find(std::make_pair(0,key));
+        seq = floor_it!=seq_floors_.end() ? floor_it->second.seq : 0;
+        auto conversation_it = conversations_.find(key);
+        if (conversation_it==conversations_.end()) return true;
+        for (int64_t message_id:conversation_it->second){
+            auto it = messages_.find(message_id);
+            if (it!=messages_.end()) seq = std::max(seq,it->second.seq);
+        }
+        return true;
+    }
+
+    bool LogMessageStore::getRoomSeq(int room_id, int64_t &seq) {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto floor_it = seq_floors_.find(std::make_pair(room_id,uint64_t{0}));
+        seq = floor_it!=seq_floors_.end() ? floor_it->second.seq : 0;
+        auto timeline_it = room_timelines_.find(room_id);
+        if (timeline_it==room_timelines_.end()) return true;
+        for (int64_t message_id:timeline_it->second){
+            auto it = room_messages_.find(message_id);
+            if (it!=room_messages_.end()) seq = std::max(seq,it->second.seq);
+        }
+        return true;
+    }
+
+    bool LogMessageStore::writeConversationSince(int user_id1, int user_id2, int64_t after_seq, int limit,
+                                                 std::string_view prefix, FrameWriter &writer, int64_t &last_seq) {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto conversation_it = conversations_.find(conversationKey(user_id1,user_id2));
+        if (conversation_it==conversations_.end()) return true;
+        std::vector<std::pair<int64_t,int64_t>> found;
+        collectSince(conversation_it->second,messages_,after_seq,0,limit,found);
+        writeSyncFrames(found,messages_,prefix,writer,last_seq);
+        return true;
+    }
+
+    bool LogMessageStore::writeRoomSince(int room_id, int64_t after_seq, int64_t after_id, int limit,
+                                         std::string_view prefix, FrameWriter &writer, int64_t &last_seq) {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto timeline_it = room_timelines_.find(room_id);
+        if (timeline_it==room_timelines_.end()) return true;
+        std::vector<std::pair<int64_t,int64_t>> found;
+        collectSince(timeline_it->second,room_messages_,after_seq,after_id,limit,found);
+        writeSyncFrames(found,room_messages_,prefix,writer,last_seq);
+        return true;
+    }
+
+    bool LogMessageStore::writeChatHistory(int user_id1, int user_id2, int limit, FrameWriter &writer) {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto conversation_it = conversations_.find(conversationKey(user_id1,user_id2));
+        if (conversation_it==conversations_.end()) return true;
+        const std::vector<int64_t>& message_ids = conversation_it->second;
+        std::string record;
+        std::string_view content;
+        bool first = true;
+        for (auto it=message_ids.rbegin();it!=message_ids.rend() && limit>0;++it){
+            auto entry_it = messages_.find(*it);
+            if (entry_it==messages_.end()) continue;
+            if (!readContent(*it,entry_it->second,record,content)) continue;
+            if (!first) writer.append('|');
+            first = false;
+            writer.appendInt(entry_it->second.sender_id);
+            writer.append(':');
+            writer.append(content);
+            --limit;
+        }
+        return true;
+    }
+
+    bool LogMessageStore::getChatHistory(int user_id1, int user_id2, std::vector<MessageInfo> &messages, int limit) {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto conversation_it = conversations_.find(conversationKey(user_id1,user_id2));
+        if (conversation_it==conversations_.end()) return true;
+        const std::vector<int64_t>& message_ids = conversation_it->second;
+        // 从最新的消息开始倒序读取
+        for (auto it=message_ids.rbegin();it!=message_ids.rend() && limit>0;++it){
+            auto entry_it = messages_.find(*it);
+            if (entry_it==messages_.end()) continue;
+            MessageInfo msg_info;
+            if (readMessage(*it,entry_it->second,msg_info)){
+                messages.push_back(std::move(msg_info));
+                --limit;
+            }
+        }
+        return true;
+    }
+
+    bool LogMessageStore::markConversationsRead(const std::vector<ReadReceipt> &receipts) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        // 只记录推进了已读位置的回执，整批写为一条记录
+        std::vector<const ReadReceipt*> advanced;
+        for (const auto& receipt:receipts){
+            auto cursor_it = read_cursors_.find(std::make_pair(receipt.reader_id,receipt.peer_id));
+            if (cursor_it==read_cursors_.end() || cursor_it->second<receipt.seq) advanced.push_back(&receipt);
+        }
+        if (advanced.empty()) return true;
+        std::string payload;
+        payload.reserve(4+advanced.size()*16);
+        putInt32(payload,static_cast<uint32_t>(advanced.size()));
+        for (const ReadReceipt* receipt:advanced){
+            putInt32(payload,receipt->reader_id);
+            putInt32(payload,receipt->peer_id);
+            putInt64(payload,receipt->seq);
+        }
+        RecordLocation location;
+        if (!appendRecord(RECORD_READ,payload,location)) return false;
+        for (const ReadReceipt* receipt:advanced){
+            int64_t& cursor = read_cursors_[std::make_pair(receipt->reader_id,receipt->peer_id)];
+            auto conversation_it = conversations_.find(conversationKey(receipt->reader_id,receipt->peer_id));
+            if (conversation_it!=conversations_.end()){
+                // 只扫描上次已读位置之后的消息
+                const auto& message_ids = conversation_it->second;
+                for (auto it = message_ids.rbegin();it!=message_ids.rend();++it){
+                    MessageEntry& entry = messages_[*it];
+                    if (entry.seq<=cursor-kSeqReorderSlack) break;
+                    if (entry.sender_id==receipt->peer_id && entry.seq<=receipt->seq) entry.is_read = 1;
+                }
+            }
+            cursor = receipt->seq;
+        }
+        return true;
+    }
+
+    bool LogMessageStore::scanMessages(int64_t after_id, int limit, std::vector<MessageInfo> &messages) {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        if (limit<=0) return true;
+        // 消息索引是哈希表，用大顶堆保留ID最小的limit条，每页遍历一次索引
+        std::vector<int64_t> page;
+        page.reserve(static_cast<size_t>(limit)+1);
+        for (const auto& [message_id,entry]:messages_){
+            if (message_id<=after_id) continue;
+            if (page.size()<static_cast<size_t>(limit)){
+                page.push_back(message_id);
+                std::push_heap(page.begin(),page.end());
+            }else if (message_id<page.front()){
+                std::pop_heap(page.begin(),page.end());
+                page.back() = message_id;
+                std::push_heap(page.begin(),page.end());
+            }
+        }
+        std::sort(page.begin(),page.end());
+        for (int64_t message_id:page){
+            MessageInfo msg_info;
+            if (readMessage(message_id,messages_.at(message_id),msg_info)) messages.push_back(std::move(msg_info));
+        }
+        return true;
+    }
+
+    bool LogMessageStore::getMessagesByIds(const std::vector<int64_t> &message_ids, std::vector<MessageInfo> &messages) {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        for (int64_t message_id:message_ids){
+            auto it = messages_.find(message_id);
+            if (it==messages_.end()) continue;
+            MessageInfo msg_info;
+            if (readMessage(message_id,it->second,msg_info)) messages.push_back(std::move(msg_info));
+        }
+        return true;
+    }
+
+    bool LogMessageStore::appendSeqFloor(int room_id, uint64_t conversation_key, int64_t seq) {
+        auto key = std::make_pair(room_id,conversation_key);
+        auto it = seq_floors_.find(key);
+        if (it!=seq_floors_.end() && it->second.seq>=seq) return true;
+        RecordLocation location;
+        if (!appendRecord(RECORD_SEQ_FLOOR,encodeSeqFloor(room_id,conversation_key,seq),location)) return false;
+        if (it!=seq_floors_.end()){
+            segments_[it->second.location.segment].dead_bytes += it->second.location.length;
+        }
+        seq_floors_[key] = SeqFloor{seq,location};
+        return true;
+    }
+
+    bool LogMessageStore::appendExpired(int room_id, const std::vector<int64_t> &message_ids,
+                                        std::vector<MessageInfo> &deleted) {
+        std::string payload;
+        payload.reserve(8+message_ids.size()*8);
+        putInt32(payload,room_id);
+        putInt32(payload,static_cast<int32_t>(message_ids.size()));
+        for (int64_t message_id:message_ids){
+            putInt64(payload,message_id);
+        }
+        RecordLocation location;
+        if (!appendRecord(RECORD_EXPIRED,payload,location)) return false;
+        auto& entries = room_id!=0 ? room_messages_ : messages_;
+        for (int64_t message_id:message_ids){
+            auto it = entries.find(message_id);
+            if (it==entries.end()) continue;
+            MessageInfo message{};
+            message.id = message_id;
+            message.sender_id = it->second.sender_id;
+            message.receiver_id = it->second.receiver_id;
+            message.is_offline = it->second.is_offline;
+            message.seq = it->second.seq;
+            deleted.push_back(std::move(message));
+            // 正文留在段文件中，压缩时回收
+            segments_[it->second.location.segment].dead_bytes += it->second.location.length;
+            entries.erase(it);
+        }
+        return true;
+    }
+
+    bool LogMessageStore::expireMessages(int64_t after_id, int64_t before_id, int limit, std::vector<MessageInfo> &deleted) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        if (limit<=0) return true;
+        // 各会话的消息ID递增，过期消息是每个会话列表的前缀：每个会话至多取limit条候选，再保留全局最小的limit条，
+        // 这样一批删除的正好是(after_id,本批最大ID]范围内的全部消息，各索引只需删除一段连续区间
+        std::vector<int64_t> batch;
+        for (const auto& [key,message_ids]:conversations_){
+            auto it = std::upper_bound(message_ids.begin(),message_ids.end(),after_id);
+            for (int taken=0;it!=message_ids.end() && *it<before_id && taken<limit;++it,++taken){
+                batch.push_back(*it);
+            }
+        }
+        if (batch.size()>static_cast<size_t>(limit)){
+            std::nth_element(batch.begin(),batch.begin()+limit,batch.end());
+            batch.resize(limit);
+        }
+        if (batch.empty()) return true;
+        std::sort(batch.begin(),batch.end());
+        int64_t last_id = batch.back();
+        auto erase_range = [after_id,last_id](std::vector<int64_t>& message_ids){
+            message_ids.erase(std::upper_bound(message_ids.begin(),message_ids.end(),after_id),
+                              std::upper_bound(message_ids.begin(),message_ids.end(),last_id));
+        };
+        // 会话中剩余的消息（只看最新的几条，序号与ID顺序可能略有出入）都早于被删除的消息时保存序号下限
+        std::unordered_map<uint64_t,int64_t> expired_seqs;
+        for (int64_t message_id:batch){
+            const MessageEntry& entry = messages_.at(message_id);
+            int64_t& seq = expired_seqs[conversationKey(entry.sender_id,entry.receiver_id)];
+            seq = std::max(seq,entry.seq);
+        }
+        for (const auto& [key,seq]:expired_seqs){
+            const std::vector<int64_t>& message_ids = conversations_.at(key);
+            auto rest = std::upper_bound(message_ids.begin(),message_ids.end(),last_id);
+            int64_t kept = 0;
+            for (auto it=rest;it!=message_ids.end() && it-rest<kSeqReorderSlack;++it){
+                kept = std::max(kept,messages_.at(*it).seq);
+            }
+            if (kept<seq && !appendSeqFloor(0,key,seq)) return false;
+        }
+        size_t first = deleted.size();
+        if (!appendExpired(0,batch,deleted)) return false;
+        for (const auto& [key,seq]:expired_seqs){
+            auto it = conversations_.find(key);
+            erase_range(it->second);
+            if (it->second.empty()) conversations_.erase(it);
+        }
+        std::unordered_set<int> receivers;
+        for (size_t i=first;i<deleted.size();++i){
+            receivers.insert(deleted[i].receiver_id);
+        }
+        for (int receiver_id:receivers){
+            for (auto* index:{&inbox_,&offline_}){
+                auto it = index->find(receiver_id);
+                if (it==index->end()) continue;
+                erase_range(it->second);
+                if (it->second.empty()) index->erase(it);
+            }
+        }
+        return true;
+    }
+
+    bool LogMessageStore::expireRoomMessages(int room_id, int64_t after_id, int64_t before_id, int limit,
+                                             std::vector<MessageInfo> &deleted) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        auto timeline_it = room_timelines_.find(room_id);
+        if (timeline_it==room_timelines_.end() || limit<=0) return true;
+        std::vector<int64_t>& message_ids = timeline_it->second;
+        auto begin = std::upper_bound(message_ids.begin(),message_ids.end(),after_id);
+        auto end = begin;
+        while (end!=message_ids.end() && *end<before_id && end-begin<limit) ++end;
+        if (begin==end) return true;
+        std::vector<int64_t> batch(begin,end);
+        int64_t seq = 0;
+        for (int64_t message_id:batch){
+            seq = std::max(seq,room_messages_.at(message_id).seq);
+        }
+        int64_t kept = 0;
+        for (auto it=end;it!=message_ids.end() && it-end<kSeqReorderSlack;++it){
+            kept = std::max(kept,room_messages_.at(*it).seq);
+        }
+        if (kept<seq && !appendSeqFloor(room_id,0,seq)) return false;
+        if (!appendExpired(room_id,batch,deleted)) return false;
+        message_ids.erase(begin,end);
+        if (message_ids.empty()) room_timelines_.erase(timeline_it);
+        return true;
+    }
+
+    bool LogMessageStore::loadInbox(int user_id, std::vector<InboxEntry> &entries) {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        // 会话键由双方ID组成，遍历会话索引找出该用户参与的会话（每个用户重启后只加载一次）
+        std::string record;
+        std::string_view content;
+        for (const auto& [key,message_ids]:conversations_){
+            int low = static_cast<int>(key>>32);
+            int high = static_cast<int>(key & 0xffffffffu);
+            if (low!=user_id && high!=user_id) continue;
+            InboxEntry inbox_entry;
+            inbox_entry.peer_id = low==user_id ? high : low;
+            inbox_entry.last_message_id = 0;
+            inbox_entry.last_seq = -1;
+            auto cursor_it = read_cursors_.find(std::make_pair(user_id,inbox_entry.peer_id));
+            int64_t cursor = cursor_it!=read_cursors_.end() ? cursor_it->second : 0;
+            const MessageEntry* last = nullptr;
+            // 从最新的消息向前扫描，越过已读位置后停止（序号与ID顺序可能略有出入）
+            for (auto it=message_ids.rbegin();it!=message_ids.rend();++it){
+                auto entry_it = messages_.find(*it);
+                if (entry_it==messages_.end()) continue;
+                const MessageEntry& entry = entry_it->second;
+                if (entry.seq>inbox_entry.last_seq){
+                    inbox_entry.last_seq = entry.seq;
+                    inbox_entry.last_message_id = *it;
+                    last = &entry;
+                }
+                if (entry.sender_id==inbox_entry.peer_id && entry.is_read==0 && entry.seq>cursor){
+                    inbox_entry.unread_seqs.push_back(entry.seq);
+                }
+                if (entry.seq<=cursor-kSeqReorderSlack) break;
+            }
+            if (!last) continue;
+            inbox_entry.last_sender_id = last->sender_id;
+            if (readContent(inbox_entry.last_message_id,*last,record,content)) inbox_entry.last_content.assign(content);
+            std::sort(inbox_entry.unread_seqs.begin(),inbox_entry.unread_seqs.end());
+            entries.push_back(std::move(inbox_entry));
+        }
+        return true;
+    }
+
+    bool LogMessageStore::getUserById(int user_id, UserInfo &user_info, bool &found) {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto it = users_.find(user_id);
+        found = it!=users_.end();
+        if (found) user_info = it->second.info;
+        return true;
+    }
+
+    bool LogMessageStore::getUserByName(const std::string &username, UserInfo &user_info, bool &found) {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto name_it = user_names_.find(username);
+        found = name_it!=user_names_.end();
+        if (found) user_info = users_[name_it->second].info;
+        return true;
+    }
+
+    bool LogMessageStore::createUser(const std::string &username, const std::string &password,
+                                     const std::string &nickname, int &user_id) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        if (user_names_.count(username)>0){
+            std::cerr<<"Username already exists: "<<username<<std::endl;
+            return false;
+        }
+        UserEntry entry;
+        entry.info.id = next_user_id_;
+        entry.info.username = username;
+        entry.info.password = password;
+        entry.info.nickname = nickname;
+        entry.info.status = 0;
+        if (!appendRecord(RECORD_USER,encodeUser(entry.info),entry.location)) return false;
+        ++next_user_id_;
+        user_id = entry.info.id;
+        user_names_[username] = entry.info.id;
+        users_[entry.info.id] = std::move(entry);
+        return true;
+    }
+
+    bool LogMessageStore::updateUserStatus(int user_id, int status) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        auto it = users_.find(user_id);
+        if (it==users_.end()) return false;
+        if (it->second.info.status==status) return true;
+        std::string payload;
+        putInt32(payload,user_id);
+        putInt32(payload,status);
+        RecordLocation location;
+        if (!appendRecord(RECORD_USER_STATUS,payload,location)) return false;
+        it->second.info.status = status;
+        return true;
+    }
+
+    bool LogMessageStore::updateUserPassword(int user_id, const std::string &password) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        auto it = users_.find(user_id);
+        if (it==users_.end()) return false;
+        // 写入完整的用户记录，旧记录变为垃圾
+        UserInfo info = it->second.info;
+        info.password = password;
+        RecordLocation location;
+        if (!appendRecord(RECORD_USER,encodeUser(info),location)) return false;
+        auto segment_it = segments_.find(it->second.location.segment);
+        if (segment_it!=segments_.end()){
+            segment_it->second.dead_bytes += it->second.location.length;
+        }
+        it->second.info = std::move(info);
+        it->second.location = location;
+        return true;
+    }
+
+    bool LogMessageStore::addOnlineUser(int user_id, int socket_fd, const std::string &/*ip*/, int /*port*/) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        online_users_[user_id] = socket_fd;
+        return true;
+    }
+
+    bool LogMessageStore::removeOnlineUser(int user_id) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        online_users_.erase(user_id);
+        return true;
+    }
+
+    bool LogMessageStore::getOnlineUserIds(std::vector<int> &user_ids) {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        for (const auto& [user_id,socket_fd]:online_users_){
+            user_ids.push_back(user_id);
+        }
+        return true;
+    }
+
+    bool LogMessageStore::updatePresence(const std::vector<PresenceUpdate> &updates) {
+        for (const auto& update:updates){
+            if (!updateUserStatus(update.user_id,update.status)) return false;
+            if (update.status==1){
+                addOnlineUser(update.user_id,update.socket_fd,update.ip,update.port);
+            }else{
+                removeOnlineUser(update.user_id);
+            }
+        }
+        return true;
+    }
+
+    bool LogMessageStore::markDelivered(const std::vector<std::pair<int, int64_t>> &deliveries) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        // 只记录确实从离线变为已投递的消息，整批写为一条记录
+        std::vector<std::pair<int,int64_t>> changed;
+        for (const auto& [receiver_id,message_id]:deliveries){
+            auto it = messages_.find(message_id);
+            if (it==messages_.end() || it->second.receiver_id!=receiver_id || !it->second.is_offline) continue;
+            changed.emplace_back(receiver_id,message_id);
+        }
+        if (changed.empty()) return true;
+        std::string payload;
+        payload.reserve(4+changed.size()*12);
+        putInt32(payload,static_cast<uint32_t>(changed.size()));
+        for (const auto& [receiver_id,message_id]:changed){
+            putInt32(payload,receiver_id);
+            putInt64(payload,message_id);
+        }
+        RecordLocation location;
+        if (!appendRecord(RECORD_DELIVERED,payload,location)) return false;
+        for (const auto& [receiver_id,message_id]:changed){
+            messages_[message_id].is_offline = 0;
+            auto offline_it = offline_.find(receiver_id);
+            if (offline_it==offline_.end()) continue;
+            auto& offline_ids = offline_it->second;
+            // 离线索引按ID递增
+            auto pos = std::lower_bound(offline_ids.begin(),offline_ids.end(),message_id);
+            if (pos!=offline_ids.end() && *pos==message_id) offline_ids.erase(pos);
+            if (offline_ids.empty()) offline_.erase(offline_it);
+        }
+        return true;
+    }
+
+    bool LogMessageStore::shouldCompact() const {
+        // 已封存段中垃圾占比超过30%时压缩
+        uint64_t total_size = 0;
+        uint64_t dead_bytes = 0;
+        for (const auto& [segment_id,segment]:segments_){
+            if (segment_id==active_segment_) continue;
+            total_size += segment.size;
+            dead_bytes += segment.dead_bytes;
+        }
+        return total_size>0 && dead_bytes*10>=total_size*3;
+    }
+
+    bool LogMessageStore::compact() {
+        std::lock_guard<std::mutex> compaction_lock(compaction_mutex_);
+        // 阶段一：持锁快照待压缩段中的存活记录
+        std::map<uint32_t,int> sources;
+        std::vector<std::pair<int64_t,MessageEntry>> live_messages;
+        std::vector<std::pair<int64_t,MessageEntry>> live_room_messages;
+        std::vector<UserEntry> live_users;
+        std::vector<std::pair<std::pair<int,std::string>,DeviceCursor>> live_cursors;
+        std::vector<std::pair<int,RoomEntry>> live_rooms;
+        std::vector<std::pair<std::pair<int,int>,RoomMemberEntry>> live_members;
+        std::vector<std::pair<std::pair<int,uint64_t>,SeqFloor>> live_floors;
+        uint32_t output_id;
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex_);
+            for (const auto& [segment_id,segment]:segments_){
+                if (segment_id!=active_segment_) sources[segment_id] = segment.fd;
+            }
+            if (sources.empty()) return true;
+            for (const auto& [message_id,entry]:messages_){
+                if (sources.count(entry.location.segment)) live_messages.emplace_back(message_id,entry);
+            }
+            for (const auto& [message_id,entry]:room_messages_){
+                if (sources.count(entry.location.segment)) live_room_messages.emplace_back(message_id,entry);
+            }
+            for (const auto& [user_id,entry]:users_){
+                if (sources.count(entry.location.segment)) live_users.push_back(entry);
+            }
+            for (const auto& [key,cursor]:device_cursors_){
+                if (sources.count(cursor.location.segment)) live_cursors.emplace_back(key,cursor);
+            }
+            for (const auto& [room_id,entry]:rooms_){
+                if (sources.count(entry.location.segment)) live_rooms.emplace_back(room_id,entry);
+            }
+            for (const auto& [key,member]:room_members_){
+                if (sources.count(member.location.segment)) live_members.emplace_back(key,member);
+            }
+            for (const auto& [key,floor]:seq_floors_){
+                if (sources.count(floor.location.segment)) live_floors.emplace_back(key,floor);
+            }
+            // 输出段沿用最大的已封存段ID，保证重放顺序早于活动段
+            output_id = sources.rbegin()->first;
+        }
+        auto by_id = [](const auto& a,const auto& b){return a.first<b.first;};
+        std::sort(live_messages.begin(),live_messages.end(),by_id);
+        std::sort(live_room_messages.begin(),live_room_messages.end(),by_id);
+
+        // 阶段二：不持锁写出新段（已封存段不可变，可安全读取）
+        std::string temp_path = segmentPath(output_id)+".compact";
+        int out_fd = ::open(temp_path.c_str(),O_RDWR | O_CREAT | O_TRUNC,0644);
+        if (out_fd==-1){
+            std::cerr<<"Failed to create compaction output "<<temp_path<<": "<<strerror(errno)<<std::endl;
+            return false;
+        }
+        uint64_t out_size = 0;
+        std::vector<RecordLocation> message_locations;
+        std::vector<RecordLocation> room_message_locations;
+        std::vector<RecordLocation> user_locations;
+        std::vector<RecordLocation> cursor_locations;
+        std::vector<RecordLocation> room_locations;
+        std::vector<RecordLocation> member_locations;
+        std::vector<RecordLocation> floor_locations;
+        bool ok = true;
+        // 追加一条记录到输出段并记下新位置
+        auto write_record = [&](uint8_t type,const std::string& payload,std::vector<RecordLocation>& locations){
+            std::string rewritten = buildRecord(type,payload);
+            if (!pwriteFull(out_fd,rewritten.data(),rewritten.size(),out_size)){
+                ok = false;
+                return;
+            }
+            locations.push_back(RecordLocation{output_id,out_size,static_cast<uint32_t>(rewritten.size())});
+            out_size += rewritten.size();
+        };
+        // 以快照中的最新状态重写消息，状态更新记录随之丢弃
+        auto write_messages = [&](uint8_t type,const std::vector<std::pair<int64_t,MessageEntry>>& entries,
+                                  std::vector<RecordLocation>& locations){
+            std::string record;
+            for (size_t i=0;ok && i<entries.size();++i){
+                const auto& [message_id,entry] = entries[i];
+                record.assign(entry.location.length,'\0');
+                if (!preadFull(sources[entry.location.segment],&record[0],record.size(),entry.location.offset)){
+                    ok = false;
+                    break;
+                }
+                PayloadReader reader(record.data()+sizeof (RecordHeader),record.size()-sizeof (RecordHeader));
+                reader.getInt64();
+                for (int j=0;j<5;++j) reader.getInt32();
+                reader.getInt64();
+                std::string content = reader.getString();
+                if (!reader.ok()){
+                    ok = false;
+                    break;
+                }
+                write_record(type,encodeMessage(message_id,entry,content),locations);
+            }
+        };
+        write_messages(RECORD_MESSAGE,live_messages,message_locations);
+        write_messages(RECORD_ROOM_MESSAGE,live_room_messages,room_message_locations);
+        for (size_t i=0;ok && i<live_users.size();++i){
+            write_record(RECORD_USER,encodeUser(live_users[i].info),user_locations);
+        }
+        for (size_t i=0;ok && i<live_cursors.size();++i){
+            const auto& [key,cursor] = live_cursors[i];
+            write_record(RECORD_DEVICE_CURSOR,encodeDeviceCursor(key.first,key.second,cursor.message_id),cursor_locations);
+        }
+        // 房间先于成员写出，重放时成员总能找到房间
+        for (size_t i=0;ok && i<live_rooms.size();++i){
+            write_record(RECORD_ROOM,encodeRoom(live_rooms[i].first,live_rooms[i].second),room_locations);
+        }
+        for (size_t i=0;ok && i<live_members.size();++i){
+            const auto& [key,member] = live_members[i];
+            write_record(RECORD_ROOM_MEMBER,encodeRoomMember(key.first,key.second,member.joined_message_id,true),member_locations);
+        }
+        // 过期删除记录随被删除的消息一起丢弃，序号下限需要保留
+        for (size_t i=0;ok && i<live_floors.size();++i){
+            const auto& [key,floor] = live_floors[i];
+            write_record(RECORD_SEQ_FLOOR,encodeSeqFloor(key.first,key.second,floor.seq),floor_locations);
+        }
+        if (!ok || ::fdatasync(out_fd)==-1){
+            std::cerr<<"Compaction failed: "<<strerror(errno)<<std::endl;
+            ::close(out_fd);
+            ::unlink(temp_path.c_str());
+            return false;
+        }
+
+        // 阶段三：持锁切换索引与段文件（索引项在此期间被更新过的不再迁移）
+        uint64_t old_size = 0;
+        {
+            std::unique_lock<std::shared_mutex> lock(mutex_);
+            auto relocate = [](auto& index,const auto& key,const RecordLocation& old_location,const RecordLocation& new_location){
+                auto it = index.find(key);
+                if (it!=index.end() && it->second.location.segment==old_location.segment
+                    && it->second.location.offset==old_location.offset){
+                    it->second.location = new_location;
+                }
+            };
+            for (size_t i=0;i<live_messages.size();++i){
+                relocate(messages_,live_messages[i].first,live_messages[i].second.location,message_locations[i]);
+            }
+            for (size_t i=0;i<live_room_messages.size();++i){
+                relocate(room_messages_,live_room_messages[i].first,live_room_messages[i].second.location,room_message_locations[i]);
+            }
+            for (size_t i=0;i<live_users.size();++i){
+                relocate(users_,live_users[i].info.id,live_users[i].location,user_locations[i]);
+            }
+            for (size_t i=0;i<live_cursors.size();++i){
+                relocate(device_cursors_,live_cursors[i].first,live_cursors[i].second.location,cursor_locations[i]);
+            }
+            for (size_t i=0;i<live_rooms.size();++i){
+                relocate(rooms_,live_rooms[i].first,live_rooms[i].second.location,room_locations[i]);
+            }
+            for (size_t i=0;i<live_members.size();++i){
+                relocate(room_members_,live_members[i].first,live_members[i].second.location,member_locations[i]);
+            }
+            for (size_t i=0;i<live_floors.size();++i){
+                relocate(seq_floors_,live_floors[i].first,live_floors[i].second.location,floor_locations[i]);
+            }
+            if (::rename(temp_path.c_str(),segmentPath(output_id).c_str())==-1){
+                std::cerr<<"Failed to install compacted segment: "<<strerror(errno)<<std::endl;
+                ::close(out_fd);
+                ::unlink(temp_path.c_str());
+                return false;
+            }
+            for (const auto& [segment_id,fd]:sources){
+                old_size += segments_[segment_id].size;
+                ::close(fd);
+                if (segment_id!=output_id){
+                    ::unlink(segmentPath(segment_id).c_str());
+                }
+                segments_.erase(segment_id);
+            }
+            segments_[output_id] = Segment{out_fd,out_size,0};
+        }
+        std::cout<<"LogMessageStore compacted "<<sources.size()<<" segments: "<<old_size<<" -> "<<out_size<<" bytes"<<std::endl;
+        return true;
+    }
+
+    void LogMessageStore::backgroundLoop() {
+        auto last_compaction = std::chrono::steady_clock::now();
+        while (running_){
+            {
+                std::unique_lock<std::mutex> lock(background_mutex_);
+                background_cv_.wait_for(lock,std::chrono::milliseconds(sync_interval_ms_),[this]{return !running_;});
+            }
+            // 批量刷盘：不在索引锁内执行fdatasync
+            int sync_fd = -1;
+            {
+                std::unique_lock<std::shared_mutex> lock(mutex_);
+                if (dirty_){
+                    sync_fd = segments_[active_segment_].fd;
+                    dirty_ = false;
+                }
+            }
+            if (sync_fd!=-1){
+                ::fdatasync(sync_fd);
+            }
+            // 定期压缩
+            auto now = std::chrono::steady_clock::now();
+            if (now-last_compaction>=std::chrono::seconds(compaction_interval_)){
+                last_compaction = now;
+                bool need_compaction;
+                {
+                    std::shared_lock<std::shared_mutex> lock(mutex_);
+                    need_compaction = shouldCompact();
+                }
+                if (need_compaction) compact();
+            }
+        }
+    }
+
+    void LogMessageStore::close() {
+        if (running_){
+            {
+                std::lock_guard<std::mutex> lock(background_mutex_);
+                running_ = false;
+            }
+            background_cv_.notify_all();
+        }
+        if (background_thread_.joinable()){
+            background_thread_.join();
+        }
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        for (auto& [segment_id,segment]:segments_){
+            if (segment_id==active_segment_){
+                ::fdatasync(segment.fd);
+            }
+            ::close(segment.fd);
+        }
+        segments_.clear();
+    }
+}
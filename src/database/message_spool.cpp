@@ -0,0 +1,250 @@
+//
+// Created by Cando on 2026/10/19.
+//
+#include "../../include/database/message_spool.h"
+#include "../../include/database/record_codec.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+
+namespace easychat{
+    using namespace record;
+
+    namespace {
+        // 溢写区记录类型
+        constexpr uint8_t kSpoolMessage = 1;
+        // 每轮回放的最大消息数
+        constexpr size_t kReplayBatch = 256;
+        // 单条记录长度上限，超出视为损坏
+        constexpr uint32_t kMaxRecordLength = 64*1024*1024;
+
+        uint64_t conversationKey(int user_id1,int user_id2){
+            uint32_t low = static_cast<uint32_t>(std::min(user_id1,user_id2));
+            uint32_t high = static_cast<uint32_t>(std::max(user_id1,user_id2));
+            return (static_cast<uint64_t>(low)<<32)|high;
+        }
+
+        std::string encodeMessage(const MessageInfo& message){
+            std::string payload;
+            payload.reserve(40+message.content.size());
+            putInt64(payload,message.id);
+            putInt32(payload,message.sender_id);
+            putInt32(payload,message.receiver_id);
+            putInt32(payload,message.message_type);
+            putInt32(payload,message.is_offline);
+            putString(payload,message.content);
+            putInt64(payload,message.seq);
+            return payload;
+        }
+
+        bool decodeMessage(const std::string& payload,MessageInfo& message){
+            PayloadReader reader(payload.data(),payload.size());
+            message.id = reader.getInt64();
+            message.sender_id = reader.getInt32();
+            message.receiver_id = reader.getInt32();
+            message.message_type = reader.getInt32();
+            message.is_offline = reader.getInt32();
+            message.is_read = 0;
+            message.content = reader.getString();
+            // 旧版本写入的记录没有序号，与未分配序号的消息一样在回放时分配
+            message.seq = reader.hasMore() ? reader.getInt64() : 0;
+            return reader.ok();
+        }
+    }
+
+    MessageSpool::MessageSpool()
+    :fd_(-1),sync_interval_ms_(50),retry_interval_ms_(1000),write_offset_(0),replay_offset_(0),
+    pending_(0),dirty_(false),running_(false){}
+
+    MessageSpool::~MessageSpool() {
+        close();
+    }
+
+    bool MessageSpool::init(const std::string &path, std::shared_ptr<MessageStore> store,
+                            int sync_interval_ms, int retry_interval_ms) {
+        path_ = path;
+        store_ = std::move(store);
+        sync_interval_ms_ = sync_interval_ms>0 ? sync_interval_ms : 50;
+        retry_interval_ms_ = retry_interval_ms>0 ? retry_interval_ms : 1000;
+
+        std::error_code ec;
+        std::filesystem::path parent = std::filesystem::path(path).parent_path();
+        if (!parent.empty()) std::filesystem::create_directories(parent,ec);
+        fd_ = ::open(path.c_str(),O_RDWR|O_CREAT|O_CLOEXEC,0644);
+        if (fd_==-1){
+            std::cerr<<"Failed to open message spool "<<path<<": "<<strerror(errno)<<std::endl;
+            return false;
+        }
+        pending_ = recover();
+        running_ = true;
+        thread_ = std::thread(&MessageSpool::backgroundLoop,this);
+        std::cout<<"Message spool opened: "<<path<<", pending messages: "<<pending_.load()<<std::endl;
+        return true;
+    }
+
+    size_t MessageSpool::recover() {
+        uint64_t offset = 0;
+        size_t count = 0;
+        RecordHeader header;
+        std::string payload;
+        while (preadFull(fd_,reinterpret_cast<char*>(&header),sizeof (header),offset)){
+            if (header.type!=kSpoolMessage || header.length>kMaxRecordLength) break;
+            payload.resize(header.length);
+            if (!preadFull(fd_,&payload[0],payload.size(),offset+sizeof (header))) break;
+            if (checksum(header.type,payload.data(),payload.size())!=header.checksum) break;
+            MessageInfo message;
+            if (decodeMessage(payload,message)) trackPending(message);
+            offset += sizeof (header)+header.length;
+            ++count;
+        }
+        // 截断崩溃时写了一半的尾部
+        struct stat st;
+        if (fstat(fd_,&st)==0 && static_cast<uint64_t>(st.st_size)>offset){
+            std::cerr<<"Truncating torn message spool tail at "<<offset<<std::endl;
+            if (ftruncate(fd_,static_cast<off_t>(offset))!=0){
+                std::cerr<<"Failed to truncate message spool: "<<strerror(errno)<<std::endl;
+            }
+        }
+        write_offset_ = offset;
+        replay_offset_ = 0;
+        return count;
+    }
+
+    void MessageSpool::trackPending(const MessageInfo &message) {
+        PendingConversation& conversation = conversations_[conversationKey(message.sender_id,message.receiver_id)];
+        conversation.max_seq = std::max(conversation.max_seq,message.seq);
+        if (message.seq==0) ++conversation.unsequenced;
+        ++conversation.pending;
+    }
+
+    void MessageSpool::untrackPending(const MessageInfo &message, bool sequenced) {
+        auto it = conversations_.find(conversationKey(message.sender_id,message.receiver_id));
+        if (it==conversations_.end()) return;
+        PendingConversation& conversation = it->second;
+        if (!sequenced && conversation.unsequenced>0) --conversation.unsequenced;
+        if (--conversation.pending==0) conversations_.erase(it);
+    }
+
+    bool MessageSpool::pendingSeq(int user_id1, int user_id2, int64_t &max_seq) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        max_seq = 0;
+        auto it = conversations_.find(conversationKey(user_id1,user_id2));
+        if (it==conversations_.end()) return true;
+        max_seq = it->second.max_seq;
+        return it->second.unsequenced==0;
+    }
+
+    bool MessageSpool::append(const MessageInfo &message) {
+        std::string data = buildRecord(kSpoolMessage,encodeMessage(message));
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (fd_==-1) return false;
+        if (!pwriteFull(fd_,data.data(),data.size(),write_offset_)){
+            std::cerr<<"Failed to append to message spool: "<<strerror(errno)<<std::endl;
+            return false;
+        }
+        write_offset_ += data.size();
+        trackPending(message);
+        ++pending_;
+        dirty_ = true;
+        return true;
+    }
+
+    bool MessageSpool::replay(size_t max_records) {
+        uint64_t end;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            end = write_offset_;
+        }
+        // [replay_offset_,end)区间写入后不再修改，可以在锁外读取
+        RecordHeader header;
+        std::string payload;
+        for (size_t i=0;i<max_records && replay_offset_<end;++i){
+            if (!preadFull(fd_,reinterpret_cast<char*>(&header),sizeof (header),replay_offset_)) return false;
+            payload.resize(header.length);
+            if (!preadFull(fd_,&payload[0],payload.size(),replay_offset_+sizeof (header))) return false;
+            MessageInfo message;
+            bool ok = decodeMessage(payload,message);
+            bool sequenced = message.seq!=0;
+            if (ok && !sequenced){
+                // 按写入顺序回放，该会话之前的消息都已存储，存储中的最大序号之后就是这条消息的序号；
+                // 会话还有未分配序号的消息时不会再写入带序号的消息，分配不会与之冲突
+                if (!store_->getConversationSeq(message.sender_id,message.receiver_id,message.seq)) return false;
+                ++message.seq;
+            }
+            if (ok && !store_->storeMessage(message)){
+                // 数据库仍不可用，稍后重试
+                return false;
+            }
+            replay_offset_ += sizeof (header)+header.length;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                untrackPending(message,sequenced);
+            }
+            --pending_;
+        }
+        // 全部回放完成，清空文件
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (replay_offset_==write_offset_ && write_offset_>0){
+            if (ftruncate(fd_,0)!=0){
+                std::cerr<<"Failed to truncate message spool: "<<strerror(errno)<<std::endl;
+                return true;
+            }
+            fdatasync(fd_);
+            write_offset_ = 0;
+            replay_offset_ = 0;
+            conversations_.clear();
+            dirty_ = false;
+            std::cout<<"Message spool drained"<<std::endl;
+        }
+        return true;
+    }
+
+    void MessageSpool::backgroundLoop() {
+        auto next_replay = std::chrono::steady_clock::now();
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (running_){
+            cond_.wait_for(lock,std::chrono::milliseconds(sync_interval_ms_));
+            // 批量刷盘：一次fdatasync覆盖这段时间内的所有追加
+            if (dirty_){
+                dirty_ = false;
+                int fd = fd_;
+                lock.unlock();
+                if (fdatasync(fd)!=0){
+                    std::cerr<<"Failed to sync message spool: "<<strerror(errno)<<std::endl;
+                }
+                lock.lock();
+            }
+            if (!running_) break;
+            if (pending_.load()>0 && std::chrono::steady_clock::now()>=next_replay){
+                lock.unlock();
+                bool ok = replay(kReplayBatch);
+                lock.lock();
+                if (!ok){
+                    next_replay = std::chrono::steady_clock::now()+std::chrono::milliseconds(retry_interval_ms_);
+                }
+            }
+        }
+    }
+
+    void MessageSpool::close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!running_ && fd_==-1) return;
+            running_ = false;
+        }
+        cond_.notify_all();
+        if (thread_.joinable()) thread_.join();
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (fd_!=-1){
+            fdatasync(fd_);
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+}
@@ -0,0 +1,758 @@
+//
+// Created by Cando on 2026/10/19.
+//
+#include "../../include/database/mysql_message_store.h"
+#include "../../include/database/row_decoder.h"
+#include <mysql/mysql.h>
+#include <algorithm>
+#include <unordered_map>
+#include <iostream>
+
+namespace easychat{
+    namespace {
+        // 将一行查询结果转换为消息信息
+        MessageInfo rowToMessage(const RowDecoder& row){
+            MessageInfo msg_info;
+            msg_info.id = row.getInt64(0);
+            msg_info.sender_id = row.getInt32(1);
+            msg_info.receiver_id = row.getInt32(2);
+            msg_info.content = row.getString(3);
+            msg_info.message_type = row.getInt32(4);
+            msg_info.is_offline = row.getInt32(5);
+            msg_info.is_read = row.getInt32(6);
+            msg_info.created_at = row.getString(7);
+            msg_info.seq = row.getInt64(8);
+            return msg_info;
+        }
+        // 两个用户之间会话的查询条件
+        std::string conversationCondition(int user_id1,int user_id2){
+            return "(sender_id="+std::to_string(user_id1)+" and receiver_id = "+std::to_string(user_id2)+") "
+                   "or (sender_id="+std::to_string(user_id2)+" and receiver_id = "+std::to_string(user_id1)+") ";
+        }
+        // 单聊会话在sequence_floors中的ID（与方向无关）
+        int64_t directConversationId(int user_id1,int user_id2){
+            uint32_t low = static_cast<uint32_t>(std::min(user_id1,user_id2));
+            uint32_t high = static_cast<uint32_t>(std::max(user_id1,user_id2));
+            return static_cast<int64_t>((static_cast<uint64_t>(low)<<32)|high);
+        }
+    }
+
+    MySQLMessageStore::MySQLMessageStore() : conn_pool_(ConnectionPool::getInstance()){}
+
+    bool MySQLMessageStore::executeSql(const std::string &sql) {
+        auto conn = conn_pool_.getConnection();
+        if (!conn || !conn->isConnected()) return false;
+        bool result = conn->execute(sql);
+        conn_pool_.returnConnection(conn);
+        return result;
+    }
+
+    bool MySQLMessageStore::storeMessage(MessageInfo &message) {
+        auto conn = conn_pool_.getConnection();
+        if (!conn || !conn->isConnected()) return false;
+
+        // 消息ID由服务器预先生成；为0时退回数据库自增
+        std::string id_value = message.id!=0 ? std::to_string(message.id) : "null";
+        std::string insert_sql = "insert into messages(id,sender_id,receiver_id,content,message_type,is_offline,seq) values("
+                +id_value+", "+std::to_string(message.sender_id)+", "+std::to_string(message.receiver_id)+", '"+conn->escape(message.content)+"', "
+                +std::to_string(message.message_type)+", "+std::to_string(message.is_offline)+", "+std::to_string(message.seq)+")";
+        // 同一ID重复写入（溢写区重放）视为成功
+        if (message.id!=0){
+            insert_sql += " on duplicate key update id=id";
+        }
+        if (!conn->execute(insert_sql)){
+            std::cerr<<"Failed to store message"<<std::endl;
+            conn_pool_.returnConnection(conn);
+            return false;
+        }
+        if (message.id==0){
+            message.id = static_cast<int64_t>(mysql_insert_id(conn->getMySQL()));
+        }
+        conn_pool_.returnConnection(conn);
+        return true;
+    }
+
+    bool MySQLMessageStore::fetchOfflineMessages(int user_id, std::vector<MessageInfo> &messages) {
+        auto conn = conn_pool_.getConnection();
+        if (!conn || !conn->isConnected()) return false;
+
+        std::string query_sql = "select id,sender_id,receiver_id,content,message_type,is_offline,is_read,created_at,seq "
+                                "from messages where receiver_id="+std::to_string(user_id)+" and is_offline=1 order by id asc";
+        MYSQL_RES* result = conn->query(query_sql);
+        if (!result) {
+            conn_pool_.returnConnection(conn);
+            return false;
+        }
+        RowDecoder row(result);
+        while (row.next()){
+            messages.push_back(rowToMessage(row));
+        }
+        mysql_free_result(result);
+
+        // 标记离线消息为已读
+        std::string update_sql = "update messages set is_offline=0,is_read=1 where receiver_id= "
+                +std::to_string(user_id)+" and is_offline=1";
+        conn->execute(update_sql);
+
+        conn_pool_.returnConnection(conn);
+        return true;
+    }
+
+    bool MySQLMessageStore::getChatHistory(int user_id1, int user_id2, std::vector<MessageInfo> &messages, int limit) {
+        auto conn = conn_pool_.getConnection();
+        if (!conn || !conn->isConnected()) return false;
+        std::string query_sql = "select id,sender_id,receiver_id,content,message_type,is_offline,is_read,created_at,seq "
+                                "from messages where "+conversationCondition(user_id1,user_id2)+
+                                "order by id desc limit "+std::to_string(limit);
+        MYSQL_RES *result = conn->query(query_sql);
+        if (!result) {
+            conn_pool_.returnConnection(conn);
+            return false;
+        }
+        RowDecoder row(result);
+        while (row.next()){
+            messages.push_back(rowToMessage(row));
+        }
+        mysql_free_result(result);
+        conn_pool_.returnConnection(conn);
+        return true;
+    }
+
+    bool MySQLMessageStore::writeOfflineMessages(int user_id, FrameWriter &writer) {
+        auto conn = conn_pool_.getConnection();
+        if (!conn || !conn->isConnected()) return false;
+
+        // 只取需要下发的列；离线标记在客户端确认后批量清除
+        std::string query_sql = "select id,sender_id,content,seq from messages where receiver_id="
+                +std::to_string(user_id)+" and is_offline=1 order by id asc";
+        MYSQL_RES* result = conn->query(query_sql);
+        if (!result) {
+            conn_pool_.returnConnection(conn);
+            return false;
+        }
+        RowDecoder row(result);
+        while (row.next()){
+            writer.beginFrame(MessageType::MSG_TYPE_OFFLINE_MSG,static_cast<uint32_t>(row.getInt32(1)));
+            writer.append(row.getView(0));
+            writer.append(':');
+            writer.append(row.getView(3));
+            writer.append(':');
+            writer.append(row.getView(2));
+            writer.endFrame();
+        }
+        mysql_free_result(result);
+        conn_pool_.returnConnection(conn);
+        return true;
+    }
+
+    bool MySQLMessageStore::writeMessagesSince(int user_id, int64_t after_id, FrameWriter &writer, int64_t &max_id) {
+        auto conn = conn_pool_.getConnection();
+        if (!conn || !conn->isConnected()) return false;
+        // 消息ID按时间递增，按主键范围扫描即可得到该设备缺失的消息
+        std::string query_sql = "select id,sender_id,content,seq from messages where receiver_id="
+                +std::to_string(user_id)+" and id>"+std::to_string(after_id)+" order by id asc";
+        MYSQL_RES* result = conn->query(query_sql);
+        if (!result) {
+            conn_pool_.returnConnection(conn);
+            return false;
+        }
+        int64_t last_id = 0;
+        RowDecoder row(result);
+        while (row.next()){
+            last_id = row.getInt64(0);
+            writer.beginFrame(MessageType::MSG_TYPE_OFFLINE_MSG,static_cast<uint32_t>(row.getInt32(1)));
+            writer.append(row.getView(0));
+            writer.append(':');
+            writer.append(row.getView(3));
+            writer.append(':');
+            writer.append(row.getView(2));
+            writer.endFrame();
+        }
+        mysql_free_result(result);
+        if (last_id!=0) max_id = std::max(max_id,last_id);
+        conn_pool_.returnConnection(conn);
+        return true;
+    }
+
+    bool MySQLMessageStore::getDeviceCursor(int user_id, const std::string &device_id, int64_t &message_id,
+                                            bool &found) {
+        found = false;
+        auto conn = conn_pool_.getConnection();
+        if (!conn || !conn->isConnected()) return false;
+        std::string query_sql = "select last_message_id from device_cursors where user_id="+std::to_string(user_id)+
+                                " and device_id='"+conn->escape(device_id)+"'";
+        MYSQL_RES* result = conn->query(query_sql);
+        if (!result){
+            conn_pool_.returnConnection(conn);
+            return false;
+        }
+        RowDecoder row(result);
+        if (row.next()){
+            message_id = row.getInt64(0);
+            found = true;
+        }
+        mysql_free_result(result);
+        conn_pool_.returnConnection(conn);
+        return true;
+    }
+
+    bool MySQLMessageStore::updateDeviceCursor(int user_id, const std::string &device_id, int64_t message_id) {
+        auto conn = conn_pool_.getConnection();
+        if (!conn || !conn->isConnected()) return false;
+        // 游标只前进不后退
+        std::string insert_sql = "insert into device_cursors(user_id,device_id,last_message_id) values("
+                +std::to_string(user_id)+", '"+conn->escape(device_id)+"', "+std::to_string(message_id)+")"
+                " on duplicate key update last_message_id=greatest(last_message_id,values(last_message_id))";
+        bool ok = conn->execute(insert_sql);
+        conn_pool_.returnConnection(conn);
+        return ok;
+    }
+
+    bool MySQLMessageStore::getUserCursor(int user_id, int64_t &message_id) {
+        auto conn = conn_pool_.getConnection();
+        if (!conn || !conn->isConnected()) return false;
+        MYSQL_RES* result = conn->query("select max(last_message_id) from device_cursors where user_id="+std::to_string(user_id));
+        bool found = false;
+        if (result){
+            RowDecoder row(result);
+            // 没有任何设备记录时max()返回NULL
+            if (row.next() && !row.isNull(0)){
+                message_id = row.getInt64(0);
+                found = true;
+            }
+            mysql_free_result(result);
+        }
+        conn_pool_.returnConnection(conn);
+        return found;
+    }
+
+    bool MySQLMessageStore::createRoom(const std::string &name, int owner_id, int &room_id) {
+        auto conn = conn_pool_.getConnection();
+        if (!conn || !conn->isConnected()) return false;
+        std::string insert_sql = "insert into rooms(name,owner_id) values('"+conn->escape(name)+"', "+std::to_string(owner_id)+")";
+        bool ok = conn->execute(insert_sql);
+        if (ok){
+            room_id = static_cast<int>(mysql_insert_id(conn->getMySQL()));
+        }
+        conn_pool_.returnConnection(conn);
+        return ok;
+    }
+
+    bool MySQLMessageStore::addRoomMember(int room_id, int user_id, int64_t joined_message_id) {
+        return executeSql("insert into room_members(room_id,user_id,joined_message_id) values("+std::to_string(room_id)+", "
+                          +std::to_string(user_id)+", "+std::to_string(joined_message_id)+") on duplicate key update room_id=room_id");
+    }
+
+    bool MySQLMessageStore::removeRoomMember(int room_id, int user_id) {
+        return executeSql("delete from room_members where room_id="+std::to_string(room_id)+" and user_id="+std::to_string(user_id));
+    }
+
+    bool MySQLMessageStore::loadRooms(std::vector<RoomInfo> &rooms) {
+        auto conn = conn_pool_.getConnection();
+        if (!conn || !conn->isConnected()) return false;
+        MYSQL_RES* result = conn->query("select id,name,owner_id from rooms order by id");
+        if (!result) {
+            conn_pool_.returnConnection(conn);
+            return false;
+        }
+        std::unordered_map<int,size_t> positions;
+        RowDecoder room_row(result);
+        while (room_row.next()){
+            RoomInfo room;
+            room.id = room_row.getInt32(0);
+            room.name = room_row.getString(1);
+            room.owner_id = room_row.getInt32(2);
+            positions[room.id] = rooms.size();
+            rooms.push_back(std::move(room));
+        }
+        mysql_free_result(result);
+
+        result = conn->query("select room_id,user_id,joined_message_id from room_members");
+        if (!result) {
+            conn_pool_.returnConnection(conn);
+            return false;
+        }
+        RowDecoder member_row(result);
+        while (member_row.next()){
+            auto it = positions.find(member_row.getInt32(0));
+            if (it==positions.end()) continue;
+            rooms[it->second].members.emplace_back(member_row.getInt32(1),member_row.getInt64(2));
+        }
+        mysql_free_result(result);
+        conn_pool_.returnConnection(conn);
+        return true;
+    }
+
+    bool MySQLMessageStore::storeRoomMessage(MessageInfo &message) {
+        auto conn = conn_pool_.getConnection();
+        if (!conn || !conn->isConnected()) return false;
+        std::string insert_sql = "insert into room_messages(id,room_id,sender_id,content,message_type,seq) values("
+                +std::to_string(message.id)+", "+std::to_string(message.receiver_id)+", "+std::to_string(message.sender_id)+", '"
+                +conn->escape(message.content)+"', "+std::to_string(message.message_type)+", "+std::to_string(message.seq)+")"
+                " on duplicate key update id=id";
+        bool ok = conn->execute(insert_sql);
+        if (!ok){
+            std::cerr<<"Failed to store room message"<<std::endl;
+        }
+        conn_pool_.returnConnection(conn);
+        return ok;
+    }
+
+    bool MySQLMessageStore::writeRoomMessagesSince(int room_id, int64_t after_id, FrameWriter &writer, int64_t &max_id) {
+        auto conn = conn_pool_.getConnection();
+        if (!conn || !conn->isConnected()) return false;
+        // (room_id,id)联合索引范围扫描
+        std::string query_sql = "select id,sender_id,content,seq from room_messages where room_id="
+                +std::to_string(room_id)+" and id>"+std::to_string(after_id)+" order by id asc";
+        MYSQL_RES* result = conn->query(query_sql);
+        if (!result) {
+            conn_pool_.returnConnection(conn);
+            return false;
+        }
+        RowDecoder row(result);
+        while (row.next()){
+            max_id = std::max(max_id,row.getInt64(0));
+            writer.beginFrame(MessageType::MSG_TYPE_ROOM_CHAT,static_cast<uint32_t>(row.getInt32(1)));
+            writer.appendInt(room_id);
+            writer.append(':');
+            writer.append(row.getView(0));
+            writer.append(':');
+            writer.append(row.getView(3));
+            writer.append(':');
+            writer.append(row.getView(2));
+            writer.endFrame();
+        }
+        mysql_free_result(result);
+        conn_pool_.returnConnection(conn);
+        return true;
+    }
+
+    bool MySQLMessageStore::querySeq(const std::string &query_sql, int64_t &seq) {
+        auto conn = conn_pool_.getConnection();
+        if (!conn || !conn->isConnected()) return false;
+        MYSQL_RES* result = conn->query(query_sql);
+        if (!result) {
+            conn_pool_.returnConnection(conn);
+            return false;
+        }
+        RowDecoder row(result);
+        // 没有消息时max()返回NULL
+        seq = row.next() ? row.getInt64(0,0) : 0;
+        mysql_free_result(result);
+        conn_pool_.returnConnection(conn);
+        return true;
+    }
+
+    bool MySQLMessageStore::getConversationSeq(int user_id1, int user_id2, int64_t &seq) {
+        // 过期删除后剩余消息的最大序号可能小于已分配过的序号，取两者中较大的
+        return querySeq("select greatest(coalesce(max(seq),0),coalesce((select seq from sequence_floors where kind=0 and conversation_id="
+                        +std::to_string(directConversationId(user_id1,user_id2))+"),0)) from messages where "
+                        +conversationCondition(user_id1,user_id2),seq);
+    }
+
+    bool MySQLMessageStore::getRoomSeq(int room_id, int64_t &seq) {
+        std::string room = std::to_string(room_id);
+        return querySeq("select greatest(coalesce(max(seq),0),coalesce((select seq from sequence_floors where kind=1 and conversation_id="
+                        +room+"),0)) from room_messages where room_id="+room,seq);
+    }
+
+    bool MySQLMessageStore::writeSeqRange(const std::string &query_sql, std::string_view prefix, FrameWriter &writer,
+                                          int64_t &last_seq) {
+        auto conn = conn_pool_.getConnection();
+        if (!conn || !conn->isConnected()) return false;
+        MYSQL_RES* result = conn->query(query_sql);
+        if (!result) {
+            conn_pool_.returnConnection(conn);
+            return false;
+        }
+        RowDecoder row(result);
+        while (row.next()){
+            last_seq = std::max(last_seq,row.getInt64(0));
+            writer.beginFrame(MessageType::MSG_TYPE_SYNC_RESP,static_cast<uint32_t>(row.getInt32(1)));
+            writer.append(prefix);
+            writer.append(row.getView(0));
+            writer.append(':');
+            writer.append(row.getView(2));
+            writer.endFrame();
+        }
+        mysql_free_result(result);
+        conn_pool_.returnConnection(conn);
+        return true;
+    }
+
+    bool MySQLMessageStore::writeConversationSince(int user_id1, int user_id2, int64_t after_seq, int limit,
+                                                   std::string_view prefix, FrameWriter &writer, int64_t &last_seq) {
+        // (sender_id,receiver_id,seq)索引，两个方向各一次范围扫描
+        return writeSeqRange("select seq,sender_id,content from messages where ("+conversationCondition(user_id1,user_id2)+
+                             ") and seq>"+std::to_string(after_seq)+" order by seq asc limit "+std::to_string(limit),
+                             prefix,writer,last_seq);
+    }
+
+    bool MySQLMessageStore::writeRoomSince(int room_id, int64_t after_seq, int64_t after_id, int limit,
+                                           std::string_view prefix, FrameWriter &writer, int64_t &last_seq) {
+        return writeSeqRange("select seq,sender_id,content from room_messages where room_id="+std::to_string(room_id)+
+                             " and seq>"+std::to_string(after_seq)+" and id>"+std::to_string(after_id)+
+                             " order by seq asc limit "+std::to_string(limit),
+                             prefix,writer,last_seq);
+    }
+
+    bool MySQLMessageStore::writeChatHistory(int user_id1, int user_id2, int limit, FrameWriter &writer) {
+        auto conn = conn_pool_.getConnection();
+        if (!conn || !conn->isConnected()) return false;
+        std::string query_sql = "select sender_id,content from messages where "+conversationCondition(user_id1,user_id2)+
+                                "order by id desc limit "+std::to_string(limit);
+        MYSQL_RES *result = conn->query(query_sql);
+        if (!result) {
+            conn_pool_.returnConnection(conn);
+            return false;
+        }
+        RowDecoder row(result);
+        bool first = true;
+        while (row.next()){
+            if (!first) writer.append('|');
+            first = false;
+            // 发送者ID原样拷贝文本，无需数值转换
+            writer.append(row.getView(0));
+            writer.append(':');
+            writer.append(row.getView(1));
+        }
+        mysql_free_result(result);
+        conn_pool_.returnConnection(conn);
+        return true;
+    }
+
+    bool MySQLMessageStore::markConversationsRead(const std::vector<ReadReceipt> &receipts) {
+        if (receipts.empty()) return true;
+        auto conn = conn_pool_.getConnection();
+        if (!conn || !conn->isConnected()) return false;
+        // 每个会话一条语句，按(sender_id,receiver_id,seq)索引范围更新
+        bool ok = true;
+        for (const auto& receipt:receipts){
+            ok = conn->execute("update messages set is_read=1 where sender_id="+std::to_string(receipt.peer_id)+
+                               " and receiver_id="+std::to_string(receipt.reader_id)+
+                               " and seq<="+std::to_string(receipt.seq)+" and is_read=0");
+            if (!ok) break;
+        }
+        conn_pool_.returnConnection(conn);
+        return ok;
+    }
+
+    bool MySQLMessageStore::queryUser(const std::string &query_sql, UserInfo &user_info, bool &found) {
+        found = false;
+        auto conn = conn_pool_.getConnection();
+        if (!conn || !conn->isConnected()) return false;
+        MYSQL_RES *result = conn->query(query_sql);
+        if (!result){
+            conn_pool_.returnConnection(conn);
+            return false;
+        }
+        // 查询成功但没有这一行：用户确实不存在
+        if (mysql_num_rows(result)==0){
+            mysql_free_result(result);
+            conn_pool_.returnConnection(conn);
+            return true;
+        }
+        found = true;
+        RowDecoder row(result);
+        row.next();
+        user_info.id = row.getInt32(0);
+        user_info.username = row.getString(1);
+        user_info.password = row.getString(2);
+        user_info.nickname = row.getString(3);
+        user_info.avatar = row.getString(4);
+        user_info.status = row.getInt32(5);
+        mysql_free_result(result);
+        conn_pool_.returnConnection(conn);
+        return true;
+    }
+
+    bool MySQLMessageStore::scanMessages(int64_t after_id, int limit, std::vector<MessageInfo> &messages) {
+        auto conn = conn_pool_.getConnection();
+        if (!conn || !conn->isConnected()) return false;
+        // 按主键范围分页，每页只扫描limit行
+        std::string query_sql = "select id,sender_id,receiver_id,content,message_type,is_offline,is_read,created_at,seq "
+                                "from messages where id>"+std::to_string(after_id)+" order by id limit "+std::to_string(limit);
+        MYSQL_RES *result = conn->query(query_sql);
+        if (!result) {
+            conn_pool_.returnConnection(conn);
+            return false;
+        }
+        RowDecoder row(result);
+        while (row.next()){
+            messages.push_back(rowToMessage(row));
+        }
+        mysql_free_result(result);
+        conn_pool_.returnConnection(conn);
+        return true;
+    }
+
+    bool MySQLMessageStore::getMessagesByIds(const std::vector<int64_t> &message_ids, std::vector<MessageInfo> &messages) {
+        if (message_ids.empty()) return true;
+        auto conn = conn_pool_.getConnection();
+        if (!conn || !conn->isConnected()) return false;
+        std::string query_sql = "select id,sender_id,receiver_id,content,message_type,is_offline,is_read,created_at,seq "
+                                "from messages where id in (";
+        for (size_t i=0;i<message_ids.size();++i){
+            if (i>0) query_sql += ',';
+            query_sql += std::to_string(message_ids[i]);
+        }
+        query_sql += ')';
+        MYSQL_RES *result = conn->query(query_sql);
+        if (!result) {
+            conn_pool_.returnConnection(conn);
+            return false;
+        }
+        RowDecoder row(result);
+        while (row.next()){
+            messages.push_back(rowToMessage(row));
+        }
+        mysql_free_result(result);
+        conn_pool_.returnConnection(conn);
+        return true;
+    }
+
+    bool MySQLMessageStore::expireMessages(int64_t after_id, int64_t before_id, int limit, std::vector<MessageInfo> &deleted) {
+        return expireRange("messages","",after_id,before_id,limit,deleted);
+    }
+
+    bool MySQLMessageStore::expireRoomMessages(int room_id, int64_t after_id, int64_t before_id, int limit,
+                                               std::vector<MessageInfo> &deleted) {
+        return expireRange("room_messages","room_id="+std::to_string(room_id)+" and ",after_id,before_id,limit,deleted);
+    }
+
+    bool MySQLMessageStore::expireRange(const std::string &table, const std::string &condition, int64_t after_id,
+                                        int64_t before_id, int limit, std::vector<MessageInfo> &deleted) {
+        auto conn = conn_pool_.getConnection();
+        if (!conn || !conn->isConnected()) return false;
+        bool room = table=="room_messages";
+        // 按主键（群聊为(room_id,id)索引）范围取一批，删除语句只锁定这一段
+        std::string query_sql = "select id,sender_id,"+std::string(room ? "room_id" : "receiver_id")+",seq from "+table
+                +" where "+condition+"id>"+std::to_string(after_id)+" and id<"+std::to_string(before_id)
+                +" order by id limit "+std::to_string(limit);
+        MYSQL_RES *result = conn->query(query_sql);
+        if (!result) {
+            conn_pool_.returnConnection(conn);
+            return false;
+        }
+        std::unordered_map<int64_t,int64_t> floors; // 会话ID->被删除消息的最大序号
+        RowDecoder row(result);
+        while (row.next()){
+            MessageInfo message{};
+            message.id = row.getInt64(0);
+            message.sender_id = row.getInt32(1);
+            message.receiver_id = row.getInt32(2);
+            message.seq = row.getInt64(3);
+            int64_t conversation_id = room ? message.receiver_id : directConversationId(message.sender_id,message.receiver_id);
+            int64_t& floor = floors[conversation_id];
+            floor = std::max(floor,message.seq);
+            deleted.push_back(std::move(message));
+        }
+        mysql_free_result(result);
+        if (deleted.empty()){
+            conn_pool_.returnConnection(conn);
+            return true;
+        }
+        // 先保存序号下限再删除（删除失败时下限只是提前保存，不影响序号分配）
+        std::string rows;
+        for (const auto& [conversation_id,seq]:floors){
+            if (!rows.empty()) rows += ",";
+            rows += "("+std::string(room ? "1" : "0")+","+std::to_string(conversation_id)+","+std::to_string(seq)+")";
+        }
+        bool ok = conn->execute("insert into sequence_floors(kind,conversation_id,seq) values "+rows+
+                                " on duplicate key update seq=greatest(seq,values(seq))") &&
+                  conn->execute("delete from "+table+" where "+condition+"id>"+std::to_string(after_id)
+                                +" and id<="+std::to_string(deleted.back().id));
+        conn_pool_.returnConnection(conn);
+        if (!ok) deleted.clear();
+        return ok;
+    }
+
+    bool MySQLMessageStore::loadInbox(int user_id, std::vector<InboxEntry> &entries) {
+        auto conn = conn_pool_.getConnection();
+        if (!conn || !conn->isConnected()) return false;
+        std::string user = std::to_string(user_id);
+        // 每个对方的最后一条消息：两个方向分别按对方分组取最大会话序号
+        // （idx_conversation与idx_receiver_conversation上的松散索引扫描，不扫描历史消息），
+        // 再按(发送者,接收者,序号)取正文，两个方向中序号较大的为最后一条
+        std::string query_sql = "select m.sender_id,m.receiver_id,m.id,m.seq,m.content from messages m join "
+                                "(select receiver_id peer_id,max(seq) seq from messages where sender_id="+user+
+                                " group by receiver_id) t on m.sender_id="+user+" and m.receiver_id=t.peer_id and m.seq=t.seq "
+                                "union all "
+                                "select m.sender_id,m.receiver_id,m.id,m.seq,m.content from messages m join "
+                                "(select sender_id peer_id,max(seq) seq from messages where receiver_id="+user+
+                                " group by sender_id) t on m.sender_id=t.peer_id and m.receiver_id="+user+" and m.seq=t.seq";
+        MYSQL_RES *result = conn->query(query_sql);
+        if (!result) {
+            conn_pool_.returnConnection(conn);
+            return false;
+        }
+        std::unordered_map<int,size_t> positions;
+        RowDecoder row(result);
+        while (row.next()){
+            InboxEntry entry;
+            int sender_id = row.getInt32(0);
+            entry.peer_id = sender_id==user_id ? row.getInt32(1) : sender_id;
+            entry.last_sender_id = sender_id;
+            entry.last_message_id = row.getInt64(2);
+            entry.last_seq = row.getInt64(3);
+            auto it = positions.find(entry.peer_id);
+            if (it!=positions.end()){
+                // 另一个方向已有该会话的最后一条消息
+                if (entries[it->second].last_seq>=entry.last_seq) continue;
+                entry.last_content = row.getString(4);
+                entries[it->second] = std::move(entry);
+                continue;
+            }
+            entry.last_content = row.getString(4);
+            positions[entry.peer_id] = entries.size();
+            entries.push_back(std::move(entry));
+        }
+        mysql_free_result(result);
+        // 未读消息序号（idx_unread覆盖索引，只读取该用户的未读消息）
+        result = conn->query("select sender_id,seq from messages where receiver_id="+user+" and is_read=0 order by seq");
+        if (!result) {
+            conn_pool_.returnConnection(conn);
+            return false;
+        }
+        RowDecoder unread_row(result);
+        while (unread_row.next()){
+            auto it = positions.find(unread_row.getInt32(0));
+            if (it!=positions.end()) entries[it->second].unread_seqs.push_back(unread_row.getInt64(1));
+        }
+        mysql_free_result(result);
+        conn_pool_.returnConnection(conn);
+        return true;
+    }
+
+    bool MySQLMessageStore::getUserById(int user_id, UserInfo &user_info, bool &found) {
+        return queryUser("select id,username,password,nickname,avatar,status from users where id="+std::to_string(user_id),
+                         user_info,found);
+    }
+
+    bool MySQLMessageStore::getUserByName(const std::string &username, UserInfo &user_info, bool &found) {
+        found = false;
+        auto conn = conn_pool_.getConnection();
+        if (!conn || !conn->isConnected()) return false;
+        std::string escaped_name = conn->escape(username);
+        conn_pool_.returnConnection(conn);
+        return queryUser("select id,username,password,nickname,avatar,status from users where username='"+escaped_name+"'",
+                         user_info,found);
+    }
+
+    bool MySQLMessageStore::createUser(const std::string &username, const std::string &password,
+                                       const std::string &nickname, int &user_id) {
+        // 获取数据库连接
+        auto conn = conn_pool_.getConnection();
+        if (!conn||!conn->isConnected()){
+            std::cerr<<"Failed to get database connection"<<std::endl;
+            return false;
+        }
+        std::string escaped_name = conn->escape(username);
+        // 检查用户名是否存在
+        std::string check_sql = "select id from users where username='"+escaped_name+"'";
+        MYSQL_RES* result = conn->query(check_sql);
+        if (result && mysql_num_rows(result)>0){
+            mysql_free_result(result);
+            std::cerr<<"Username already exists: "<<username<<std::endl;
+            conn_pool_.returnConnection(conn);
+            return false;
+        }
+        if (result){
+            mysql_free_result(result);
+        }
+        // 插入新用户
+        std::string insert_sql = "insert into users (username,password,nickname) values('"+escaped_name+"','"
+                +conn->escape(password)+"','"+conn->escape(nickname)+"')";
+        bool ok = conn->execute(insert_sql);
+        if (ok) user_id = static_cast<int>(mysql_insert_id(conn->getMySQL()));
+        conn_pool_.returnConnection(conn);
+        return ok;
+    }
+
+    bool MySQLMessageStore::updateUserStatus(int user_id, int status) {
+        return executeSql("update users set status="+std::to_string(status)+" where id="+std::to_string(user_id));
+    }
+
+    bool MySQLMessageStore::updateUserPassword(int user_id, const std::string &password) {
+        auto conn = conn_pool_.getConnection();
+        if (!conn || !conn->isConnected()) return false;
+        std::string update_sql = "update users set password='"+conn->escape(password)+"' where id="+std::to_string(user_id);
+        bool ok = conn->execute(update_sql);
+        conn_pool_.returnConnection(conn);
+        return ok;
+    }
+
+    bool MySQLMessageStore::addOnlineUser(int user_id, int socket_fd, const std::string &ip, int port) {
+        auto conn = conn_pool_.getConnection();
+        if (!conn || !conn->isConnected()) return false;
+        std::string insert_sql = "insert ignore into online_users(user_id,socket_fd,ip,port) values("
+                +std::to_string(user_id)+", "+std::to_string(socket_fd)+", '"+conn->escape(ip)+"', "+std::to_string(port)+")";
+        bool ok = conn->execute(insert_sql);
+        conn_pool_.returnConnection(conn);
+        return ok;
+    }
+
+    bool MySQLMessageStore::removeOnlineUser(int user_id) {
+        return executeSql("delete from online_users where user_id = "+std::to_string(user_id));
+    }
+
+    bool MySQLMessageStore::getOnlineUserIds(std::vector<int> &user_ids) {
+        auto conn = conn_pool_.getConnection();
+        if (!conn || !conn->isConnected()) return false;
+
+        MYSQL_RES *result = conn->query("select user_id from online_users");
+        if (!result) {
+            conn_pool_.returnConnection(conn);
+            return false;
+        }
+        RowDecoder row(result);
+        while (row.next()){
+            user_ids.push_back(row.getInt32(0));
+        }
+        mysql_free_result(result);
+        conn_pool_.returnConnection(conn);
+        return true;
+    }
+
+    bool MySQLMessageStore::markDelivered(const std::vector<std::pair<int, int64_t>> &deliveries) {
+        if (deliveries.empty()) return true;
+        // 整批合并为一条语句，接收者ID一并匹配，客户端无法确认别人的消息
+        std::string rows;
+        rows.reserve(deliveries.size()*32);
+        for (const auto& [receiver_id,message_id]:deliveries){
+            if (!rows.empty()) rows += ",";
+            rows += "("+std::to_string(message_id)+","+std::to_string(receiver_id)+")";
+        }
+        return executeSql("update messages set is_offline=0 where is_offline=1 and (id,receiver_id) in ("+rows+")");
+    }
+
+    bool MySQLMessageStore::updatePresence(const std::vector<PresenceUpdate> &updates) {
+        if (updates.empty()) return true;
+        auto conn = conn_pool_.getConnection();
+        if (!conn || !conn->isConnected()) return false;
+        // 整批合并为至多四条语句：上线/下线用户状态各一条，在线用户表插入/删除各一条
+        std::string online_ids,offline_ids,online_rows;
+        for (const auto& update:updates){
+            std::string id = std::to_string(update.user_id);
+            if (update.status==1){
+                online_ids += (online_ids.empty() ? "" : ",")+id;
+                online_rows += std::string(online_rows.empty() ? "" : ",")+"("+id+", "+std::to_string(update.socket_fd)+", '"
+                        +conn->escape(update.ip)+"', "+std::to_string(update.port)+")";
+            }else{
+                offline_ids += (offline_ids.empty() ? "" : ",")+id;
+            }
+        }
+        bool ok = true;
+        if (!online_ids.empty()){
+            ok = conn->execute("update users set status=1 where id in ("+online_ids+")") &&
+                 conn->execute("insert into online_users(user_id,socket_fd,ip,port) values "+online_rows+
+                               " on duplicate key update socket_fd=values(socket_fd),ip=values(ip),port=values(port)");
+        }
+        if (ok && !offline_ids.empty()){
+            ok = conn->execute("update users set status=0 where id in ("+offline_ids+")") &&
+                 conn->execute("delete from online_users where user_id in ("+offline_ids+")");
+        }
+        conn_pool_.returnConnection(conn);
+        return ok;
+    }
+}
@@ -0,0 +1,232 @@
+//
+// Created by Cando on 2026/10/19.
+//
+#include "../../include/database/query_stats.h"
+#include <algorithm>
+#include <cctype>
+#include <ctime>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+namespace easychat{
+    namespace {
+        // 慢查询日志中SQL的最大长度
+        constexpr size_t kMaxLoggedSqlLength = 1024;
+
+        uint64_t fnv1a(const std::string& text){
+            uint64_t hash = 1469598103934665603ULL;
+            for (unsigned char c:text){
+                hash ^= c;
+                hash *= 1099511628211ULL;
+            }
+            // 0保留为空槽标记
+            return hash==0 ? 1 : hash;
+        }
+
+        int bucketIndex(uint64_t us){
+            int index = 0;
+            while (us>0 && index<QueryStats::kBucketCount-1){
+                us >>= 1;
+                ++index;
+            }
+            return index;
+        }
+
+        void updateMax(std::atomic<uint64_t>& target,uint64_t value){
+            uint64_t current = target.load(std::memory_order_relaxed);
+            while (value>current && !target.compare_exchange_weak(current,value,std::memory_order_relaxed)){}
+        }
+    }
+
+    QueryStats::QueryStats() : slow_threshold_us_(-1){
+        for (auto& slot:slots_){
+            slot.hash = 0;
+            slot.text = nullptr;
+        }
+        overflow_.hash = 0;
+        overflow_.text = nullptr;
+        auto reset = [](StatementStats& stats){
+            stats.count = 0;
+            stats.errors = 0;
+            stats.total_us = 0;
+            stats.max_us = 0;
+            stats.total_wait_us = 0;
+            stats.rows = 0;
+            for (auto& bucket:stats.buckets) bucket = 0;
+        };
+        for (auto& slot:slots_) reset(slot);
+        reset(overflow_);
+    }
+
+    QueryStats::~QueryStats() {
+        close();
+        for (auto& slot:slots_){
+            delete slot.text.load();
+        }
+    }
+
+    QueryStats &QueryStats::getInstance() {
+        static QueryStats instance;
+        return instance;
+    }
+
+    bool QueryStats::init(int slow_query_ms, const std::string &slow_log_path) {
+        std::lock_guard<std::mutex> lock(slow_log_mutex_);
+        slow_threshold_us_ = slow_query_ms<0 ? -1 : static_cast<int64_t>(slow_query_ms)*1000;
+        if (slow_query_ms<0 || slow_log_path.empty()) return true;
+        slow_log_.open(slow_log_path,std::ios::app);
+        if (!slow_log_.is_open()){
+            std::cerr<<"Failed to open slow query log: "<<slow_log_path<<std::endl;
+            return false;
+        }
+        std::cout<<"Slow query log: "<<slow_log_path<<", threshold: "<<slow_query_ms<<"ms"<<std::endl;
+        return true;
+    }
+
+    void QueryStats::close() {
+        std::lock_guard<std::mutex> lock(slow_log_mutex_);
+        if (slow_log_.is_open()){
+            slow_log_.close();
+        }
+    }
+
+    std::string QueryStats::normalize(const std::string &sql) {
+        std::string result;
+        result.reserve(sql.size());
+        size_t i = 0;
+        while (i<sql.size()){
+            char c = sql[i];
+            if (c=='\'' || c=='"'){
+                // 字符串字面量（处理反斜杠转义与''转义）
+                char quote = c;
+                ++i;
+                while (i<sql.size()){
+                    if (sql[i]=='\\'){
+                        i += 2;
+                    }else if (sql[i]==quote){
+                        if (i+1<sql.size() && sql[i+1]==quote){
+                            i += 2;
+                        }else{
+                            ++i;
+                            break;
+                        }
+                    }else{
+                        ++i;
+                    }
+                }
+                result += '?';
+            }else if (std::isdigit(static_cast<unsigned char>(c)) &&
+                      (result.empty() || !(std::isalnum(static_cast<unsigned char>(result.back())) || result.back()=='_'))){
+                // 数字字面量（标识符中的数字保留）
+                while (i<sql.size() && (std::isalnum(static_cast<unsigned char>(sql[i])) || sql[i]=='.')) ++i;
+                result += '?';
+            }else if (std::isspace(static_cast<unsigned char>(c))){
+                // 合并连续空白
+                while (i<sql.size() && std::isspace(static_cast<unsigned char>(sql[i]))) ++i;
+                if (!result.empty() && result.back()!=' ') result += ' ';
+            }else{
+                result += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+                ++i;
+            }
+        }
+        while (!result.empty() && result.back()==' ') result.pop_back();
+        return result;
+    }
+
+    QueryStats::StatementStats *QueryStats::findSlot(uint64_t hash, const std::string &text) {
+        // 开放寻址，线性探测；槽一旦被占用就不再释放
+        size_t start = hash%kMaxTemplates;
+        for (size_t probe=0;probe<kMaxTemplates;++probe){
+            StatementStats& slot = slots_[(start+probe)%kMaxTemplates];
+            uint64_t current = slot.hash.load(std::memory_order_acquire);
+            if (current==hash) return &slot;
+            if (current==0){
+                uint64_t expected = 0;
+                if (slot.hash.compare_exchange_strong(expected,hash,std::memory_order_acq_rel)){
+                    slot.text.store(new std::string(text),std::memory_order_release);
+                    return &slot;
+                }
+                if (expected==hash) return &slot;
+            }
+        }
+        return &overflow_;
+    }
+
+    void QueryStats::record(const std::string &sql, int64_t wait_us, int64_t exec_us, int64_t rows, bool ok) {
+        std::string text = normalize(sql);
+        StatementStats* stats = findSlot(fnv1a(text),text);
+        uint64_t us = static_cast<uint64_t>(std::max<int64_t>(exec_us,0));
+        stats->count.fetch_add(1,std::memory_order_relaxed);
+        if (!ok) stats->errors.fetch_add(1,std::memory_order_relaxed);
+        stats->total_us.fetch_add(us,std::memory_order_relaxed);
+        stats->total_wait_us.fetch_add(static_cast<uint64_t>(std::max<int64_t>(wait_us,0)),std::memory_order_relaxed);
+        if (rows>0) stats->rows.fetch_add(static_cast<uint64_t>(rows),std::memory_order_relaxed);
+        stats->buckets[bucketIndex(us)].fetch_add(1,std::memory_order_relaxed);
+        updateMax(stats->max_us,us);
+
+        int64_t threshold = slow_threshold_us_.load(std::memory_order_relaxed);
+        if (threshold>=0 && wait_us+exec_us>=threshold){
+            writeSlowLog(sql,wait_us,exec_us,rows,ok);
+        }
+    }
+
+    void QueryStats::writeSlowLog(const std::string &sql, int64_t wait_us, int64_t exec_us, int64_t rows, bool ok) {
+        time_t now = time(nullptr);
+        struct tm tm_now;
+        localtime_r(&now,&tm_now);
+        char time_buf[32];
+        strftime(time_buf,sizeof (time_buf),"%Y-%m-%d %H:%M:%S",&tm_now);
+
+        std::lock_guard<std::mutex> lock(slow_log_mutex_);
+        if (!slow_log_.is_open()) return;
+        slow_log_<<"["<<time_buf<<"] total="<<(wait_us+exec_us)/1000.0<<"ms wait="<<wait_us/1000.0
+                 <<"ms exec="<<exec_us/1000.0<<"ms rows="<<rows<<(ok ? "" : " FAILED")<<" sql: "
+                 <<sql.substr(0,kMaxLoggedSqlLength)<<(sql.size()>kMaxLoggedSqlLength ? "..." : "")<<"\n";
+        slow_log_.flush();
+    }
+
+    uint64_t QueryStats::percentile(const StatementStats &stats, double ratio) {
+        uint64_t counts[kBucketCount];
+        uint64_t total = 0;
+        for (int i=0;i<kBucketCount;++i){
+            counts[i] = stats.buckets[i].load(std::memory_order_relaxed);
+            total += counts[i];
+        }
+        if (total==0) return 0;
+        uint64_t target = static_cast<uint64_t>(total*ratio);
+        if (target==0) target = 1;
+        uint64_t seen = 0;
+        for (int i=0;i<kBucketCount;++i){
+            seen += counts[i];
+            if (seen>=target) return i==0 ? 0 : (1ULL<<i);
+        }
+        return 1ULL<<(kBucketCount-1);
+    }
+
+    std::string QueryStats::report() const {
+        std::vector<const StatementStats*> active;
+        for (const auto& slot:slots_){
+            if (slot.text.load(std::memory_order_acquire)!= nullptr && slot.count.load()>0){
+                active.push_back(&slot);
+            }
+        }
+        if (overflow_.count.load()>0) active.push_back(&overflow_);
+        std::sort(active.begin(),active.end(),[](const StatementStats* a,const StatementStats* b){
+            return a->total_us.load()>b->total_us.load();
+        });
+
+        std::ostringstream out;
+        out<<"count errors total_ms avg_wait_us p50_us p99_us max_us rows statement\n";
+        for (const StatementStats* stats:active){
+            uint64_t count = stats->count.load();
+            uint64_t max_us = stats->max_us.load();
+            const std::string* text = stats->text.load();
+            // 桶上界可能超过实际最大值
+            out<<count<<" "<<stats->errors.load()<<" "<<stats->total_us.load()/1000<<" "
+               <<stats->total_wait_us.load()/count<<" "<<std::min(percentile(*stats,0.5),max_us)<<" "
+               <<std::min(percentile(*stats,0.99),max_us)<<" "<<max_us<<" "<<stats->rows.load()<<" "<<(text ? *text : "<other>")<<"\n";
+        }
+        return out.str();
+    }
+}
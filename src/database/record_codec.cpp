@@ -0,0 +1,68 @@
+//
+// Created by Cando on 2026/10/19.
+//
+#include "../../include/database/record_codec.h"
+#include <unistd.h>
+#include <cerrno>
+
+namespace easychat{
+    namespace record{
+        uint32_t checksum(uint8_t type,const char* data,size_t length){
+            uint32_t hash = 2166136261u;
+            hash = (hash ^ type) * 16777619u;
+            for (size_t i=0;i<length;++i){
+                hash = (hash ^ static_cast<uint8_t>(data[i])) * 16777619u;
+            }
+            return hash;
+        }
+
+        void putInt32(std::string& out,int32_t value){
+            out.append(reinterpret_cast<const char*>(&value),sizeof (value));
+        }
+
+        void putInt64(std::string& out,int64_t value){
+            out.append(reinterpret_cast<const char*>(&value),sizeof (value));
+        }
+
+        void putString(std::string& out,const std::string& value){
+            putInt32(out,static_cast<int32_t>(value.size()));
+            out.append(value);
+        }
+
+        std::string buildRecord(uint8_t type,const std::string& payload){
+            RecordHeader header;
+            header.length = static_cast<uint32_t>(payload.size());
+            header.checksum = checksum(type,payload.data(),payload.size());
+            header.type = type;
+            std::string record(reinterpret_cast<const char*>(&header),sizeof (header));
+            record.append(payload);
+            return record;
+        }
+
+        bool preadFull(int fd,char* buffer,size_t length,uint64_t offset){
+            size_t total = 0;
+            while (total<length){
+                ssize_t bytes = ::pread(fd,buffer+total,length-total,offset+total);
+                if (bytes<=0){
+                    if (bytes==-1 && errno==EINTR) continue;
+                    return false;
+                }
+                total += bytes;
+            }
+            return true;
+        }
+
+        bool pwriteFull(int fd,const char* buffer,size_t length,uint64_t offset){
+            size_t total = 0;
+            while (total<length){
+                ssize_t bytes = ::pwrite(fd,buffer+total,length-total,offset+total);
+                if (bytes<=0){
+                    if (bytes==-1 && errno==EINTR) continue;
+                    return false;
+                }
+                total += bytes;
+            }
+            return true;
+        }
+    }
+}
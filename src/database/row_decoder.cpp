@@ -0,0 +1,46 @@
+//
+// Created by Cando on 2026/10/19.
+//
+#include "../../include/database/row_decoder.h"
+#include <charconv>
+
+namespace easychat{
+    namespace {
+        template<typename T> T parseInteger(std::string_view view,T default_value){
+            T value = default_value;
+            auto [ptr,ec] = std::from_chars(view.data(),view.data()+view.size(),value);
+            if (ec!=std::errc() || ptr!=view.data()+view.size()) return default_value;
+            return value;
+        }
+    }
+
+    RowDecoder::RowDecoder(MYSQL_RES *result) : result_(result),row_(nullptr),lengths_(nullptr){}
+
+    bool RowDecoder::next() {
+        if (result_== nullptr) return false;
+        row_ = mysql_fetch_row(result_);
+        if (row_== nullptr) return false;
+        lengths_ = mysql_fetch_lengths(result_);
+        return lengths_!= nullptr;
+    }
+
+    std::string_view RowDecoder::getView(int column) const {
+        if (row_[column]== nullptr) return {};
+        return std::string_view(row_[column],lengths_[column]);
+    }
+
+    std::string RowDecoder::getString(int column) const {
+        std::string_view view = getView(column);
+        return std::string(view.data(),view.size());
+    }
+
+    int32_t RowDecoder::getInt32(int column, int32_t default_value) const {
+        if (row_[column]== nullptr) return default_value;
+        return parseInteger<int32_t>(getView(column),default_value);
+    }
+
+    int64_t RowDecoder::getInt64(int column, int64_t default_value) const {
+        if (row_[column]== nullptr) return default_value;
+        return parseInteger<int64_t>(getView(column),default_value);
+    }
+}
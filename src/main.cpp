@@ -3,10 +3,24 @@
 #include "common/logger.h"
 #include "common/daemon.h"
 #include "common/signal_handler.h"
+#include "common/id_generator.h"
 #include "network/reactor.h"
+#include "network/rate_limiter.h"
 #include "database/connection_pool.h"
+#include "database/mysql_message_store.h"
+#include "database/query_stats.h"
+#include "database/message_spool.h"
+#include "database/blob_store.h"
+#include "business/session_manager.h"
+#include "database/log_message_store.h"
 #include "business/user_manager.h"
 #include "business/message_handler.h"
+#include "business/room_manager.h"
+#include "business/broadcaster.h"
+#include "business/conversation_index.h"
+#include "business/inbox_index.h"
+#include "business/search_index.h"
+#include "business/retention_sweeper.h"
 
 using namespace easychat;
 
@@ -97,29 +111,154 @@ int main(int argc, char* argv[]) {
     signal_handler.init();
     LOG_INFO()<<"Signal handlers initialized successfully";
 
-    // 初始化数据库连接池
-    LOG_INFO()<<"Initializing database connection pool...";
-    std::string db_host = Config::getInstance().getString("database.host", "localhost");
-    uint16_t db_port = Config::getInstance().getPort("database.port", 3306);
-    std::string db_user = Config::getInstance().getString("database.user", "easychat");
-    std::string db_password = Config::getInstance().getString("database.password", "password");
-    std::string db_name = Config::getInstance().getString("database.database", "easychat");
-    int db_pool_size = Config::getInstance().getInt("database.max_connections", 10);
-
-    LOG_INFO()<<"Database config: "<<db_host<<":"<<std::to_string(db_port)<<", user: "<<db_user<<", db: "<<db_name;
-
-    auto& conn_pool = ConnectionPool::getInstance();
-    if (!conn_pool.init(db_host, db_port, db_user, db_password, db_name, db_pool_size)) {
-        LOG_ERROR()<<"Failed to initialize database connection pool";
-        std::cerr << "Failed to initialize database connection pool" << std::endl;
-        return 1;
+    // 初始化消息ID生成器（多节点部署时每个节点的node_id必须不同）
+    IdGenerator::getInstance().init(Config::getInstance().getInt("server.node_id", 0));
+
+    // 初始化存储后端
+    std::string storage_backend = Config::getInstance().getString("storage.backend", "mysql");
+    LOG_INFO()<<"Storage backend: "<<storage_backend;
+    std::shared_ptr<MessageStore> store;
+    std::shared_ptr<LogMessageStore> log_store;
+    std::shared_ptr<MessageSpool> spool;
+    if (storage_backend == "log") {
+        // 嵌入式追加日志存储，无需MySQL
+        std::string data_dir = Config::getInstance().getString("storage.data_dir", "data/store");
+        size_t segment_size = static_cast<size_t>(Config::getInstance().getInt("storage.segment_size", 64)) * 1024 * 1024;
+        int compaction_interval = Config::getInstance().getInt("storage.compaction_interval", 300);
+        int sync_interval_ms = Config::getInstance().getInt("storage.sync_interval_ms", 100);
+        log_store = std::make_shared<LogMessageStore>();
+        if (!log_store->init(data_dir, segment_size, compaction_interval, sync_interval_ms)) {
+            LOG_ERROR()<<"Failed to initialize log store at "<<data_dir;
+            std::cerr << "Failed to initialize log store at " << data_dir << std::endl;
+            return 1;
+        }
+        store = log_store;
+        LOG_INFO()<<"Log store initialized at "<<data_dir;
+    } else {
+        // 初始化数据库连接池
+        LOG_INFO()<<"Initializing database connection pool...";
+        std::string db_host = Config::getInstance().getString("database.host", "localhost");
+        uint16_t db_port = Config::getInstance().getPort("database.port", 3306);
+        std::string db_user = Config::getInstance().getString("database.user", "easychat");
+        std::string db_password = Config::getInstance().getString("database.password", "password");
+        std::string db_name = Config::getInstance().getString("database.database", "easychat");
+        int db_pool_size = Config::getInstance().getInt("database.max_connections", 10);
+
+        LOG_INFO()<<"Database config: "<<db_host<<":"<<std::to_string(db_port)<<", user: "<<db_user<<", db: "<<db_name;
+
+        auto& conn_pool = ConnectionPool::getInstance();
+        // 超时与熔断：数据库卡死或宕机时快速失败，消息转入本地溢写区
+        conn_pool.configureResilience(Config::getInstance().getInt("database.connect_timeout", 3),
+                                      Config::getInstance().getInt("database.read_timeout", 5),
+                                      Config::getInstance().getInt("database.write_timeout", 5),
+                                      Config::getInstance().getInt("database.acquire_timeout_ms", 1000),
+                                      Config::getInstance().getInt("database.breaker_failure_threshold", 5),
+                                      Config::getInstance().getInt("database.breaker_open_ms", 5000));
+        if (!conn_pool.init(db_host, db_port, db_user, db_password, db_name, db_pool_size)) {
+            LOG_ERROR()<<"Failed to initialize database connection pool";
+            std::cerr << "Failed to initialize database connection pool" << std::endl;
+            return 1;
+        }
+        store = std::make_shared<MySQLMessageStore>();
+        LOG_INFO()<<"Database connection pool initialized successfully";
+
+        // 慢查询日志与语句耗时统计
+        int slow_query_ms = Config::getInstance().getInt("database.slow_query_ms", 100);
+        std::string slow_log_path = Config::getInstance().getString("database.slow_log_path", "logs/slow_query.log");
+        if (!QueryStats::getInstance().init(slow_query_ms, slow_log_path)) {
+            LOG_WARN()<<"Failed to open slow query log: "<<slow_log_path;
+        }
+
+        // 本地消息溢写区（spool_path为空时关闭）
+        std::string spool_path = Config::getInstance().getString("storage.spool_path", "data/spool/messages.spool");
+        if (!spool_path.empty()) {
+            spool = std::make_shared<MessageSpool>();
+            if (!spool->init(spool_path, store,
+                             Config::getInstance().getInt("storage.spool_sync_interval_ms", 50),
+                             Config::getInstance().getInt("storage.spool_retry_interval_ms", 1000))) {
+                LOG_ERROR()<<"Failed to open message spool at "<<spool_path;
+                std::cerr << "Failed to open message spool at " << spool_path << std::endl;
+                return 1;
+            }
+            LOG_INFO()<<"Message spool opened at "<<spool_path<<", pending: "<<spool->pendingCount();
+        }
+    }
+
+    // 附件存储（blob.dir为空时关闭附件上传）
+    std::string blob_dir = Config::getInstance().getString("blob.dir", "data/blobs");
+    if (!blob_dir.empty()) {
+        if (!BlobStore::getInstance().init(blob_dir,
+                static_cast<uint64_t>(Config::getInstance().getInt("blob.max_mb", 100)) * 1024 * 1024,
+                Config::getInstance().getInt("blob.upload_ttl_hours", 24) * 3600,
+                static_cast<uint64_t>(Config::getInstance().getInt("blob.user_quota_mb", 1024)) * 1024 * 1024,
+                Config::getInstance().getInt("blob.max_pending_uploads", 8))) {
+            LOG_ERROR()<<"Failed to initialize blob store at "<<blob_dir;
+            return 1;
+        }
+        BlobStore::getInstance().setRoomMembership([](int room_id, int user_id) {
+            return RoomManager::getInstance().isMember(room_id, user_id);
+        });
+        LOG_INFO()<<"Blob store initialized at "<<blob_dir;
     }
-    LOG_INFO()<<"Database connection pool initialized successfully";
 
     // 初始化业务模块
     LOG_INFO()<<"Initializing business modules...";
-    UserManager::getInstance().init();
-    MessageHandler::getInstance().init();
+    if (!SessionManager::getInstance().init(Config::getInstance().getString("security.session_secret", ""),
+                                            Config::getInstance().getInt("security.session_ttl", 604800))) {
+        LOG_ERROR()<<"Failed to initialize session manager";
+        return 1;
+    }
+    UserManager::getInstance().init(store);
+    UserManager::getInstance().setPasswordIterations(Config::getInstance().getInt("security.password_iterations", 100000));
+    UserManager::getInstance().configureCache(
+            static_cast<size_t>(Config::getInstance().getInt("cache.user_capacity", 10000)),
+            Config::getInstance().getInt("cache.user_ttl_ms", 60000),
+            Config::getInstance().getInt("cache.user_negative_ttl_ms", 5000));
+    UserManager::getInstance().configurePresence(
+            Config::getInstance().getInt("presence.flush_interval_ms", 200),
+            static_cast<size_t>(Config::getInstance().getInt("presence.batch_size", 500)));
+    if (!RoomManager::getInstance().init(store,
+                                         static_cast<size_t>(Config::getInstance().getInt("room.max_members", 1000)))) {
+        LOG_ERROR()<<"Failed to initialize room manager";
+        return 1;
+    }
+    ConversationIndex::getInstance().init(
+            static_cast<size_t>(Config::getInstance().getInt("sync.recent_messages", 64)),
+            static_cast<size_t>(Config::getInstance().getInt("sync.cached_conversations", 10000)),
+            static_cast<size_t>(Config::getInstance().getInt("sync.cache_mb", 64)) * 1024 * 1024);
+    InboxIndex::getInstance().init(static_cast<size_t>(Config::getInstance().getInt("inbox.cached_users", 10000)));
+    if (Config::getInstance().getBool("search.enabled", true)) {
+        SearchIndex::getInstance().start(store,
+                static_cast<size_t>(Config::getInstance().getInt("search.seal_postings", 65536)),
+                static_cast<size_t>(Config::getInstance().getInt("search.max_segments", 8)),
+                Config::getInstance().getBool("search.backfill", true));
+    }
+    MessageHandler::getInstance().init(store, spool);
+    MessageHandler::getInstance().setMaxSyncDelta(Config::getInstance().getInt("sync.max_delta", 500));
+    MessageHandler::getInstance().configureDelivery(
+            static_cast<size_t>(Config::getInstance().getInt("delivery.max_unacked", 1000)),
+            static_cast<size_t>(Config::getInstance().getInt("delivery.max_parked", 10000)),
+            Config::getInstance().getInt("delivery.flush_interval_ms", 200),
+            static_cast<size_t>(Config::getInstance().getInt("delivery.batch_size", 500)),
+            Config::getInstance().getInt("delivery.cursor_grace_ms", 5000));
+    MessageHandler::getInstance().configureDedupe(
+            Config::getInstance().getInt("dedupe.ttl_seconds", 300) * 1000,
+            static_cast<size_t>(Config::getInstance().getInt("dedupe.max_entries", 100000)));
+    MessageHandler::getInstance().configureReceipts(
+            Config::getInstance().getInt("receipt.window_ms", 500),
+            static_cast<size_t>(Config::getInstance().getInt("receipt.batch_size", 500)));
+    if (Config::getInstance().getBool("retention.enabled", false)) {
+        RetentionSweeper::getInstance().start(store,
+                Config::getInstance().getInt("retention.ttl_seconds", 0),
+                Config::getInstance().getInt("retention.room_ttl_seconds", 0),
+                Config::getInstance().getString("retention.room_overrides", ""),
+                Config::getInstance().getInt("retention.batch_size", 500),
+                Config::getInstance().getInt("retention.max_rate", 2000),
+                Config::getInstance().getInt("retention.interval_seconds", 600));
+    }
+    Broadcaster::getInstance().init(
+            static_cast<size_t>(Config::getInstance().getInt("broadcast.batch_size", 1000)),
+            Config::getInstance().getString("broadcast.admin_user_ids", ""));
     LOG_INFO()<<"Business modules initialized successfully";
 
     // 初始化 Reactor
@@ -127,10 +266,30 @@ int main(int argc, char* argv[]) {
     std::string server_host = Config::getInstance().getString("server.host", "0.0.0.0");
     uint16_t server_port = Config::getInstance().getPort("server.port", 8888);
     int thread_pool_size = Config::getInstance().getInt("server.thread_pool_size", 4);
+    RateLimiter::getInstance().configure(RateClass::CHAT,
+                                         Config::getInstance().getInt("rate_limit.chat_rate", 20),
+                                         Config::getInstance().getInt("rate_limit.chat_burst", 40),
+                                         Config::getInstance().getInt("rate_limit.global_chat_rate", 50000));
+    RateLimiter::getInstance().configure(RateClass::QUERY,
+                                         Config::getInstance().getInt("rate_limit.query_rate", 5),
+                                         Config::getInstance().getInt("rate_limit.query_burst", 20),
+                                         Config::getInstance().getInt("rate_limit.global_query_rate", 5000));
+    RateLimiter::getInstance().configure(RateClass::AUTH,
+                                         Config::getInstance().getInt("rate_limit.auth_rate", 2),
+                                         Config::getInstance().getInt("rate_limit.auth_burst", 5),
+                                         Config::getInstance().getInt("rate_limit.global_auth_rate", 200));
+
+    Reactor::getInstance().setRelayLimit(
+            static_cast<uint64_t>(Config::getInstance().getInt("relay.max_mb", 100)) * 1024 * 1024);
+    Reactor::getInstance().setRelayTimeouts(Config::getInstance().getInt("relay.accept_timeout_seconds", 30),
+                                            Config::getInstance().getInt("relay.idle_timeout_seconds", 10));
 
     LOG_INFO()<<"Server config: " + server_host + ":" + std::to_string(server_port) + ", thread pool size: " + std::to_string(thread_pool_size);
 
-    if (!Reactor::getInstance().init(server_host, server_port, thread_pool_size)) {
+    int auth_thread_count = Config::getInstance().getInt("security.auth_thread_count", 2);
+    int auth_queue_size = Config::getInstance().getInt("security.auth_queue_size", 256);
+    if (!Reactor::getInstance().init(server_host, server_port, thread_pool_size,
+                                     auth_thread_count, static_cast<size_t>(auth_queue_size))) {
         LOG_ERROR()<<"Failed to initialize reactor";
         std::cerr << "Failed to initialize reactor" << std::endl;
         return 1;
@@ -144,7 +303,23 @@ int main(int argc, char* argv[]) {
 
     // 清理资源
     LOG_INFO()<<"Shutting down...";
+    LOG_INFO()<<"User cache: "<<UserManager::getInstance().getCacheStats();
     std::cout << "Server shutting down..." << std::endl;
+    // 先停止过期清理，写完在线状态与投递状态，再关闭存储
+    RetentionSweeper::getInstance().stop();
+    UserManager::getInstance().shutdown();
+    MessageHandler::getInstance().shutdown();
+    SearchIndex::getInstance().stop();
+    if (spool) {
+        spool->close();
+    }
+    if (log_store) {
+        log_store->close();
+    } else {
+        // 输出各语句模板的耗时统计
+        LOG_INFO()<<"Query statistics:\n"<<QueryStats::getInstance().report();
+        QueryStats::getInstance().close();
+    }
     Logger::getInstance().close();
 
     // 删除 PID 文件（如果是守护进程）
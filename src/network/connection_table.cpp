@@ -0,0 +1,82 @@
+//
+// Created by Cando on 2026/10/19.
+//
+#include "../../include/network/connection_table.h"
+
+namespace easychat{
+    ConnectionTable::ConnectionTable() :size_(0){
+        for (auto& chunk:chunks_){
+            chunk.store(nullptr,std::memory_order_relaxed);
+        }
+    }
+
+    ConnectionTable::~ConnectionTable() {
+        for (auto& chunk:chunks_){
+            delete chunk.load(std::memory_order_relaxed);
+        }
+    }
+
+    ConnectionTable::Slot *ConnectionTable::slotFor(int fd, bool create) const {
+        if (fd<0) return nullptr;
+        size_t index = static_cast<size_t>(fd)/kChunkSize;
+        if (index>=kMaxChunks) return nullptr;
+        Chunk* chunk = chunks_[index].load(std::memory_order_acquire);
+        if (chunk== nullptr){
+            if (!create) return nullptr;
+            std::lock_guard<std::mutex> lock(grow_mutex_);
+            chunk = chunks_[index].load(std::memory_order_relaxed);
+            if (chunk== nullptr){
+                chunk = new Chunk();
+                chunks_[index].store(chunk,std::memory_order_release);
+            }
+        }
+        return &chunk->slots[static_cast<size_t>(fd)%kChunkSize];
+    }
+
+    bool ConnectionTable::insert(const ConnectionHandle &handle, std::shared_ptr<ClientConnection> conn) {
+        if (!handle.valid()) return false;
+        Slot* slot = slotFor(handle.fd,true);
+        if (slot== nullptr) return false;
+        std::lock_guard<std::mutex> lock(slot->mutex);
+        if (slot->conn) return false;
+        slot->generation = handle.generation;
+        slot->conn = std::move(conn);
+        size_.fetch_add(1,std::memory_order_relaxed);
+        return true;
+    }
+
+    std::shared_ptr<ClientConnection> ConnectionTable::find(const ConnectionHandle &handle) const {
+        if (!handle.valid()) return nullptr;
+        Slot* slot = slotFor(handle.fd,false);
+        if (slot== nullptr) return nullptr;
+        std::lock_guard<std::mutex> lock(slot->mutex);
+        if (slot->generation!=handle.generation) return nullptr;
+        return slot->conn;
+    }
+
+    bool ConnectionTable::remove(const ConnectionHandle &handle) {
+        Slot* slot = slotFor(handle.fd,false);
+        if (slot== nullptr) return false;
+        std::shared_ptr<ClientConnection> removed;
+        {
+            std::lock_guard<std::mutex> lock(slot->mutex);
+            if (!slot->conn || slot->generation!=handle.generation) return false;
+            removed = std::move(slot->conn);
+            slot->conn.reset();
+        }
+        size_.fetch_sub(1,std::memory_order_relaxed);
+        // removed在锁外析构，连接的最后一个引用可能在此释放
+        return true;
+    }
+
+    void ConnectionTable::snapshot(std::vector<std::shared_ptr<ClientConnection>> &conns) const {
+        for (const auto& chunk_ptr:chunks_){
+            Chunk* chunk = chunk_ptr.load(std::memory_order_acquire);
+            if (chunk== nullptr) continue;
+            for (const auto& slot:chunk->slots){
+                std::lock_guard<std::mutex> lock(slot.mutex);
+                if (slot.conn) conns.push_back(slot.conn);
+            }
+        }
+    }
+}
@@ -62,6 +62,7 @@ namespace easychat{
             return false;
         }
         // 清除回调函数
+        std::lock_guard<std::mutex> lock(callback_mutex_);
         read_callbacks_.erase(fd);
         write_callbacks_.erase(fd);
         error_callbacks_.erase(fd);
@@ -93,16 +94,25 @@ namespace easychat{
         return events_[index].events;
     }
     void Epoll::setReadCallback(int fd, EventCallback cb) {
-        read_callbacks_[fd] = cb;
+        std::lock_guard<std::mutex> lock(callback_mutex_);
+        read_callbacks_[fd] = std::move(cb);
     }
     void Epoll::setWriteCallback(int fd, EventCallback cb) {
-        write_callbacks_[fd] = cb;
+        std::lock_guard<std::mutex> lock(callback_mutex_);
+        write_callbacks_[fd] = std::move(cb);
     }
     void Epoll::setErrorCallback(int fd, EventCallback cb) {
-        error_callbacks_[fd] = cb;
+        std::lock_guard<std::mutex> lock(callback_mutex_);
+        error_callbacks_[fd] = std::move(cb);
     }
     void Epoll::setCloseCallback(int fd, EventCallback cb) {
-        close_callbacks_[fd] = cb;
+        std::lock_guard<std::mutex> lock(callback_mutex_);
+        close_callbacks_[fd] = std::move(cb);
+    }
+    EventCallback Epoll::findCallback(const std::unordered_map<int, EventCallback> &callbacks, int fd) {
+        std::lock_guard<std::mutex> lock(callback_mutex_);
+        auto it = callbacks.find(fd);
+        return it!=callbacks.end() ? it->second : EventCallback();
     }
     void Epoll::handleEvents(int num_events) {
         //遍历就绪事件
@@ -112,26 +122,23 @@ namespace easychat{
 
             // 处理错误事件
             if (events & (EPOLLERR | EPOLLHUP)){
-                auto it = error_callbacks_.find(fd);
-                if (it!=error_callbacks_.end() && it->second){
-                    it->second();
+                if (auto cb = findCallback(error_callbacks_,fd)){
+                    cb();
                 }
                 continue;
             }
             //处理可读事件
             if (events & EPOLLIN){
-                auto it = read_callbacks_.find(fd);
-                if (it!=read_callbacks_.end() && it->second){
-                    it->second();
+                if (auto cb = findCallback(read_callbacks_,fd)){
+                    cb();
                 }
             }
             // 处理可写事件
             if (events & EPOLLOUT){
-                auto it = write_callbacks_.find(fd);
-                if (it!=write_callbacks_.end() && it->second){
-                    it->second();
+                if (auto cb = findCallback(write_callbacks_,fd)){
+                    cb();
                 }
             }
         }
     }
-}
\ No newline at end of file
+}
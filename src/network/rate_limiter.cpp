@@ -0,0 +1,118 @@
+//
+// Created by Cando on 2026/10/19.
+//
+#include "../../include/network/rate_limiter.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+namespace easychat{
+    namespace {
+        constexpr size_t kMinPruneThreshold = 1024;
+
+        int64_t currentUs(){
+            return std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+    }
+
+    bool TokenBucket::take(int rate_per_sec, int burst, int64_t now_us, int64_t &retry_after_ms) {
+        if (rate_per_sec<=0) return true;
+        // 每个令牌的间隔与允许提前的时间（突发量-1个间隔）
+        int64_t interval = 1000000/rate_per_sec;
+        int64_t tolerance = interval*(std::max(burst,1)-1);
+        int64_t tat = tat_.load(std::memory_order_relaxed);
+        while (true){
+            int64_t start = std::max(tat,now_us);
+            if (start-now_us>tolerance){
+                retry_after_ms = (start-tolerance-now_us+999)/1000;
+                return false;
+            }
+            if (tat_.compare_exchange_weak(tat,start+interval,std::memory_order_relaxed)) return true;
+        }
+    }
+
+    RateLimiter::RateLimiter() :prune_threshold_(kMinPruneThreshold){}
+
+    RateLimiter &RateLimiter::getInstance() {
+        static RateLimiter instance;
+        return instance;
+    }
+
+    void RateLimiter::configure(RateClass rate_class, int user_rate, int user_burst, int global_rate) {
+        if (rate_class==RateClass::NONE) return;
+        ClassLimit& limit = limits_[static_cast<int>(rate_class)];
+        limit.user_rate = user_rate;
+        limit.user_burst = std::max(user_burst,1);
+        limit.global_rate = global_rate;
+        std::cout<<"Rate limit configured, class: "<<static_cast<int>(rate_class)<<", user: "<<user_rate<<"/s burst "
+        <<limit.user_burst<<", global: "<<global_rate<<"/s"<<std::endl;
+    }
+
+    RateClass RateLimiter::classify(MessageType type) {
+        switch (type){
+            case MessageType::MSG_TYPE_CHAT:
+            case MessageType::MSG_TYPE_ROOM_CHAT:
+            case MessageType::MSG_TYPE_BROADCAST:
+            case MessageType::MSG_TYPE_READ:
+                return RateClass::CHAT;
+            case MessageType::MSG_TYPE_HISTORY:
+            case MessageType::MSG_TYPE_GET_USERS:
+            case MessageType::MSG_TYPE_INBOX:
+            case MessageType::MSG_TYPE_SEARCH:
+            case MessageType::MSG_TYPE_BLOB_BEGIN:
+            case MessageType::MSG_TYPE_BLOB_GET:
+            case MessageType::MSG_TYPE_RELAY_BEGIN:
+            case MessageType::MSG_TYPE_GET_USER_BY_NAME:
+            case MessageType::MSG_TYPE_SYNC:
+            case MessageType::MSG_TYPE_ROOM_CREATE:
+            case MessageType::MSG_TYPE_ROOM_JOIN:
+            case MessageType::MSG_TYPE_ROOM_LEAVE:
+                return RateClass::QUERY;
+            case MessageType::MSG_TYPE_LOGIN:
+            case MessageType::MSG_TYPE_REGISTER:
+            case MessageType::MSG_TYPE_RESUME:
+                return RateClass::AUTH;
+            default:
+                return RateClass::NONE;
+        }
+    }
+
+    std::shared_ptr<UserRateState> RateLimiter::acquire(int user_id) {
+        std::lock_guard<std::mutex> lock(users_mutex_);
+        auto& entry = users_[user_id];
+        auto state = entry.lock();
+        if (!state){
+            state = std::make_shared<UserRateState>();
+            entry = state;
+        }
+        if (users_.size()>prune_threshold_){
+            for (auto it=users_.begin();it!=users_.end();){
+                if (it->second.expired()) it = users_.erase(it);
+                else ++it;
+            }
+            prune_threshold_ = std::max(kMinPruneThreshold,users_.size()*2);
+        }
+        return state;
+    }
+
+    bool RateLimiter::allow(UserRateState *state, MessageType type, int64_t &retry_after_ms) {
+        RateClass rate_class = classify(type);
+        if (rate_class==RateClass::NONE) return true;
+        int index = static_cast<int>(rate_class);
+        const ClassLimit& limit = limits_[index];
+        int64_t now_us = currentUs();
+        // 先扣用户的令牌：被用户限流的请求不消耗全服令牌
+        if (state && !state->buckets[index].take(limit.user_rate,limit.user_burst,now_us,retry_after_ms)) return false;
+        // 全服令牌桶的突发量为一秒的速率
+        return global_buckets_[index].take(limit.global_rate,limit.global_rate,now_us,retry_after_ms);
+    }
+
+    bool RateLimiter::allowUnauthenticated(TokenBucket &connection_bucket, int64_t &retry_after_ms) {
+        int index = static_cast<int>(RateClass::AUTH);
+        const ClassLimit& limit = limits_[index];
+        int64_t now_us = currentUs();
+        if (!connection_bucket.take(limit.user_rate,limit.user_burst,now_us,retry_after_ms)) return false;
+        return global_buckets_[index].take(limit.global_rate,limit.global_rate,now_us,retry_after_ms);
+    }
+}
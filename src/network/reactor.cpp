@@ -3,13 +3,53 @@
 //
 #include "../../include/network/reactor.h"
 #include "../../include/common/protocol.h"
+#include "../../include/business/session_manager.h"
+#include "../../include/business/broadcaster.h"
+#include "../../include/common/id_generator.h"
 #include <iostream>
+#include <algorithm>
 #include <arpa/inet.h>
 #include <cstring>
+#include <limits>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
 
 namespace easychat{
+    namespace {
+        // 连接代数从1开始递增（0表示无效句柄）
+        uint32_t nextGeneration(){
+            static std::atomic<uint32_t> generation{0};
+            uint32_t value = generation.fetch_add(1,std::memory_order_relaxed)+1;
+            return value!=0 ? value : generation.fetch_add(1,std::memory_order_relaxed)+1;
+        }
+        // 单调时钟毫秒数（直传超时）
+        int64_t steadyMs(){
+            return std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+        // 未指定设备ID的客户端共用默认设备
+        const char* kDefaultDevice = "default";
+        const size_t kMaxDeviceIdLength = 64;
+        // 拆分可选的设备ID字段（value:device_id），返回设备ID
+        std::string splitDeviceId(std::string& value){
+            size_t colon_pos = value.find(':');
+            if (colon_pos==std::string::npos) return kDefaultDevice;
+            std::string device_id = value.substr(colon_pos+1,kMaxDeviceIdLength);
+            value.resize(colon_pos);
+            return device_id.empty() ? kDefaultDevice : device_id;
+        }
+    }
+
+    Relay::~Relay() {
+        if (pipe_fds[0]!=-1) ::close(pipe_fds[0]);
+        if (pipe_fds[1]!=-1) ::close(pipe_fds[1]);
+    }
+
     ClientConnection::ClientConnection(int fd, const std::string &ip, int port)
-    :fd_(fd),ip_(ip),port_(port),user_id_(-1),socket_(fd, true){ // 明确拥有文件描述符
+    :fd_(fd),generation_(nextGeneration()),ip_(ip),port_(port),user_id_(-1),auth_pending_(false),closed_(false),socket_(fd, true),
+    scan_offset_(0),send_offset_(0),pending_bytes_(0),device_id_(kDefaultDevice),pushed_id_(0),
+    evicted_floor_(std::numeric_limits<int64_t>::max()),sync_floor_(std::numeric_limits<int64_t>::max()),sync_token_(0){ // 明确拥有文件描述符
         // 设置Socket为非阻塞模式
         socket_.setNonBlocking();
         std::cout<<"New client connected: "<<ip_<<":"<<port_<<", FD: "<<fd_<<std::endl;
@@ -18,11 +58,22 @@ namespace easychat{
         std::cout<<"Client disconnected: "<<ip_<<": "<<port_<<", FD: "<<fd_<<std::endl;
     }
     void ClientConnection::handleRead() {
+        std::lock_guard<std::mutex> lock(read_mutex_);
+        if (closed_) return;
+        // 直传期间不解析帧，发送者的数据由接收者的发送过程直接从socket读取
+        if (auto relay = currentRelay()){
+            if (!relayRead(relay)) return;
+        }
         char buf[4096];
         ssize_t bytes_read;
-        // 读取数据（非阻塞模式）
+        // 读取数据（非阻塞模式）；缓冲区中出现开始直传的帧时停止读取，其后的原始字节留在内核中由splice转发
+        bool stopped_early = false;
         while ((bytes_read= socket_.recv(buf,sizeof (buf)))>0){
             buffer_.append(buf,bytes_read);
+            if (relayStartBuffered()){
+                stopped_early = true;
+                break;
+            }
         }
         // 处理连接关闭的情况
         if (bytes_read == 0) {
@@ -37,6 +88,8 @@ namespace easychat{
         }
         // 处理接收的数据
         while (true){
+            // 认证完成前暂不处理后续消息，完成后会重新调度
+            if (auth_pending_) break;
             // 检测缓冲区是否读取消息头部
             if (buffer_.size()<sizeof (MessageHeader)) break;
             // 解析消息头部
@@ -44,42 +97,65 @@ namespace easychat{
             std::memcpy(&header,buffer_.data(),sizeof (MessageHeader));
             // 转换字节序
             uint32_t total_length = networkTOHost32(header.length);
-            uint32_t total_type = networkTOHost32(header.type);
-            uint32_t total_id = networkTOHost32(header.user_id);
+            // 帧长度不合法（大附件应分块上传），断开连接
+            if (total_length<sizeof (MessageHeader) || total_length>kMaxFrameLength){
+                std::cerr<<"Invalid frame length "<<total_length<<" from client "<<fd_<<", closing"<<std::endl;
+                handleClose();
+                return;
+            }
             // 检查缓冲区是否有完整消息
             if (buffer_.size()<total_length) break;
             // 提取消息
             Message msg=Message::deserialize(buffer_.data(),total_length);
+            // 先检查限流（已认证按用户，认证前按连接），被限流的请求不进入业务处理、不访问存储
+            int64_t retry_after_ms = 0;
+            RateLimiter& rate_limiter = RateLimiter::getInstance();
+            if (isAuthenticated() ? !rate_limiter.allow(rate_state_.get(),msg.getType(),retry_after_ms)
+                                  : !rate_limiter.allowUnauthenticated(auth_bucket_,retry_after_ms)){
+                Message resp_msg(MessageType::MSG_TYPE_ERROR,user_id_,"Rate limited, retry after:"+std::to_string(retry_after_ms));
+                sendMessage(resp_msg);
+                buffer_.erase(0,total_length);
+                scan_offset_ -= std::min(scan_offset_,static_cast<size_t>(total_length));
+                continue;
+            }
             // 处理消息
             if (!isAuthenticated()){
                 if (msg.getType()==MessageType::MSG_TYPE_LOGIN){
-                    // 处理登录
+                    // 处理登录（格式：username:password[:device_id]）
                     std::string data = msg.getData();
                     size_t colon_pos = data.find(':');
                     if (colon_pos!=std::string::npos){
                         std::string username = data.substr(0,colon_pos);
                         std::string password = data.substr(colon_pos+1);
-                        int login_user_id;
-                        if (UserManager::getInstance().loginUser(username,password,login_user_id)){
-                            // 登陆成功
-                            user_id_ = login_user_id;
-                            UserManager::getInstance().userOnline(user_id_,fd_,ip_,port_);
-                            // 发送登录响应
-                            Message resp_msg(MessageType::MSG_TYPE_LOGIN_RESP,user_id_,"Login successful");
+                        device_id_ = splitDeviceId(password);
+                        submitAuth([self=shared_from_this(),username,password]{self->completeLogin(username,password);});
+                    }
+                }else if (msg.getType()==MessageType::MSG_TYPE_RESUME){
+                    // 处理会话恢复（格式：token[:device_id]）：只校验令牌签名，不访问用户表
+                    std::string token = msg.getData();
+                    std::string device_id = splitDeviceId(token);
+                    int resume_user_id;
+                    int64_t issued_at;
+                    if (SessionManager::getInstance().verifyToken(token,resume_user_id,issued_at)){
+                        if (!UserManager::getInstance().userOnline(resume_user_id,getHandle(),ip_,port_,true)){
+                            Message resp_msg(MessageType::MSG_TYPE_ERROR,-1,"Too many devices online");
                             sendMessage(resp_msg);
-                            // 推送离线消息
-                            std::vector<MessageInfo> offline_messages;
-                            if (MessageHandler::getInstance().getOfflineMessage(user_id_,offline_messages)){
-                                for (const auto& msg_info:offline_messages){
-                                    Message offline_msg(MessageType::MSG_TYPE_OFFLINE_MSG,msg_info.sender_id,msg_info.content);
-                                    sendMessage(offline_msg);
-                                }
-                            }
                         }else{
-                            //登陆失败
-                            Message resp_msg(MessageType::MSG_TYPE_ERROR,-1,"Login failed");
+                            device_id_ = device_id;
+                            rate_state_ = RateLimiter::getInstance().acquire(resume_user_id);
+                            user_id_ = resume_user_id;
+                            Message resp_msg(MessageType::MSG_TYPE_LOGIN_RESP,user_id_,"Resume successful");
                             sendMessage(resp_msg);
+                            // 令牌签发于本进程启动前，或之后有发给该用户的消息超过了该设备的游标，才需要同步
+                            if (issued_at<SessionManager::getInstance().getStartTime() ||
+                                MessageHandler::getInstance().hasUnsyncedMessages(user_id_,device_id_)){
+                                syncDevice();
+                            }
                         }
+                    }else{
+                        // 令牌无效或过期，客户端应回退到密码登录
+                        Message resp_msg(MessageType::MSG_TYPE_ERROR,-1,"Resume failed");
+                        sendMessage(resp_msg);
                     }
                 }else if (msg.getType()==MessageType::MSG_TYPE_REGISTER){
                     // 处理注册
@@ -88,15 +164,7 @@ namespace easychat{
                     if (colon_pos!=std::string::npos){
                         std::string username = data.substr(0,colon_pos);
                         std::string password = data.substr(colon_pos+1);
-                        if (UserManager::getInstance().registerUser(username,password)){
-                            //注册成功
-                            Message resp_msg(MessageType::MSG_TYPE_REGISTER_RESP,-1,"Register successful");
-                            sendMessage(resp_msg);
-                        }else{
-                            // 注册失败
-                            Message resp_msg(MessageType::MSG_TYPE_ERROR,-1,"Register failed");
-                            sendMessage(resp_msg);
-                        }
+                        submitAuth([self=shared_from_this(),username,password]{self->completeRegister(username,password);});
                     }
                 }
             }else if (msg.getType() == MessageType::MSG_TYPE_HISTORY) {
@@ -107,21 +175,15 @@ namespace easychat{
                     int user_id2 = std::stoi(data.substr(0, colon_pos));
                     int limit = std::stoi(data.substr(colon_pos + 1));
 
-                    // 获取聊天记录
-                    std::vector<MessageInfo> history;
-                    if (MessageHandler::getInstance().getChatHistory(user_id_, user_id2, history, limit)) {
-                        // 构建聊天记录字符串（格式：sender_id:content|sender_id:content|...）
-                        std::string history_str = "";
-                        for (const auto& msg_info : history) {
-                            if (!history_str.empty()) {
-                                history_str += "|";
-                            }
-                            history_str += std::to_string(msg_info.sender_id) + ":" + msg_info.content;
-                        }
+                    // 聊天记录直接序列化到响应帧（格式：sender_id:content|sender_id:content|...）
+                    FrameWriter history_frame;
+                    history_frame.beginFrame(MessageType::MSG_TYPE_HISTORY_RESP, user_id_);
+                    if (MessageHandler::getInstance().writeChatHistory(user_id_, user_id2, limit, history_frame)) {
+                        size_t body_size = history_frame.currentBodySize();
+                        history_frame.endFrame();
                         // 发送聊天记录
-                        Message history_msg(MessageType::MSG_TYPE_HISTORY_RESP, user_id_, history_str);
-                        sendMessage(history_msg);
-                        std::cout << "发送聊天记录: " << history_str << std::endl;
+                        sendFrames(history_frame);
+                        std::cout << "发送聊天记录: " << body_size << " bytes" << std::endl;
                     }
                 }
             }else if (msg.getType() == MessageType::MSG_TYPE_GET_USERS) {
@@ -158,8 +220,77 @@ namespace easychat{
             }else{
                 // 已认证连接，处理其他消息
                 if (msg.getType()==MessageType::MSG_TYPE_CHAT){
-                    // 处理聊天消息
-                    MessageHandler::getInstance().handleReceivedMessage(msg);
+                    // 处理聊天消息，带客户端消息ID时回复发送确认
+                    std::string receipt;
+                    if (MessageHandler::getInstance().handleReceivedMessage(msg,receipt) && !receipt.empty()){
+                        Message resp_msg(MessageType::MSG_TYPE_CHAT_RESP,user_id_,receipt);
+                        sendMessage(resp_msg);
+                    }
+                }else if (msg.getType()==MessageType::MSG_TYPE_ROOM_CHAT){
+                    // 处理群聊消息（格式：room_id:content）
+                    if (!MessageHandler::getInstance().handleRoomMessage(user_id_,msg)){
+                        Message resp_msg(MessageType::MSG_TYPE_ERROR,user_id_,"Room message rejected");
+                        sendMessage(resp_msg);
+                    }
+                }else if (msg.getType()==MessageType::MSG_TYPE_ROOM_CREATE ||
+                          msg.getType()==MessageType::MSG_TYPE_ROOM_JOIN ||
+                          msg.getType()==MessageType::MSG_TYPE_ROOM_LEAVE){
+                    handleRoomRequest(msg);
+                }else if (msg.getType()==MessageType::MSG_TYPE_BROADCAST){
+                    handleBroadcastRequest(msg);
+                }else if (msg.getType()==MessageType::MSG_TYPE_ACK){
+                    handleAck(msg.getData());
+                }else if (msg.getType()==MessageType::MSG_TYPE_READ){
+                    // 已读回执（格式：对方用户ID:seq），合并后转发
+                    MessageHandler::getInstance().handleReadReceipt(user_id_,msg.getData());
+                }else if (msg.getType()==MessageType::MSG_TYPE_INBOX){
+                    // 收件箱（消息体为会话数，为空时使用默认值），一个帧返回
+                    int limit = kDefaultInboxLimit;
+                    try {
+                        if (!msg.getData().empty()) limit = std::stoi(msg.getData());
+                    }catch (const std::exception& e){
+                        limit = kDefaultInboxLimit;
+                    }
+                    limit = std::max(1,std::min(limit,kMaxInboxLimit));
+                    FrameWriter inbox_frame;
+                    inbox_frame.beginFrame(MessageType::MSG_TYPE_INBOX,user_id_);
+                    if (MessageHandler::getInstance().writeInbox(user_id_,limit,inbox_frame)){
+                        inbox_frame.endFrame();
+                        sendFrames(inbox_frame);
+                    }else{
+                        Message resp_msg(MessageType::MSG_TYPE_ERROR,user_id_,"Inbox unavailable");
+                        sendMessage(resp_msg);
+                    }
+                }else if (msg.getType()==MessageType::MSG_TYPE_SEARCH){
+                    // 全文搜索（格式：条数:before_id:关键词），一个帧返回
+                    FrameWriter search_frame;
+                    search_frame.beginFrame(MessageType::MSG_TYPE_SEARCH,user_id_);
+                    if (MessageHandler::getInstance().writeSearch(user_id_,msg.getData(),search_frame)){
+                        search_frame.endFrame();
+                        sendFrames(search_frame);
+                    }else{
+                        Message resp_msg(MessageType::MSG_TYPE_ERROR,user_id_,"Search failed");
+                        sendMessage(resp_msg);
+                    }
+                }else if (msg.getType()==MessageType::MSG_TYPE_BLOB_BEGIN ||
+                          msg.getType()==MessageType::MSG_TYPE_BLOB_CHUNK ||
+                          msg.getType()==MessageType::MSG_TYPE_BLOB_GET){
+                    handleBlobRequest(msg);
+                }else if (msg.getType()==MessageType::MSG_TYPE_RELAY_BEGIN){
+                    handleRelayRequest(msg);
+                }else if (msg.getType()==MessageType::MSG_TYPE_RELAY_ACCEPT){
+                    handleRelayAccept(msg);
+                }else if (msg.getType()==MessageType::MSG_TYPE_RELAY_START){
+                    if (!handleRelayStart(msg,total_length)){
+                        std::cerr<<"Invalid relay start from client "<<fd_<<", closing"<<std::endl;
+                        handleClose();
+                        return;
+                    }
+                }else if (msg.getType()==MessageType::MSG_TYPE_SYNC){
+                    // 增量同步，所有帧一次发送
+                    FrameWriter frames;
+                    MessageHandler::getInstance().syncConversations(user_id_,msg.getData(),frames);
+                    sendFrames(frames);
                 }else if (msg.getType()==MessageType::MSG_TYPE_HEARTBEAT){
                     // 处理心跳消息
                     Message resp_msg(MessageType::MSG_TYPE_HEARTBEAT,user_id_,"Pong");
@@ -168,33 +299,795 @@ namespace easychat{
             }
             // 从缓存区中移除已处理的消息
             buffer_.erase(0,total_length);
+            scan_offset_ -= std::min(scan_offset_,static_cast<size_t>(total_length));
+            // 开始直传后，之后的字节属于直传数据
+            if (msg.getType()==MessageType::MSG_TYPE_RELAY_START && currentRelay()) break;
+        }
+        // 提前停止读取时内核缓冲区中还有数据，不会再触发边缘事件，重新调度读取
+        if (stopped_early && !closed_) Reactor::getInstance().scheduleRead(getHandle());
+    }
+
+    bool ClientConnection::relayStartBuffered() {
+        while (scan_offset_+sizeof (MessageHeader)<=buffer_.size()){
+            MessageHeader header;
+            std::memcpy(&header,buffer_.data()+scan_offset_,sizeof (MessageHeader));
+            uint32_t length = networkTOHost32(header.length);
+            // 非法帧由解析时处理，不再继续读取
+            if (length<sizeof (MessageHeader) || length>kMaxFrameLength) return true;
+            if (networkTOHost32(header.type)==static_cast<uint32_t>(MessageType::MSG_TYPE_RELAY_START)){
+                return scan_offset_+length<=buffer_.size();
+            }
+            scan_offset_ += length;
+        }
+        return false;
+    }
+    void ClientConnection::submitAuth(std::function<void()> task) {
+        auth_pending_ = true;
+        // 任务持有连接的引用，认证期间连接关闭也不会访问已释放的对象
+        auto wrapped = [self=shared_from_this(),task=std::move(task)]{
+            task();
+            // 认证结束，继续处理期间积压的消息
+            self->auth_pending_ = false;
+            Reactor::getInstance().scheduleRead(self->getHandle());
+        };
+        if (!Reactor::getInstance().submitAuthTask(std::move(wrapped))){
+            // 登录风暴：认证队列已满，直接拒绝，客户端稍后重试
+            auth_pending_ = false;
+            Message resp_msg(MessageType::MSG_TYPE_ERROR,-1,"Server busy, retry later");
+            sendMessage(resp_msg);
+        }
+    }
+
+    void ClientConnection::completeLogin(const std::string &username, const std::string &password) {
+        int login_user_id;
+        if (UserManager::getInstance().loginUser(username,password,login_user_id)){
+            // 登陆成功，先加入在线注册表，同步期间到达的消息实时推送（可能与同步重复）
+            // 先设置用户ID再登记：认证期间连接关闭时，关闭流程能看到用户ID并移除登记
+            rate_state_ = RateLimiter::getInstance().acquire(login_user_id);
+            user_id_ = login_user_id;
+            if (!UserManager::getInstance().userOnline(login_user_id,getHandle(),ip_,port_)){
+                user_id_ = -1;
+                Message resp_msg(MessageType::MSG_TYPE_ERROR,-1,"Too many devices online");
+                sendMessage(resp_msg);
+                return;
+            }
+            if (closed_){
+                // 连接在认证期间已关闭，关闭流程可能先于登记执行，这里撤销登记，避免失效的句柄占用设备名额
+                UserManager::getInstance().userOffline(login_user_id,getHandle());
+                return;
+            }
+            // 发送登录响应，附带会话令牌（断线重连时用MSG_TYPE_RESUME免密恢复）
+            std::string token = SessionManager::getInstance().issueToken(login_user_id);
+            Message resp_msg(MessageType::MSG_TYPE_LOGIN_RESP,login_user_id,"Login successful:"+token);
+            sendMessage(resp_msg);
+            // 补发该设备离线期间的消息
+            syncDevice();
+        }else{
+            //登陆失败
+            Message resp_msg(MessageType::MSG_TYPE_ERROR,-1,"Login failed");
+            sendMessage(resp_msg);
+        }
+    }
+
+    void ClientConnection::completeRegister(const std::string &username, const std::string &password) {
+        if (UserManager::getInstance().registerUser(username,password)){
+            //注册成功
+            Message resp_msg(MessageType::MSG_TYPE_REGISTER_RESP,-1,"Register successful");
+            sendMessage(resp_msg);
+        }else{
+            // 注册失败
+            Message resp_msg(MessageType::MSG_TYPE_ERROR,-1,"Register failed");
+            sendMessage(resp_msg);
+        }
+    }
+
+    void ClientConnection::handleRoomRequest(const Message &msg) {
+        RoomManager& room_manager = RoomManager::getInstance();
+        std::string result;
+        int room_id = -1;
+        if (msg.getType()==MessageType::MSG_TYPE_ROOM_CREATE){
+            // 消息体为房间名
+            std::string name = msg.getData().substr(0,kMaxRoomNameLength);
+            if (!name.empty() && room_manager.createRoom(user_id_,name,room_id)) result = "created";
+        }else{
+            // 消息体为房间ID
+            try {
+                room_id = std::stoi(msg.getData());
+            }catch (const std::exception& e){
+                room_id = -1;
+            }
+            if (msg.getType()==MessageType::MSG_TYPE_ROOM_JOIN){
+                if (room_id>0 && room_manager.joinRoom(room_id,user_id_)) result = "joined";
+            }else{
+                if (room_id>0 && room_manager.leaveRoom(room_id,user_id_)) result = "left";
+            }
+        }
+        if (result.empty()){
+            Message resp_msg(MessageType::MSG_TYPE_ERROR,user_id_,"Room request failed");
+            sendMessage(resp_msg);
+            return;
+        }
+        Message resp_msg(MessageType::MSG_TYPE_ROOM_RESP,user_id_,result+":"+std::to_string(room_id));
+        sendMessage(resp_msg);
+    }
+
+    void ClientConnection::handleBroadcastRequest(const Message &msg) {
+        // 只有配置中的管理员（按用户ID）可以发起全服公告
+        if (!Broadcaster::getInstance().isAdmin(user_id_)){
+            Message resp_msg(MessageType::MSG_TYPE_ERROR,user_id_,"Permission denied");
+            sendMessage(resp_msg);
+            return;
+        }
+        if (msg.getData().empty()){
+            Message resp_msg(MessageType::MSG_TYPE_ERROR,user_id_,"Empty broadcast");
+            sendMessage(resp_msg);
+            return;
+        }
+        size_t online = Broadcaster::getInstance().broadcast(msg.getData());
+        Message resp_msg(MessageType::MSG_TYPE_BROADCAST_RESP,user_id_,"queued:"+std::to_string(online));
+        sendMessage(resp_msg);
+    }
+
+    void ClientConnection::handleBlobRequest(const Message &msg) {
+        BlobStore& blob_store = BlobStore::getInstance();
+        const std::string& data = msg.getData();
+        // 所有请求都以哈希:数字开头（上传块之后是原始字节，不做拷贝）
+        size_t number_end = data.size()>65 ? data.find(':',65) : std::string::npos;
+        if (data.size()<66 || data[64]!=':' || (msg.getType()!=MessageType::MSG_TYPE_BLOB_BEGIN && number_end==std::string::npos)){
+            Message resp_msg(MessageType::MSG_TYPE_ERROR,user_id_,"Invalid blob request");
+            sendMessage(resp_msg);
+            return;
+        }
+        std::string sha256 = data.substr(0,64);
+        uint64_t number;
+        try {
+            number = std::stoull(data.substr(65,number_end==std::string::npos ? std::string::npos : number_end-65));
+        }catch (const std::exception& e){
+            Message resp_msg(MessageType::MSG_TYPE_ERROR,user_id_,"Invalid blob request");
+            sendMessage(resp_msg);
+            return;
+        }
+        std::string error;
+        if (msg.getType()==MessageType::MSG_TYPE_BLOB_BEGIN){
+            // 开始上传（格式：哈希:字节数），回复已收到的字节数，等于总字节数时表示附件已存在
+            bool exists;
+            uint64_t received;
+            if (!blob_store.beginUpload(user_id_,sha256,number,exists,received,error)){
+                Message resp_msg(MessageType::MSG_TYPE_ERROR,user_id_,error);
+                sendMessage(resp_msg);
+                return;
+            }
+            Message resp_msg(MessageType::MSG_TYPE_BLOB_RESP,user_id_,
+                             sha256+":"+std::to_string(received)+":"+std::to_string(number));
+            sendMessage(resp_msg);
+        }else if (msg.getType()==MessageType::MSG_TYPE_BLOB_CHUNK){
+            // 上传一块（格式：哈希:偏移:原始字节），只在完成或出错时回复
+            size_t length = data.size()-number_end-1;
+            if (length>kBlobChunkBytes){
+                Message resp_msg(MessageType::MSG_TYPE_ERROR,user_id_,"Blob chunk too large");
+                sendMessage(resp_msg);
+                return;
+            }
+            bool completed;
+            uint64_t received;
+            if (!blob_store.appendChunk(user_id_,sha256,number,data.data()+number_end+1,length,completed,received,error)){
+                Message resp_msg(MessageType::MSG_TYPE_ERROR,user_id_,"Blob chunk rejected:"+sha256+":"+error);
+                sendMessage(resp_msg);
+                return;
+            }
+            if (completed){
+                Message resp_msg(MessageType::MSG_TYPE_BLOB_RESP,user_id_,
+                                 sha256+":"+std::to_string(received)+":"+std::to_string(received));
+                sendMessage(resp_msg);
+            }
+        }else{
+            // 下载（格式：哈希:偏移:字节数，字节数为0表示到文件末尾），分块以sendfile直接从文件发送
+            uint64_t length = 0;
+            try {
+                length = std::stoull(data.substr(number_end+1));
+            }catch (const std::exception& e){
+                length = 0;
+            }
+            // 只有上传过、或收发过引用该附件的消息的用户可以下载；无权访问与不存在的回复相同
+            auto file = blob_store.canAccess(user_id_,sha256) ? blob_store.open(sha256) : nullptr;
+            if (!file){
+                Message resp_msg(MessageType::MSG_TYPE_ERROR,user_id_,"Blob not found:"+sha256);
+                sendMessage(resp_msg);
+                return;
+            }
+            uint64_t offset = number;
+            if (offset>=file->size()){
+                Message resp_msg(MessageType::MSG_TYPE_ERROR,user_id_,"Invalid blob range:"+sha256);
+                sendMessage(resp_msg);
+                return;
+            }
+            uint64_t end = length==0 ? file->size() : std::min(file->size(),offset+length);
+            while (offset<end){
+                size_t chunk = static_cast<size_t>(std::min<uint64_t>(kBlobChunkBytes,end-offset));
+                // 帧头部与前缀（哈希:偏移:总字节数:）在内存中，消息体的文件部分由sendfile发送
+                std::string prefix = sha256+":"+std::to_string(offset)+":"+std::to_string(file->size())+":";
+                auto frame = std::make_shared<std::vector<char>>(sizeof (MessageHeader)+prefix.size());
+                MessageHeader header;
+                header.length = hostToNetwork32(static_cast<uint32_t>(frame->size()+chunk));
+                header.type = hostToNetwork32(static_cast<uint32_t>(MessageType::MSG_TYPE_BLOB_DATA));
+                header.user_id = hostToNetwork32(static_cast<uint32_t>(user_id_.load()));
+                std::memcpy(frame->data(),&header,sizeof (MessageHeader));
+                std::memcpy(frame->data()+sizeof (MessageHeader),prefix.data(),prefix.size());
+                if (!sendFileFrame(frame,file,offset,chunk)) return;
+                offset += chunk;
+            }
+        }
+    }
+
+    void ClientConnection::handleRelayRequest(const Message &msg) {
+        // 格式：接收者ID:字节数:文件名
+        const std::string& data = msg.getData();
+        size_t first = data.find(':');
+        size_t second = first==std::string::npos ? std::string::npos : data.find(':',first+1);
+        int receiver_id;
+        uint64_t size;
+        try {
+            if (second==std::string::npos) throw std::invalid_argument("relay");
+            receiver_id = std::stoi(data.substr(0,first));
+            size = std::stoull(data.substr(first+1,second-first-1));
+        }catch (const std::exception& e){
+            Message resp_msg(MessageType::MSG_TYPE_ERROR,user_id_,"Invalid relay request");
+            sendMessage(resp_msg);
+            return;
+        }
+        std::string name = data.substr(second+1,kMaxRoomNameLength*2);
+        std::replace(name.begin(),name.end(),':','_');
+        Message store_msg(MessageType::MSG_TYPE_RELAY_RESP,user_id_,"store");
+        if (size==0 || size>Reactor::getInstance().relayLimit() || size>std::numeric_limits<uint32_t>::max()-kMaxFrameLength){
+            sendMessage(store_msg);
+            return;
+        }
+        // 接收者在线才发出邀请，否则回退到附件上传（存储转发）
+        std::shared_ptr<ClientConnection> receiver;
+        DeviceHandles devices;
+        if (UserManager::getInstance().getConnectionHandles(receiver_id,devices)){
+            for (size_t i=0;i<devices.count && !receiver;++i){
+                receiver = Reactor::getInstance().findConnection(devices.handles[i]);
+            }
+        }
+        if (!receiver || receiver.get()==this){
+            sendMessage(store_msg);
+            return;
+        }
+        auto relay = std::make_shared<Relay>();
+        relay->id = IdGenerator::getInstance().nextId();
+        relay->size = size;
+        relay->name = name;
+        relay->last_progress_ms = steadyMs();
+        relay->sender = shared_from_this();
+        relay->receiver = receiver->getHandle();
+        Reactor::getInstance().addRelay(relay);
+        // 接收者接受之前不占用其发送队列，超时未答复时回退到附件上传
+        Message offer_msg(MessageType::MSG_TYPE_RELAY_OFFER,user_id_,std::to_string(relay->id)+":"+
+                          std::to_string(user_id_.load())+":"+std::to_string(size)+":"+name);
+        if (!receiver->sendMessage(offer_msg)){
+            Reactor::getInstance().removeRelay(relay->id,relay.get());
+            sendMessage(store_msg);
+            return;
+        }
+        Message resp_msg(MessageType::MSG_TYPE_RELAY_RESP,user_id_,"wait:"+std::to_string(relay->id));
+        sendMessage(resp_msg);
+    }
+
+    void ClientConnection::handleRelayAccept(const Message &msg) {
+        // 格式：id:1（接受）或id:0（拒绝）
+        const std::string& data = msg.getData();
+        size_t colon_pos = data.find(':');
+        int64_t id;
+        try {
+            if (colon_pos==std::string::npos) throw std::invalid_argument("relay");
+            id = std::stoll(data.substr(0,colon_pos));
+        }catch (const std::exception& e){
+            return;
+        }
+        bool accepted = data.substr(colon_pos+1)=="1";
+        auto relay = Reactor::getInstance().findRelay(id);
+        if (!relay || relay->receiver!=getHandle()) return;
+        {
+            std::lock_guard<std::mutex> lock(relay->mutex);
+            if (relay->state!=RelayState::OFFERED) return;
+            relay->state = RelayState::ACCEPTED;
+            relay->last_progress_ms = steadyMs();
+        }
+        if (!accepted) Reactor::getInstance().removeRelay(id);
+        Message resp_msg(MessageType::MSG_TYPE_RELAY_RESP,relay->sender->getUserId(),
+                         (accepted ? "go:" : "store:")+std::to_string(id));
+        relay->sender->sendMessage(resp_msg);
+    }
+
+    bool ClientConnection::handleRelayStart(const Message &msg, size_t frame_length) {
+        // 格式：id:字节数，帧之后紧接着是原始字节
+        const std::string& data = msg.getData();
+        size_t colon_pos = data.find(':');
+        int64_t id;
+        uint64_t size;
+        try {
+            if (colon_pos==std::string::npos) throw std::invalid_argument("relay");
+            id = std::stoll(data.substr(0,colon_pos));
+            size = std::stoull(data.substr(colon_pos+1));
+        }catch (const std::exception& e){
+            return false;
+        }
+        if (size==0 || size>Reactor::getInstance().relayLimit() || size>std::numeric_limits<uint32_t>::max()-kMaxFrameLength){
+            return false;
+        }
+        auto relay = Reactor::getInstance().findRelay(id);
+        // 直传ID可以被猜到：只有本连接发起的直传才能开始、取消或以该ID登记
+        bool owned = relay && relay->sender.get()==this;
+        bool valid = false;
+        if (owned){
+            std::lock_guard<std::mutex> lock(relay->mutex);
+            valid = relay->state==RelayState::ACCEPTED && relay->size==size;
+            if (valid) relay->state = RelayState::STREAMING;
+        }
+        std::shared_ptr<ClientConnection> receiver;
+        if (valid){
+            receiver = Reactor::getInstance().findConnection(relay->receiver);
+            valid = receiver && ::pipe2(relay->pipe_fds,O_CLOEXEC|O_NONBLOCK)!=-1;
+        }
+        if (!valid){
+            // 邀请已过期或接收者已断开：读出这些字节后丢弃，保持帧边界，随后通知回退到附件上传
+            if (owned) Reactor::getInstance().removeRelay(id);
+            relay = std::make_shared<Relay>();
+            relay->id = id;
+            relay->state = RelayState::STREAMING;
+            relay->size = size;
+            relay->sender = shared_from_this();
+            relay->receiver_failed = true;
+        }
+        relay->last_progress_ms = steadyMs();
+        // 此前已读入缓冲区的字节同样按顺序属于直传数据
+        size_t head_length = static_cast<size_t>(std::min<uint64_t>(size,buffer_.size()-frame_length));
+        relay->from_sender = size-head_length;
+        if (valid){
+            relay->head = buffer_.substr(frame_length,head_length);
+            std::string prefix = std::to_string(relay->id)+":"+std::to_string(user_id_.load())+":"+std::to_string(size)+":"+relay->name+":";
+            auto frame = std::make_shared<std::vector<char>>(sizeof (MessageHeader)+prefix.size());
+            MessageHeader header;
+            header.length = hostToNetwork32(static_cast<uint32_t>(frame->size()+size));
+            header.type = hostToNetwork32(static_cast<uint32_t>(MessageType::MSG_TYPE_RELAY_DATA));
+            header.user_id = hostToNetwork32(static_cast<uint32_t>(user_id_.load()));
+            std::memcpy(frame->data(),&header,sizeof (MessageHeader));
+            std::memcpy(frame->data()+sizeof (MessageHeader),prefix.data(),prefix.size());
+            if (relay->from_sender>0){
+                std::lock_guard<std::mutex> lock(relay_mutex_);
+                relay_ = relay;
+            }
+            // 接收者还有积压时不直传，已发出的字节读出后丢弃
+            if (!receiver->sendRelayFrame(frame,relay,static_cast<size_t>(size))){
+                std::lock_guard<std::mutex> lock(relay->mutex);
+                relay->head.clear();
+                relay->receiver_failed = true;
+            }else{
+                std::cout<<"Relay "<<relay->id<<" started: "<<user_id_<<" -> "<<receiver->getUserId()<<", "<<size<<" bytes"<<std::endl;
+            }
+        }
+        buffer_.erase(frame_length,head_length);
+        bool discarding;
+        {
+            std::lock_guard<std::mutex> lock(relay->mutex);
+            discarding = relay->receiver_failed;
+        }
+        if (!discarding) return true;
+        if (relay->from_sender==0){
+            {
+                std::lock_guard<std::mutex> lock(relay_mutex_);
+                relay_.reset();
+            }
+            if (owned) Reactor::getInstance().removeRelay(id);
+            Message resp_msg(MessageType::MSG_TYPE_RELAY_RESP,user_id_,"store:"+std::to_string(id));
+            sendMessage(resp_msg);
+            return true;
+        }
+        {
+            std::lock_guard<std::mutex> lock(relay_mutex_);
+            relay_ = relay;
+        }
+        // 不属于本连接的ID只在本连接内丢弃剩余字节，不登记，不影响该ID上真正的直传
+        if (owned) Reactor::getInstance().addRelay(relay);
+        return true;
+    }
+
+    std::shared_ptr<Relay> ClientConnection::currentRelay() {
+        std::lock_guard<std::mutex> lock(relay_mutex_);
+        return relay_;
+    }
+
+    bool ClientConnection::relayRead(const std::shared_ptr<Relay> &relay) {
+        bool sender_failed;
+        bool receiver_failed;
+        uint64_t remaining;
+        auto snapshot = [&]{
+            std::lock_guard<std::mutex> lock(relay->mutex);
+            sender_failed = relay->sender_failed;
+            receiver_failed = relay->receiver_failed;
+            remaining = relay->from_sender;
+        };
+        snapshot();
+        if (!sender_failed && !receiver_failed && remaining>0){
+            // 由接收者的发送过程从本连接读取，接收者发送缓冲区满时数据留在本连接的内核缓冲区
+            if (auto receiver = Reactor::getInstance().findConnection(relay->receiver)){
+                receiver->handleWrite();
+            }else{
+                std::lock_guard<std::mutex> lock(relay->mutex);
+                relay->receiver_failed = true;
+            }
+            snapshot();
+        }
+        if (sender_failed){
+            handleClose();
+            return false;
+        }
+        if (receiver_failed && remaining>0){
+            // 接收者已断开：读出剩余字节丢弃，保持帧边界
+            char buf[16384];
+            while (remaining>0){
+                ssize_t bytes = socket_.recv(buf,static_cast<size_t>(std::min<uint64_t>(sizeof (buf),remaining)));
+                if (bytes>0){
+                    remaining -= static_cast<uint64_t>(bytes);
+                    std::lock_guard<std::mutex> lock(relay->mutex);
+                    relay->last_progress_ms = steadyMs();
+                    continue;
+                }
+                if (bytes==0 || (errno!=EAGAIN && errno!=EWOULDBLOCK)){
+                    handleClose();
+                    return false;
+                }
+                break;
+            }
+            {
+                std::lock_guard<std::mutex> lock(relay->mutex);
+                relay->from_sender = remaining;
+            }
+            if (remaining>0) return false;
+            // 接收者已断开或停止接收：通知发送者改为上传附件
+            Reactor::getInstance().removeRelay(relay->id,relay.get());
+            Message resp_msg(MessageType::MSG_TYPE_RELAY_RESP,user_id_,"store:"+std::to_string(relay->id));
+            sendMessage(resp_msg);
+        }
+        if (remaining>0) return false;
+        std::lock_guard<std::mutex> lock(relay_mutex_);
+        relay_.reset();
+        return true;
+    }
+
+    ssize_t ClientConnection::pumpRelay(Relay &relay, size_t length) {
+        static const char kZeros[4096] = {};
+        std::lock_guard<std::mutex> lock(relay.mutex);
+        size_t sent = 0;
+        while (sent<length){
+            ssize_t bytes;
+            if (relay.head_offset<relay.head.size()){
+                // 开始直传时已在用户态的少量字节
+                size_t chunk = std::min(relay.head.size()-relay.head_offset,length-sent);
+                bytes = socket_.trySend(relay.head.data()+relay.head_offset,chunk);
+                if (bytes==-1) return -1;
+                relay.head_offset += static_cast<size_t>(bytes);
+                sent += static_cast<size_t>(bytes);
+                if (static_cast<size_t>(bytes)<chunk) break;
+            }else if (relay.in_pipe>0){
+                // 管道->接收者，接收者发送缓冲区满时停止，不再从发送者读取
+                bytes = ::splice(relay.pipe_fds[0],nullptr,fd_,nullptr,std::min(relay.in_pipe,length-sent),
+                                 SPLICE_F_MOVE|SPLICE_F_NONBLOCK);
+                if (bytes==-1){
+                    if (errno==EINTR) continue;
+                    if (errno==EAGAIN) break;
+                    return -1;
+                }
+                relay.in_pipe -= static_cast<size_t>(bytes);
+                sent += static_cast<size_t>(bytes);
+            }else if (relay.sender_failed){
+                // 发送者中途断开，以0补齐帧的剩余部分
+                size_t chunk = std::min(sizeof (kZeros),length-sent);
+                bytes = socket_.trySend(kZeros,chunk);
+                if (bytes==-1) return -1;
+                sent += static_cast<size_t>(bytes);
+                if (static_cast<size_t>(bytes)<chunk) break;
+            }else{
+                // 管道已空：发送者->管道，发送者暂无数据时等待其可读事件
+                bytes = ::splice(relay.sender->getFd(),nullptr,relay.pipe_fds[1],nullptr,
+                                 static_cast<size_t>(std::min<uint64_t>(relay.from_sender,kRelayPipeBytes)),
+                                 SPLICE_F_MOVE|SPLICE_F_NONBLOCK);
+                if (bytes==-1 && errno==EINTR) continue;
+                if (bytes==-1 && errno==EAGAIN) break;
+                if (bytes<=0){
+                    relay.sender_failed = true;
+                    Reactor::getInstance().scheduleRead(relay.sender->getHandle());
+                    continue;
+                }
+                relay.from_sender -= static_cast<uint64_t>(bytes);
+                relay.in_pipe += static_cast<size_t>(bytes);
+                // 发送者的数据已读完，恢复解析其后续的帧
+                if (relay.from_sender==0) Reactor::getInstance().scheduleRead(relay.sender->getHandle());
+            }
+        }
+        if (sent>0) relay.last_progress_ms = steadyMs();
+        if (sent==length){
+            Reactor::getInstance().removeRelay(relay.id,&relay);
+            // 直传完成：通知发送者；发送者中途断开时通知接收者数据无效
+            auto self = shared_from_this();
+            auto sender = relay.sender;
+            int64_t id = relay.id;
+            bool aborted = relay.sender_failed;
+            Reactor::getInstance().submitTask([self,sender,id,aborted]{
+                if (aborted){
+                    Message resp_msg(MessageType::MSG_TYPE_ERROR,self->getUserId(),"Relay aborted:"+std::to_string(id));
+                    self->sendMessage(resp_msg);
+                }else{
+                    Message resp_msg(MessageType::MSG_TYPE_RELAY_RESP,sender->getUserId(),"done:"+std::to_string(id));
+                    sender->sendMessage(resp_msg);
+                }
+            });
+            std::cout<<"Relay "<<id<<(aborted ? " aborted" : " completed")<<std::endl;
+        }
+        return static_cast<ssize_t>(sent);
+    }
+
+    void ClientConnection::syncDevice() {
+        // 所有帧写入同一缓冲区，一次发送
+        FrameWriter frames;
+        int64_t from = 0;
+        int64_t cursor = 0;
+        std::vector<std::pair<int64_t,SharedFrame>> retransmit;
+        MessageHandler& handler = MessageHandler::getInstance();
+        if (!handler.syncDevice(user_id_,device_id_,frames,from,cursor,retransmit)) return;
+        if (!retransmit.empty()){
+            // 上一个连接未确认的帧直接从内存重发，未确认前仍计入确认水位
+            for (const auto& [message_id,frame]:retransmit){
+                if (!trackUnacked(message_id,frame,handler.maxUnacked()) || !sendFrame(frame)) return;
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(outbox_mutex_);
+            pushed_id_ = std::max(pushed_id_,cursor);
+            if (!frames.empty()){
+                // 从存储补发的批次：客户端确认批次末尾的确认号之前，确认水位停在同步起点
+                sync_floor_ = from;
+                sync_token_ = IdGenerator::getInstance().nextId();
+                frames.beginFrame(MessageType::MSG_TYPE_ACK,static_cast<uint32_t>(user_id_.load()));
+                frames.appendInt(sync_token_);
+                frames.endFrame();
+            }
+        }
+        sendFrames(frames);
+    }
+
+    bool ClientConnection::trackUnacked(int64_t message_id, const SharedFrame &frame, size_t max_unacked) {
+        std::lock_guard<std::mutex> lock(outbox_mutex_);
+        if (closed_) return false;
+        unacked_[message_id] = frame;
+        pushed_id_ = std::max(pushed_id_,message_id);
+        while (unacked_.size()>max_unacked){
+            evicted_floor_ = std::min(evicted_floor_,unacked_.begin()->first-1);
+            unacked_.erase(unacked_.begin());
+        }
+        return true;
+    }
+
+    int64_t ClientConnection::ackedWatermark() {
+        std::lock_guard<std::mutex> lock(outbox_mutex_);
+        int64_t watermark = std::min({pushed_id_,evicted_floor_,sync_floor_});
+        if (!unacked_.empty()) watermark = std::min(watermark,unacked_.begin()->first-1);
+        return watermark;
+    }
+
+    void ClientConnection::handleAck(const std::string &data) {
+        std::vector<int64_t> message_ids;
+        size_t pos = 0;
+        while (pos<data.size()){
+            size_t end = data.find(',',pos);
+            if (end==std::string::npos) end = data.size();
+            try {
+                message_ids.push_back(std::stoll(data.substr(pos,end-pos)));
+            }catch (const std::exception& e){
+                // 忽略无法解析的项
+            }
+            pos = end+1;
         }
+        {
+            std::lock_guard<std::mutex> lock(outbox_mutex_);
+            for (auto it = message_ids.begin();it!=message_ids.end();){
+                unacked_.erase(*it);
+                if (*it==sync_token_ && sync_token_!=0){
+                    // 同步批次已全部收到
+                    sync_floor_ = std::numeric_limits<int64_t>::max();
+                    sync_token_ = 0;
+                    it = message_ids.erase(it);
+                    continue;
+                }
+                ++it;
+            }
+        }
+        MessageHandler::getInstance().acknowledge(user_id_,message_ids);
+    }
+
+    ssize_t ClientConnection::writeOutbound(const OutboundFrame &item, size_t offset) {
+        size_t sent = 0;
+        size_t frame_size = item.frame->size();
+        if (offset<frame_size){
+            ssize_t bytes = socket_.trySend(item.frame->data()+offset,frame_size-offset);
+            if (bytes==-1) return -1;
+            sent = static_cast<size_t>(bytes);
+            if (offset+sent<frame_size) return static_cast<ssize_t>(sent);
+        }
+        // 帧的内存部分已发完，消息体的剩余部分直接从文件或直传管道发送
+        size_t file_sent = offset+sent-frame_size;
+        if (file_sent<item.file_length){
+            ssize_t bytes = item.relay ? pumpRelay(*item.relay,item.file_length-file_sent) :
+                            socket_.trySendFile(item.file->fd(),static_cast<off_t>(item.file_offset+file_sent),
+                                                item.file_length-file_sent);
+            if (bytes==-1) return -1;
+            sent += static_cast<size_t>(bytes);
+        }
+        return static_cast<ssize_t>(sent);
     }
+
     void ClientConnection::handleWrite() {
-        // 可写事件处理
+        bool failed = false;
+        {
+            std::lock_guard<std::mutex> lock(send_mutex_);
+            while (!send_queue_.empty()){
+                const auto& item = send_queue_.front();
+                ssize_t bytes = writeOutbound(item,send_offset_);
+                if (bytes==-1){
+                    failed = true;
+                    break;
+                }
+                size_t frame_size = item.frame->size();
+                pending_bytes_ -= std::min(send_offset_+static_cast<size_t>(bytes),frame_size)-std::min(send_offset_,frame_size);
+                send_offset_ += static_cast<size_t>(bytes);
+                // 内核缓冲区又满了，等待下一次可写事件
+                if (send_offset_<item.size()) break;
+                send_queue_.pop_front();
+                send_offset_ = 0;
+            }
+            if (!failed && send_queue_.empty() && !closed_){
+                Reactor::getInstance().updateWriteInterest(getHandle(),false);
+            }
+        }
+        if (failed){
+            std::cerr<<"Failed to send to client "<<fd_<<": "<<strerror(errno)<<std::endl;
+            handleClose();
+        }
     }
     void ClientConnection::handleError() {
         std::cerr<<"Error on client "<<fd_<<std::endl;
         handleClose();
     }
     void ClientConnection::handleClose() {
-        // 如果用户已认证，更新状态为离线
+        if (closed_.exchange(true)) return;
+        // 作为发送者：接收者的剩余部分以0填充；作为接收者：发送者读出剩余字节后丢弃
+        std::shared_ptr<Relay> outgoing;
+        {
+            std::lock_guard<std::mutex> lock(relay_mutex_);
+            outgoing.swap(relay_);
+        }
+        if (outgoing){
+            {
+                std::lock_guard<std::mutex> lock(outgoing->mutex);
+                outgoing->sender_failed = true;
+            }
+            if (auto receiver = Reactor::getInstance().findConnection(outgoing->receiver)){
+                Reactor::getInstance().submitTask([receiver]{receiver->handleWrite();});
+            }
+        }
+        std::vector<std::shared_ptr<Relay>> incoming;
+        {
+            std::lock_guard<std::mutex> lock(send_mutex_);
+            for (const auto& item:send_queue_){
+                if (item.relay) incoming.push_back(item.relay);
+            }
+        }
+        for (const auto& relay:incoming){
+            {
+                std::lock_guard<std::mutex> lock(relay->mutex);
+                relay->receiver_failed = true;
+            }
+            Reactor::getInstance().scheduleRead(relay->sender->getHandle());
+        }
+        // 如果用户已认证，更新状态为离线，保存确认水位为设备游标，未确认的帧留待重连时重发
         if (user_id_!=-1){
-            UserManager::getInstance().userOffline(user_id_);
+            UserManager::getInstance().userOffline(user_id_,getHandle());
+            int64_t watermark = ackedWatermark();
+            if (watermark>0){
+                MessageHandler::getInstance().saveDeviceCursor(user_id_,device_id_,watermark);
+            }
+            std::vector<std::pair<int64_t,SharedFrame>> frames;
+            int64_t pushed_id;
+            bool complete;
+            {
+                std::lock_guard<std::mutex> lock(outbox_mutex_);
+                // 有帧被丢弃或同步批次未确认时，内存中的帧不完整，重连时由存储补发
+                complete = evicted_floor_==std::numeric_limits<int64_t>::max() &&
+                           sync_floor_==std::numeric_limits<int64_t>::max();
+                pushed_id = pushed_id_;
+                if (complete) frames.assign(unacked_.begin(),unacked_.end());
+                unacked_.clear();
+            }
+            if (complete && !frames.empty() && watermark>0){
+                MessageHandler::getInstance().parkOutbox(user_id_,device_id_,watermark,pushed_id,std::move(frames));
+            }
         }
-        // 关闭Socket
-        socket_.close();
+        // 从Epoll和连接表中移除；Socket在最后一个引用释放时关闭
+        Reactor::getInstance().removeClientConnection(getHandle());
     }
 
-    void ClientConnection::sendMessage(const easychat::Message &msg) {
-        // 序列化消息
-        auto buffer = msg.serialize();
-        // 发送消息
-        socket_.send(buffer.data(),buffer.size());
+    bool ClientConnection::sendMessage(const easychat::Message &msg) {
+        return sendFrame(makeSharedFrame(msg));
+    }
+
+    bool ClientConnection::sendFrames(const FrameWriter &writer) {
+        if (writer.empty()) return true;
+        return sendFrame(std::make_shared<const std::vector<char>>(writer.buffer()));
+    }
+
+    bool ClientConnection::sendFrame(const SharedFrame &frame) {
+        OutboundFrame item;
+        item.frame = frame;
+        return enqueue(std::move(item));
+    }
+
+    bool ClientConnection::sendFileFrame(const SharedFrame &frame, std::shared_ptr<const BlobFile> file,
+                                         uint64_t offset, size_t length) {
+        OutboundFrame item;
+        item.frame = frame;
+        item.file = std::move(file);
+        item.file_offset = offset;
+        item.file_length = length;
+        return enqueue(std::move(item));
+    }
+
+    bool ClientConnection::sendRelayFrame(const SharedFrame &frame, std::shared_ptr<Relay> relay, size_t length) {
+        {
+            // 接收者还有积压时不直传（慢速接收者回退到存储转发）
+            std::lock_guard<std::mutex> lock(send_mutex_);
+            if (closed_ || !send_queue_.empty()) return false;
+        }
+        OutboundFrame item;
+        item.frame = frame;
+        item.relay = std::move(relay);
+        item.file_length = length;
+        return enqueue(std::move(item));
+    }
+
+    bool ClientConnection::enqueue(OutboundFrame item) {
+        bool overflow = false;
+        {
+            std::lock_guard<std::mutex> lock(send_mutex_);
+            if (closed_) return false;
+            size_t offset = 0;
+            // 队列为空时直接发送，避免一次额外的可写事件
+            if (send_queue_.empty()){
+                ssize_t bytes = writeOutbound(item,0);
+                if (bytes==-1) return false;
+                offset = static_cast<size_t>(bytes);
+                if (offset==item.size()) return true;
+            }
+            // 剩余部分排队（帧数据共享，不拷贝）
+            if (send_queue_.empty()){
+                send_offset_ = offset;
+                Reactor::getInstance().updateWriteInterest(getHandle(),true);
+            }
+            pending_bytes_ += item.frame->size()-std::min(offset,item.frame->size());
+            send_queue_.push_back(std::move(item));
+            overflow = pending_bytes_>kMaxPendingBytes;
+        }
+        if (overflow){
+            std::cerr<<"Client "<<fd_<<" is too slow, pending bytes exceed "<<kMaxPendingBytes<<", closing"<<std::endl;
+            handleClose();
+            return false;
+        }
+        return true;
     }
 
     Reactor::Reactor()
-    :server_fd_(-1),server_port_(0),running_(false),
+    :server_fd_(-1),server_port_(0),running_(false),auth_queue_size_(256),relay_max_bytes_(100*1024*1024),
+    relay_accept_timeout_ms_(30000),relay_idle_timeout_ms_(10000),last_relay_check_ms_(0),
     user_manager_(UserManager::getInstance()),
     message_handler_(MessageHandler::getInstance()){}
 
@@ -205,7 +1098,8 @@ namespace easychat{
         return instance;
     }
 
-    bool Reactor::init(const std::string &ip, uint16_t port, int thread_count) {
+    bool Reactor::init(const std::string &ip, uint16_t port, int thread_count,
+                       int auth_thread_count, size_t auth_queue_size) {
         server_ip = ip;
         server_port_ = port;
         // 创建服务器Socket
@@ -224,6 +1118,9 @@ namespace easychat{
         epoll_->setReadCallback(server_socket_->getFd(),[this]{this->handleNewConnection();});
         // 创建线程池
         thread_pool_ = std::make_unique<ThreadPool>(thread_count);
+        // 创建认证线程池
+        auth_pool_ = std::make_unique<ThreadPool>(auth_thread_count);
+        auth_queue_size_ = auth_queue_size;
         server_fd_ = server_socket_->getFd();
         running_ = true;
 
@@ -245,6 +1142,12 @@ namespace easychat{
             }
             // 处理事件
             epoll_->handleEvents(num_events);
+            // 每秒在工作线程中检查一次直传超时
+            int64_t now_ms = steadyMs();
+            if (now_ms-last_relay_check_ms_>=1000){
+                last_relay_check_ms_ = now_ms;
+                submitTask([this]{checkRelays();});
+            }
         }
         std::cout<<"Reactor stopped"<<std::endl;
     }
@@ -252,10 +1155,11 @@ namespace easychat{
     void Reactor::stop() {
         running_ = false;
         // 关闭所有客户端连接
-        for (auto& [fd,conn]:clients_){
+        std::vector<std::shared_ptr<ClientConnection>> conns;
+        connections_.snapshot(conns);
+        for (auto& conn:conns){
             conn->handleClose();
         }
-        clients_.clear();
         // 关闭服务器Socket
         if (server_socket_){
             server_socket_->close();
@@ -288,7 +1192,7 @@ namespace easychat{
             client_socket->releaseOwnership(); // 释放文件描述符所有权
             
             // 创建客户端连接
-            auto conn = std::make_unique<ClientConnection>(
+            auto conn = std::make_shared<ClientConnection>(
                     client_fd,client_ip,client_port
                     );
             
@@ -299,43 +1203,149 @@ namespace easychat{
         }
     }
 
-    void Reactor::registerClientConnection(std::unique_ptr<ClientConnection> conn) {
+    void Reactor::registerClientConnection(std::shared_ptr<ClientConnection> conn) {
         int client_fd = conn->getFd();
+        ConnectionHandle handle = conn->getHandle();
+        // 先加入连接表，再注册到Epoll，回调触发时一定能找到连接
+        if (!connections_.insert(handle,conn)){
+            std::cerr<<"Failed to register client connection: FD="<<client_fd<<std::endl;
+            return;
+        }
+        // 回调只捕获句柄，通过连接表查找连接
+        epoll_->setReadCallback(client_fd,[this,handle]{
+            thread_pool_->submit([this,handle]{this->handleClientMessage(handle);});
+        });
+        // 可写事件在Reactor线程中直接发送（非阻塞）
+        epoll_->setWriteCallback(client_fd,[this,handle]{
+            if (auto conn = findConnection(handle)) conn->handleWrite();
+        });
+        epoll_->setErrorCallback(client_fd,[this,handle]{
+            if (auto conn = findConnection(handle)) conn->handleError();
+        });
+        epoll_->setCloseCallback(client_fd,[this,handle]{
+            if (auto conn = findConnection(handle)) conn->handleClose();
+        });
         // 添加到Epoll
         epoll_->addFd(client_fd,EPOLLIN | EPOLLET | EPOLLERR | EPOLLHUP);
-        // 设置回调函数
-        epoll_->setReadCallback(client_fd,
-    [this,client_fd]{thread_pool_->submit([this,client_fd]{this->handleClientMessage(client_fd);});
-        });
-        epoll_->setErrorCallback(client_fd,[conn=conn.get()]{conn->handleError();});
-        epoll_->setCloseCallback(client_fd,[conn=conn.get()]{conn->handleClose();});
-        // 添加到客户端映射
-        {
-            std::lock_guard<std::mutex> lock(client_mutex_);
-            clients_[client_fd] = std::move(conn);
-        }
 
         std::cout<<"Client connection registered: FD="<<client_fd<<std::endl;
     }
 
-    void Reactor::removeClientConnection(int client_fd) {
+    void Reactor::removeClientConnection(const ConnectionHandle &handle) {
+        // 代数不一致说明描述符已属于新连接，不能移除
+        if (!connections_.remove(handle)) return;
         // 从Epoll中移除
-        epoll_->removeFd(client_fd);
-        // 从客户端映射中移除
-        {
-            std::lock_guard<std::mutex> lock(client_mutex_);
-            clients_.erase(client_fd);
-        }
-        std::cout<<"Client connection removed: FD="<<client_fd<<std::endl;
+        epoll_->removeFd(handle.fd);
+        std::cout<<"Client connection removed: FD="<<handle.fd<<std::endl;
+    }
+
+    void Reactor::updateWriteInterest(const ConnectionHandle &handle, bool enable) {
+        uint32_t events = EPOLLIN | EPOLLET | EPOLLERR | EPOLLHUP;
+        if (enable) events |= EPOLLOUT;
+        epoll_->modifyFd(handle.fd,events);
+    }
+
+    void Reactor::scheduleRead(const ConnectionHandle &handle) {
+        thread_pool_->submit([this,handle]{this->handleClientMessage(handle);});
+    }
+
+    void Reactor::submitTask(std::function<void()> task) {
+        thread_pool_->submit(std::move(task));
+    }
+
+    bool Reactor::submitAuthTask(std::function<void()> task) {
+        return auth_pool_->trySubmit(std::move(task),auth_queue_size_);
+    }
+
+    void Reactor::setRelayTimeouts(int accept_seconds, int idle_seconds) {
+        relay_accept_timeout_ms_ = static_cast<int64_t>(std::max(accept_seconds,1))*1000;
+        relay_idle_timeout_ms_ = static_cast<int64_t>(std::max(idle_seconds,1))*1000;
+    }
+
+    void Reactor::addRelay(const std::shared_ptr<Relay> &relay) {
+        std::lock_guard<std::mutex> lock(relays_mutex_);
+        relays_[relay->id] = relay;
+    }
+
+    std::shared_ptr<Relay> Reactor::findRelay(int64_t id) {
+        std::lock_guard<std::mutex> lock(relays_mutex_);
+        auto it = relays_.find(id);
+        return it!=relays_.end() ? it->second : nullptr;
     }
 
-    void Reactor::handleClientMessage(int client_fd) {
+    void Reactor::removeRelay(int64_t id, const Relay *relay) {
+        std::lock_guard<std::mutex> lock(relays_mutex_);
+        auto it = relays_.find(id);
+        if (it==relays_.end() || (relay!=nullptr && it->second.get()!=relay)) return;
+        relays_.erase(it);
+    }
+
+    void Reactor::checkRelays() {
+        std::vector<std::shared_ptr<Relay>> relays;
         {
-            std::lock_guard<std::mutex> lock(client_mutex_);
-            auto it = clients_.find(client_fd);
-            if (it!=clients_.end()){
-                it->second->handleRead();
+            std::lock_guard<std::mutex> lock(relays_mutex_);
+            relays.reserve(relays_.size());
+            for (const auto& [id,relay]:relays_) relays.push_back(relay);
+        }
+        int64_t now_ms = steadyMs();
+        for (const auto& relay:relays){
+            RelayState state;
+            bool idle;
+            bool sender_failed;
+            bool receiver_failed;
+            bool receiver_pending; // 有数据（或补齐的0）等待写给接收者
+            {
+                std::lock_guard<std::mutex> lock(relay->mutex);
+                state = relay->state;
+                idle = now_ms-relay->last_progress_ms>(state==RelayState::STREAMING ? relay_idle_timeout_ms_ : relay_accept_timeout_ms_);
+                sender_failed = relay->sender_failed;
+                receiver_failed = relay->receiver_failed;
+                receiver_pending = relay->in_pipe>0 || relay->head_offset<relay->head.size() || relay->sender_failed;
+                if (idle) relay->last_progress_ms = now_ms;
+            }
+            auto receiver = findConnection(relay->receiver);
+            if (state!=RelayState::STREAMING){
+                // 邀请未被接受（或接受后发送者未开始）：回退到附件上传
+                if (!idle && (receiver || state!=RelayState::OFFERED)) continue;
+                removeRelay(relay->id,relay.get());
+                Message store_msg(MessageType::MSG_TYPE_RELAY_RESP,relay->sender->getUserId(),"store:"+std::to_string(relay->id));
+                relay->sender->sendMessage(store_msg);
+                if (receiver){
+                    Message abort_msg(MessageType::MSG_TYPE_ERROR,receiver->getUserId(),"Relay aborted:"+std::to_string(relay->id));
+                    receiver->sendMessage(abort_msg);
+                }
+                std::cout<<"Relay "<<relay->id<<" offer expired"<<std::endl;
+                continue;
+            }
+            if (sender_failed && receiver_failed){
+                removeRelay(relay->id,relay.get());
+                continue;
             }
+            if (!idle) continue;
+            if (!receiver_failed && receiver_pending){
+                // 接收者停止接收：断开接收者（帧已发出一部分，无法再保持帧边界），
+                // 发送者的剩余字节读出后丢弃，随后改为上传附件
+                std::cerr<<"Relay "<<relay->id<<" receiver stalled, closing receiver"<<std::endl;
+                if (receiver){
+                    receiver->handleClose();
+                }else{
+                    std::lock_guard<std::mutex> lock(relay->mutex);
+                    relay->receiver_failed = true;
+                }
+                scheduleRead(relay->sender->getHandle());
+            }else{
+                // 发送者停止发送：断开发送者，接收者的剩余部分以0补齐后收到中止通知
+                std::cerr<<"Relay "<<relay->id<<" sender stalled, closing sender"<<std::endl;
+                if (receiver_failed) removeRelay(relay->id,relay.get());
+                relay->sender->handleClose();
+            }
+        }
+    }
+
+    void Reactor::handleClientMessage(const ConnectionHandle &handle) {
+        // 只锁定该连接，不同连接的消息并行处理
+        if (auto conn = connections_.find(handle)){
+            conn->handleRead();
         }
     }
 }
@@ -3,6 +3,7 @@
 //
 #include "../../include/network/socket.h"
 #include <sys/socket.h>
+#include <sys/sendfile.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
@@ -147,6 +148,37 @@ namespace easychat{
         }
         return total_sent;
     }
+    ssize_t Socket::trySend(const char *data, size_t length) {
+        if (fd_==-1) return -1;
+        size_t total_sent = 0;
+        while (total_sent < length) {
+            // 对端已关闭时不产生SIGPIPE
+            ssize_t bytes = ::send(fd_, data + total_sent, length - total_sent, MSG_NOSIGNAL);
+            if (bytes == -1) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+                if (errno == EINTR) continue;
+                return -1;
+            }
+            total_sent += bytes;
+        }
+        return static_cast<ssize_t>(total_sent);
+    }
+    ssize_t Socket::trySendFile(int file_fd, off_t offset, size_t length) {
+        if (fd_==-1) return -1;
+        size_t total_sent = 0;
+        while (total_sent < length) {
+            ssize_t bytes = ::sendfile(fd_, file_fd, &offset, length - total_sent);
+            if (bytes == -1) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+                if (errno == EINTR) continue;
+                return -1;
+            }
+            // 文件被截断
+            if (bytes == 0) return -1;
+            total_sent += bytes;
+        }
+        return static_cast<ssize_t>(total_sent);
+    }
     bool Socket::setNonBlocking() {
         if (fd_==-1) return false;
         // 获取文件描述符
@@ -0,0 +1,122 @@
+//
+// Created by Cando on 2026/10/19.
+//
+// 在线用户注册表微基准：多个读线程并发查找（模拟转发消息），一个写线程不断上线/下线
+// 对比 OnlineRegistry 与原先的 unordered_map + mutex 实现
+// 用法：bench_online_registry [读线程数=32] [运行毫秒=2000] [用户数=100000]
+#include "business/online_registry.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace easychat;
+
+namespace {
+    // 原实现：单个互斥锁保护的哈希表
+    class MutexRegistry{
+    public:
+        bool lookup(int user_id,ConnectionHandle& handle){
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = users_.find(user_id);
+            if (it==users_.end()) return false;
+            handle = it->second;
+            return true;
+        }
+        bool add(int user_id,const ConnectionHandle& handle){
+            std::lock_guard<std::mutex> lock(mutex_);
+            users_[user_id] = handle;
+            return true;
+        }
+        bool remove(int user_id,const ConnectionHandle&){
+            std::lock_guard<std::mutex> lock(mutex_);
+            return users_.erase(user_id)>0;
+        }
+    private:
+        std::mutex mutex_;
+        std::unordered_map<int,ConnectionHandle> users_;
+    };
+
+    uint32_t nextRandom(uint32_t& state){
+        state ^= state<<13;
+        state ^= state>>17;
+        state ^= state<<5;
+        return state;
+    }
+
+    template<typename Registry>
+    void run(const char* name,Registry& registry,int readers,int duration_ms,int users){
+        for (int i=1;i<=users;++i){
+            registry.add(i,ConnectionHandle{i%60000+3,static_cast<uint32_t>(i)});
+        }
+        std::atomic<bool> running{true};
+        std::atomic<uint64_t> total_lookups{0};
+        std::atomic<uint64_t> total_hits{0};
+        uint64_t writes = 0;
+
+        std::vector<std::thread> threads;
+        for (int t=0;t<readers;++t){
+            threads.emplace_back([&,t](){
+                uint32_t state = 2463534242u+t;
+                uint64_t lookups = 0,hits = 0;
+                ConnectionHandle handle;
+                while (running.load(std::memory_order_relaxed)){
+                    // 每批查找后再检查一次停止标志，减少对共享变量的访问
+                    for (int i=0;i<256;++i){
+                        int user_id = static_cast<int>(nextRandom(state)%users)+1;
+                        if (registry.lookup(user_id,handle)) ++hits;
+                    }
+                    lookups += 256;
+                }
+                total_lookups += lookups;
+                total_hits += hits;
+            });
+        }
+        // 写线程：随机用户下线后重新上线（新代数）
+        std::thread writer([&](){
+            uint32_t state = 88172645u;
+            uint32_t generation = static_cast<uint32_t>(users)+1;
+            while (running.load(std::memory_order_relaxed)){
+                int user_id = static_cast<int>(nextRandom(state)%users)+1;
+                registry.remove(user_id,ConnectionHandle{});
+                registry.add(user_id,ConnectionHandle{user_id%60000+3,generation++});
+                writes += 2;
+            }
+        });
+
+        auto start = std::chrono::steady_clock::now();
+        std::this_thread::sleep_for(std::chrono::milliseconds(duration_ms));
+        running = false;
+        for (auto& thread:threads) thread.join();
+        writer.join();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+
+        std::cout<<name<<": readers="<<readers
+                 <<", lookups/s="<<static_cast<uint64_t>(total_lookups/seconds)
+                 <<", hit rate="<<(total_lookups ? 100.0*total_hits/total_lookups : 0)<<"%"
+                 <<", writes/s="<<static_cast<uint64_t>(writes/seconds)<<std::endl;
+    }
+}
+
+int main(int argc,char* argv[]){
+    int readers = argc>1 ? std::atoi(argv[1]) : 32;
+    int duration_ms = argc>2 ? std::atoi(argv[2]) : 2000;
+    int users = argc>3 ? std::atoi(argv[3]) : 100000;
+    if (readers<=0 || duration_ms<=0 || users<=0){
+        std::cerr<<"Usage: "<<argv[0]<<" [readers] [duration_ms] [users]"<<std::endl;
+        return 1;
+    }
+    {
+        MutexRegistry registry;
+        run("mutex+unordered_map",registry,readers,duration_ms,users);
+    }
+    {
+        OnlineRegistry registry;
+        run("OnlineRegistry",registry,readers,duration_ms,users);
+    }
+    return 0;
+}
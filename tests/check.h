@@ -0,0 +1,31 @@
+//
+// Created by Cando on 2026/10/19.
+//
+// 单元检查的公共部分：与Python测试脚本相同的输出格式，失败时进程返回非0（供ctest判定）
+#ifndef EASYCHATSERVER_CHECK_H
+#define EASYCHATSERVER_CHECK_H
+
+#include <iostream>
+#include <string>
+
+namespace easychat{
+    namespace check{
+        inline bool& allPassed(){
+            static bool passed = true;
+            return passed;
+        }
+        // 输出一项检查的结果并记录失败
+        inline bool expect(const std::string& name,bool ok){
+            std::cout<<"["<<(ok ? "通过" : "失败")<<"] "<<name<<std::endl;
+            if (!ok) allPassed() = false;
+            return ok;
+        }
+        // main的返回值
+        inline int finish(){
+            std::cout<<(allPassed() ? "检查完成" : "检查失败")<<std::endl;
+            return allPassed() ? 0 : 1;
+        }
+    }
+}
+
+#endif //EASYCHATSERVER_CHECK_H
@@ -0,0 +1,160 @@
+//
+// Created by Cando on 2026/10/19.
+//
+// 全服公告检查：在进程内启动服务器（日志存储、随机端口），多个客户端登录后，
+// 管理员的公告按分片分轮推送给所有在线设备（每轮2个连接，多轮重新排队），非管理员被拒绝
+#include "business/broadcaster.h"
+#include "business/conversation_index.h"
+#include "business/inbox_index.h"
+#include "business/message_handler.h"
+#include "business/room_manager.h"
+#include "business/session_manager.h"
+#include "business/user_manager.h"
+#include "database/log_message_store.h"
+#include "network/rate_limiter.h"
+#include "network/reactor.h"
+#include "check.h"
+#include <arpa/inet.h>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace easychat;
+
+namespace {
+    // 阻塞模式的测试客户端（接收超时3秒）
+    class Client{
+    public:
+        explicit Client(uint16_t port) : fd_(::socket(AF_INET,SOCK_STREAM,0)){
+            timeval timeout{3,0};
+            setsockopt(fd_,SOL_SOCKET,SO_RCVTIMEO,&timeout,sizeof (timeout));
+            sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(port);
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            connected_ = ::connect(fd_,reinterpret_cast<sockaddr*>(&addr),sizeof (addr))==0;
+        }
+        ~Client(){
+            ::close(fd_);
+        }
+        bool send(MessageType type,int user_id,const std::string& data){
+            std::vector<char> bytes = Message(type,user_id,data).serialize();
+            return connected_ && ::send(fd_,bytes.data(),bytes.size(),MSG_NOSIGNAL)==static_cast<ssize_t>(bytes.size());
+        }
+        // 接收指定类型的消息（其他消息暂存，供之后按类型取出），超时返回false
+        bool receive(MessageType type,Message& msg){
+            for (auto it=pending_.begin();it!=pending_.end();++it){
+                if (it->getType()!=type) continue;
+                msg = *it;
+                pending_.erase(it);
+                return true;
+            }
+            while (receiveOne(msg)){
+                if (msg.getType()==type) return true;
+                pending_.push_back(msg);
+            }
+            return false;
+        }
+        // 注册（已存在时忽略）并登录，返回用户ID
+        int login(const std::string& username){
+            Message msg;
+            send(MessageType::MSG_TYPE_REGISTER,0,username+":123456");
+            receiveOne(msg);
+            send(MessageType::MSG_TYPE_LOGIN,0,username+":123456");
+            if (!receive(MessageType::MSG_TYPE_LOGIN_RESP,msg)) return -1;
+            return static_cast<int>(msg.getUserId());
+        }
+    private:
+        bool receiveExact(char* data,size_t size){
+            size_t received = 0;
+            while (received<size){
+                ssize_t n = ::recv(fd_,data+received,size-received,0);
+                if (n<=0) return false;
+                received += static_cast<size_t>(n);
+            }
+            return true;
+        }
+        bool receiveOne(Message& msg){
+            char header[sizeof (MessageHeader)];
+            if (!receiveExact(header,sizeof (header))) return false;
+            uint32_t length = ntohl(reinterpret_cast<MessageHeader*>(header)->length);
+            if (length<sizeof (header)) return false;
+            std::vector<char> frame(header,header+sizeof (header));
+            frame.resize(length);
+            if (!receiveExact(frame.data()+sizeof (header),length-sizeof (header))) return false;
+            msg = Message::deserialize(frame.data(),frame.size());
+            return true;
+        }
+        int fd_;
+        bool connected_;
+        std::vector<Message> pending_;
+    };
+
+    template<typename Predicate> bool waitFor(Predicate predicate,int timeout_ms){
+        auto deadline = std::chrono::steady_clock::now()+std::chrono::milliseconds(timeout_ms);
+        while (!predicate()){
+            if (std::chrono::steady_clock::now()>=deadline) return false;
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return true;
+    }
+}
+
+int main(){
+    std::string dir = "/tmp/easychat_check_broadcast_"+std::to_string(getpid());
+    uint16_t port = static_cast<uint16_t>(20000+getpid()%20000);
+    auto store = std::make_shared<LogMessageStore>();
+    bool started = store->init(dir,1024*1024,0,10) && SessionManager::getInstance().init("check",3600) &&
+                   RoomManager::getInstance().init(store);
+    UserManager::getInstance().init(store);
+    UserManager::getInstance().setPasswordIterations(1000);
+    ConversationIndex::getInstance().init(64,1000,1024*1024);
+    InboxIndex::getInstance().init(1000);
+    MessageHandler::getInstance().init(store);
+    RateLimiter::getInstance().configure(RateClass::AUTH,0,0,0);
+    Broadcaster::getInstance().init(2,"");
+    started = started && Reactor::getInstance().init("127.0.0.1",port,4,2,256);
+    check::expect("启动服务器",started);
+    if (!started) return check::finish();
+    std::thread loop([]{Reactor::getInstance().start();});
+
+    constexpr int kClients = 7;
+    std::vector<std::unique_ptr<Client>> clients;
+    std::vector<int> user_ids;
+    bool logged_in = true;
+    for (int i=0;i<kClients;++i){
+        clients.push_back(std::make_unique<Client>(port));
+        user_ids.push_back(clients.back()->login("bcast"+std::to_string(i)));
+        logged_in &= user_ids.back()>0;
+    }
+    check::expect("客户端登录",logged_in);
+
+    // 只有配置中的管理员可以发起公告
+    Message msg;
+    clients[1]->send(MessageType::MSG_TYPE_BROADCAST,user_ids[1],"not allowed");
+    check::expect("非管理员被拒绝",clients[1]->receive(MessageType::MSG_TYPE_ERROR,msg) && msg.getData()=="Permission denied");
+    Broadcaster::getInstance().init(2," "+std::to_string(user_ids[0])+",abc");
+    check::expect("按用户ID配置管理员（忽略无效项）",Broadcaster::getInstance().isAdmin(user_ids[0]) &&
+                                                  !Broadcaster::getInstance().isAdmin(user_ids[1]));
+
+    clients[0]->send(MessageType::MSG_TYPE_BROADCAST,user_ids[0],"maintenance at 2am");
+    check::expect("公告已受理",clients[0]->receive(MessageType::MSG_TYPE_BROADCAST_RESP,msg) &&
+                              msg.getData()=="queued:"+std::to_string(kClients));
+    bool all_received = true;
+    for (auto& client:clients){
+        all_received &= client->receive(MessageType::MSG_TYPE_BROADCAST,msg) && msg.getUserId()==0 &&
+                        msg.getData()=="maintenance at 2am";
+    }
+    check::expect("所有在线设备收到公告（系统消息user_id为0）",all_received);
+    check::expect("推送任务全部结束",waitFor([]{return Broadcaster::getInstance().activeTasks()==0;},2000));
+
+    clients.clear();
+    Reactor::getInstance().stop();
+    loop.join();
+    store->close();
+    std::filesystem::remove_all(dir);
+    return check::finish();
+}
@@ -0,0 +1,43 @@
+//
+// Created by Cando on 2026/10/19.
+//
+// 熔断器检查：连续失败达到阈值后断开，冷却后只放行一个探测请求，只有探测请求的成功能恢复
+#include "database/circuit_breaker.h"
+#include "check.h"
+#include <chrono>
+#include <thread>
+
+using namespace easychat;
+
+int main(){
+    CircuitBreaker breaker;
+    breaker.configure(3,100);
+    bool probe = true;
+    check::expect("初始为闭合状态",breaker.getState()==CircuitBreaker::State::CLOSED && breaker.allowRequest(probe) && !probe);
+
+    breaker.recordFailure();
+    breaker.recordFailure();
+    check::expect("未达到阈值时保持闭合",breaker.getState()==CircuitBreaker::State::CLOSED);
+    breaker.recordSuccess(false);
+    breaker.recordFailure();
+    breaker.recordFailure();
+    check::expect("成功后重新计数",breaker.getState()==CircuitBreaker::State::CLOSED);
+    breaker.recordFailure();
+    check::expect("连续失败达到阈值后断开",breaker.getState()==CircuitBreaker::State::OPEN && !breaker.allowRequest(probe));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    check::expect("冷却后放行一个探测请求",breaker.allowRequest(probe) && probe &&
+                                         breaker.getState()==CircuitBreaker::State::HALF_OPEN);
+    bool second_probe = true;
+    check::expect("探测期间其他请求快速失败",!breaker.allowRequest(second_probe) && !second_probe);
+    breaker.recordSuccess(false);
+    check::expect("断开前取出的连接迟到的成功不能恢复",breaker.getState()==CircuitBreaker::State::HALF_OPEN);
+    breaker.recordFailure();
+    check::expect("探测失败后继续断开",breaker.getState()==CircuitBreaker::State::OPEN && !breaker.allowRequest(probe));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    check::expect("下一个冷却周期再次探测",breaker.allowRequest(probe) && probe);
+    breaker.recordSuccess(true);
+    check::expect("探测成功后恢复",breaker.getState()==CircuitBreaker::State::CLOSED && breaker.allowRequest(probe) && !probe);
+    return check::finish();
+}
@@ -0,0 +1,64 @@
+//
+// Created by Cando on 2026/10/19.
+//
+// 连接表检查：按句柄查找、描述符被新连接复用后旧句柄失效、旧句柄不能移除新连接，
+// 以及句柄的打包与解包
+#include "network/connection_table.h"
+#include "network/reactor.h"
+#include "check.h"
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace easychat;
+
+namespace {
+    // 用socketpair的一端构造连接（连接析构时关闭该端）
+    std::shared_ptr<ClientConnection> makeConnection(int& peer_fd){
+        int fds[2];
+        if (socketpair(AF_UNIX,SOCK_STREAM,0,fds)!=0) return nullptr;
+        peer_fd = fds[1];
+        return std::make_shared<ClientConnection>(fds[0],"127.0.0.1",0);
+    }
+}
+
+int main(){
+    ConnectionHandle packed{42,7};
+    check::expect("句柄打包与解包",ConnectionHandle::unpack(packed.pack())==packed && ConnectionHandle{}.pack()==0 &&
+                                  !ConnectionHandle::unpack(0).valid());
+
+    ConnectionTable table;
+    int peer_fd = -1;
+    auto first = makeConnection(peer_fd);
+    ConnectionHandle first_handle = first->getHandle();
+    check::expect("插入连接",table.insert(first_handle,first) && table.size()==1);
+    check::expect("按句柄查找",table.find(first_handle)==first);
+    check::expect("槽位已占用时插入失败",!table.insert(first_handle,first));
+    ConnectionHandle stale{first_handle.fd,first_handle.generation+100};
+    check::expect("代数不一致时查找失败",table.find(stale)==nullptr && !table.remove(stale) && table.size()==1);
+
+    // 关闭连接后内核把同一描述符分配给新连接，新连接的代数不同
+    int fd = first_handle.fd;
+    check::expect("移除连接",table.remove(first_handle) && table.size()==0 && table.find(first_handle)==nullptr);
+    first.reset();
+    ::close(peer_fd);
+    auto second = makeConnection(peer_fd);
+    ConnectionHandle second_handle = second->getHandle();
+    check::expect("描述符被复用",second_handle.fd==fd && second_handle.generation!=first_handle.generation);
+    table.insert(second_handle,second);
+    check::expect("旧句柄查不到新连接",table.find(first_handle)==nullptr && table.find(second_handle)==second);
+    check::expect("旧句柄不能移除新连接",!table.remove(first_handle) && table.size()==1);
+
+    // 第一块之外的槽位按需分配
+    ConnectionHandle far{5000,second_handle.generation};
+    check::expect("按需分配更多的块",table.insert(far,second) && table.find(far)==second && table.size()==2);
+    check::expect("超出范围的描述符",!table.insert(ConnectionHandle{1<<21,1},second));
+    std::vector<std::shared_ptr<ClientConnection>> conns;
+    table.snapshot(conns);
+    check::expect("快照包含所有连接",conns.size()==2);
+    conns.clear();
+    table.remove(far);
+    table.remove(second_handle);
+    second.reset();
+    ::close(peer_fd);
+    return check::finish();
+}
@@ -0,0 +1,115 @@
+//
+// Created by Cando on 2026/10/19.
+//
+// 会话索引检查：会话键、近期消息环（条数上限、按序号增量同步与回源判断、最近聊天记录分页）、
+// 过期删除后丢弃近期消息，以及按会话数与字节数淘汰时跳过仍在使用中的会话
+#include "business/conversation_index.h"
+#include "check.h"
+#include <arpa/inet.h>
+
+using namespace easychat;
+
+namespace {
+    // 拆分FrameWriter写出的帧
+    std::vector<Message> splitFrames(const FrameWriter& writer){
+        std::vector<Message> messages;
+        const std::vector<char>& buffer = writer.buffer();
+        size_t offset = 0;
+        while (offset+sizeof (MessageHeader)<=buffer.size()){
+            uint32_t length = ntohl(reinterpret_cast<const MessageHeader*>(buffer.data()+offset)->length);
+            messages.push_back(Message::deserialize(buffer.data()+offset,length));
+            offset += length;
+        }
+        return messages;
+    }
+
+    // 模拟写入一条消息：分配序号并追加到近期消息
+    void append(ConversationIndex& index,Conversation& conversation,int64_t message_id,int sender_id,const std::string& content){
+        MessageInfo message{};
+        message.id = message_id;
+        message.sender_id = sender_id;
+        message.content = content;
+        message.seq = ++conversation.last_seq;
+        index.remember(conversation,message);
+    }
+}
+
+int main(){
+    ConversationIndex& index = ConversationIndex::getInstance();
+    index.init(4,16,16*1024);
+
+    check::expect("单聊会话键与方向无关",ConversationIndex::directKey(3,7)==ConversationIndex::directKey(7,3));
+    check::expect("群聊会话键与单聊会话键不冲突",ConversationIndex::roomKey(7)!=ConversationIndex::directKey(0,7) &&
+                                              ConversationIndex::roomKey(7)!=ConversationIndex::roomKey(8));
+    check::expect("查找不存在的会话不创建",index.find(ConversationIndex::roomKey(1))==nullptr &&
+                                        index.find(ConversationIndex::roomKey(1))==nullptr);
+
+    uint64_t key = ConversationIndex::directKey(1,2);
+    {
+        auto conversation = index.acquire(key);
+        check::expect("获取与查找返回同一会话",index.find(key)==conversation);
+        std::lock_guard<std::mutex> lock(conversation->mutex);
+        conversation->loaded = true;
+        for (int i=1;i<=6;++i) append(index,*conversation,100+i,i%2 ? 1 : 2,"m"+std::to_string(i));
+        check::expect("近期消息只保留最新的若干条",conversation->recent.size()==4 && conversation->recent.front().seq==3);
+
+        // 增量同步：近期消息覆盖(after_seq,last_seq]时直接写出
+        FrameWriter writer;
+        int64_t last_seq = 0;
+        bool served = index.writeRecent(*conversation,3,0,10,"2:",writer,last_seq);
+        std::vector<Message> frames = splitFrames(writer);
+        check::expect("增量同步从近期消息写出",served && frames.size()==3 && last_seq==6 &&
+                                            frames[0].getType()==MessageType::MSG_TYPE_SYNC_RESP &&
+                                            frames[0].getData()=="2:4:m4" && frames[0].getUserId()==2);
+        FrameWriter limited;
+        served = index.writeRecent(*conversation,2,104,1,"",limited,last_seq);
+        frames = splitFrames(limited);
+        check::expect("跳过已收到的消息ID并限制条数",served && frames.size()==1 && frames[0].getData()=="5:m5" && last_seq==5);
+        FrameWriter stale;
+        check::expect("起点早于近期消息时回源存储",!index.writeRecent(*conversation,1,0,10,"",stale,last_seq) &&
+                                                 stale.empty());
+        check::expect("没有新消息时不写出",index.writeRecent(*conversation,6,0,10,"",stale,last_seq) && stale.empty());
+
+        // 最近聊天记录：由新到旧，近期消息不足时回源存储
+        FrameWriter history;
+        history.beginFrame(MessageType::MSG_TYPE_HISTORY_RESP,1);
+        served = index.writeHistory(*conversation,3,history);
+        history.endFrame();
+        frames = splitFrames(history);
+        check::expect("最近聊天记录由新到旧",served && frames.size()==1 && frames[0].getData()=="2:m6|1:m5|2:m4");
+        FrameWriter too_many;
+        check::expect("近期消息不足时回源存储",!index.writeHistory(*conversation,5,too_many));
+
+        // 过期删除：丢弃消息ID不超过上限的近期消息并扣除字节数
+        size_t bytes = index.cachedBytes();
+        index.forget(*conversation,104);
+        check::expect("过期删除后丢弃近期消息",conversation->recent.size()==2 && conversation->recent.front().seq==5 &&
+                                            index.cachedBytes()<bytes);
+        check::expect("近期消息不再连续时增量同步回源存储",!index.writeRecent(*conversation,3,0,10,"",stale,last_seq));
+    }
+
+    // 会话数超出配额：淘汰没有其他引用的会话，使用中的会话保留
+    auto held = index.acquire(ConversationIndex::roomKey(1000));
+    for (int room_id=0;room_id<200;++room_id) index.acquire(ConversationIndex::roomKey(room_id));
+    size_t resident = 0;
+    for (int room_id=0;room_id<200;++room_id) resident += index.find(ConversationIndex::roomKey(room_id))!=nullptr;
+    check::expect("超出会话数配额时淘汰",resident<=16);
+    check::expect("使用中的会话不被淘汰",index.find(ConversationIndex::roomKey(1000))==held);
+    held.reset();
+
+    // 字节数超出配额：再次获取超额的会话时返回该会话本身，其他会话被淘汰后扣除字节数
+    index.init(64,16000,16*1024);
+    uint64_t large_key = ConversationIndex::roomKey(5000);
+    {
+        auto conversation = index.acquire(large_key);
+        std::lock_guard<std::mutex> lock(conversation->mutex);
+        conversation->loaded = true;
+        for (int i=1;i<=8;++i) append(index,*conversation,200+i,1,std::string(512,'x'));
+    }
+    auto again = index.acquire(large_key);
+    check::expect("再次获取超额的会话返回原会话",again!=nullptr && again->recent.size()==8 && again->last_seq==8);
+    again.reset();
+    for (int room_id=6000;room_id<6064;++room_id) index.acquire(ConversationIndex::roomKey(room_id));
+    check::expect("超出字节配额时淘汰没有引用的会话",index.find(large_key)==nullptr && index.cachedBytes()==0);
+    return check::finish();
+}
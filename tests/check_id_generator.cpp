@@ -0,0 +1,57 @@
+//
+// Created by Cando on 2026/10/19.
+//
+// 消息ID生成器检查：单线程严格递增、多线程（超过线程槽数，部分线程使用共享槽）不重复，
+// 以及时间戳/节点ID的解析与按时间查询的下界
+#include "common/id_generator.h"
+#include "check.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace easychat;
+
+int main(){
+    IdGenerator& generator = IdGenerator::getInstance();
+    generator.init(37);
+
+    // 单线程：同一毫秒内序列号用尽时借用下一毫秒，仍严格递增
+    std::vector<int64_t> ids(200000);
+    for (auto& id:ids) id = generator.nextId();
+    check::expect("单线程生成的ID严格递增",std::adjacent_find(ids.begin(),ids.end(),[](int64_t a,int64_t b){
+        return a>=b;
+    })==ids.end());
+    check::expect("ID中解析出节点ID",IdGenerator::extractNodeId(ids.front())==37 && IdGenerator::extractNodeId(ids.back())==37);
+
+    int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    int64_t timestamp = IdGenerator::extractTimestamp(ids.front());
+    check::expect("ID中解析出生成时间",timestamp<=now && timestamp>now-60000);
+    check::expect("按时间查询的下界不大于该时间生成的ID",IdGenerator::minIdForTimestamp(timestamp)<=ids.front() &&
+                                                     IdGenerator::minIdForTimestamp(timestamp+1)>ids.front());
+    check::expect("纪元之前的时间下界为0",IdGenerator::minIdForTimestamp(IdGenerator::kEpochMs-1)==0);
+
+    // 多线程：40个线程超过31个线程槽，其余线程共用加锁的共享槽
+    constexpr int kThreads = 40;
+    constexpr int kPerThread = 20000;
+    std::vector<std::vector<int64_t>> per_thread(kThreads);
+    std::vector<std::thread> threads;
+    for (int i=0;i<kThreads;++i){
+        threads.emplace_back([&generator,&ids=per_thread[i]]{
+            ids.resize(kPerThread);
+            for (auto& id:ids) id = generator.nextId();
+        });
+    }
+    for (auto& thread:threads) thread.join();
+    bool each_increasing = true;
+    std::vector<int64_t> all;
+    for (const auto& thread_ids:per_thread){
+        each_increasing &= std::is_sorted(thread_ids.begin(),thread_ids.end());
+        all.insert(all.end(),thread_ids.begin(),thread_ids.end());
+    }
+    check::expect("每个线程内的ID递增",each_increasing);
+    std::sort(all.begin(),all.end());
+    check::expect("多线程生成的ID不重复",std::adjacent_find(all.begin(),all.end())==all.end());
+    return check::finish();
+}
@@ -0,0 +1,138 @@
+//
+// Created by Cando on 2026/10/19.
+//
+// 收件箱索引检查：加载后按新消息与已读回执增量维护未读数、重复消息按序号跳过、
+// 按最后一条消息排序与预览截断、加载期间的更新暂存与重放、过期删除使加载结果失效，
+// 超出跟踪上限的未读数，以及按用户数淘汰
+#include "business/inbox_index.h"
+#include "check.h"
+#include <arpa/inet.h>
+
+using namespace easychat;
+
+namespace {
+    MessageInfo makeMessage(int64_t id,int sender_id,int receiver_id,int64_t seq,const std::string& content){
+        MessageInfo message{};
+        message.id = id;
+        message.sender_id = sender_id;
+        message.receiver_id = receiver_id;
+        message.seq = seq;
+        message.content = content;
+        return message;
+    }
+
+    int64_t unread(const Inbox& inbox,int peer_id){
+        auto it = inbox.conversations.find(peer_id);
+        return it==inbox.conversations.end() ? -1 : it->second.unreadCount();
+    }
+
+    // 写出收件箱前limit个会话的消息体
+    std::string top(InboxIndex& index,const Inbox& inbox,int limit){
+        FrameWriter writer;
+        writer.beginFrame(MessageType::MSG_TYPE_INBOX,0);
+        index.writeTop(inbox,limit,writer);
+        writer.endFrame();
+        const std::vector<char>& buffer = writer.buffer();
+        return Message::deserialize(buffer.data(),buffer.size()).getData();
+    }
+}
+
+int main(){
+    InboxIndex& index = InboxIndex::getInstance();
+    index.init(16);
+    constexpr int kUser = 1;
+
+    // 未加载的收件箱不接收增量更新
+    auto inbox = index.acquire(kUser);
+    index.onMessage(makeMessage(90,2,kUser,1,"ignored"));
+    check::expect("未加载时忽略新消息",!inbox->loaded && inbox->conversations.empty() && inbox->pending_messages.empty());
+
+    // 从存储加载后增量维护
+    {
+        std::lock_guard<std::mutex> lock(inbox->mutex);
+        std::vector<InboxEntry> entries{{2,100,3,2,"hello",{2,3}},{3,101,5,kUser,"bye",{}}};
+        index.beginLoad(*inbox);
+        check::expect("加载存储数据",index.load(*inbox,entries) && inbox->loaded && inbox->loaders==0 &&
+                                    unread(*inbox,2)==2 && unread(*inbox,3)==0);
+    }
+    index.onMessage(makeMessage(102,2,kUser,4,"new"));
+    index.onMessage(makeMessage(100,2,kUser,3,"hello"));
+    index.onMessage(makeMessage(103,kUser,4,1,"first"));
+    index.onRead(kUser,2,3);
+    {
+        std::lock_guard<std::mutex> lock(inbox->mutex);
+        check::expect("新消息计入未读，已包含的序号跳过，回执清除已读部分",unread(*inbox,2)==1 &&
+                                                                      inbox->conversations[2].last_seq==4);
+        check::expect("自己发出的消息不计未读",unread(*inbox,4)==0 && inbox->conversations[4].last_sender_id==kUser);
+        check::expect("按最后一条消息由新到旧写出",top(index,*inbox,2)=="4:0:1:1:5:first|2:1:4:2:3:new");
+        check::expect("不限制条数时写出全部会话",top(index,*inbox,10).find("|3:0:5:1:3:bye")!=std::string::npos);
+    }
+
+    // 预览截断不切断UTF-8字符
+    std::string long_content = std::string(63,'a')+"\xe4\xbd\xa0"+"tail";
+    index.onMessage(makeMessage(104,5,kUser,1,long_content));
+    {
+        std::lock_guard<std::mutex> lock(inbox->mutex);
+        check::expect("预览截断在UTF-8字符边界",inbox->conversations[5].preview==std::string(63,'a'));
+    }
+
+    // 过期删除后重新加载：加载期间到达的消息与回执暂存并重放
+    index.invalidate(kUser);
+    {
+        std::lock_guard<std::mutex> lock(inbox->mutex);
+        check::expect("过期删除后标记为未加载",!inbox->loaded);
+        index.beginLoad(*inbox);
+    }
+    index.onMessage(makeMessage(105,2,kUser,5,"during load"));
+    index.onRead(kUser,2,4);
+    {
+        std::lock_guard<std::mutex> lock(inbox->mutex);
+        // 存储读到的状态：已包含序号4的消息，尚未包含加载期间的消息与回执
+        std::vector<InboxEntry> entries{{2,102,4,2,"new",{4}}};
+        check::expect("加载期间的更新暂存",inbox->pending_messages.size()==1 && inbox->pending_reads.size()==1);
+        check::expect("加载完成后重放暂存的更新",index.load(*inbox,entries) && unread(*inbox,2)==1 &&
+                                              inbox->conversations[2].preview=="during load" &&
+                                              inbox->pending_messages.empty());
+    }
+
+    // 加载期间发生过期删除：本轮加载结果不安装
+    index.invalidate(kUser);
+    {
+        std::lock_guard<std::mutex> lock(inbox->mutex);
+        index.beginLoad(*inbox);
+    }
+    index.invalidate(kUser);
+    {
+        std::lock_guard<std::mutex> lock(inbox->mutex);
+        std::vector<InboxEntry> entries{{2,102,4,2,"stale",{4}}};
+        check::expect("加载期间过期删除时不安装",!index.load(*inbox,entries) && !inbox->loaded &&
+                                              !inbox->pending_dropped && inbox->loaders==0);
+    }
+
+    // 超出跟踪上限的未读消息只计数，回执越过其中的最大序号后清零
+    {
+        std::lock_guard<std::mutex> lock(inbox->mutex);
+        InboxEntry entry{6,5000,1005,6,"many",{}};
+        for (int64_t seq=1;seq<=1005;++seq) entry.unread_seqs.push_back(seq);
+        std::vector<InboxEntry> entries{entry};
+        index.beginLoad(*inbox);
+        check::expect("超出跟踪上限的未读数",index.load(*inbox,entries) && unread(*inbox,6)==1005 &&
+                                          inbox->conversations[6].unread_seqs.size()==1000);
+    }
+    index.onRead(kUser,6,3);
+    index.onRead(kUser,6,1000);
+    {
+        std::lock_guard<std::mutex> lock(inbox->mutex);
+        check::expect("回执越过计数部分后清零",unread(*inbox,6)==5);
+    }
+
+    // 每个分片只保留一个收件箱：没有引用的收件箱被淘汰，使用中的保留
+    inbox.reset();
+    index.acquire(kUser+16);
+    check::expect("超出用户数配额时淘汰",!index.acquire(kUser)->loaded);
+    auto held = index.acquire(kUser+32);
+    held->loaded = true;
+    index.acquire(kUser+48);
+    check::expect("使用中的收件箱不被淘汰",index.acquire(kUser+32)==held);
+    return check::finish();
+}
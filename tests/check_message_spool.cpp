@@ -0,0 +1,99 @@
+//
+// Created by Cando on 2026/10/19.
+//
+// 消息溢写区检查：存储不可用时消息留在溢写文件中，重新打开时截断写了一半的尾部，
+// 存储恢复后按写入顺序回放，序号为0的消息回放时依次分配序号
+#include "database/log_message_store.h"
+#include "database/message_spool.h"
+#include "common/id_generator.h"
+#include "check.h"
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <unistd.h>
+
+using namespace easychat;
+
+namespace {
+    // 可以模拟不可用的日志存储
+    class FlakyStore : public LogMessageStore{
+    public:
+        std::atomic<bool> down{true};
+        bool storeMessage(MessageInfo& message) override{
+            return !down && LogMessageStore::storeMessage(message);
+        }
+        bool getConversationSeq(int user_id1,int user_id2,int64_t& seq) override{
+            return !down && LogMessageStore::getConversationSeq(user_id1,user_id2,seq);
+        }
+    };
+
+    MessageInfo makeMessage(int sender_id,int receiver_id,const std::string& content){
+        MessageInfo message{};
+        message.id = IdGenerator::getInstance().nextId();
+        message.sender_id = sender_id;
+        message.receiver_id = receiver_id;
+        message.content = content;
+        message.is_offline = 1;
+        return message;
+    }
+
+    // 等待直到条件成立或超时
+    template<typename Predicate> bool waitFor(Predicate predicate,int timeout_ms){
+        auto deadline = std::chrono::steady_clock::now()+std::chrono::milliseconds(timeout_ms);
+        while (!predicate()){
+            if (std::chrono::steady_clock::now()>=deadline) return false;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return true;
+    }
+}
+
+int main(){
+    std::string dir = "/tmp/easychat_check_spool_"+std::to_string(getpid());
+    std::string spool_path = dir+"/messages.spool";
+    auto store = std::make_shared<FlakyStore>();
+    check::expect("打开日志存储",store->init(dir+"/store",1024*1024,0,10));
+
+    {
+        MessageSpool spool;
+        check::expect("打开溢写区",spool.init(spool_path,store,10,50));
+        for (int i=1;i<=3;++i){
+            check::expect("存储不可用时写入溢写区",spool.append(makeMessage(1,2,"spooled "+std::to_string(i))));
+        }
+        int64_t max_seq = -1;
+        check::expect("会话有未分配序号的消息时序号未定",!spool.pendingSeq(1,2,max_seq));
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        check::expect("存储不可用时消息保留在溢写区",spool.pendingCount()==3);
+        spool.close();
+    }
+
+    // 模拟崩溃时写了一半的记录
+    {
+        std::ofstream tail(spool_path,std::ios::binary|std::ios::app);
+        tail<<"torn";
+    }
+    MessageSpool spool;
+    check::expect("重新打开溢写区",spool.init(spool_path,store,10,50));
+    check::expect("截断尾部后恢复全部完整记录",spool.pendingCount()==3 &&
+                                           std::filesystem::file_size(spool_path)>0);
+
+    store->down = false;
+    check::expect("存储恢复后全部回放",waitFor([&spool]{return !spool.hasPending();},3000));
+    std::vector<MessageInfo> history;
+    check::expect("读取回放后的聊天记录",store->getChatHistory(1,2,history,10));
+    bool ordered = history.size()==3;
+    for (size_t i=0;ordered && i<history.size();++i){
+        // 聊天记录按时间倒序
+        const MessageInfo& message = history[history.size()-1-i];
+        ordered = message.seq==static_cast<int64_t>(i+1) && message.content=="spooled "+std::to_string(i+1);
+    }
+    check::expect("按写入顺序回放并依次分配序号",ordered);
+    check::expect("全部回放后清空溢写文件",waitFor([&spool_path]{return std::filesystem::file_size(spool_path)==0;},1000));
+
+    spool.close();
+    store->close();
+    std::filesystem::remove_all(dir);
+    return check::finish();
+}
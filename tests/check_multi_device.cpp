@@ -0,0 +1,47 @@
+//
+// Created by Cando on 2026/10/19.
+//
+// 多设备在线检查：同一用户的多个设备连接登记在同一槽位，达到设备上限后拒绝新设备，
+// 移除一个设备时用户仍在线，用无效句柄移除时下线所有设备
+#include "business/online_registry.h"
+#include "check.h"
+#include <algorithm>
+
+using namespace easychat;
+
+namespace {
+    bool contains(const DeviceHandles& devices,const ConnectionHandle& handle){
+        return std::find(devices.handles,devices.handles+devices.count,handle)!=devices.handles+devices.count;
+    }
+}
+
+int main(){
+    OnlineRegistry registry;
+    constexpr size_t kMax = DeviceHandles::kMaxDevices;
+    bool added = true;
+    for (size_t i=0;i<kMax;++i){
+        added &= registry.add(1,ConnectionHandle{static_cast<int>(10+i),static_cast<uint32_t>(i+1)});
+    }
+    check::expect("同一用户登记多个设备",added && registry.size()==1);
+    check::expect("达到设备上限后拒绝新设备",!registry.add(1,ConnectionHandle{100,100}));
+    check::expect("已登记的设备重复登记不占新位置",registry.add(1,ConnectionHandle{10,1}));
+
+    DeviceHandles devices;
+    check::expect("查找所有设备",registry.lookup(1,devices) && devices.count==kMax &&
+                                contains(devices,ConnectionHandle{10,1}) &&
+                                contains(devices,ConnectionHandle{static_cast<int>(10+kMax-1),static_cast<uint32_t>(kMax)}));
+
+    bool now_offline = true;
+    check::expect("移除一个设备后用户仍在线",registry.remove(1,ConnectionHandle{10,1},&now_offline) && !now_offline &&
+                                           registry.isOnline(1) && registry.size()==1);
+    check::expect("同一描述符的旧代数不能移除设备",!registry.remove(1,ConnectionHandle{11,99},&now_offline) &&
+                                                  registry.lookup(1,devices) && devices.count==kMax-1);
+    check::expect("移除设备后空出的位置可以登记新设备",registry.add(1,ConnectionHandle{100,100}) &&
+                                                     registry.lookup(1,devices) && devices.count==kMax &&
+                                                     contains(devices,ConnectionHandle{100,100}));
+    check::expect("其他用户不受影响",registry.add(2,ConnectionHandle{200,1}) && registry.size()==2);
+
+    check::expect("无效句柄移除该用户的所有设备",registry.remove(1,ConnectionHandle{},&now_offline) && now_offline &&
+                                               !registry.isOnline(1) && registry.isOnline(2) && registry.size()==1);
+    return check::finish();
+}
@@ -0,0 +1,87 @@
+//
+// Created by Cando on 2026/10/19.
+//
+// 在线用户注册表检查：添加/查找/移除、表的扩容与按在线数缩小、快照，
+// 以及写线程不断上下线时无锁读者不会读到其他用户的句柄
+#include "business/online_registry.h"
+#include "check.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace easychat;
+
+namespace {
+    // 每个用户的句柄由用户ID决定，读者据此判断是否读到了其他用户的句柄
+    ConnectionHandle handleOf(int user_id,uint32_t generation=1){
+        return ConnectionHandle{user_id%60000+3,static_cast<uint32_t>(user_id)*16+generation};
+    }
+    bool belongsTo(const ConnectionHandle& handle,int user_id){
+        return handle.fd==user_id%60000+3 && handle.generation/16==static_cast<uint32_t>(user_id);
+    }
+}
+
+int main(){
+    OnlineRegistry registry(4,8);
+    ConnectionHandle handle;
+    check::expect("空表查找不到",!registry.lookup(1,handle) && !registry.isOnline(1) && registry.size()==0);
+    check::expect("拒绝无效句柄",!registry.add(1,ConnectionHandle{}));
+
+    // 远超初始容量，触发多次重建
+    constexpr int kUsers = 5000;
+    bool added = true;
+    for (int i=1;i<=kUsers;++i) added &= registry.add(i,handleOf(i));
+    check::expect("添加用户（多次扩容）",added && registry.size()==kUsers);
+    bool all_found = true;
+    for (int i=1;i<=kUsers;++i) all_found &= registry.lookup(i,handle) && handle==handleOf(i);
+    check::expect("扩容后全部可查",all_found);
+    check::expect("重复添加同一句柄不计数",registry.add(7,handleOf(7)) && registry.size()==kUsers);
+
+    bool now_offline = false;
+    check::expect("按句柄移除",registry.remove(7,handleOf(7),&now_offline) && now_offline && !registry.isOnline(7));
+    check::expect("移除不在线的用户",!registry.remove(7,handleOf(7),&now_offline) && now_offline);
+    check::expect("句柄不匹配时不移除",!registry.remove(8,handleOf(8,2)) && registry.isOnline(8));
+
+    std::vector<int> snapshot;
+    registry.snapshot(snapshot);
+    check::expect("快照为在线用户",snapshot.size()==kUsers-1 &&
+                                  std::find(snapshot.begin(),snapshot.end(),7)==snapshot.end());
+    // 各分片的句柄追加到同一个数组
+    std::vector<ConnectionHandle> handles;
+    for (size_t shard=0;shard<registry.shardCount();++shard){
+        registry.snapshotShard(shard,handles);
+    }
+    check::expect("各分片句柄快照合计为在线设备数",handles.size()==kUsers-1);
+
+    // 大部分用户下线后重新上线新用户：按在线数重建，已下线用户的键不再占用槽位
+    for (int i=1;i<=kUsers;++i) registry.remove(i,ConnectionHandle{});
+    check::expect("全部下线",registry.size()==0 && !registry.isOnline(100));
+    for (int i=kUsers+1;i<=kUsers+100;++i) registry.add(i,handleOf(i));
+    all_found = true;
+    for (int i=kUsers+1;i<=kUsers+100;++i) all_found &= registry.lookup(i,handle) && handle==handleOf(i);
+    check::expect("下线后重建的表可查",all_found && !registry.isOnline(1) && registry.size()==100);
+
+    // 并发：读线程查找时写线程不断上下线（新代数）并触发重建
+    std::atomic<bool> running{true};
+    std::atomic<bool> wrong{false};
+    std::vector<std::thread> readers;
+    for (int t=0;t<4;++t){
+        readers.emplace_back([&registry,&running,&wrong,t]{
+            ConnectionHandle found;
+            int user_id = t+1;
+            while (running.load(std::memory_order_relaxed)){
+                user_id = user_id%2000+1;
+                if (registry.lookup(user_id,found) && !belongsTo(found,user_id)) wrong = true;
+            }
+        });
+    }
+    for (int round=0;round<20;++round){
+        for (int i=1;i<=2000;++i) registry.add(i,handleOf(i,round%15+1));
+        for (int i=1;i<=2000;++i) registry.remove(i,handleOf(i,round%15+1));
+    }
+    running = false;
+    for (auto& reader:readers) reader.join();
+    check::expect("并发读写时不会读到其他用户的句柄",!wrong);
+    return check::finish();
+}
@@ -0,0 +1,37 @@
+//
+// Created by Cando on 2026/10/19.
+//
+// 密码哈希检查：PBKDF2-SHA256的已知向量、加盐、迭代次数低于目标或旧版MD5哈希时的升级标记，
+// 以及格式错误或迭代次数超限的存储值
+#include "business/password_hasher.h"
+#include "check.h"
+
+using namespace easychat;
+
+int main(){
+    bool needs_upgrade = true;
+    // PBKDF2-HMAC-SHA256("password","salt",1次迭代)
+    std::string known = "pbkdf2_sha256$1$salt$120fb6cffcf8b32c43e7225256c4f837a86548c92ccc35480805987cb70be17b";
+    check::expect("已知向量",PasswordHasher::verify("password",known,1,needs_upgrade) && !needs_upgrade);
+    check::expect("已知向量低于目标迭代次数时需要升级",PasswordHasher::verify("password",known,1000,needs_upgrade) && needs_upgrade);
+    check::expect("错误密码",!PasswordHasher::verify("passwort",known,1,needs_upgrade));
+
+    std::string stored = PasswordHasher::hash("123456",1000);
+    check::expect("存储格式带算法与迭代次数",stored.rfind("pbkdf2_sha256$1000$",0)==0);
+    check::expect("校验新哈希",PasswordHasher::verify("123456",stored,1000,needs_upgrade) && !needs_upgrade);
+    check::expect("相同密码每次加盐不同",PasswordHasher::hash("123456",1000)!=stored);
+    check::expect("调高迭代次数后需要升级",PasswordHasher::verify("123456",stored,2000,needs_upgrade) && needs_upgrade);
+    std::string upgraded = PasswordHasher::hash("123456",2000);
+    check::expect("升级后的哈希不再需要升级",PasswordHasher::verify("123456",upgraded,2000,needs_upgrade) && !needs_upgrade);
+
+    // 旧版无盐MD5("123456")
+    std::string legacy = "e10adc3949ba59abbe56e057f20f883e";
+    check::expect("旧版MD5哈希可登录并需要升级",PasswordHasher::verify("123456",legacy,1000,needs_upgrade) && needs_upgrade);
+    check::expect("旧版MD5哈希的错误密码",!PasswordHasher::verify("654321",legacy,1000,needs_upgrade));
+
+    check::expect("格式错误的存储值",!PasswordHasher::verify("password","pbkdf2_sha256$1",1,needs_upgrade) &&
+                                    !PasswordHasher::verify("password","pbkdf2_sha256$x$salt$00",1,needs_upgrade) &&
+                                    !PasswordHasher::verify("password","pbkdf2_sha256$0$salt$00",1,needs_upgrade));
+    check::expect("拒绝超过上限的迭代次数",!PasswordHasher::verify("password","pbkdf2_sha256$2000000000$salt$00",1,needs_upgrade));
+    return check::finish();
+}
@@ -0,0 +1,74 @@
+//
+// Created by Cando on 2026/10/19.
+//
+// SQL执行统计检查：语句模板归一化、同一模板的聚合与分位数、慢查询日志的阈值
+#include "database/query_stats.h"
+#include "check.h"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+using namespace easychat;
+
+namespace {
+    // 在报告中查找以模板结尾的行
+    std::string reportLine(const std::string& report,const std::string& text){
+        std::istringstream in(report);
+        std::string line;
+        while (std::getline(in,line)){
+            if (line.size()>text.size() && line.compare(line.size()-text.size(),text.size(),text)==0 &&
+                line[line.size()-text.size()-1]==' '){
+                return line;
+            }
+        }
+        return "";
+    }
+}
+
+int main(){
+    check::expect("数字与字符串字面量替换为?",
+                  QueryStats::normalize("SELECT * FROM messages WHERE id=42 AND content='a''b\\'c'")==
+                  "select * from messages where id=? and content=?");
+    check::expect("标识符中的数字保留、连续空白合并",
+                  QueryStats::normalize("select  col1\n from t2   where x = 3.5  ")=="select col1 from t2 where x = ?");
+    check::expect("参数不同的语句归一化为同一模板",
+                  QueryStats::normalize("update users set status=1 where id=7")==
+                  QueryStats::normalize("update users set status=0 where id=12345"));
+
+    std::string slow_log_path = "/tmp/easychat_check_slow_"+std::to_string(getpid())+".log";
+    QueryStats& stats = QueryStats::getInstance();
+    check::expect("打开慢查询日志",stats.init(1,slow_log_path));
+
+    // 98次100微秒、2次100毫秒（其中1次失败）
+    for (int i=0;i<98;++i){
+        stats.record("select id from users where id="+std::to_string(i),10,100,1,true);
+    }
+    stats.record("select id from users where id=98",10,100000,1,true);
+    stats.record("select id from users where id=99",10,100000,0,false);
+    stats.record("delete from messages where id<5",0,500,3,true);
+
+    // 列：count errors total_ms avg_wait_us p50_us p99_us max_us rows statement
+    std::string line = reportLine(stats.report(),"select id from users where id=?");
+    std::istringstream fields(line);
+    uint64_t count = 0,errors = 0,total_ms = 0,avg_wait = 0,p50 = 0,p99 = 0,max_us = 0,rows = 0;
+    fields>>count>>errors>>total_ms>>avg_wait>>p50>>p99>>max_us>>rows;
+    check::expect("同一模板聚合为一行",count==100 && errors==1 && rows==99);
+    check::expect("总耗时与平均等待时间",total_ms==(98*100+2*100000)/1000 && avg_wait==10);
+    check::expect("p50取所在桶的上界",p50==128);
+    check::expect("p99不超过最大耗时",p99==100000 && max_us==100000);
+    check::expect("不同模板分开统计",!reportLine(stats.report(),"delete from messages where id<?").empty());
+
+    // 阈值1毫秒：只有两条100毫秒的语句写入慢查询日志，失败的语句带FAILED标记
+    stats.close();
+    std::ifstream slow_log(slow_log_path);
+    int slow_lines = 0,failed_lines = 0;
+    std::string slow_line;
+    while (std::getline(slow_log,slow_line)){
+        ++slow_lines;
+        if (slow_line.find(" FAILED sql: select id from users where id=99")!=std::string::npos) ++failed_lines;
+    }
+    check::expect("只记录超过阈值的语句",slow_lines==2 && failed_lines==1);
+    std::remove(slow_log_path.c_str());
+    return check::finish();
+}
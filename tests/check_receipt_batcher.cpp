@@ -0,0 +1,116 @@
+//
+// Created by Cando on 2026/10/19.
+//
+// 已读回执合并器检查：未启动时同步写入并转发；窗口内同一会话的多次回执只保留最大序号，
+// 写入失败时不转发、保留到恢复后重试；停止时写完剩余回执
+#include "business/receipt_batcher.h"
+#include "database/log_message_store.h"
+#include "check.h"
+#include <atomic>
+#include <filesystem>
+#include <map>
+#include <thread>
+#include <unistd.h>
+
+using namespace easychat;
+using namespace std::chrono_literals;
+
+namespace {
+    // 记录回执写入的日志存储，可以模拟写入失败
+    class ReceiptStore : public LogMessageStore{
+    public:
+        std::atomic<bool> failing{false};
+        std::atomic<size_t> written{0};
+        bool markConversationsRead(const std::vector<ReadReceipt>& receipts) override{
+            if (failing || !LogMessageStore::markConversationsRead(receipts)) return false;
+            written += receipts.size();
+            return true;
+        }
+    };
+
+    // 记录转发给发送者的回执（会话->序号）
+    struct Forwarded{
+        std::mutex mutex;
+        std::map<std::pair<int,int>,int64_t> receipts;
+        size_t frames = 0;
+        void add(const std::vector<ReadReceipt>& batch){
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const auto& receipt:batch){
+                receipts[std::make_pair(receipt.reader_id,receipt.peer_id)] = receipt.seq;
+                ++frames;
+            }
+        }
+        size_t count(){
+            std::lock_guard<std::mutex> lock(mutex);
+            return frames;
+        }
+    };
+
+    template<typename Predicate> bool waitFor(Predicate predicate,int timeout_ms){
+        auto deadline = std::chrono::steady_clock::now()+std::chrono::milliseconds(timeout_ms);
+        while (!predicate()){
+            if (std::chrono::steady_clock::now()>=deadline) return false;
+            std::this_thread::sleep_for(5ms);
+        }
+        return true;
+    }
+}
+
+int main(){
+    std::string dir = "/tmp/easychat_check_receipt_"+std::to_string(getpid());
+    auto store = std::make_shared<ReceiptStore>();
+    check::expect("打开日志存储",store->init(dir,1024*1024,0,10));
+
+    // 未启动：每个回执同步写入并立即转发
+    {
+        Forwarded forwarded;
+        ReceiptBatcher batcher;
+        batcher.init(store,[&forwarded](const std::vector<ReadReceipt>& batch){forwarded.add(batch);});
+        batcher.read(2,1,3);
+        check::expect("未启动时同步写入并转发",batcher.pendingCount()==0 && store->written==1 &&
+                                              forwarded.count()==1 && forwarded.receipts[{2,1}]==3);
+    }
+
+    // 启动后：窗口内同一会话只保留最大序号，写入失败时不转发
+    {
+        Forwarded forwarded;
+        ReceiptBatcher batcher;
+        batcher.init(store,[&forwarded](const std::vector<ReadReceipt>& batch){forwarded.add(batch);});
+        store->failing = true;
+        store->written = 0;
+        batcher.start(50,100);
+        batcher.read(2,1,5);
+        batcher.read(2,1,9);
+        batcher.read(2,1,7);
+        batcher.read(3,1,4);
+        batcher.read(1,2,6);
+        check::expect("同一会话的回执合并（不同方向分开记录）",batcher.pendingCount()==3);
+        std::this_thread::sleep_for(150ms);
+        check::expect("写入失败时不转发且保留待写",batcher.pendingCount()==3 && forwarded.count()==0);
+        batcher.read(3,1,8);
+        store->failing = false;
+        check::expect("恢复后写完",waitFor([&batcher]{return batcher.pendingCount()==0;},2000) &&
+                                  waitFor([&forwarded]{return forwarded.count()==3;},2000));
+        std::lock_guard<std::mutex> lock(forwarded.mutex);
+        check::expect("每个会话只写入并转发一个最大序号的回执",store->written==3 && forwarded.receipts[{2,1}]==9 &&
+                                                          forwarded.receipts[{3,1}]==8 && forwarded.receipts[{1,2}]==6);
+    }
+
+    // 停止时写完窗口内剩余的回执
+    {
+        Forwarded forwarded;
+        ReceiptBatcher batcher;
+        batcher.init(store,[&forwarded](const std::vector<ReadReceipt>& batch){forwarded.add(batch);});
+        batcher.start(10000,100);
+        batcher.read(4,1,2);
+        batcher.read(4,1,3);
+        check::expect("窗口结束前不写入",batcher.pendingCount()==1 && forwarded.count()==0);
+        batcher.stop();
+        check::expect("停止时写完剩余回执",batcher.pendingCount()==0 && forwarded.count()==1 &&
+                                         forwarded.receipts[{4,1}]==3);
+    }
+
+    store->close();
+    std::filesystem::remove_all(dir);
+    return check::finish();
+}
@@ -0,0 +1,56 @@
+//
+// Created by Cando on 2026/10/19.
+//
+// 群聊成员检查：创建者自动加入、成员快照不可变（扇出时持有的旧快照不受之后的变更影响）、
+// 成员上限、加入位置递增，以及重启后从存储加载房间与成员
+#include "business/room_manager.h"
+#include "database/log_message_store.h"
+#include "check.h"
+#include <filesystem>
+#include <unistd.h>
+
+using namespace easychat;
+
+int main(){
+    std::string dir = "/tmp/easychat_check_rooms_"+std::to_string(getpid());
+    auto store = std::make_shared<LogMessageStore>();
+    check::expect("打开日志存储",store->init(dir,1024*1024,0,10));
+    RoomManager& rooms = RoomManager::getInstance();
+    check::expect("初始化",rooms.init(store,3));
+
+    int room_id = 0;
+    check::expect("创建房间",rooms.createRoom(1,"check",room_id) && room_id>0);
+    check::expect("创建者自动加入",rooms.isMember(room_id,1));
+    RoomMembers before = rooms.getMembers(room_id);
+    check::expect("加入房间",rooms.joinRoom(room_id,3) && rooms.joinRoom(room_id,2));
+    check::expect("重复加入视为成功",rooms.joinRoom(room_id,2));
+    check::expect("之前取得的快照不受影响",before->size()==1);
+    RoomMembers members = rooms.getMembers(room_id);
+    check::expect("成员按用户ID排序",members->size()==3 && (*members)[0].user_id==1 &&
+                                    (*members)[1].user_id==2 && (*members)[2].user_id==3);
+    check::expect("后加入的成员加入位置更大",(*members)[2].joined_message_id>(*members)[0].joined_message_id &&
+                                           (*members)[1].joined_message_id>(*members)[2].joined_message_id);
+    check::expect("人数已满时拒绝加入",!rooms.joinRoom(room_id,4) && !rooms.isMember(room_id,4));
+    check::expect("房间不存在",!rooms.joinRoom(room_id+1000,4) && rooms.getMembers(room_id+1000)==nullptr);
+
+    check::expect("退出房间",rooms.leaveRoom(room_id,3) && !rooms.isMember(room_id,3) && members->size()==3);
+    std::vector<std::pair<int,int64_t>> user_rooms;
+    rooms.getUserRooms(2,user_rooms);
+    check::expect("用户加入的房间",user_rooms.size()==1 && user_rooms[0].first==room_id);
+    user_rooms.clear();
+    rooms.getUserRooms(3,user_rooms);
+    check::expect("退出后不再列出",user_rooms.empty());
+
+    // 重启：从段文件重放后重新加载
+    int64_t joined = rooms.getMembers(room_id)->at(1).joined_message_id;
+    store->close();
+    store = std::make_shared<LogMessageStore>();
+    check::expect("重新打开日志存储",store->init(dir,1024*1024,0,10));
+    check::expect("重新加载房间",rooms.init(store,3));
+    members = rooms.getMembers(room_id);
+    check::expect("重启后成员与加入位置不变",members && members->size()==2 && (*members)[1].user_id==2 &&
+                                           (*members)[1].joined_message_id==joined);
+    store->close();
+    std::filesystem::remove_all(dir);
+    return check::finish();
+}
@@ -0,0 +1,62 @@
+//
+// Created by Cando on 2026/10/19.
+//
+// 结果集行解码器检查：不连接MySQL，用本文件中的mysql_fetch_row/mysql_fetch_lengths
+// 替换客户端库的实现（可执行文件中的定义优先于共享库），喂入构造好的行
+#include "database/row_decoder.h"
+#include "check.h"
+#include <vector>
+
+using namespace easychat;
+
+namespace {
+    // 构造的结果集：每行的列指针（NULL列为nullptr）与列长度
+    struct FakeResult{
+        std::vector<std::vector<char*>> rows;
+        std::vector<std::vector<unsigned long>> lengths;
+        size_t index = 0;
+    };
+
+    FakeResult* fakeOf(MYSQL_RES* result){
+        return reinterpret_cast<FakeResult*>(result);
+    }
+}
+
+extern "C" MYSQL_ROW mysql_fetch_row(MYSQL_RES* result){
+    FakeResult* fake = fakeOf(result);
+    if (fake->index>=fake->rows.size()) return nullptr;
+    return fake->rows[fake->index++].data();
+}
+
+extern "C" unsigned long* mysql_fetch_lengths(MYSQL_RES* result){
+    FakeResult* fake = fakeOf(result);
+    return fake->lengths[fake->index-1].data();
+}
+
+int main(){
+    // 列值不以'\0'结尾：解码器只能按mysql_fetch_lengths给出的长度读取
+    char buffer[] = "12345|hello|9223372036854775807|4294967296|12a|-7";
+    FakeResult fake;
+    fake.rows.push_back({buffer,buffer+6,nullptr,buffer+12});
+    fake.lengths.push_back({5,5,0,19});
+    fake.rows.push_back({buffer+32,buffer+43,buffer+47,nullptr});
+    fake.lengths.push_back({10,3,2,0});
+
+    RowDecoder row(reinterpret_cast<MYSQL_RES*>(&fake));
+    check::expect("读取第一行",row.next());
+    check::expect("按列长度解析整数",row.getInt32(0)==12345);
+    check::expect("字符串视图不越过列长度",row.getView(1)=="hello" && row.getString(1)=="hello");
+    check::expect("NULL列",row.isNull(2) && row.getView(2).empty() && row.getInt32(2,-1)==-1);
+    check::expect("64位整数",row.getInt64(3)==9223372036854775807LL);
+
+    check::expect("读取第二行",row.next());
+    check::expect("超出32位范围的整数返回默认值",row.getInt32(0,-1)==-1 && row.getInt64(0)==4294967296LL);
+    check::expect("格式错误的整数返回默认值",row.getInt32(1,-1)==-1);
+    check::expect("负数",row.getInt32(2)==-7 && row.getInt64(2)==-7);
+    check::expect("NULL列的64位整数返回默认值",row.getInt64(3,42)==42);
+    check::expect("没有更多行",!row.next());
+
+    RowDecoder empty(nullptr);
+    check::expect("空结果集",!empty.next());
+    return check::finish();
+}
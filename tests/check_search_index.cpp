@@ -0,0 +1,121 @@
+//
+// Created by Cando on 2026/10/19.
+//
+// 全文搜索索引检查：分词（ASCII按词转小写、中日韩文字单字与二元组、标点分隔、去重），
+// 启动时从存储重建索引，以及消息封存为压缩段并合并后查询结果不变（大消息ID的差值varint编解码）、
+// 重复索引去重、分页与过期消息跳过
+#include "business/search_index.h"
+#include "database/log_message_store.h"
+#include "check.h"
+#include <algorithm>
+#include <filesystem>
+#include <thread>
+#include <unistd.h>
+
+using namespace easychat;
+using namespace std::chrono_literals;
+
+namespace {
+    // 消息ID取接近Snowflake量级的大数，差值跨越多个varint字节
+    constexpr int64_t kBaseId = 1LL<<60;
+    int64_t messageId(int i){
+        return kBaseId+static_cast<int64_t>(i)*1000003;
+    }
+
+    MessageInfo makeMessage(int i,int sender_id,int receiver_id){
+        MessageInfo message{};
+        message.id = messageId(i);
+        message.sender_id = sender_id;
+        message.receiver_id = receiver_id;
+        message.content = "msg"+std::to_string(i)+" common";
+        if (i%3==0) message.content += " Fizz";
+        if (i%5==0) message.content += " 嗡嗡声";
+        return message;
+    }
+
+    std::vector<std::string> tokens(std::string_view text){
+        std::vector<std::string> terms;
+        SearchIndex::tokenize(text,terms);
+        return terms;
+    }
+
+    std::vector<int64_t> search(int user_id,std::string_view query,size_t limit,int64_t before_id = 0){
+        std::vector<int64_t> message_ids;
+        SearchIndex::getInstance().search(user_id,tokens(query),limit,before_id,message_ids);
+        return message_ids;
+    }
+
+    // 期望的查询结果（由新到旧）
+    std::vector<int64_t> expected(int from,int to,bool (*match)(int)){
+        std::vector<int64_t> ids;
+        for (int i=to-1;i>=from;--i){
+            if (match(i)) ids.push_back(messageId(i));
+        }
+        return ids;
+    }
+
+    template<typename Predicate> bool waitFor(Predicate predicate,int timeout_ms){
+        auto deadline = std::chrono::steady_clock::now()+std::chrono::milliseconds(timeout_ms);
+        while (!predicate()){
+            if (std::chrono::steady_clock::now()>=deadline) return false;
+            std::this_thread::sleep_for(5ms);
+        }
+        return true;
+    }
+}
+
+int main(){
+    // 分词
+    check::expect("ASCII按词切分、转小写并去重",tokens("Hello, World hello!")==std::vector<std::string>({"hello","world"}));
+    check::expect("中文按单字与二元组切分",tokens("你好世界")==std::vector<std::string>({"世","世界","你","你好","好","好世","界"}));
+    check::expect("中英混排与全角标点分隔",tokens("abc中文，OK")==std::vector<std::string>({"abc","ok","中","中文","文"}));
+    check::expect("其他非ASCII字母计入单词",tokens("Café au lait")==std::vector<std::string>({"au","café","lait"}));
+    check::expect("只有标点时没有词项",tokens("...，！ ").empty());
+
+    std::string dir = "/tmp/easychat_check_search_"+std::to_string(getpid());
+    auto store = std::make_shared<LogMessageStore>();
+    bool stored = store->init(dir,1024*1024,0,10);
+    for (int i=0;i<3;++i){
+        MessageInfo message = makeMessage(i,1,2);
+        stored &= store->storeMessage(message);
+    }
+    check::expect("写入已有消息",stored);
+
+    // 启动时重建已有消息的索引；可变段每8个倒排项封存，不可变段超过2个时合并
+    SearchIndex& index = SearchIndex::getInstance();
+    index.start(store,8,2,true);
+    check::expect("启动时从存储重建索引",waitFor([]{return search(2,"msg1",10)==std::vector<int64_t>{messageId(1)};},2000));
+
+    constexpr int kMessages = 300;
+    for (int i=3;i<kMessages;++i){
+        index.add(makeMessage(i,i%2 ? 1 : 2,i%2 ? 2 : 1));
+    }
+    // 重复索引同一条消息
+    index.add(makeMessage(30,2,1));
+    check::expect("封存并合并不可变段",waitFor([&index]{return index.segmentCount()>=1 && index.segmentCount()<=2;},3000));
+    std::this_thread::sleep_for(1200ms);
+    check::expect("合并后段数不超过上限",index.segmentCount()>=1 && index.segmentCount()<=2);
+
+    auto fizzBuzz = [](int i){return i%15==0;};
+    check::expect("多词项查询取交集（编解码后结果不变）",search(1,"fizz 嗡嗡",100)==expected(0,kMessages,fizzBuzz));
+    check::expect("发送者与接收者都能查到",search(2,"FIZZ 嗡嗡",100)==expected(0,kMessages,fizzBuzz));
+    check::expect("非参与者查不到",search(3,"common",100).empty());
+    check::expect("不存在的词项没有结果",search(1,"fizz nothing",100).empty());
+    auto first_page = search(1,"common",10);
+    auto second_page = search(1,"common",10,first_page.back());
+    check::expect("按before_id分页",first_page==expected(kMessages-10,kMessages,[](int){return true;}) &&
+                                   second_page==expected(kMessages-20,kMessages-10,[](int){return true;}));
+
+    // 过期消息查询时跳过，之后封存与合并时丢弃
+    index.expireBefore(messageId(150));
+    check::expect("过期的消息不再返回",search(2,"fizz 嗡嗡",100)==expected(150,kMessages,fizzBuzz));
+    for (int i=kMessages;i<kMessages+60;++i) index.add(makeMessage(i,1,2));
+    std::this_thread::sleep_for(1200ms);
+    check::expect("过期后继续封存与合并结果正确",search(1,"fizz 嗡嗡",100)==expected(150,kMessages+60,fizzBuzz) &&
+                                              index.segmentCount()<=2);
+
+    index.stop();
+    store->close();
+    std::filesystem::remove_all(dir);
+    return check::finish();
+}
@@ -0,0 +1,68 @@
+//
+// Created by Cando on 2026/10/19.
+//
+// 会话令牌检查：签发与校验、篡改与换密钥后失效、过期与非法用户ID（用同一密钥在本地构造令牌）
+#include "business/session_manager.h"
+#include "check.h"
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <ctime>
+
+using namespace easychat;
+
+namespace {
+    const std::string kSecret = "check-secret";
+
+    // 与SessionManager相同的签名方式构造令牌
+    std::string forgeToken(const std::string& secret,const std::string& payload){
+        unsigned char digest[EVP_MAX_MD_SIZE];
+        unsigned int digest_length = 0;
+        HMAC(EVP_sha256(),secret.data(),static_cast<int>(secret.size()),
+             reinterpret_cast<const unsigned char*>(payload.data()),payload.size(),digest,&digest_length);
+        static const char digits[] = "0123456789abcdef";
+        std::string hex;
+        for (unsigned int i=0;i<digest_length;++i){
+            hex += digits[digest[i]>>4];
+            hex += digits[digest[i]&0x0f];
+        }
+        return payload+"."+hex;
+    }
+}
+
+int main(){
+    SessionManager& sessions = SessionManager::getInstance();
+    check::expect("初始化",sessions.init(kSecret,3600));
+
+    std::string token = sessions.issueToken(42);
+    int user_id = 0;
+    int64_t issued_at = 0;
+    int64_t now = static_cast<int64_t>(time(nullptr));
+    check::expect("校验签发的令牌",sessions.verifyToken(token,user_id,issued_at) && user_id==42 &&
+                                  issued_at<=now && issued_at>=now-5);
+    check::expect("每次签发的令牌不同",sessions.issueToken(42)!=token);
+
+    std::string tampered = token;
+    tampered[0] = '4';
+    tampered[1] = '3';
+    check::expect("篡改用户ID后失效",tampered!=token && !sessions.verifyToken(tampered,user_id,issued_at));
+    std::string bad_signature = token;
+    bad_signature.back() = bad_signature.back()=='0' ? '1' : '0';
+    check::expect("篡改签名后失效",!sessions.verifyToken(bad_signature,user_id,issued_at));
+    check::expect("截断签名后失效",!sessions.verifyToken(token.substr(0,token.size()-2),user_id,issued_at));
+    check::expect("格式错误",!sessions.verifyToken("",user_id,issued_at) &&
+                            !sessions.verifyToken("no-dots",user_id,issued_at) &&
+                            !sessions.verifyToken(std::string(300,'a'),user_id,issued_at));
+
+    check::expect("本地构造的有效令牌",sessions.verifyToken(
+            forgeToken(kSecret,"7."+std::to_string(now)+".00"),user_id,issued_at) && user_id==7);
+    check::expect("过期令牌",!sessions.verifyToken(
+            forgeToken(kSecret,"7."+std::to_string(now-7200)+".00"),user_id,issued_at));
+    check::expect("用户ID不合法",!sessions.verifyToken(forgeToken(kSecret,"0."+std::to_string(now)+".00"),user_id,issued_at) &&
+                                !sessions.verifyToken(forgeToken(kSecret,"x."+std::to_string(now)+".00"),user_id,issued_at));
+
+    // 更换密钥（如未配置密钥时重启）后旧令牌失效
+    check::expect("更换密钥",sessions.init("",3600));
+    check::expect("旧密钥签发的令牌失效",!sessions.verifyToken(token,user_id,issued_at));
+    check::expect("新密钥签发的令牌有效",sessions.verifyToken(sessions.issueToken(42),user_id,issued_at));
+    return check::finish();
+}
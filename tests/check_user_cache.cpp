@@ -0,0 +1,63 @@
+//
+// Created by Cando on 2026/10/19.
+//
+// 用户资料缓存检查：分片LRU的淘汰顺序与过期时间，以及UserCache的负缓存与双索引失效
+#include "business/user_cache.h"
+#include "common/lru_cache.h"
+#include "check.h"
+#include <thread>
+
+using namespace easychat;
+using namespace std::chrono_literals;
+
+int main(){
+    // 单分片便于确定淘汰顺序
+    ShardedLruCache<int,int> cache(1,3);
+    cache.put(1,10,10s);
+    cache.put(2,20,10s);
+    cache.put(3,30,10s);
+    int value = 0;
+    check::expect("命中",cache.get(1,value) && value==10);
+    cache.put(4,40,10s);
+    check::expect("超出容量时淘汰最久未使用的条目",!cache.get(2,value) && cache.get(1,value) && cache.evictions()==1);
+    cache.put(3,33,10s);
+    check::expect("覆盖已有条目不淘汰",cache.get(3,value) && value==33 && cache.size()==3 && cache.evictions()==1);
+    int old = 0;
+    check::expect("删除时返回旧值",cache.erase(4,&old) && old==40 && !cache.get(4,value) && !cache.erase(4));
+    cache.put(5,50,20ms);
+    std::this_thread::sleep_for(40ms);
+    check::expect("过期条目视为未命中并被移除",!cache.get(5,value) && cache.size()==2);
+    cache.setCapacity(1);
+    check::expect("缩小容量时立即淘汰",cache.size()==1 && cache.get(3,value));
+
+    UserCache users;
+    users.configure(100,50,20);
+    UserInfo user{7,"alice","hash","Alice","",1};
+    UserInfo found{};
+    check::expect("未缓存",users.getById(7,found)==UserCache::Lookup::MISS);
+    users.put(user);
+    check::expect("按ID命中",users.getById(7,found)==UserCache::Lookup::HIT && found.username=="alice");
+    found = UserInfo{};
+    check::expect("按用户名命中同一条目",users.getByName("alice",found)==UserCache::Lookup::HIT && found.id==7);
+    users.invalidate(7);
+    check::expect("按ID失效时同时移除用户名索引",users.getByName("alice",found)==UserCache::Lookup::MISS);
+
+    users.putMissing("nobody");
+    users.putMissing(404);
+    check::expect("负缓存",users.getByName("nobody",found)==UserCache::Lookup::NOT_FOUND &&
+                          users.getById(404,found)==UserCache::Lookup::NOT_FOUND);
+    std::this_thread::sleep_for(40ms);
+    check::expect("负缓存按较短的时间过期",users.getByName("nobody",found)==UserCache::Lookup::MISS);
+
+    users.put(user);
+    std::this_thread::sleep_for(70ms);
+    check::expect("用户资料过期",users.getById(7,found)==UserCache::Lookup::MISS);
+
+    UserCache disabled;
+    disabled.configure(100,0,0);
+    disabled.put(user);
+    disabled.putMissing(404);
+    check::expect("过期时间为0时关闭缓存",disabled.getById(7,found)==UserCache::Lookup::MISS &&
+                                         disabled.getById(404,found)==UserCache::Lookup::MISS);
+    return check::finish();
+}
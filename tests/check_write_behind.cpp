@@ -0,0 +1,166 @@
+//
+// Created by Cando on 2026/10/19.
+//
+// 异步批量写入器检查：同一键的变更合并、未启动时同步写入、单批上限、
+// 写入失败后与新变更按先后顺序合并并重试、待写表上限，以及停止时写完剩余变更；
+// 在线状态写入器在一个周期内的多次上下线只写一次，最终状态与已写入的状态相同时不写库
+#include "common/write_behind_batcher.h"
+#include "business/presence_writer.h"
+#include "database/log_message_store.h"
+#include "check.h"
+#include <atomic>
+#include <map>
+#include <memory>
+#include <filesystem>
+#include <thread>
+#include <unistd.h>
+
+using namespace easychat;
+using namespace std::chrono_literals;
+
+namespace {
+    // 一次变更：count为合并的变更次数，last为最后一次变更的值
+    struct Update{
+        int key;
+        int count;
+        int last;
+    };
+
+    std::unique_ptr<WriteBehindBatcher<int,Update>> makeBatcher(){
+        return std::make_unique<WriteBehindBatcher<int,Update>>("check updates",[](const Update& update){return update.key;},
+                                                                [](Update& older,Update&& newer){
+                                                                    older.count += newer.count;
+                                                                    older.last = newer.last;
+                                                                });
+    }
+
+    // 记录写入结果的存储，可以模拟写入失败
+    struct FakeSink{
+        std::mutex mutex;
+        std::map<int,Update> written;
+        std::vector<size_t> batch_sizes;
+        std::atomic<bool> failing{false};
+        bool flush(std::vector<Update>& batch){
+            std::lock_guard<std::mutex> lock(mutex);
+            if (failing) return false;
+            batch_sizes.push_back(batch.size());
+            for (const auto& update:batch){
+                Update& target = written[update.key];
+                target.key = update.key;
+                target.count += update.count;
+                target.last = update.last;
+            }
+            return true;
+        }
+    };
+
+    // 记录在线状态写入的日志存储
+    class CountingStore : public LogMessageStore{
+    public:
+        std::mutex mutex;
+        std::vector<PresenceUpdate> updates;
+        bool updatePresence(const std::vector<PresenceUpdate>& batch) override{
+            if (!LogMessageStore::updatePresence(batch)) return false;
+            std::lock_guard<std::mutex> lock(mutex);
+            updates.insert(updates.end(),batch.begin(),batch.end());
+            return true;
+        }
+        size_t count(){
+            std::lock_guard<std::mutex> lock(mutex);
+            return updates.size();
+        }
+    };
+
+    template<typename Predicate> bool waitFor(Predicate predicate,int timeout_ms){
+        auto deadline = std::chrono::steady_clock::now()+std::chrono::milliseconds(timeout_ms);
+        while (!predicate()){
+            if (std::chrono::steady_clock::now()>=deadline) return false;
+            std::this_thread::sleep_for(5ms);
+        }
+        return true;
+    }
+}
+
+int main(){
+    // 未启动：每次变更同步写入
+    {
+        FakeSink sink;
+        auto batcher = makeBatcher();
+        batcher->add(Update{1,1,10});
+        check::expect("未设置回调时只进入待写表",batcher->pendingCount()==1);
+        batcher->setFlush([&sink](std::vector<Update>& batch){return sink.flush(batch);});
+        batcher->add(Update{1,1,11});
+        check::expect("未启动时同步写入（与之前的变更合并）",batcher->pendingCount()==0 &&
+                                                        sink.written[1].count==2 && sink.written[1].last==11);
+    }
+
+    // 启动后：周期内同一键合并为一项，按单批上限分批写入
+    {
+        FakeSink sink;
+        auto batcher = makeBatcher();
+        batcher->setFlush([&sink](std::vector<Update>& batch){return sink.flush(batch);});
+        sink.failing = true;
+        batcher->start(20,4);
+        std::vector<Update> updates;
+        for (int round=0;round<5;++round){
+            for (int key=0;key<10;++key) updates.push_back(Update{key,1,round});
+        }
+        check::expect("批量记录",batcher->add(std::move(updates))==50);
+        check::expect("同一键合并为一项",batcher->pendingCount()==10);
+
+        // 写入失败期间到达的新变更：以失败的一项为较早的变更合并
+        std::this_thread::sleep_for(60ms);
+        check::expect("写入失败后放回待写表",batcher->pendingCount()==10 && sink.written.empty());
+        batcher->add(Update{3,1,99});
+        sink.failing = false;
+        check::expect("恢复后写完",waitFor([&batcher]{return batcher->pendingCount()==0;},2000));
+        std::lock_guard<std::mutex> lock(sink.mutex);
+        bool merged = sink.written.size()==10;
+        for (const auto& [key,update]:sink.written){
+            merged &= update.count==(key==3 ? 6 : 5) && update.last==(key==3 ? 99 : 4);
+        }
+        check::expect("重试时合并失败的变更与新变更，保留最后的值",merged);
+        bool bounded = true;
+        for (size_t size:sink.batch_sizes) bounded &= size<=4;
+        check::expect("单批不超过上限",bounded && sink.batch_sizes.size()>=3);
+    }
+
+    // 待写表上限与停止时写完剩余变更
+    {
+        FakeSink sink;
+        auto batcher = makeBatcher();
+        batcher->setFlush([&sink](std::vector<Update>& batch){return sink.flush(batch);});
+        batcher->start(10000,100,3);
+        bool accepted = batcher->add(Update{1,1,1}) && batcher->add(Update{2,1,1}) && batcher->add(Update{3,1,1});
+        check::expect("待写表已满时丢弃新键",accepted && !batcher->add(Update{4,1,1}));
+        check::expect("待写表已满时已有的键仍可合并",batcher->add(Update{1,1,2}));
+        batcher->stop();
+        check::expect("停止时写完剩余变更",batcher->pendingCount()==0 && sink.written.size()==3 &&
+                                         sink.written[1].count==2 && sink.written.count(4)==0);
+    }
+
+    // 在线状态：快速断线重连只写最终状态
+    {
+        std::string dir = "/tmp/easychat_check_presence_"+std::to_string(getpid());
+        auto store = std::make_shared<CountingStore>();
+        int user_id = 0;
+        check::expect("打开日志存储",store->init(dir,1024*1024,0,10) && store->createUser("presence","hash","",user_id));
+        PresenceWriter writer;
+        writer.init(store);
+        writer.start(200,100);
+        writer.online(user_id,5,"127.0.0.1",1000);
+        writer.offline(user_id);
+        writer.online(user_id,6,"127.0.0.1",1001);
+        check::expect("一个周期内的多次上下线只写一次",waitFor([&writer]{return writer.pendingCount()==0;},2000) &&
+                                                      waitFor([&store]{return store->count()==1;},2000) &&
+                                                      store->updates[0].status==1 && store->updates[0].socket_fd==6);
+        writer.offline(user_id);
+        writer.online(user_id,6,"127.0.0.1",1001);
+        std::this_thread::sleep_for(400ms);
+        check::expect("最终状态与已写入的状态相同时不写库",writer.pendingCount()==0 && store->count()==1);
+        writer.stop();
+        store->close();
+        std::filesystem::remove_all(dir);
+    }
+    return check::finish();
+}
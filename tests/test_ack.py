@@ -0,0 +1,118 @@
+import socket
+import struct
+import sys
+import time
+
+# 投递确认测试：未确认的消息在同一设备重连时重发，已确认的消息不再作为离线消息补发
+# 服务器需关闭消息过期清理（[retention] enabled = false 或 ttl_seconds 大于测试时长），
+# 否则未确认的消息可能在重连前被清理
+
+# 消息类型
+MSG_TYPE_LOGIN = 1
+MSG_TYPE_REGISTER = 3
+MSG_TYPE_CHAT = 5
+MSG_TYPE_OFFLINE_MSG = 7
+MSG_TYPE_ACK = 26
+
+def send_message(sock, msg_type, user_id, data):
+    """发送消息到服务器"""
+    body = data.encode('utf-8')
+    header = struct.pack('!III', 12 + len(body), msg_type, user_id)
+    sock.sendall(header + body)
+
+def receive_exact(sock, size):
+    """接收指定字节数"""
+    data = b''
+    while len(data) < size:
+        chunk = sock.recv(size - len(data))
+        if not chunk:
+            return None
+        data += chunk
+    return data
+
+def receive_message(sock, timeout=3):
+    """从服务器接收消息，超时返回None"""
+    sock.settimeout(timeout)
+    try:
+        header = receive_exact(sock, 12)
+        if not header:
+            return None
+        total_length, msg_type, user_id = struct.unpack('!III', header)
+        data = receive_exact(sock, total_length - 12)
+        if data is None:
+            return None
+        return msg_type, user_id, data.decode('utf-8', errors='replace')
+    except socket.timeout:
+        return None
+
+def receive_all(sock, timeout=1):
+    """接收直到超时没有新消息"""
+    messages = []
+    while True:
+        msg = receive_message(sock, timeout)
+        if not msg:
+            return messages
+        messages.append(msg)
+
+def login(username, password, device=''):
+    """注册（已存在时忽略）并登录，返回连接与用户ID"""
+    sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    sock.connect(('localhost', 8888))
+    send_message(sock, MSG_TYPE_REGISTER, 0, f"{username}:{password}")
+    receive_message(sock)
+    send_message(sock, MSG_TYPE_LOGIN, 0, f"{username}:{password}" + (f":{device}" if device else ""))
+    msg = receive_message(sock)
+    if not msg or not msg[2].startswith("Login successful"):
+        print(f"{username} 登录失败: {msg}")
+        sys.exit(1)
+    return sock, msg[1]
+
+def check(name, ok, detail=''):
+    print(f"[{'通过' if ok else '失败'}] {name}{' ' + str(detail) if detail else ''}")
+    return ok
+
+def test_ack_redelivery():
+    """测试投递确认：未确认的消息在重连时重发，已确认的消息不再作为离线消息补发"""
+    print("=== 测试投递确认与重发 ===")
+    tag = str(int(time.time()) % 1000000)
+    sender, sender_id = login(f"acka{tag}", "123456")
+    receiver, receiver_id = login(f"ackb{tag}", "123456", "phone")
+    receive_all(sender)
+    receive_all(receiver)
+
+    # 发送6条消息，接收者只确认前3条
+    for i in range(6):
+        send_message(sender, MSG_TYPE_CHAT, sender_id, f"{receiver_id}:ack test {i}")
+    pushed = [m for m in receive_all(receiver) if m[0] == MSG_TYPE_CHAT]
+    ok = check("在线推送6条", len(pushed) == 6, len(pushed))
+    ids = [m[2].split(':')[0] for m in pushed]
+    send_message(receiver, MSG_TYPE_ACK, receiver_id, ",".join(ids[:3]))
+    # 等待投递状态批量写入
+    time.sleep(1)
+    receiver.close()
+    time.sleep(0.5)
+
+    # 同一设备重连：未确认的3条重发
+    receiver, _ = login(f"ackb{tag}", "123456", "phone")
+    frames = receive_all(receiver)
+    redelivered = [m[2].split(':')[0] for m in frames if m[0] in (MSG_TYPE_CHAT, MSG_TYPE_OFFLINE_MSG)]
+    ok &= check("同一设备重连重发未确认的消息", set(ids[3:]) <= set(redelivered), redelivered)
+    # 同步批次末尾的确认号原样确认
+    for m in frames:
+        if m[0] == MSG_TYPE_ACK:
+            send_message(receiver, MSG_TYPE_ACK, receiver_id, m[2])
+    receiver.close()
+    time.sleep(0.5)
+
+    # 新设备上线：只补发仍未确认的离线消息
+    tablet, _ = login(f"ackb{tag}", "123456", "tablet")
+    offline = [m[2].split(':')[0] for m in receive_all(tablet) if m[0] == MSG_TYPE_OFFLINE_MSG]
+    ok &= check("已确认的消息不作为离线消息补发", not (set(ids[:3]) & set(offline)), offline)
+
+    tablet.close()
+    sender.close()
+    print("测试完成" if ok else "测试失败")
+    return ok
+
+if __name__ == "__main__":
+    sys.exit(0 if test_ack_redelivery() else 1)
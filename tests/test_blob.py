@@ -0,0 +1,167 @@
+import hashlib
+import os
+import socket
+import struct
+import sys
+import time
+
+# 附件测试：分块上传与断点续传、按内容去重、下载的访问控制，以及引用未上传附件的消息被拒绝
+# 服务器需配置 [blob] dir（留空时关闭附件上传），max_mb 与 user_quota_mb 不小于1MB
+
+# 消息类型
+MSG_TYPE_LOGIN = 1
+MSG_TYPE_REGISTER = 3
+MSG_TYPE_CHAT = 5
+MSG_TYPE_ERROR = 9
+MSG_TYPE_BLOB_BEGIN = 30
+MSG_TYPE_BLOB_CHUNK = 31
+MSG_TYPE_BLOB_RESP = 32
+MSG_TYPE_BLOB_GET = 33
+MSG_TYPE_BLOB_DATA = 34
+
+# 附件大小与分块大小（每块至多256KB）
+BLOB_SIZE = 600 * 1024
+CHUNK_SIZE = 256 * 1024
+
+def send_message(sock, msg_type, user_id, data):
+    """发送消息到服务器（data为str或bytes）"""
+    body = data.encode('utf-8') if isinstance(data, str) else data
+    header = struct.pack('!III', 12 + len(body), msg_type, user_id)
+    sock.sendall(header + body)
+
+def receive_exact(sock, size):
+    """接收指定字节数"""
+    data = b''
+    while len(data) < size:
+        chunk = sock.recv(size - len(data))
+        if not chunk:
+            return None
+        data += chunk
+    return data
+
+def receive_message(sock, timeout=3):
+    """从服务器接收消息（消息体为bytes），超时返回None"""
+    sock.settimeout(timeout)
+    try:
+        header = receive_exact(sock, 12)
+        if not header:
+            return None
+        total_length, msg_type, user_id = struct.unpack('!III', header)
+        data = receive_exact(sock, total_length - 12)
+        if data is None:
+            return None
+        return msg_type, user_id, data
+    except socket.timeout:
+        return None
+
+def receive_all(sock, timeout=1):
+    """接收直到超时没有新消息"""
+    messages = []
+    while True:
+        msg = receive_message(sock, timeout)
+        if not msg:
+            return messages
+        messages.append(msg)
+
+def login(username, password):
+    """注册（已存在时忽略）并登录，返回连接与用户ID"""
+    sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    sock.connect(('localhost', 8888))
+    send_message(sock, MSG_TYPE_REGISTER, 0, f"{username}:{password}")
+    receive_message(sock)
+    send_message(sock, MSG_TYPE_LOGIN, 0, f"{username}:{password}")
+    msg = receive_message(sock)
+    if not msg or not msg[2].startswith(b"Login successful"):
+        print(f"{username} 登录失败: {msg}")
+        sys.exit(1)
+    return sock, msg[1]
+
+def check(name, ok, detail=''):
+    print(f"[{'通过' if ok else '失败'}] {name}{' ' + str(detail) if detail else ''}")
+    return ok
+
+def begin_upload(sock, user_id, sha, size):
+    """开始上传，返回服务器已收到的字节数（出错时返回错误信息）"""
+    send_message(sock, MSG_TYPE_BLOB_BEGIN, user_id, f"{sha}:{size}")
+    msg = receive_message(sock)
+    if not msg or msg[0] != MSG_TYPE_BLOB_RESP:
+        return msg
+    return int(msg[2].decode().split(':')[1])
+
+def upload(sock, user_id, sha, blob, offset):
+    """从offset开始分块上传，返回最后的上传进度"""
+    while offset < len(blob):
+        chunk = blob[offset:offset + CHUNK_SIZE]
+        send_message(sock, MSG_TYPE_BLOB_CHUNK, user_id, f"{sha}:{offset}:".encode() + chunk)
+        offset += len(chunk)
+    return receive_message(sock, timeout=5)
+
+def download(sock, user_id, sha):
+    """下载整个附件，返回内容（失败时返回错误帧）"""
+    send_message(sock, MSG_TYPE_BLOB_GET, user_id, f"{sha}:0:0")
+    data = b''
+    while True:
+        msg = receive_message(sock)
+        if not msg:
+            return data
+        if msg[0] == MSG_TYPE_ERROR:
+            return msg
+        if msg[0] != MSG_TYPE_BLOB_DATA:
+            continue
+        _, offset, total, raw = msg[2].split(b':', 3)
+        data += raw
+        if int(offset) + len(raw) >= int(total):
+            return data
+
+def test_blob_upload_dedupe():
+    """测试附件分块上传、按内容去重与访问控制"""
+    print("=== 测试附件上传与去重 ===")
+    tag = str(int(time.time()) % 1000000)
+    owner, owner_id = login(f"blba{tag}", "123456")
+    peer, peer_id = login(f"blbb{tag}", "123456")
+    other, other_id = login(f"blbc{tag}", "123456")
+    for sock in (owner, peer, other):
+        receive_all(sock)
+
+    blob = os.urandom(BLOB_SIZE)
+    sha = hashlib.sha256(blob).hexdigest()
+
+    # 分块上传：先上传第一块后中断，重新开始时从已收到的位置续传
+    ok = check("新附件从0开始上传", begin_upload(owner, owner_id, sha, BLOB_SIZE) == 0)
+    send_message(owner, MSG_TYPE_BLOB_CHUNK, owner_id, f"{sha}:0:".encode() + blob[:CHUNK_SIZE])
+    resumed = begin_upload(owner, owner_id, sha, BLOB_SIZE)
+    ok &= check("断点续传返回已收到的字节数", resumed == CHUNK_SIZE, resumed)
+    done = upload(owner, owner_id, sha, blob, resumed)
+    ok &= check("上传完成", done is not None and done[0] == MSG_TYPE_BLOB_RESP
+                and done[2].decode() == f"{sha}:{BLOB_SIZE}:{BLOB_SIZE}", done and done[2][:100])
+    ok &= check("上传者再次上传无需传输", begin_upload(owner, owner_id, sha, BLOB_SIZE) == BLOB_SIZE)
+
+    # 其他用户不能下载，开始上传时也不透露附件已存在
+    denied = download(other, other_id, sha)
+    ok &= check("无关用户下载被拒绝", isinstance(denied, tuple) and denied[2].startswith(b"Blob not found"), denied)
+    ok &= check("无关用户开始上传时不透露附件已存在", begin_upload(other, other_id, sha, BLOB_SIZE) == 0)
+    # 其他用户完整上传相同内容后只保存一份，视为已有访问权
+    done = upload(other, other_id, sha, blob, 0)
+    ok &= check("相同内容的重复上传完成", done is not None and done[0] == MSG_TYPE_BLOB_RESP
+                and done[2].decode() == f"{sha}:{BLOB_SIZE}:{BLOB_SIZE}", done and done[2][:100])
+
+    # 发送引用附件的消息，接收者获得访问权
+    send_message(owner, MSG_TYPE_CHAT, owner_id, f"{peer_id}:file:{sha}:{BLOB_SIZE}:test.bin")
+    pushed = [m for m in receive_all(peer) if m[0] == MSG_TYPE_CHAT]
+    ok &= check("接收者收到附件引用", len(pushed) == 1 and f"file:{sha}".encode() in pushed[0][2])
+    ok &= check("接收者无需上传即可访问", begin_upload(peer, peer_id, sha, BLOB_SIZE) == BLOB_SIZE)
+    ok &= check("接收者下载内容一致", download(peer, peer_id, sha) == blob)
+
+    # 引用未上传的附件的消息不存储也不推送
+    missing = hashlib.sha256(b"missing" + blob[:16]).hexdigest()
+    send_message(owner, MSG_TYPE_CHAT, owner_id, f"{peer_id}:file:{missing}:16:missing.bin")
+    pushed = [m for m in receive_all(peer) if m[0] == MSG_TYPE_CHAT]
+    ok &= check("引用不存在的附件的消息被拒绝", pushed == [], pushed)
+
+    for sock in (owner, peer, other):
+        sock.close()
+    print("测试完成" if ok else "测试失败")
+    return ok
+
+if __name__ == "__main__":
+    sys.exit(0 if test_blob_upload_dedupe() else 1)
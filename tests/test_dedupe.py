@@ -0,0 +1,111 @@
+import socket
+import struct
+import sys
+import time
+
+# 幂等发送测试：带客户端消息ID（c<id>:）的重发只回复原消息ID，不再存储和推送
+# 服务器的 [dedupe] ttl_seconds 需大于测试时长（默认300秒）
+
+# 消息类型
+MSG_TYPE_LOGIN = 1
+MSG_TYPE_REGISTER = 3
+MSG_TYPE_CHAT = 5
+MSG_TYPE_CHAT_RESP = 6
+MSG_TYPE_ERROR = 9
+
+def send_message(sock, msg_type, user_id, data):
+    """发送消息到服务器"""
+    body = data.encode('utf-8')
+    header = struct.pack('!III', 12 + len(body), msg_type, user_id)
+    sock.sendall(header + body)
+
+def receive_exact(sock, size):
+    """接收指定字节数"""
+    data = b''
+    while len(data) < size:
+        chunk = sock.recv(size - len(data))
+        if not chunk:
+            return None
+        data += chunk
+    return data
+
+def receive_message(sock, timeout=3):
+    """从服务器接收消息，超时返回None"""
+    sock.settimeout(timeout)
+    try:
+        header = receive_exact(sock, 12)
+        if not header:
+            return None
+        total_length, msg_type, user_id = struct.unpack('!III', header)
+        data = receive_exact(sock, total_length - 12)
+        if data is None:
+            return None
+        return msg_type, user_id, data.decode('utf-8', errors='replace')
+    except socket.timeout:
+        return None
+
+def receive_all(sock, timeout=1):
+    """接收直到超时没有新消息"""
+    messages = []
+    while True:
+        msg = receive_message(sock, timeout)
+        if not msg:
+            return messages
+        messages.append(msg)
+
+def login(username, password, device=''):
+    """注册（已存在时忽略）并登录，返回连接与用户ID"""
+    sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    sock.connect(('localhost', 8888))
+    send_message(sock, MSG_TYPE_REGISTER, 0, f"{username}:{password}")
+    receive_message(sock)
+    send_message(sock, MSG_TYPE_LOGIN, 0, f"{username}:{password}" + (f":{device}" if device else ""))
+    msg = receive_message(sock)
+    if not msg or not msg[2].startswith("Login successful"):
+        print(f"{username} 登录失败: {msg}")
+        sys.exit(1)
+    return sock, msg[1]
+
+def check(name, ok, detail=''):
+    print(f"[{'通过' if ok else '失败'}] {name}{' ' + str(detail) if detail else ''}")
+    return ok
+
+def test_dedupe_retry():
+    """测试幂等发送：带客户端消息ID的重发只回复原消息ID，不再存储和推送"""
+    print("=== 测试客户端消息ID去重 ===")
+    tag = str(int(time.time()) % 1000000)
+    sender, sender_id = login(f"dupa{tag}", "123456")
+    receiver, receiver_id = login(f"dupb{tag}", "123456")
+    receive_all(sender)
+    receive_all(receiver)
+
+    client_id = int(time.time() * 1000)
+    send_message(sender, MSG_TYPE_CHAT, sender_id, f"c{client_id}:{receiver_id}:dedupe test")
+    first = receive_message(sender)
+    ok = check("首次发送回复客户端消息ID与消息ID", first is not None and first[0] == MSG_TYPE_CHAT_RESP
+               and first[2].startswith(f"{client_id}:"), first)
+    message_id = first[2].split(':')[1] if first else None
+
+    # 模拟未收到回复的重试：同一客户端消息ID重发两次
+    for _ in range(2):
+        send_message(sender, MSG_TYPE_CHAT, sender_id, f"c{client_id}:{receiver_id}:dedupe test")
+        retry = receive_message(sender)
+        ok &= check("重发返回原消息ID", retry is not None and retry[0] == MSG_TYPE_CHAT_RESP
+                    and retry[2] == f"{client_id}:{message_id}", retry)
+
+    pushed = [m for m in receive_all(receiver) if m[0] == MSG_TYPE_CHAT]
+    ok &= check("接收者只收到一条", len(pushed) == 1 and pushed[0][2].startswith(f"{message_id}:"), pushed)
+
+    # 不同的客户端消息ID是新消息
+    send_message(sender, MSG_TYPE_CHAT, sender_id, f"c{client_id + 1}:{receiver_id}:dedupe test")
+    other = receive_message(sender)
+    ok &= check("新的客户端消息ID分配新消息ID", other is not None and other[0] == MSG_TYPE_CHAT_RESP
+                and other[2].split(':')[1] != message_id, other)
+
+    sender.close()
+    receiver.close()
+    print("测试完成" if ok else "测试失败")
+    return ok
+
+if __name__ == "__main__":
+    sys.exit(0 if test_dedupe_retry() else 1)
@@ -0,0 +1,198 @@
+import socket
+import struct
+import sys
+import time
+
+# 日志存储的重放与压缩测试，分两步运行：
+#   python test_log_store.py write        写入数据并等待过期消息被压缩
+#   （重启服务器）
+#   python test_log_store.py verify <tag> <room_id>  校验重启后从段文件重放的数据
+# 服务器需使用日志存储并开启单聊消息过期（群聊消息永久保留），例如：
+# [storage]
+# backend = log
+# segment_size = 1
+# compaction_interval = 2
+# [retention]
+# enabled = true
+# ttl_seconds = 5
+# interval_seconds = 1
+
+# 消息类型
+MSG_TYPE_LOGIN = 1
+MSG_TYPE_REGISTER = 3
+MSG_TYPE_CHAT = 5
+MSG_TYPE_HISTORY = 10
+MSG_TYPE_HISTORY_RESP = 12
+MSG_TYPE_ROOM_CREATE = 17
+MSG_TYPE_ROOM_JOIN = 18
+MSG_TYPE_ROOM_CHAT = 20
+MSG_TYPE_ROOM_RESP = 21
+MSG_TYPE_SYNC = 24
+MSG_TYPE_SYNC_RESP = 25
+MSG_TYPE_ACK = 26
+
+# 过期的单聊消息条数与大小：写满至少一个段（segment_size = 1MB），过期后段中大部分是垃圾，触发压缩
+EXPIRED_COUNT = 600
+EXPIRED_SIZE = 2048
+# 永久保留的群聊消息条数
+ROOM_COUNT = 20
+# 等待过期与压缩的时间（秒）
+EXPIRE_TIMEOUT = 30
+COMPACT_WAIT = 5
+
+def send_message(sock, msg_type, user_id, data):
+    """发送消息到服务器"""
+    body = data.encode('utf-8')
+    header = struct.pack('!III', 12 + len(body), msg_type, user_id)
+    sock.sendall(header + body)
+
+def receive_exact(sock, size):
+    """接收指定字节数"""
+    data = b''
+    while len(data) < size:
+        chunk = sock.recv(size - len(data))
+        if not chunk:
+            return None
+        data += chunk
+    return data
+
+def receive_message(sock, timeout=3):
+    """从服务器接收消息，超时返回None"""
+    sock.settimeout(timeout)
+    try:
+        header = receive_exact(sock, 12)
+        if not header:
+            return None
+        total_length, msg_type, user_id = struct.unpack('!III', header)
+        data = receive_exact(sock, total_length - 12)
+        if data is None:
+            return None
+        return msg_type, user_id, data.decode('utf-8', errors='replace')
+    except socket.timeout:
+        return None
+
+def receive_all(sock, timeout=1):
+    """接收直到超时没有新消息"""
+    messages = []
+    while True:
+        msg = receive_message(sock, timeout)
+        if not msg:
+            return messages
+        messages.append(msg)
+
+def login(username, password, device=''):
+    """注册（已存在时忽略）并登录，返回连接与用户ID"""
+    sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    sock.connect(('localhost', 8888))
+    send_message(sock, MSG_TYPE_REGISTER, 0, f"{username}:{password}")
+    receive_message(sock)
+    send_message(sock, MSG_TYPE_LOGIN, 0, f"{username}:{password}" + (f":{device}" if device else ""))
+    msg = receive_message(sock)
+    if not msg or not msg[2].startswith("Login successful"):
+        print(f"{username} 登录失败: {msg}")
+        sys.exit(1)
+    return sock, msg[1]
+
+def check(name, ok, detail=''):
+    print(f"[{'通过' if ok else '失败'}] {name}{' ' + str(detail) if detail else ''}")
+    return ok
+
+def history(sock, user_id, peer_id):
+    """查询聊天记录，返回消息条数"""
+    send_message(sock, MSG_TYPE_HISTORY, user_id, f"{peer_id}:50")
+    while True:
+        msg = receive_message(sock)
+        if not msg:
+            return None
+        if msg[0] == MSG_TYPE_HISTORY_RESP:
+            return 0 if not msg[2] else len(msg[2].split('|'))
+
+def sync(sock, user_id, request):
+    """发送增量同步请求，返回同步到的（序号, 内容）与最后的同步结果"""
+    send_message(sock, MSG_TYPE_SYNC, user_id, request)
+    messages = []
+    while True:
+        msg = receive_message(sock)
+        if not msg:
+            return messages, None
+        if msg[0] == MSG_TYPE_SYNC_RESP:
+            _, seq, content = msg[2].split(':', 2)
+            messages.append((int(seq), content))
+        elif msg[0] == MSG_TYPE_SYNC:
+            return messages, msg[2]
+
+def write_phase():
+    """写入：过期的单聊消息（产生垃圾，触发压缩）与永久保留的群聊消息"""
+    print("=== 日志存储：写入 ===")
+    tag = str(int(time.time()) % 1000000)
+    sender, sender_id = login(f"lsa{tag}", "123456")
+    receiver, receiver_id = login(f"lsb{tag}", "123456")
+    receive_all(sender)
+    receive_all(receiver)
+
+    # 群聊消息永久保留
+    send_message(sender, MSG_TYPE_ROOM_CREATE, sender_id, f"logstore{tag}")
+    resp = receive_message(sender)
+    room_id = resp[2].split(':')[1]
+    send_message(receiver, MSG_TYPE_ROOM_JOIN, receiver_id, room_id)
+    receive_message(receiver)
+    for i in range(ROOM_COUNT):
+        send_message(sender, MSG_TYPE_ROOM_CHAT, sender_id, f"{room_id}:room {i}")
+        # 限流（默认每秒20条聊天类请求）下放慢发送
+        time.sleep(0.06)
+
+    # 单聊消息写满段后过期
+    padding = "x" * EXPIRED_SIZE
+    for i in range(EXPIRED_COUNT):
+        send_message(sender, MSG_TYPE_CHAT, sender_id, f"{receiver_id}:expire {i} {padding}")
+        time.sleep(0.06)
+    pushed = [m for m in receive_all(receiver) if m[0] == MSG_TYPE_CHAT]
+    ok = check("单聊消息全部送达", len(pushed) == EXPIRED_COUNT, len(pushed))
+    send_message(receiver, MSG_TYPE_ACK, receiver_id, ",".join(m[2].split(':')[0] for m in pushed))
+
+    deadline = time.time() + EXPIRE_TIMEOUT
+    remaining = history(receiver, receiver_id, sender_id)
+    while remaining and time.time() < deadline:
+        time.sleep(1)
+        remaining = history(receiver, receiver_id, sender_id)
+    ok &= check("单聊消息全部过期", remaining == 0, remaining)
+    # 等待后台线程压缩（服务器日志中应出现 LogMessageStore compacted）
+    time.sleep(COMPACT_WAIT)
+
+    sender.close()
+    receiver.close()
+    print(f"写入完成，重启服务器后运行: python test_log_store.py verify {tag} {room_id}" if ok else "测试失败")
+    return ok
+
+def verify_phase(tag, room_id):
+    """校验：重启后用户、群聊消息、过期删除与序号下限都从段文件重放"""
+    print("=== 日志存储：重启后校验 ===")
+    sender, sender_id = login(f"lsa{tag}", "123456")
+    receiver, receiver_id = login(f"lsb{tag}", "123456")
+    receive_all(sender)
+    receive_all(receiver)
+
+    messages, _ = sync(receiver, receiver_id, f"r{room_id}=0")
+    ok = check("群聊消息重放完整", [content for _, content in messages] == [f"room {i}" for i in range(ROOM_COUNT)],
+               len(messages))
+    messages, _ = sync(receiver, receiver_id, f"u{sender_id}=0")
+    ok &= check("已过期的单聊消息没有重新出现", messages == [], len(messages))
+
+    # 序号下限随压缩保留：新消息接着过期前的最大序号
+    send_message(sender, MSG_TYPE_CHAT, sender_id, f"{receiver_id}:after restart")
+    pushed = [m for m in receive_all(receiver) if m[0] == MSG_TYPE_CHAT]
+    seq = int(pushed[0][2].split(':')[1]) if pushed else None
+    ok &= check(f"新消息序号为{EXPIRED_COUNT + 1}", seq == EXPIRED_COUNT + 1, seq)
+
+    sender.close()
+    receiver.close()
+    print("测试完成" if ok else "测试失败")
+    return ok
+
+if __name__ == "__main__":
+    if len(sys.argv) >= 2 and sys.argv[1] == "write":
+        sys.exit(0 if write_phase() else 1)
+    elif len(sys.argv) >= 4 and sys.argv[1] == "verify":
+        sys.exit(0 if verify_phase(sys.argv[2], sys.argv[3]) else 1)
+    print("用法: python test_log_store.py write | verify <tag> <room_id>")
+    sys.exit(1)
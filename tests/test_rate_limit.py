@@ -0,0 +1,113 @@
+import socket
+import struct
+import sys
+import time
+
+# 请求限流测试：超出令牌桶的聊天请求回复 Rate limited 错误，等待 retry_after 后重发成功
+# 服务器需开启 [rate_limit] chat_rate（压测时关闭限流的配置下本测试会失败）
+
+# 消息类型
+MSG_TYPE_LOGIN = 1
+MSG_TYPE_REGISTER = 3
+MSG_TYPE_CHAT = 5
+MSG_TYPE_CHAT_RESP = 6
+MSG_TYPE_ERROR = 9
+
+# 发送的消息数，需超过服务器配置的 [rate_limit] chat_burst（默认40）
+SEND_COUNT = 100
+
+def send_message(sock, msg_type, user_id, data):
+    """发送消息到服务器"""
+    body = data.encode('utf-8')
+    header = struct.pack('!III', 12 + len(body), msg_type, user_id)
+    sock.sendall(header + body)
+
+def receive_exact(sock, size):
+    """接收指定字节数"""
+    data = b''
+    while len(data) < size:
+        chunk = sock.recv(size - len(data))
+        if not chunk:
+            return None
+        data += chunk
+    return data
+
+def receive_message(sock, timeout=3):
+    """从服务器接收消息，超时返回None"""
+    sock.settimeout(timeout)
+    try:
+        header = receive_exact(sock, 12)
+        if not header:
+            return None
+        total_length, msg_type, user_id = struct.unpack('!III', header)
+        data = receive_exact(sock, total_length - 12)
+        if data is None:
+            return None
+        return msg_type, user_id, data.decode('utf-8', errors='replace')
+    except socket.timeout:
+        return None
+
+def receive_all(sock, timeout=1):
+    """接收直到超时没有新消息"""
+    messages = []
+    while True:
+        msg = receive_message(sock, timeout)
+        if not msg:
+            return messages
+        messages.append(msg)
+
+def login(username, password, device=''):
+    """注册（已存在时忽略）并登录，返回连接与用户ID"""
+    sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    sock.connect(('localhost', 8888))
+    send_message(sock, MSG_TYPE_REGISTER, 0, f"{username}:{password}")
+    receive_message(sock)
+    send_message(sock, MSG_TYPE_LOGIN, 0, f"{username}:{password}" + (f":{device}" if device else ""))
+    msg = receive_message(sock)
+    if not msg or not msg[2].startswith("Login successful"):
+        print(f"{username} 登录失败: {msg}")
+        sys.exit(1)
+    return sock, msg[1]
+
+def check(name, ok, detail=''):
+    print(f"[{'通过' if ok else '失败'}] {name}{' ' + str(detail) if detail else ''}")
+    return ok
+
+def test_rate_limit():
+    """测试请求限流：超出令牌桶的消息回复 Rate limited 错误，等待后原样重发成功"""
+    print("=== 测试请求限流 ===")
+    tag = str(int(time.time()) % 1000000)
+    sender, sender_id = login(f"rla{tag}", "123456")
+    receiver, receiver_id = login(f"rlb{tag}", "123456")
+    receive_all(sender)
+    receive_all(receiver)
+
+    # 每条消息都带客户端消息ID，被限流的可以原样重发
+    base = int(time.time() * 1000)
+    for i in range(SEND_COUNT):
+        send_message(sender, MSG_TYPE_CHAT, sender_id, f"c{base + i}:{receiver_id}:rate {i}")
+    replies = receive_all(sender)
+    accepted = [m for m in replies if m[0] == MSG_TYPE_CHAT_RESP]
+    limited = [m for m in replies if m[0] == MSG_TYPE_ERROR and m[2].startswith("Rate limited, retry after:")]
+    ok = check("超出突发量的消息被限流", len(limited) > 0, f"accepted={len(accepted)} limited={len(limited)}")
+    ok &= check("每条消息都有回复", len(accepted) + len(limited) == SEND_COUNT, len(replies))
+    received = [m for m in receive_all(receiver) if m[0] == MSG_TYPE_CHAT]
+    ok &= check("被限流的消息没有推送", len(received) == len(accepted), len(received))
+
+    # 按错误中的等待时间等待后，原样重发第一条被限流的消息
+    if limited:
+        retry_after = int(limited[0][2].rsplit(':', 1)[1])
+        time.sleep(retry_after / 1000.0 + 0.1)
+        accepted_ids = {m[2].split(':')[0] for m in accepted}
+        retry_index = next(i for i in range(SEND_COUNT) if str(base + i) not in accepted_ids)
+        send_message(sender, MSG_TYPE_CHAT, sender_id, f"c{base + retry_index}:{receiver_id}:rate {retry_index}")
+        reply = receive_message(sender)
+        ok &= check("等待后重发成功", reply is not None and reply[0] == MSG_TYPE_CHAT_RESP, reply)
+
+    sender.close()
+    receiver.close()
+    print("测试完成" if ok else "测试失败")
+    return ok
+
+if __name__ == "__main__":
+    sys.exit(0 if test_rate_limit() else 1)
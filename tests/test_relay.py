@@ -0,0 +1,159 @@
+import os
+import socket
+import struct
+import sys
+import time
+
+# 在线直传测试：接收者拒绝、完整传输、发送者中途断开与接收者中途断开
+# 服务器需开启 [relay] max_mb（不小于1MB），idle_timeout_seconds 大于1秒
+
+# 消息类型
+MSG_TYPE_LOGIN = 1
+MSG_TYPE_REGISTER = 3
+MSG_TYPE_ERROR = 9
+MSG_TYPE_RELAY_BEGIN = 35
+MSG_TYPE_RELAY_RESP = 36
+MSG_TYPE_RELAY_DATA = 37
+MSG_TYPE_RELAY_OFFER = 38
+MSG_TYPE_RELAY_ACCEPT = 39
+MSG_TYPE_RELAY_START = 40
+
+# 直传的文件大小
+FILE_SIZE = 256 * 1024
+
+def send_message(sock, msg_type, user_id, data):
+    """发送消息到服务器（data为str或bytes）"""
+    body = data.encode('utf-8') if isinstance(data, str) else data
+    header = struct.pack('!III', 12 + len(body), msg_type, user_id)
+    sock.sendall(header + body)
+
+def receive_exact(sock, size):
+    """接收指定字节数"""
+    data = b''
+    while len(data) < size:
+        chunk = sock.recv(size - len(data))
+        if not chunk:
+            return None
+        data += chunk
+    return data
+
+def receive_message(sock, timeout=3):
+    """从服务器接收消息（消息体为bytes），超时返回None"""
+    sock.settimeout(timeout)
+    try:
+        header = receive_exact(sock, 12)
+        if not header:
+            return None
+        total_length, msg_type, user_id = struct.unpack('!III', header)
+        data = receive_exact(sock, total_length - 12)
+        if data is None:
+            return None
+        return msg_type, user_id, data
+    except socket.timeout:
+        return None
+
+def receive_type(sock, msg_type, timeout=3):
+    """接收直到指定类型的消息（跳过其他消息），超时返回None"""
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        msg = receive_message(sock, max(deadline - time.time(), 0.1))
+        if not msg:
+            return None
+        if msg[0] == msg_type:
+            return msg
+    return None
+
+def login(username, password):
+    """注册（已存在时忽略）并登录，返回连接与用户ID"""
+    sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    sock.connect(('localhost', 8888))
+    send_message(sock, MSG_TYPE_REGISTER, 0, f"{username}:{password}")
+    receive_message(sock)
+    send_message(sock, MSG_TYPE_LOGIN, 0, f"{username}:{password}")
+    msg = receive_message(sock)
+    if not msg or not msg[2].startswith(b"Login successful"):
+        print(f"{username} 登录失败: {msg}")
+        sys.exit(1)
+    return sock, msg[1]
+
+def check(name, ok, detail=''):
+    print(f"[{'通过' if ok else '失败'}] {name}{' ' + str(detail) if detail else ''}")
+    return ok
+
+def offer(sender, sender_id, receiver, receiver_id):
+    """发起直传并等待接收者收到邀请，返回直传ID（失败时返回None）"""
+    send_message(sender, MSG_TYPE_RELAY_BEGIN, sender_id, f"{receiver_id}:{FILE_SIZE}:test.bin")
+    resp = receive_type(sender, MSG_TYPE_RELAY_RESP)
+    if not resp or not resp[2].startswith(b"wait:"):
+        print(f"发起直传失败: {resp}")
+        return None
+    relay_id = resp[2].decode().split(':')[1]
+    invite = receive_type(receiver, MSG_TYPE_RELAY_OFFER)
+    if not invite or invite[2].decode() != f"{relay_id}:{sender_id}:{FILE_SIZE}:test.bin":
+        print(f"接收者未收到邀请: {invite}")
+        return None
+    return relay_id
+
+def test_relay_abort():
+    """测试在线直传的拒绝、完成与中途断开"""
+    print("=== 测试在线直传 ===")
+    tag = str(int(time.time()) % 1000000)
+    sender, sender_id = login(f"rlya{tag}", "123456")
+    receiver, receiver_id = login(f"rlyb{tag}", "123456")
+    data = os.urandom(FILE_SIZE)
+
+    # 接收者拒绝：发送者收到store，改为上传附件
+    relay_id = offer(sender, sender_id, receiver, receiver_id)
+    ok = check("发起直传", relay_id is not None)
+    send_message(receiver, MSG_TYPE_RELAY_ACCEPT, receiver_id, f"{relay_id}:0")
+    resp = receive_type(sender, MSG_TYPE_RELAY_RESP)
+    ok &= check("接收者拒绝后发送者收到store", resp is not None and resp[2].decode() == f"store:{relay_id}", resp)
+
+    # 完整传输
+    relay_id = offer(sender, sender_id, receiver, receiver_id)
+    send_message(receiver, MSG_TYPE_RELAY_ACCEPT, receiver_id, f"{relay_id}:1")
+    resp = receive_type(sender, MSG_TYPE_RELAY_RESP)
+    ok &= check("接收者接受后发送者收到go", resp is not None and resp[2].decode() == f"go:{relay_id}", resp)
+    send_message(sender, MSG_TYPE_RELAY_START, sender_id, f"{relay_id}:{FILE_SIZE}")
+    sender.sendall(data)
+    frame = receive_type(receiver, MSG_TYPE_RELAY_DATA, timeout=5)
+    prefix = f"{relay_id}:{sender_id}:{FILE_SIZE}:test.bin:".encode()
+    ok &= check("接收者收到完整数据", frame is not None and frame[2] == prefix + data)
+    resp = receive_type(sender, MSG_TYPE_RELAY_RESP)
+    ok &= check("发送者收到done", resp is not None and resp[2].decode() == f"done:{relay_id}", resp)
+
+    # 发送者中途断开：接收者的帧以0补齐，随后收到Relay aborted
+    relay_id = offer(sender, sender_id, receiver, receiver_id)
+    send_message(receiver, MSG_TYPE_RELAY_ACCEPT, receiver_id, f"{relay_id}:1")
+    receive_type(sender, MSG_TYPE_RELAY_RESP)
+    send_message(sender, MSG_TYPE_RELAY_START, sender_id, f"{relay_id}:{FILE_SIZE}")
+    sender.sendall(data[:FILE_SIZE // 2])
+    time.sleep(0.3)
+    sender.close()
+    frame = receive_type(receiver, MSG_TYPE_RELAY_DATA, timeout=5)
+    ok &= check("发送者断开后接收者的帧保持完整长度", frame is not None and len(frame[2]) == len(prefix) + FILE_SIZE
+                and frame[2][len(prefix):len(prefix) + FILE_SIZE // 2] == data[:FILE_SIZE // 2])
+    error = receive_type(receiver, MSG_TYPE_ERROR, timeout=5)
+    ok &= check("接收者收到Relay aborted", error is not None and error[2].decode() == f"Relay aborted:{relay_id}", error)
+
+    # 接收者中途断开：发送者收到store，连接可继续使用
+    sender, sender_id = login(f"rlya{tag}", "123456")
+    relay_id = offer(sender, sender_id, receiver, receiver_id)
+    send_message(receiver, MSG_TYPE_RELAY_ACCEPT, receiver_id, f"{relay_id}:1")
+    receive_type(sender, MSG_TYPE_RELAY_RESP)
+    receiver.close()
+    time.sleep(0.3)
+    send_message(sender, MSG_TYPE_RELAY_START, sender_id, f"{relay_id}:{FILE_SIZE}")
+    sender.sendall(data)
+    resp = receive_type(sender, MSG_TYPE_RELAY_RESP, timeout=5)
+    ok &= check("接收者断开后发送者收到store", resp is not None and resp[2].decode() == f"store:{relay_id}", resp)
+    send_message(sender, MSG_TYPE_RELAY_BEGIN, sender_id, f"{receiver_id}:{FILE_SIZE}:test.bin")
+    resp = receive_type(sender, MSG_TYPE_RELAY_RESP)
+    ok &= check("连接继续可用（接收者离线时直接回复store）", resp is not None and resp[2] == b"store", resp)
+
+    sender.close()
+    print("测试完成" if ok else "测试失败")
+    return ok
+
+if __name__ == "__main__":
+    sys.exit(0 if test_relay_abort() else 1)
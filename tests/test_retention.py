@@ -0,0 +1,147 @@
+import socket
+import struct
+import sys
+import time
+
+# 消息过期测试：后台清理删除过期消息后，会话序号不回退，已同步的序号仍然有效
+# 服务器需开启消息过期清理，例如：
+# [retention]
+# enabled = true
+# ttl_seconds = 2
+# interval_seconds = 1
+
+# 消息类型
+MSG_TYPE_LOGIN = 1
+MSG_TYPE_REGISTER = 3
+MSG_TYPE_CHAT = 5
+MSG_TYPE_HISTORY = 10
+MSG_TYPE_HISTORY_RESP = 12
+MSG_TYPE_SYNC = 24
+MSG_TYPE_SYNC_RESP = 25
+MSG_TYPE_ACK = 26
+
+# 等待过期清理的最长时间（秒）
+EXPIRE_TIMEOUT = 15
+
+def send_message(sock, msg_type, user_id, data):
+    """发送消息到服务器"""
+    body = data.encode('utf-8')
+    header = struct.pack('!III', 12 + len(body), msg_type, user_id)
+    sock.sendall(header + body)
+
+def receive_exact(sock, size):
+    """接收指定字节数"""
+    data = b''
+    while len(data) < size:
+        chunk = sock.recv(size - len(data))
+        if not chunk:
+            return None
+        data += chunk
+    return data
+
+def receive_message(sock, timeout=3):
+    """从服务器接收消息，超时返回None"""
+    sock.settimeout(timeout)
+    try:
+        header = receive_exact(sock, 12)
+        if not header:
+            return None
+        total_length, msg_type, user_id = struct.unpack('!III', header)
+        data = receive_exact(sock, total_length - 12)
+        if data is None:
+            return None
+        return msg_type, user_id, data.decode('utf-8', errors='replace')
+    except socket.timeout:
+        return None
+
+def receive_all(sock, timeout=1):
+    """接收直到超时没有新消息"""
+    messages = []
+    while True:
+        msg = receive_message(sock, timeout)
+        if not msg:
+            return messages
+        messages.append(msg)
+
+def login(username, password, device=''):
+    """注册（已存在时忽略）并登录，返回连接与用户ID"""
+    sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    sock.connect(('localhost', 8888))
+    send_message(sock, MSG_TYPE_REGISTER, 0, f"{username}:{password}")
+    receive_message(sock)
+    send_message(sock, MSG_TYPE_LOGIN, 0, f"{username}:{password}" + (f":{device}" if device else ""))
+    msg = receive_message(sock)
+    if not msg or not msg[2].startswith("Login successful"):
+        print(f"{username} 登录失败: {msg}")
+        sys.exit(1)
+    return sock, msg[1]
+
+def check(name, ok, detail=''):
+    print(f"[{'通过' if ok else '失败'}] {name}{' ' + str(detail) if detail else ''}")
+    return ok
+
+def history(sock, user_id, peer_id):
+    """查询聊天记录，返回消息条数"""
+    send_message(sock, MSG_TYPE_HISTORY, user_id, f"{peer_id}:50")
+    while True:
+        msg = receive_message(sock)
+        if not msg:
+            return None
+        if msg[0] == MSG_TYPE_HISTORY_RESP:
+            return 0 if not msg[2] else len(msg[2].split('|'))
+
+def sync(sock, user_id, request):
+    """发送增量同步请求，返回同步到的序号与最后的同步结果"""
+    send_message(sock, MSG_TYPE_SYNC, user_id, request)
+    seqs = []
+    while True:
+        msg = receive_message(sock)
+        if not msg:
+            return seqs, None
+        if msg[0] == MSG_TYPE_SYNC_RESP:
+            seqs.append(int(msg[2].split(':', 2)[1]))
+        elif msg[0] == MSG_TYPE_SYNC:
+            return seqs, msg[2]
+
+def test_retention_seq_floor():
+    """测试消息过期后会话序号不回退：新消息接着原来的最大序号，已同步的序号仍然有效"""
+    print("=== 测试消息过期与序号下限 ===")
+    tag = str(int(time.time()) % 1000000)
+    sender, sender_id = login(f"rtna{tag}", "123456")
+    receiver, receiver_id = login(f"rtnb{tag}", "123456")
+    receive_all(sender)
+    receive_all(receiver)
+
+    for i in range(1, 4):
+        send_message(sender, MSG_TYPE_CHAT, sender_id, f"{receiver_id}:retention {i}")
+    pushed = [m for m in receive_all(receiver) if m[0] == MSG_TYPE_CHAT]
+    ok = check("过期前收到3条", len(pushed) == 3, len(pushed))
+    send_message(receiver, MSG_TYPE_ACK, receiver_id, ",".join(m[2].split(':')[0] for m in pushed))
+
+    # 等待会话的消息全部过期
+    deadline = time.time() + EXPIRE_TIMEOUT
+    remaining = history(receiver, receiver_id, sender_id)
+    while remaining and time.time() < deadline:
+        time.sleep(1)
+        remaining = history(receiver, receiver_id, sender_id)
+    ok &= check("消息全部过期", remaining == 0, remaining)
+
+    # 新消息的序号接着被删除消息的最大序号
+    send_message(sender, MSG_TYPE_CHAT, sender_id, f"{receiver_id}:after expiry")
+    pushed = [m for m in receive_all(receiver) if m[0] == MSG_TYPE_CHAT]
+    seq = int(pushed[0][2].split(':')[1]) if pushed else None
+    ok &= check("过期后的新消息序号为4", seq == 4, seq)
+
+    # 客户端已同步到的序号仍然有效，只返回之后的新消息
+    seqs, summary = sync(receiver, receiver_id, f"u{sender_id}=3")
+    ok &= check("从序号3同步只返回新消息", seqs == [4] and summary == f"u{sender_id}=4:4", (seqs, summary))
+    seqs, summary = sync(receiver, receiver_id, f"u{sender_id}=0")
+    ok &= check("已过期的消息不再返回", seqs == [4], seqs)
+
+    sender.close()
+    receiver.close()
+    print("测试完成" if ok else "测试失败")
+    return ok
+
+if __name__ == "__main__":
+    sys.exit(0 if test_retention_seq_floor() else 1)
@@ -0,0 +1,122 @@
+import socket
+import struct
+import sys
+import time
+
+# 增量同步测试：客户端提交各会话已同步的序号，服务器只返回其后的消息
+# 服务器使用默认的 [sync] 配置即可（近期消息缓存未命中时从存储补齐）
+
+# 消息类型
+MSG_TYPE_LOGIN = 1
+MSG_TYPE_REGISTER = 3
+MSG_TYPE_CHAT = 5
+MSG_TYPE_SYNC = 24
+MSG_TYPE_SYNC_RESP = 25
+
+def send_message(sock, msg_type, user_id, data):
+    """发送消息到服务器"""
+    body = data.encode('utf-8')
+    header = struct.pack('!III', 12 + len(body), msg_type, user_id)
+    sock.sendall(header + body)
+
+def receive_exact(sock, size):
+    """接收指定字节数"""
+    data = b''
+    while len(data) < size:
+        chunk = sock.recv(size - len(data))
+        if not chunk:
+            return None
+        data += chunk
+    return data
+
+def receive_message(sock, timeout=3):
+    """从服务器接收消息，超时返回None"""
+    sock.settimeout(timeout)
+    try:
+        header = receive_exact(sock, 12)
+        if not header:
+            return None
+        total_length, msg_type, user_id = struct.unpack('!III', header)
+        data = receive_exact(sock, total_length - 12)
+        if data is None:
+            return None
+        return msg_type, user_id, data.decode('utf-8', errors='replace')
+    except socket.timeout:
+        return None
+
+def receive_all(sock, timeout=1):
+    """接收直到超时没有新消息"""
+    messages = []
+    while True:
+        msg = receive_message(sock, timeout)
+        if not msg:
+            return messages
+        messages.append(msg)
+
+def login(username, password, device=''):
+    """注册（已存在时忽略）并登录，返回连接与用户ID"""
+    sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    sock.connect(('localhost', 8888))
+    send_message(sock, MSG_TYPE_REGISTER, 0, f"{username}:{password}")
+    receive_message(sock)
+    send_message(sock, MSG_TYPE_LOGIN, 0, f"{username}:{password}" + (f":{device}" if device else ""))
+    msg = receive_message(sock)
+    if not msg or not msg[2].startswith("Login successful"):
+        print(f"{username} 登录失败: {msg}")
+        sys.exit(1)
+    return sock, msg[1]
+
+def check(name, ok, detail=''):
+    print(f"[{'通过' if ok else '失败'}] {name}{' ' + str(detail) if detail else ''}")
+    return ok
+
+def sync(sock, user_id, request):
+    """发送增量同步请求，返回同步到的消息（序号, 内容）与最后的同步结果"""
+    send_message(sock, MSG_TYPE_SYNC, user_id, request)
+    messages = []
+    while True:
+        msg = receive_message(sock)
+        if not msg:
+            return messages, None
+        if msg[0] == MSG_TYPE_SYNC_RESP:
+            conversation, seq, content = msg[2].split(':', 2)
+            messages.append((int(seq), content))
+        elif msg[0] == MSG_TYPE_SYNC:
+            return messages, msg[2]
+
+def test_sync_delta():
+    """测试增量同步：只返回客户端已同步序号之后的消息"""
+    print("=== 测试增量同步 ===")
+    tag = str(int(time.time()) % 1000000)
+    sender, sender_id = login(f"syna{tag}", "123456")
+    receiver, receiver_id = login(f"synb{tag}", "123456")
+    receive_all(sender)
+    receive_all(receiver)
+
+    for i in range(1, 6):
+        send_message(sender, MSG_TYPE_CHAT, sender_id, f"{receiver_id}:sync {i}")
+    pushed = [m for m in receive_all(receiver) if m[0] == MSG_TYPE_CHAT]
+    seqs = [int(m[2].split(':')[1]) for m in pushed]
+    ok = check("推送的消息带递增序号", seqs == [1, 2, 3, 4, 5], seqs)
+
+    # 客户端只收到了序号2为止的消息
+    messages, summary = sync(receiver, receiver_id, f"u{sender_id}=2")
+    ok &= check("返回序号2之后的消息", [seq for seq, _ in messages] == [3, 4, 5], messages)
+    ok &= check("消息内容正确", [content for _, content in messages] == ["sync 3", "sync 4", "sync 5"])
+    ok &= check("同步结果为 已同步序号:最新序号", summary == f"u{sender_id}=5:5", summary)
+
+    # 已是最新时不返回消息
+    messages, summary = sync(receiver, receiver_id, f"u{sender_id}=5")
+    ok &= check("已同步到最新时没有消息", messages == [] and summary == f"u{sender_id}=5:5", summary)
+
+    # 发送者一侧的同一会话序号相同
+    messages, summary = sync(sender, sender_id, f"u{receiver_id}=4")
+    ok &= check("对方同步同一会话", [seq for seq, _ in messages] == [5], messages)
+
+    sender.close()
+    receiver.close()
+    print("测试完成" if ok else "测试失败")
+    return ok
+
+if __name__ == "__main__":
+    sys.exit(0 if test_sync_delta() else 1)
@@ -6,6 +6,10 @@ import time
 # 消息类型
 MSG_TYPE_LOGIN = 1
 MSG_TYPE_CHAT = 5
+MSG_TYPE_ERROR = 9
+
+# 接收超时（秒）：超过该时间没有新消息则结束，不会一直等待被限流丢弃的消息
+RECEIVE_TIMEOUT = 5
 
 def send_message(sock, msg_type, user_id, data):
     """发送消息到服务器"""
@@ -15,17 +19,42 @@ def send_message(sock, msg_type, user_id, data):
     header = struct.pack('!III', total_length, msg_type, user_id)
     sock.sendall(header + data.encode('utf-8'))
 
+def receive_exact(sock, size):
+    """接收指定字节数"""
+    data = b''
+    while len(data) < size:
+        chunk = sock.recv(size - len(data))
+        if not chunk:
+            return None
+        data += chunk
+    return data
+
 def receive_message(sock):
     """从服务器接收消息"""
-    header = sock.recv(12)
+    header = receive_exact(sock, 12)
     if not header:
         return None
     total_length, msg_type, user_id = struct.unpack('!III', header)
-    data = sock.recv(total_length - 12)
-    if not data:
+    data = receive_exact(sock, total_length - 12)
+    if data is None:
         return None
     return msg_type, user_id, data.decode('utf-8')
 
+def limited_thread(sock, stats):
+    """统计发送方收到的限流错误（服务器直接丢弃被限流的消息）"""
+    sock.settimeout(RECEIVE_TIMEOUT)
+    while not stats['done']:
+        try:
+            msg = receive_message(sock)
+        except socket.timeout:
+            continue
+        except OSError:
+            return
+        if not msg:
+            return
+        if msg[0] == MSG_TYPE_ERROR and msg[2].startswith("Rate limited"):
+            stats['limited'] += 1
+
 def sender_thread(sock, user_id, receiver_id, count):
     """发送消息的线程"""
     start_time = time.time()
@@ -35,15 +64,28 @@ def sender_thread(sock, user_id, receiver_id, count):
     print(f"发送完成，耗时: {end_time - start_time:.2f} 秒")
     print(f"发送速率: {count / (end_time - start_time):.2f} 消息/秒")
 
-def receiver_thread(sock, count):
+def receiver_thread(sock, count, stats):
     """接收消息的线程"""
     received = 0
     start_time = time.time()
-    while received < count:
-        msg = receive_message(sock)
-        if msg:
+    end_time = start_time
+    sock.settimeout(RECEIVE_TIMEOUT)
+    while received + stats['limited'] < count:
+        try:
+            msg = receive_message(sock)
+        except socket.timeout:
+            break
+        if not msg:
+            break
+        if msg[0] == MSG_TYPE_CHAT:
             received += 1
-    end_time = time.time()
+            end_time = time.time()
+    if stats['limited'] > 0:
+        print(f"{stats['limited']} 条消息被限流丢弃，测试完整吞吐量请将 [rate_limit] chat_rate 设为0")
+    if received == 0:
+        print("没有收到消息")
+        return
+    end_time = max(end_time, start_time + 1e-6)
     print(f"接收完成，耗时: {end_time - start_time:.2f} 秒")
     print(f"接收速率: {received / (end_time - start_time):.2f} 消息/秒")
 
@@ -70,8 +112,11 @@ def test_throughput():
     # 测试参数
     message_count = 1000  # 发送1000条消息
 
-    # 启动接收线程
-    receiver = threading.Thread(target=receiver_thread, args=(sock2, message_count))
+    # 启动接收线程与限流统计线程
+    stats = {'limited': 0, 'done': False}
+    limited = threading.Thread(target=limited_thread, args=(sock1, stats))
+    limited.start()
+    receiver = threading.Thread(target=receiver_thread, args=(sock2, message_count, stats))
     receiver.start()
 
     # 启动发送线程
@@ -81,6 +126,8 @@ def test_throughput():
     # 等待线程完成
     sender.join()
     receiver.join()
+    stats['done'] = True
+    limited.join()
 
     # 关闭连接
     sock1.close()